@@ -13,6 +13,7 @@
 #include "IntelGEM.h"
 #include "IntelRingBuffer.h"
 #include "IntelContext.h"
+#include "IntelPPGTT.h"
 #include "IntelRequest.h"
 #include "IntelFence.h"
 #include "IntelBlitter.h"  // For blitter engine
@@ -1325,12 +1326,13 @@ void AppleIntelTGLController::cleanupResources()
  * Register Access Helpers
 
 u32 AppleIntelTGLController::readRegister32(u32 offset) const {
-    return uncore ? uncore->readRegister32(offset) : 0;
+    // Trace against our caller, not this forwarding wrapper
+    return uncore ? uncore->readRegister32From(offset, __builtin_return_address(0)) : 0;
 }
 
 void AppleIntelTGLController::writeRegister32(u32 offset, u32 value) {
     if (uncore) {
-        uncore->writeRegister32(offset, value);
+        uncore->writeRegister32From(offset, value, __builtin_return_address(0));
     }
 }
 
@@ -1397,6 +1399,48 @@ IntelFence* AppleIntelTGLController::createFence() {
     return fence;
 }
 
+uint32_t AppleIntelTGLController::createFences(IntelFence** fences, uint32_t count) {
+    if (!fences || count == 0) {
+        return 0;
+    }
+    
+    if (!fenceLock) {
+        fenceLock = IOLockAlloc();
+        if (!fenceLock) {
+            IOLog("AppleIntelTGL: Failed to allocate fence lock\n");
+            return 0;
+        }
+    }
+    
+    if (!activeFences) {
+        activeFences = OSArray::withCapacity(64);
+        if (!activeFences) {
+            IOLog("AppleIntelTGL: Failed to allocate fence array\n");
+            return 0;
+        }
+    }
+    
+    IOLockLock(fenceLock);
+    
+    // Grow the array once for the whole batch
+    activeFences->ensureCapacity(activeFences->getCount() + count);
+    
+    uint32_t created = 0;
+    while (created < count) {
+        IntelFence* fence = IntelFence::create(nextFenceId);
+        if (!fence) {
+            break;
+        }
+        nextFenceId++;
+        activeFences->setObject(fence);
+        fences[created++] = fence;
+    }
+    
+    IOLockUnlock(fenceLock);
+    
+    return created;
+}
+
 IntelFence* AppleIntelTGLController::findFence(uint32_t fenceId) {
     if (!activeFences || !fenceLock) {
         return nullptr;
@@ -1427,6 +1471,25 @@ void AppleIntelTGLController::signalFence(uint32_t fenceId) {
     }
 }
 
+void AppleIntelTGLController::signalFencesUpTo(uint32_t engine, uint32_t seqno) {
+    if (!activeFences || !fenceLock) {
+        return;
+    }
+    
+    IOLockLock(fenceLock);
+    
+    // Seqno 0 means the submitter has not stamped the fence yet
+    for (unsigned int i = 0; i < activeFences->getCount(); i++) {
+        IntelFence* fence = OSDynamicCast(IntelFence, activeFences->getObject(i));
+        if (fence && fence->getEngineId() == engine && fence->getSeqno() != 0 &&
+            (int32_t)(seqno - fence->getSeqno()) >= 0 && !fence->isSignaled()) {
+            fence->signal();
+        }
+    }
+    
+    IOLockUnlock(fenceLock);
+}
+
 void AppleIntelTGLController::releaseFence(uint32_t fenceId) {
     if (!activeFences || !fenceLock) {
         return;
@@ -1501,6 +1564,7 @@ IOReturn AppleIntelTGLController::mapSurfaceToGPU(IOMemoryDescriptor* mem, uint6
     ret = bindGEMtoPPGTT(gem, defaultContext);
     if (ret != kIOReturnSuccess) {
         IOLog("ERROR: Failed to bind GEM to PPGTT: 0x%x\n", ret);
+        defaultContext->getPPGTT()->freeSpace(gpuVA, (size_t)length);
         map->release();
         gem->destroy();
         mem->complete();
@@ -1528,20 +1592,22 @@ uint64_t AppleIntelTGLController::allocateGPUVirtualAddress(uint64_t size) {
     // Align to 4KB page boundary
     size = (size + 0xFFF) & ~0xFFFULL;
     
-    // Allocate from PPGTT range (start at 1GB to avoid NULL)
-    // Tiger Lake supports 48-bit addressing (256TB)
-    static uint64_t nextVA = 0x40000000ULL; // Start at 1GB
-    
-    uint64_t va = nextVA;
-    nextVA += size;
+    // Allocate from the default context's own PPGTT address space
+    // (VA 0 is never handed out, so 0 still means failure)
+    IntelPPGTT* ppgtt = defaultContext ? defaultContext->getPPGTT() : NULL;
+    if (!ppgtt) {
+        IOLog("ERROR: No PPGTT for GPU VA allocation\n");
+        return 0;
+    }
     
-    // Check for overflow (shouldn't happen with 48-bit)
-    if (nextVA >= (1ULL << 48)) {
+    // Size-based alignment so large surfaces get 2MB/64KB PPGTT pages
+    uint64_t va = ppgtt->allocateSpace((size_t)size, IntelPPGTT::alignmentFor((size_t)size));
+    if (va == 0) {
         IOLog("ERROR: GPU VA space exhausted!\n");
         return 0;
     }
     
-    IOLog("Allocated GPU VA: 0x%llx - 0x%llx (%llu bytes)\n", va, nextVA - 1, size);
+    IOLog("Allocated GPU VA: 0x%llx - 0x%llx (%llu bytes)\n", va, va + size - 1, size);
     
     return va;
 }
@@ -1558,8 +1624,11 @@ IOReturn AppleIntelTGLController::unmapSurfaceFromGPU(uint64_t gpuAddress) {
         
         IntelGEMObject* gem = (IntelGEMObject*)num->unsigned64BitValue();
         if (gem && gem->getGPUAddress() == gpuAddress) {
-            // Unbind from PPGTT
+            // Unbind from PPGTT and release the VA range
             unbindGEMfromPPGTT(gem, defaultContext);
+            if (defaultContext && defaultContext->getPPGTT()) {
+                defaultContext->getPPGTT()->freeSpace(gpuAddress, (size_t)gem->getSize());
+            }
             
             // Free GEM object (this will release memory descriptor)
             gem->destroy();
@@ -1586,38 +1655,13 @@ IOReturn AppleIntelTGLController::bindGEMtoPPGTT(IntelGEMObject* gem, IntelConte
     // Get page tables for this context
     IntelPPGTT* ppgtt = context->getPPGTT();
     uint64_t va = gem->getGPUAddress();
-    uint64_t size = gem->getSize();
-    
-    // Walk through pages
-    uint32_t pageCount = (uint32_t)((size + 4095) / 4096);
+    uint32_t pageCount = (uint32_t)((gem->getSize() + 4095) / 4096);
     
-    for (uint32_t i = 0; i < pageCount; i++) {
-        uint64_t pageVA = va + (i * 4096);
-        
-        // Get physical address for this page
-        IOPhysicalAddress pa = 0;
-        
-        IOMemoryDescriptor* memDesc = gem->getMemoryDescriptor();
-        if (memDesc) {
-            IOByteCount segmentLength = 0;
-            pa = memDesc->getPhysicalSegment(i * 4096, &segmentLength, 0);
-            
-            if (pa == 0 || segmentLength == 0) {
-                IOLog("WARNING: Failed to get physical address for page %u\n", i);
-                continue;
-            }
-        }
-        
-        // Create page table entry
-        // Format: [63:12] = physical address, [11:0] = flags
-        // Note: PPGTT_PTE constants would be defined in i915_reg.h
-        uint64_t pte = (pa & ~0xFFFULL) | 0x1 | 0x2; // Valid + Writeable flags
-        
-        // Install PTE in page table (would need setPPGTTEntry implementation)
-        // For now, just log
-        if (i < 5 || i == pageCount - 1) {  // Log first few and last
-            IOLog("  Page %u: VA=0x%llx -> PA=0x%llx\n", i, pageVA, pa);
-        }
+    // Walk the backing segments and write PTEs, allocating PDP/PD/PT on demand
+    if (!ppgtt->insertEntries(va, gem->getMemoryDescriptor(),
+                              GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE)) {
+        IOLog("ERROR: PPGTT insert failed at VA=0x%llx\n", va);
+        return kIOReturnNoMemory;
     }
     
     IOLog("OK  Bound %u pages to PPGTT\n", pageCount);
@@ -1633,9 +1677,11 @@ IOReturn AppleIntelTGLController::unbindGEMfromPPGTT(IntelGEMObject* gem, IntelC
     IOLog("Unbinding GEM from PPGTT: VA=0x%llx, size=%llu\n",
           gem->getGPUAddress(), gem->getSize());
     
-    // Clear page table entries
+    // Clear page table entries (empty tables go back to the pool)
     uint32_t pageCount = (uint32_t)((gem->getSize() + 4095) / 4096);
     
+    context->getPPGTT()->clearEntries(gem->getGPUAddress(), (size_t)gem->getSize());
+    
     IOLog("OK  Unbound %u pages from PPGTT\n", pageCount);
     
     return kIOReturnSuccess;
@@ -82,8 +82,10 @@ virtual void free(void) APPLE_KEXT_OVERRIDE;
     
     // Fence management
     class IntelFence* createFence();
+    uint32_t createFences(class IntelFence** fences, uint32_t count);  // One lock round trip
     class IntelFence* findFence(uint32_t fenceId);
     void signalFence(uint32_t fenceId);
+    void signalFencesUpTo(uint32_t engine, uint32_t seqno);  // Render-complete path
     void releaseFence(uint32_t fenceId);
     
     /* Register access helpers (delegate to uncore) - implemented in .cpp to avoid incomplete type */
@@ -21,6 +21,7 @@
 #include "IntelIOSurfaceManager.h"
 #include "IntelBlitter.h"
 #include "IntelRingBuffer.h"
+#include "IntelUncore.h"
 #include <IOKit/IOMemoryDescriptor.h>
 #include <IOKit/IOLib.h>
 #include <mach/mach_time.h>
@@ -241,8 +242,18 @@ IOExternalMethodDispatch IntelDeviceClient::sDeviceMethods[25] = {
  { NULL, 0, 0, 0, 0 }, // 20
  { NULL, 0, 0, 0, 0 }, // 21
  { NULL, 0, 0, 0, 0 }, // 22
- { NULL, 0, 0, 0, 0 }, // 23
- { NULL, 0, 0, 0, 0 }  // 24
+ 
+ // Selector 23: mmio_trace_control - scalar in: enable; out: enabled, record size
+ {
+     (IOExternalMethodAction)&IntelDeviceClient::s_mmio_trace_control,
+     1, 0, 2, 0
+ },
+ 
+ // Selector 24: mmio_trace_drain - Drains intel_mmio_trace_record[]; out: count, dropped
+ {
+     (IOExternalMethodAction)&IntelDeviceClient::s_mmio_trace_drain,
+     0, 0, 2, 0xFFFFFFFF
+ }
 };
 
 // CRITICAL: externalMethod - Apple's actual dispatch mechanism
@@ -472,6 +483,89 @@ IOReturn IntelDeviceClient::s_set_api_property(OSObject* target, void* ref,
  return kIOReturnSuccess;
 }
 
+IOReturn IntelDeviceClient::s_mmio_trace_control(OSObject* target, void* ref,
+                                            IOExternalMethodArguments* args)
+{
+ IntelDeviceClient* me = OSDynamicCast(IntelDeviceClient, target);
+ if (!me) return kIOReturnBadArgument;
+ 
+ // Register values are not something every Metal client should see
+ if (IOUserClient::clientHasPrivilege(me->owningTask, kIOClientPrivilegeAdministrator) != kIOReturnSuccess) {
+     return kIOReturnNotPrivileged;
+ }
+ 
+ IntelUncore* uncore = me->controller ? me->controller->getUncore() : NULL;
+ if (!uncore) return kIOReturnNotReady;
+ 
+ bool enable = args->scalarInput[0] != 0;
+ IOLog("[TGL][DeviceClient] mmio_trace_control (selector 23) enable=%d\n", enable);
+ 
+ if (!uncore->mmioTraceEnable(enable)) {
+     return kIOReturnNoMemory;
+ }
+ 
+ args->scalarOutput[0] = uncore->isMMIOTraceEnabled() ? 1 : 0;
+ args->scalarOutput[1] = sizeof(struct intel_mmio_trace_record);
+ return kIOReturnSuccess;
+}
+
+IOReturn IntelDeviceClient::s_mmio_trace_drain(OSObject* target, void* ref,
+                                          IOExternalMethodArguments* args)
+{
+ IntelDeviceClient* me = OSDynamicCast(IntelDeviceClient, target);
+ if (!me) return kIOReturnBadArgument;
+ 
+ if (IOUserClient::clientHasPrivilege(me->owningTask, kIOClientPrivilegeAdministrator) != kIOReturnSuccess) {
+     return kIOReturnNotPrivileged;
+ }
+ 
+ IntelUncore* uncore = me->controller ? me->controller->getUncore() : NULL;
+ if (!uncore) return kIOReturnNotReady;
+ 
+ const uint32_t recordSize = sizeof(struct intel_mmio_trace_record);
+ uint32_t total = 0;
+ uint64_t dropped = 0;
+ 
+ if (args->structureOutputDescriptor) {
+     // Large captures arrive as a descriptor; drain through a small bounce buffer
+     IOMemoryDescriptor* md = args->structureOutputDescriptor;
+     uint32_t max = (uint32_t)(md->getLength() / recordSize);
+     struct intel_mmio_trace_record chunk[16];
+     
+     if (md->prepare() != kIOReturnSuccess) {
+         return kIOReturnVMError;
+     }
+     
+     while (total < max) {
+         uint32_t want = max - total;
+         if (want > 16) {
+             want = 16;
+         }
+         
+         uint64_t lost = 0;
+         uint32_t n = uncore->mmioTraceDrain(chunk, want, &lost);
+         dropped += lost;
+         if (n == 0) {
+             break;
+         }
+         
+         md->writeBytes((IOByteCount)total * recordSize, chunk, (IOByteCount)n * recordSize);
+         total += n;
+     }
+     
+     md->complete();
+     args->structureOutputDescriptorSize = total * recordSize;
+ } else if (args->structureOutput) {
+     total = uncore->mmioTraceDrain((struct intel_mmio_trace_record*)args->structureOutput,
+                                    args->structureOutputSize / recordSize, &dropped);
+     args->structureOutputSize = total * recordSize;
+ }
+ 
+ args->scalarOutput[0] = total;
+ args->scalarOutput[1] = dropped;
+ return kIOReturnSuccess;
+}
+
 // Private implementations
 IOReturn IntelDeviceClient::doGet_config(IOAccelDeviceConfigData* output) {
   if (!output) return kIOReturnBadArgument;
@@ -737,7 +831,7 @@ IOExternalMethodDispatch IntelContextClient::sContextMethods[8] = {
  // Selector 2: submit_data_buffers  THE GPU COMMAND SUBMISSION!
  {
      (IOExternalMethodAction)&IntelContextClient::s_submit_data_buffers,
-     0, 0x88, 3, 0xFFFFFFFF
+     0, 0xFFFFFFFF, 3, 0xFFFFFFFF    // 0x88 per buffer; several may be batched
  },
  
  // Selector 3: get_data_buffer
@@ -768,7 +862,7 @@ IOExternalMethodDispatch IntelContextClient::sContextMethods[8] = {
  // Selector 7: submit_data_buffers (foreground variant)
  {
      (IOExternalMethodAction)&IntelContextClient::s_submit_data_buffers,
-     0, 0x88, 0x13, 0xFFFFFFFF
+     0, 0xFFFFFFFF, 0x13, 0xFFFFFFFF
  }
 };
 
@@ -1183,34 +1277,26 @@ IOReturn IntelContextClient::doSetClientInfo(const IOAccelClientInfo* clientInfo
 IOReturn IntelContextClient::doSubmitDataBuffers(const IOAccelContextSubmitDataBuffersIn* input,
                                              IOAccelContextSubmitDataBuffersOut* output,
                                              uint32_t inputSize, uint32_t outputSize) {
- if (!input || inputSize < sizeof(IOAccelContextSubmitDataBuffersIn)) {
+ // A call may carry several buffers back to back; each gets an output slot
+ if (!input || inputSize < sizeof(IOAccelContextSubmitDataBuffersIn) ||
+     inputSize % sizeof(IOAccelContextSubmitDataBuffersIn)) {
      IOLog("[TGL][ContextClient] ERROR: Invalid submit_data_buffers input\n");
      return kIOReturnBadArgument;
  }
  
- if (!output || outputSize < sizeof(IOAccelContextSubmitDataBuffersOut)) {
-     IOLog("[TGL][ContextClient] ERROR: Invalid submit_data_buffers output\n");
+ uint32_t count = inputSize / sizeof(IOAccelContextSubmitDataBuffersIn);
+ if (count > kMaxSubmitBurst) {
+     IOLog("[TGL][ContextClient] ERROR: %u buffers in one submit (max %u)\n", count, kMaxSubmitBurst);
      return kIOReturnBadArgument;
  }
  
- IOLog("[TGL][ContextClient]  REAL GPU COMMAND SUBMISSION:\n");
- IOLog("   - Client Type: %u (%s)\n", clientType,
-       clientType == kIOAccelClientType2DContext ? "WindowServer 2D" :
-       clientType == kIOAccelClientTypeContext ? "GL/Metal Context" :
-       clientType == kIOAccelClientTypeVideoContext ? "Video Context" : "Unknown");
- IOLog("   - Buffer Address: 0x%llx\n", input->bufferAddress);
- IOLog("   - Buffer Size: %u bytes\n", input->bufferSize);
- IOLog("   - Context ID: %u\n", input->contextID);
- IOLog("   - Fence Address: 0x%llx\n", input->fenceAddress);
- IOLog("   - Fence Value: %u\n", input->fenceValue);
- IOLog("   - Queue ID: %u\n", input->queueID);
- IOLog("   - Priority: %u\n", input->priority);
- IOLog("   - Command Count: %u\n", input->commandCount);
- IOLog("   - Timestamp: %llu\n", input->timestamp);
+ if (!output || outputSize < count * sizeof(IOAccelContextSubmitDataBuffersOut)) {
+     IOLog("[TGL][ContextClient] ERROR: Invalid submit_data_buffers output\n");
+     return kIOReturnBadArgument;
+ }
  
  //  SPECIAL HANDLING FOR Type 3: WindowServer 2D Compositing
  if (clientType == kIOAccelClientType2DContext) {
-     IOLog("[TGL][ContextClient]   WindowServer 2D compositing path\n");
      return doSubmit2DCommands(input, output, inputSize, outputSize);
  }
  
@@ -1232,28 +1318,7 @@ IOReturn IntelContextClient::doSubmitDataBuffers(const IOAccelContextSubmitDataB
          break;
      }
      
-     // Step 2: Map command buffer from userspace to kernel
-     IOMemoryDescriptor* cmdBufferDesc = NULL;
-
-     if (input->bufferAddress != 0 && input->bufferSize > 0) {
-         if (!owningTask) {
-             IOLog("[TGL][ContextClient] ERROR: No owning task for userspace mapping\n");
-             result = kIOReturnNotReady;
-             break;
-         }
-
-         cmdBufferDesc = IOMemoryDescriptor::withAddressRange(
-             input->bufferAddress,
-             input->bufferSize,
-             kIODirectionIn,
-             owningTask);
-
-         if (!cmdBufferDesc) {
-             IOLog("[TGL][ContextClient] WARNING: Failed to map userspace command buffer\n");
-         }
-     }
-     
-     // Step 3: Ensure GPU context
+     // Step 2: Ensure GPU context
      if (!gpuContext) {
          gpuContext = new IntelContext();
          if (!gpuContext || !gpuContext->init(controller, input->contextID)) {
@@ -1261,7 +1326,6 @@ IOReturn IntelContextClient::doSubmitDataBuffers(const IOAccelContextSubmitDataB
                  gpuContext->release();
              }
              gpuContext = NULL;
-             if (cmdBufferDesc) cmdBufferDesc->release();
              result = kIOReturnNoMemory;
              break;
          }
@@ -1271,149 +1335,127 @@ IOReturn IntelContextClient::doSubmitDataBuffers(const IOAccelContextSubmitDataB
              gpuContext->bindRing(ring);
          }
 
-         if (gucSubmission) {
-             gucSubmission->registerContext(gpuContext, input->priority);
-         }
+         gucSubmission->registerContext(gpuContext, input->priority);
      }
 
-     // Step 4: Create GPU request
-     IntelRequest* gpuRequest = new IntelRequest;
-     if (!gpuRequest) {
-         IOLog("[TGL][ContextClient] ERROR: Failed to create GPU request\n");
-         if (cmdBufferDesc) cmdBufferDesc->release();
-         result = kIOReturnNoMemory;
-         break;
+     // Step 3: Build a request per buffer; nothing is queued unless all are valid
+     IntelRequest* requests[kMaxSubmitBurst];
+     uint32_t prepared = 0;
+     uint32_t seqno = gucSubmission->getCurrentFenceValue();
+     while (prepared < count) {
+         requests[prepared] = prepareDataBufferRequest(&input[prepared], ++seqno, &result);
+         if (!requests[prepared]) {
+             break;
+         }
+         prepared++;
      }
      
-     if (!gpuRequest->init()) {
-         IOLog("[TGL][ContextClient] ERROR: Failed to init GPU request\n");
-         gpuRequest->release();
-         if (cmdBufferDesc) cmdBufferDesc->release();
-         result = kIOReturnError;
+     if (prepared < count) {
+         for (uint32_t i = 0; i < prepared; i++) {
+             requests[i]->release();
+         }
          break;
      }
      
-     // Step 5: Configure the request
-     gpuRequest->setContextID(input->contextID);
-     gpuRequest->setQueueID(input->queueID);
-     gpuRequest->setPriority((IntelRequestPriority)input->priority);
-     gpuRequest->setCommandCount(input->commandCount);
-     gpuRequest->setState(REQUEST_STATE_ALLOCATED);
-     gpuRequest->setHangTimeout(5000);
-     if (!gpuRequest->setBatchAddress(input->bufferAddress)) {
-         IOLog("[TGL][ContextClient] ERROR: Invalid batch address\n");
-         gpuRequest->release();
-         if (cmdBufferDesc) cmdBufferDesc->release();
-         result = kIOReturnBadArgument;
-         break;
-     }
-     gpuRequest->setBatchLength(input->bufferSize);
-     gpuRequest->setContext(gpuContext);
-
-     IntelRingBuffer* ring = controller->getRenderRing();
-     if (ring) {
-         gpuRequest->setRing(ring);
-     }
-
-     uint32_t seqno = gucSubmission ? (gucSubmission->getCurrentFenceValue() + 1) : 1;
-     gpuRequest->setSeqno(seqno);
-
-     if (cmdBufferDesc) {
-         gpuRequest->setCommandBuffer(cmdBufferDesc);
-         if (!gpuRequest->validateCommandBuffer()) {
-             IOLog("[TGL][ContextClient] ERROR: Command buffer validation failed\n");
-             gpuRequest->release();
-             cmdBufferDesc->release();
-             result = kIOReturnBadArgument;
-             break;
-         }
-         cmdBufferDesc->release();
-         cmdBufferDesc = NULL;
+     // Step 4: Submit the whole burst: one work-queue append and one doorbell
+     // per context run instead of one per buffer
+     uint32_t submitted = gucSubmission->submitRequests(requests, count);
+     if (submitted < count) {
+         IOLog("[TGL][ContextClient] WARNING: GuC took %u of %u buffers\n", submitted, count);
+         result = kIOReturnNotReady;
      }
      
-     // Step 6: Submit to GuC (Gen12+ preferred) or ring buffer (fallback)
-     IOLog("[TGL][ContextClient]  Submitting to GuC submission system...\n");
-     
-     bool submitted = gucSubmission->submitRequest(gpuRequest);
-     if (!submitted) {
-         IOLog("[TGL][ContextClient] WARNING: GuC submission failed\n");
-         gpuRequest->release();
-         if (cmdBufferDesc) cmdBufferDesc->release();
-         result = kIOReturnNotReady;
-         break;
+     // Step 5: Return per-buffer results and track what reached the GuC
+     bzero(output, count * sizeof(IOAccelContextSubmitDataBuffersOut));
+     for (uint32_t i = 0; i < count; i++) {
+         IntelFence* fence = (i < submitted) ? requests[i]->getModernFence() : NULL;
          
-         /* TODO: Implement ring buffer fallback
-         // Fallback to direct ring buffer submission
-         IntelRingBuffer* ring = controller->getRingBuffer(RCS0); // Render Command Streamer
-         if (!ring) {
-             IOLog("[TGL][ContextClient] ERROR: No ring buffer available\n");
-             gpuRequest->release();
-             if (cmdBufferDesc) cmdBufferDesc->release();
-             result = kIOReturnNotReady;
-             break;
-         }
+         output[i].status = (i < submitted) ? 0 : (uint32_t)kIOReturnNotReady;
+         output[i].sequenceNumber = requests[i]->getSequenceNumber();
+         output[i].fenceID = fence ? fence->getId() : 0;
+         output[i].completionTime = 0;  // Unknown until fence signals
          
-         // Submit directly to ring buffer
-         if (!ring->begin(64)) {  // Reserve 64 dwords
-             IOLog("[TGL][ContextClient] ERROR: Failed to begin ring buffer\n");
-             gpuRequest->release();
-             if (cmdBufferDesc) cmdBufferDesc->release();
-             result = kIOReturnNotReady;
-             break;
+         // Track request for hang detection
+         if (fence) {
+             trackSubmittedRequest(requests[i], fence->getId(), input[i].timestamp);
          }
          
-         // TODO: Actually write commands to ring buffer
-         // For now, just emit NOOPs
-         ring->emit(0x00000000);  // NOOP
-         ring->emit(0x00000000);  // NOOP
-         
-         if (!ring->advance()) {
-             IOLog("[TGL][ContextClient] ERROR: Failed to advance ring buffer\n");
-             gpuRequest->release();
-             if (cmdBufferDesc) cmdBufferDesc->release();
-             result = kIOReturnNotReady;
-             break;
-         }
-         
-         IOLog("[TGL][ContextClient] OK  Submitted via ring buffer fallback\n");
-         */
-     } else {
-         IOLog("[TGL][ContextClient] OK  Submitted via GuC hardware scheduler\n");
+         requests[i]->release();
      }
      
-     // Step 7: Create fence for completion tracking
-     IntelFence* fence = gpuRequest->getModernFence();
-     if (fence) {
-         IOLog("[TGL][ContextClient] OK  Fence created: ID=%u\n", fence->getId());
-     }
-     
-     // Step 7: Return submission results
-     bzero(output, sizeof(IOAccelContextSubmitDataBuffersOut));
-     output->status = 0;  // Success
-     output->sequenceNumber = gpuRequest->getSequenceNumber();
-     output->fenceID = fence ? fence->getId() : 0;
-     output->completionTime = 0;  // Unknown until fence signals
-     
-     IOLog("[TGL][ContextClient] OK  GPU command submission completed:\n");
-     IOLog("   - Sequence Number: %u\n", output->sequenceNumber);
-     IOLog("   - Fence ID: %u\n", output->fenceID);
-     IOLog("   - Status: 0x%x\n", output->status);
-     
-     // Track request for hang detection
-     if (fence) {
-         trackSubmittedRequest(gpuRequest, fence->getId(), input->timestamp);
+ } while (false);
+ 
+ return result;
+}
+
+IntelRequest* IntelContextClient::prepareDataBufferRequest(const IOAccelContextSubmitDataBuffersIn* input,
+                                                          uint32_t seqno, IOReturn* error) {
+ // Map command buffer from userspace to kernel
+ IOMemoryDescriptor* cmdBufferDesc = NULL;
+
+ if (input->bufferAddress != 0 && input->bufferSize > 0) {
+     if (!owningTask) {
+         IOLog("[TGL][ContextClient] ERROR: No owning task for userspace mapping\n");
+         *error = kIOReturnNotReady;
+         return NULL;
      }
 
-     // Clean up
+     cmdBufferDesc = IOMemoryDescriptor::withAddressRange(
+         input->bufferAddress,
+         input->bufferSize,
+         kIODirectionIn,
+         owningTask);
+
+     if (!cmdBufferDesc) {
+         IOLog("[TGL][ContextClient] WARNING: Failed to map userspace command buffer\n");
+     }
+ }
+ 
+ // Take a GPU request from the manager's pool
+ IntelRequestManager* requestManager = controller->getRequestManager();
+ IntelRequest* gpuRequest = requestManager ? requestManager->allocateRequest(NULL, NULL) : NULL;
+ if (!gpuRequest) {
+     IOLog("[TGL][ContextClient] ERROR: Failed to create GPU request\n");
+     if (cmdBufferDesc) cmdBufferDesc->release();
+     *error = kIOReturnNoMemory;
+     return NULL;
+ }
+ 
+ gpuRequest->setContextID(input->contextID);
+ gpuRequest->setQueueID(input->queueID);
+ gpuRequest->setPriority((IntelRequestPriority)input->priority);
+ gpuRequest->setCommandCount(input->commandCount);
+ gpuRequest->setState(REQUEST_STATE_ALLOCATED);
+ gpuRequest->setHangTimeout(5000);
+ if (!gpuRequest->setBatchAddress(input->bufferAddress)) {
+     IOLog("[TGL][ContextClient] ERROR: Invalid batch address\n");
      gpuRequest->release();
      if (cmdBufferDesc) cmdBufferDesc->release();
-     
-     // Success
-     result = kIOReturnSuccess;
-     
- } while (false);
+     *error = kIOReturnBadArgument;
+     return NULL;
+ }
+ gpuRequest->setBatchLength(input->bufferSize);
+ gpuRequest->setContext(gpuContext);
+
+ IntelRingBuffer* ring = controller->getRenderRing();
+ if (ring) {
+     gpuRequest->setRing(ring);
+ }
+
+ gpuRequest->setSeqno(seqno);
+
+ if (cmdBufferDesc) {
+     gpuRequest->setCommandBuffer(cmdBufferDesc);
+     cmdBufferDesc->release();
+     if (!gpuRequest->validateCommandBuffer()) {
+         IOLog("[TGL][ContextClient] ERROR: Command buffer validation failed\n");
+         gpuRequest->release();
+         *error = kIOReturnBadArgument;
+         return NULL;
+     }
+ }
  
- return result;
+ return gpuRequest;
 }
 
 IOReturn IntelContextClient::doReclaimResources() {
@@ -1427,18 +1469,21 @@ IOReturn IntelContextClient::doSubmit2DCommands(const IOAccelContextSubmitDataBu
                                              uint32_t inputSize, uint32_t outputSize) {
  IOLog("[TGL][2DContext] WindowServer 2D compositing\n");
  
+ // Every buffer in the call gets a zeroed result slot
+ uint32_t burst = inputSize / sizeof(IOAccelContextSubmitDataBuffersIn);
+ 
  // Get blitter for 2D ops
  IntelBlitter* blitter = controller ? controller->getBlitter() : NULL;
  if (!blitter) {
      IOLog("[TGL][2DContext] WARNING: No blitter, returning success\n");
-     bzero(output, sizeof(IOAccelContextSubmitDataBuffersOut));
+     bzero(output, burst * sizeof(IOAccelContextSubmitDataBuffersOut));
      output->status = 0;
      return kIOReturnSuccess;
  }
  
  IOLog("[TGL][2DContext] Processed %u 2D commands\n", input->commandCount);
  
- bzero(output, sizeof(IOAccelContextSubmitDataBuffersOut));
+ bzero(output, burst * sizeof(IOAccelContextSubmitDataBuffersOut));
  output->status = 0;
  output->sequenceNumber = input->contextID;
  output->fenceID = 0;
@@ -1968,7 +2013,7 @@ IOExternalMethodDispatch IntelCommandQueueClient::sCommandQueueMethods[18] = {
  // Selector 1 (index 3): submit_command_buffer
  {
      (IOExternalMethodAction)&IntelCommandQueueClient::s_submit_command_buffer,
-     0, 0x40, 3, 0
+     0, 0xFFFFFFFF, 3, 0    // 0x40 per command buffer; several may be batched
  },
  { NULL, 0, 0, 0, 0 },
  { NULL, 0, 0, 0, 0 },
@@ -2115,8 +2160,10 @@ IOReturn IntelCommandQueueClient::s_submit_command_buffer(OSObject* target, void
  
  IOLog("[TGL][CommandQueue]  submit_command_buffer (selector 1) - METAL COMMAND SUBMISSION!\n");
  
- if (args->structureInputSize < sizeof(IOAccelCommandBufferSubmit)) {
-     IOLog("[TGL][CommandQueue] ERROR: Input too small for command buffer submit\n");
+ // One or more submit records back to back, handed over as a single burst
+ if (args->structureInputSize < sizeof(IOAccelCommandBufferSubmit) ||
+     args->structureInputSize % sizeof(IOAccelCommandBufferSubmit)) {
+     IOLog("[TGL][CommandQueue] ERROR: Bad input size for command buffer submit\n");
      return kIOReturnBadArgument;
  }
  
@@ -2125,6 +2172,7 @@ IOReturn IntelCommandQueueClient::s_submit_command_buffer(OSObject* target, void
  uint32_t fence = 0;
 
  IOReturn result = me->doSubmitCommandBuffer((const IOAccelCommandBufferSubmit*)args->structureInput,
+                                             args->structureInputSize / sizeof(IOAccelCommandBufferSubmit),
                                              &status, &seqno, &fence);
 
  if (args->scalarOutputCount >= 1) {
@@ -2247,20 +2295,17 @@ IOReturn IntelCommandQueueClient::doSetNotificationPort(mach_port_t port) {
  return kIOReturnSuccess;
 }
 
-IOReturn IntelCommandQueueClient::doSubmitCommandBuffer(const IOAccelCommandBufferSubmit* submit,
+IOReturn IntelCommandQueueClient::doSubmitCommandBuffer(const IOAccelCommandBufferSubmit* submits,
+                                                    uint32_t count,
                                                     uint32_t* outStatus,
                                                     uint32_t* outSeqno,
                                                     uint32_t* outFence) {
- if (!submit || !outStatus || !outSeqno || !outFence) return kIOReturnBadArgument;
+ if (!submits || count == 0 || !outStatus || !outSeqno || !outFence) return kIOReturnBadArgument;
  
- IOLog("[TGL][CommandQueue]  METAL COMMAND SUBMISSION:\n");
- IOLog("   - Command Buffer: 0x%llx\n", submit->commandBuffer);
- IOLog("   - Command Size: %u bytes\n", submit->commandSize);
- IOLog("   - Command Count: %u\n", submit->commandCount);
- IOLog("   - Fence Address: 0x%llx\n", submit->fenceAddress);
- IOLog("   - Fence Value: %u\n", submit->fenceValue);
- IOLog("   - Priority: %u\n", submit->priority);
- IOLog("   - Timestamp: %llu\n", submit->timestamp);
+ if (count > kMaxSubmitBurst) {
+     *outStatus = (uint32_t)kIOReturnBadArgument;
+     return kIOReturnBadArgument;
+ }
  
  if (!controller) {
      *outStatus = (uint32_t)kIOReturnNotAttached;
@@ -2279,6 +2324,114 @@ IOReturn IntelCommandQueueClient::doSubmitCommandBuffer(const IOAccelCommandBuff
      return kIOReturnNotReady;
  }
 
+ IntelRequestManager* requestManager = controller->getRequestManager();
+ if (!requestManager) {
+     *outStatus = (uint32_t)kIOReturnNoMemory;
+     return kIOReturnNoMemory;
+ }
+
+ // Build every request first so a bad buffer rejects the call before
+ // anything reaches the GPU
+ IntelRequest* requests[kMaxSubmitBurst];
+ uint32_t prepared = 0;
+ uint32_t seqno = gucSubmission->getCurrentFenceValue();
+ IOReturn error = kIOReturnSuccess;
+ while (prepared < count) {
+     requests[prepared] = prepareCommandBufferRequest(&submits[prepared], context, ++seqno, &error);
+     if (!requests[prepared]) {
+         break;
+     }
+     prepared++;
+ }
+
+ if (prepared < count) {
+     for (uint32_t i = 0; i < prepared; i++) {
+         requests[i]->release();
+     }
+     *outStatus = (uint32_t)error;
+     return error;
+ }
+
+ // The whole burst goes through the request manager in one submitBatch(),
+ // so the GuC sees one work-queue append and one doorbell per context run.
+ // Once queued the manager owns the allocation reference; keep our own
+ // until the fences have been read.
+ for (uint32_t i = 0; i < count; i++) {
+     requests[i]->retain();
+ }
+ uint32_t submitted = requestManager->submitBatch(requests, count);
+ for (uint32_t i = submitted; i < count; i++) {
+     // Rolled back, so both references are still ours
+     requests[i]->release();
+     requestManager->freeRequest(requests[i]);
+ }
+ if (submitted == 0) {
+     *outStatus = (uint32_t)kIOReturnNotReady;
+     return kIOReturnNotReady;
+ }
+
+ uint32_t fenceID = 0;
+ for (uint32_t i = 0; i < submitted; i++) {
+     // Get fence before releasing request (fence is retained separately)
+     IntelFence* fence = requests[i]->getModernFence();
+     fenceID = fence ? fence->getId() : requests[i]->getSeqno();
+
+     if (queueLock) {
+         IOLockLock(queueLock);
+         if (pendingCommands) {
+             struct QueueCommandRecord {
+                 uint32_t fenceID;
+                 uint32_t seqno;
+                 uint32_t status;
+                 uint64_t submitTime;
+             } record;
+
+             record.fenceID = fenceID;
+             record.seqno = requests[i]->getSeqno();
+             record.status = 0;
+             record.submitTime = mach_absolute_time();
+
+             OSData* data = OSData::withBytes(&record, sizeof(record));
+             if (data) {
+                 pendingCommands->setObject(data);
+                 data->release();
+             }
+         }
+         IOLockUnlock(queueLock);
+     }
+
+     queueState.pendingCommands++;
+ }
+
+ // Scalar results describe the last buffer; its fence covers the burst
+ const IOAccelCommandBufferSubmit* last = &submits[submitted - 1];
+ seqno = requests[submitted - 1]->getSeqno();
+
+ queueState.commandBufferAddress = last->commandBuffer;
+ queueState.commandBufferSize = last->commandSize;
+ queueState.fenceValue = fenceID;
+ queueState.status = 1;
+
+ lastSubmittedSeqno = seqno;
+ lastSubmittedFence = fenceID;
+ lastSubmittedStatus = 0;
+
+ *outStatus = (submitted == count) ? 0 : (uint32_t)kIOReturnNotReady;
+ *outSeqno = seqno;
+ *outFence = fenceID;
+
+ for (uint32_t i = 0; i < submitted; i++) {
+     requests[i]->release();
+ }
+
+ IOLog("[TGL][CommandQueue] OK  Submitted %u of %u command buffers (seqno=%u fence=%u)\n",
+       submitted, count, seqno, fenceID);
+ return (submitted == count) ? kIOReturnSuccess : kIOReturnNotReady;
+}
+
+IntelRequest* IntelCommandQueueClient::prepareCommandBufferRequest(const IOAccelCommandBufferSubmit* submit,
+                                                                  IntelContext* context,
+                                                                  uint32_t seqno, IOReturn* error) {
  IOMemoryDescriptor* cmdBufferDesc = NULL;
  if (submit->commandBuffer != 0 && submit->commandSize > 0 && owningTask) {
      cmdBufferDesc = IOMemoryDescriptor::withAddressRange(
@@ -2288,11 +2441,12 @@ IOReturn IntelCommandQueueClient::doSubmitCommandBuffer(const IOAccelCommandBuff
          owningTask);
  }
 
- IntelRequest* request = new IntelRequest;
- if (!request || !request->init()) {
+ IntelRequestManager* requestManager = controller->getRequestManager();
+ IntelRequest* request = requestManager->allocateRequest(NULL, context);
+ if (!request) {
      if (cmdBufferDesc) cmdBufferDesc->release();
-     *outStatus = (uint32_t)kIOReturnNoMemory;
-     return kIOReturnNoMemory;
+     *error = kIOReturnNoMemory;
+     return NULL;
  }
 
  request->setContext(context);
@@ -2302,8 +2456,8 @@ IOReturn IntelCommandQueueClient::doSubmitCommandBuffer(const IOAccelCommandBuff
  if (!request->setBatchAddress(submit->commandBuffer)) {
      request->release();
      if (cmdBufferDesc) cmdBufferDesc->release();
-     *outStatus = (uint32_t)kIOReturnBadArgument;
-     return kIOReturnBadArgument;
+     *error = kIOReturnBadArgument;
+     return NULL;
  }
  request->setBatchLength(submit->commandSize);
 
@@ -2314,77 +2468,16 @@ IOReturn IntelCommandQueueClient::doSubmitCommandBuffer(const IOAccelCommandBuff
 
  if (cmdBufferDesc) {
      request->setCommandBuffer(cmdBufferDesc);
+     cmdBufferDesc->release();
      if (!request->validateCommandBuffer()) {
-         cmdBufferDesc->release();
          request->release();
-         *outStatus = (uint32_t)kIOReturnBadArgument;
-         return kIOReturnBadArgument;
+         *error = kIOReturnBadArgument;
+         return NULL;
      }
-     cmdBufferDesc->release();
-     cmdBufferDesc = NULL;
  }
 
- uint32_t seqno = gucSubmission->getCurrentFenceValue() + 1;
  request->setSeqno(seqno);
-
- bool submitted = gucSubmission->submitRequest(request);
- if (!submitted) {
-     request->release();
-     *outStatus = (uint32_t)kIOReturnNotReady;
-     return kIOReturnNotReady;
- }
-
- // Get fence before releasing request (fence is retained separately)
- uint32_t fenceID = 0;
- IntelFence* fence = request->getModernFence();
- if (fence) {
-     fenceID = fence->getId();
- } else {
-     fenceID = seqno;
- }
-
- if (queueLock) {
-     IOLockLock(queueLock);
-     if (pendingCommands) {
-         struct QueueCommandRecord {
-             uint32_t fenceID;
-             uint32_t seqno;
-             uint32_t status;
-             uint64_t submitTime;
-         } record;
-
-         record.fenceID = fenceID;
-         record.seqno = seqno;
-         record.status = 0;
-         record.submitTime = mach_absolute_time();
-
-         OSData* data = OSData::withBytes(&record, sizeof(record));
-         if (data) {
-             pendingCommands->setObject(data);
-             data->release();
-         }
-     }
-     IOLockUnlock(queueLock);
- }
-
- queueState.commandBufferAddress = submit->commandBuffer;
- queueState.commandBufferSize = submit->commandSize;
- queueState.pendingCommands++;
- queueState.fenceValue = fenceID;
- queueState.status = 1;
-
- lastSubmittedSeqno = seqno;
- lastSubmittedFence = fenceID;
- lastSubmittedStatus = 0;
-
- *outStatus = 0;
- *outSeqno = seqno;
- *outFence = fenceID;
-
- request->release();
-
- IOLog("[TGL][CommandQueue] OK  Command submitted successfully (seqno=%u fence=%u)\n", seqno, fenceID);
- return kIOReturnSuccess;
+ return request;
 }
 
 IOReturn IntelCommandQueueClient::doWaitForCompletion(uint32_t bufferID, uint32_t timeoutMs) {
@@ -3110,6 +3203,11 @@ IOReturn IntelSurfaceClient::s_lock_surface(OSObject* target, void* ref, IOExter
                         record->scanoutCacheMemDesc[slot]->release();
                     }
 
+                    if (record->scanoutCacheSG[slot]) {
+                        IntelGTT::destroySGTable(record->scanoutCacheSG[slot]);
+                        record->scanoutCacheSG[slot] = nullptr;
+                    }
+
                     record->scanoutCacheMemDesc[slot] = nullptr;
                     record->scanoutCacheHasBinding[slot] = false;
                     record->scanoutCachePrepared[slot] = false;
@@ -3147,7 +3245,7 @@ IOReturn IntelSurfaceClient::s_lock_surface(OSObject* target, void* ref, IOExter
                     size_t   gttSize   = 0;
 
                     uint64_t gpuAddr = me->bindMemoryDescriptorToGGTT(
-                        memDesc, &gttOffset, &gttSize
+                        memDesc, &gttOffset, &gttSize, &record->scanoutCacheSG[slot]
                     );
 
                     if (!gpuAddr || !gttOffset) {
@@ -4135,9 +4233,10 @@ IOReturn IntelSurfaceClient::doCreateSurface(const IOAccelSurfaceCreateData* cre
 // Handles multi-segment (scatter-gather) IOMemoryDescriptors properly
 uint64_t IntelSurfaceClient::bindMemoryDescriptorToGGTT(IOMemoryDescriptor* memDesc,
                                                       uint32_t* outGttOffset,
-                                                      size_t* outSize) {
- if (!memDesc || !controller) {
-     IOLog("[TGL][SurfaceClient] ERR  bindToGGTT: NULL memDesc or controller\n");
+                                                      size_t* outSize,
+                                                      struct gtt_sg_table** ioSGTable) {
+ if (!memDesc || !controller || !ioSGTable) {
+     IOLog("[TGL][SurfaceClient] ERR  bindToGGTT: NULL memDesc, controller or SG table slot\n");
      return 0;
  }
  
@@ -4165,69 +4264,50 @@ uint64_t IntelSurfaceClient::bindMemoryDescriptorToGGTT(IOMemoryDescriptor* memD
  }
  
 
-  // STEP 2: Enumerate ALL physical segments (debug/diagnostics)
+  // STEP 2: Build the coalesced segment list once; rebinds reuse it
 
- IOByteCount offset = 0;
- int segmentCount = 0;
- IOPhysicalAddress firstSegPhys = 0;
- IOByteCount firstSegLen = 0;
- bool isContiguous = true;
- IOPhysicalAddress expectedNextPhys = 0;
- 
- while (offset < totalLength && segmentCount < 1024) { // Safety limit
-     IOByteCount segLen = 0;
-     IOPhysicalAddress segPhys = memDesc->getPhysicalSegment(offset, &segLen);
-     
-     if (segPhys == 0 || segLen == 0) {
-         IOLog("[TGL][SurfaceClient]   getPhysicalSegment(%llu) returned NULL\n", offset);
-         break;
-     }
-     
-     if (segmentCount == 0) {
-         firstSegPhys = segPhys;
-         firstSegLen = segLen;
-         expectedNextPhys = segPhys + segLen;
-     } else {
-         // Check if physically contiguous
-         if (segPhys != expectedNextPhys) {
-             isContiguous = false;
-             IOLog("[TGL][SurfaceClient]   NON-CONTIGUOUS: seg[%d] @0x%llx (expected 0x%llx)\n",
-                   segmentCount, (uint64_t)segPhys, (uint64_t)expectedNextPhys);
-         }
-         expectedNextPhys = segPhys + segLen;
+ bool builtSGTable = false;
+ if (!*ioSGTable) {
+     *ioSGTable = IntelGTT::createSGTable(memDesc);
+     if (!*ioSGTable) {
+         IOLog("[TGL][SurfaceClient] ERR  Failed to build SG table\n");
+         memDesc->complete();
+         return 0;
      }
-     
-     IOLog("[TGL][SurfaceClient]   Seg[%d]: phys=0x%llx len=%llu\n",
-           segmentCount, (uint64_t)segPhys, (uint64_t)segLen);
-     
-     offset += segLen;
-     segmentCount++;
+     builtSGTable = true;
  }
  
- if (offset < totalLength) {
-     IOLog("[TGL][SurfaceClient]   Only enumerated %llu of %llu bytes (%d segments)\n",
-           offset, totalLength, segmentCount);
- }
+ struct gtt_sg_table* sgt = *ioSGTable;
+ IOPhysicalAddress firstSegPhys = (IOPhysicalAddress)sgt->entries[0].phys;
  
- IOLog("[TGL][SurfaceClient]  Memory layout: %d segments, %s\n",
-       segmentCount, isContiguous ? "CONTIGUOUS" : "SCATTERED");
+ IOLog("[TGL][SurfaceClient]  Memory layout: %u runs, %s%s\n",
+       sgt->count, sgt->count == 1 ? "CONTIGUOUS" : "SCATTERED",
+       builtSGTable ? "" : " (cached)");
  
 
   // STEP 3: Bind to GGTT (supports scatter-gather)
 
-  // Use allocateSpace() + insertEntries() so non-contiguous IOSurface backing
-  // is mapped correctly page-by-page.
+  // Use allocateSpace() + bindRange() so non-contiguous IOSurface backing
+  // is mapped correctly run-by-run with a single flush.
   u64 gttAddr = gtt->allocateSpace((size_t)totalLength, 4096);
   if (gttAddr == 0) {
       IOLog("[TGL][SurfaceClient] ERR  GGTT allocateSpace failed (%llu bytes)\n", totalLength);
+      if (builtSGTable) {
+          IntelGTT::destroySGTable(*ioSGTable);
+          *ioSGTable = NULL;
+      }
       memDesc->complete();
       return 0;
   }
 
-  // insertEntries() will DMA-walk the descriptor and write PTEs for each page.
-  if (!gtt->insertEntries(gttAddr, memDesc, (u32)(GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE))) {
-      IOLog("[TGL][SurfaceClient] ERR  GGTT insertEntries failed at 0x%llx\n", gttAddr);
+  if (!gtt->bindRange(gttAddr, sgt->entries, sgt->count,
+                      (u32)(GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE))) {
+      IOLog("[TGL][SurfaceClient] ERR  GGTT bindRange failed at 0x%llx\n", gttAddr);
       gtt->freeSpace(gttAddr, (size_t)totalLength);
+      if (builtSGTable) {
+          IntelGTT::destroySGTable(*ioSGTable);
+          *ioSGTable = NULL;
+      }
       memDesc->complete();
       return 0;
   }
@@ -4246,8 +4326,8 @@ uint64_t IntelSurfaceClient::bindMemoryDescriptorToGGTT(IOMemoryDescriptor* memD
  uint64_t gpuAddress = (uint64_t)gttOffset;
  
     IOLog("[TGL][SurfaceClient] OK  GGTT bound successfully:\n");
-    IOLog("[TGL][SurfaceClient]    First seg phys: 0x%llx (%d segments)\n",
-          (uint64_t)firstSegPhys, segmentCount);
+    IOLog("[TGL][SurfaceClient]    First seg phys: 0x%llx (%u runs)\n",
+          (uint64_t)firstSegPhys, sgt->count);
     IOLog("[TGL][SurfaceClient]    GTT offset (for PLANE_SURF): 0x%x\n", gttOffset);
     IOLog("[TGL][SurfaceClient]    GPU address: 0x%llx\n", gpuAddress);
     IOLog("[TGL][SurfaceClient]    Size:        %llu bytes (%llu pages)\n",
@@ -4394,7 +4474,8 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
   //  PATH A: Try direct GGTT binding first (MODERN macOS 10.13+ scanout)
   uint32_t gttOffset = 0;
   size_t gttSize = 0;
-  uint64_t gttGpuAddr = bindMemoryDescriptorToGGTT(memDesc, &gttOffset, &gttSize);
+  struct gtt_sg_table* sgTable = NULL;
+  uint64_t gttGpuAddr = bindMemoryDescriptorToGGTT(memDesc, &gttOffset, &gttSize, &sgTable);
   
   if (gttGpuAddr != 0) {
       IOLog("[TGL][SurfaceClient] OK  Direct GGTT binding SUCCESS - will use for scanout\n");
@@ -4415,6 +4496,7 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
              gtt->unbindSurfacePages(gttOffset, gttSize);
          }
      }
+     IntelGTT::destroySGTable(sgTable);
      return createResult;
  }
 
@@ -4426,12 +4508,14 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
              gtt->unbindSurfacePages(gttOffset, gttSize);
          }
      }
+     IntelGTT::destroySGTable(sgTable);
     return kIOReturnError;
  }
 
  SurfaceRecord* record = (SurfaceRecord*)IOMalloc(sizeof(SurfaceRecord));
  if (!record) {
      surfaceManager->destroySurface(iosurfaceID);
+     IntelGTT::destroySGTable(sgTable);
      return kIOReturnNoMemory;
  }
 
@@ -4440,6 +4524,7 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
   record->iosurfacePort = props.iosurfacePort;
   record->memDesc = memDesc;          // CRITICAL: Retain for complete() on destroy
   if (memDesc) memDesc->retain();     // Retain while surface exists
+  record->sgTable = sgTable;          // Owned by the record from here on
   record->gpuAddress = props.gpuAddress;
   record->physicalAddr = props.physAddress;
   record->gttOffset = gttOffset;  // GTT byte address for unbindSurfacePages
@@ -4458,6 +4543,13 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
  uint32_t handle = allocateSurfaceHandle(record, iosurfaceID);
  if (handle == 0) {
      surfaceManager->destroySurface(iosurfaceID);
+     if (record->hasGttBinding && controller) {
+         IntelGTT* gtt = controller->getGTT();
+         if (gtt) {
+             gtt->unbindSurfacePages(record->gttOffset, record->gttSize);
+         }
+     }
+     IntelGTT::destroySGTable(record->sgTable);
      IOFree(record, sizeof(SurfaceRecord));
      return kIOReturnNoResources;
  }
@@ -4465,6 +4557,16 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
  record->handle = handle;
  *surfaceID = handle;
 
+ // Let the GTT reclaim this binding under aperture pressure until its
+ // address is handed out
+ if (record->hasGttBinding && controller && controller->getGTT()) {
+     IOLockLock(surfacesLock);
+     record->gttTracked = controller->getGTT()->trackBinding(&record->gttBinding,
+                                                              record->gttOffset, record->gttSize,
+                                                              record, &kSurfaceBindingOps, false);
+     IOLockUnlock(surfacesLock);
+ }
+
  IOLog("[TGL][SurfaceClient] OK  Surface created: ID=%u GPU=0x%llx %ux%u\n",
        handle, record->gpuAddress, record->width, record->height);
 
@@ -4478,6 +4580,13 @@ IOReturn IntelSurfaceClient::doCreateSurface2(IOMemoryDescriptor* memDesc, IOExt
                                                                  record->format);
          if (scanoutResult != kIOReturnSuccess) {
              IOLog("[TGL][SurfaceClient] WARN: setScanoutSurface failed 0x%x\n", scanoutResult);
+         } else {
+             // Being scanned out: never evict
+             IOLockLock(surfacesLock);
+             if (!record->gttExported) {
+                 record->gttExported = pinSurfaceGGTT(record);
+             }
+             IOLockUnlock(surfacesLock);
          }
      }
  }
@@ -4641,6 +4750,10 @@ void IntelSurfaceClient::destroySurfaceRecord(uint32_t surfaceID) {
                   record->scanoutCacheGttOffset[s] = 0;
                   record->scanoutCacheGttSize[s] = 0;
               }
+              if (record->scanoutCacheSG[s]) {
+                  IntelGTT::destroySGTable(record->scanoutCacheSG[s]);
+                  record->scanoutCacheSG[s] = NULL;
+              }
           }
           record->scanoutGttOffset = 0;
           record->scanoutGttSize = 0;
@@ -4648,12 +4761,16 @@ void IntelSurfaceClient::destroySurfaceRecord(uint32_t surfaceID) {
           // STEP 1: Cleanup GGTT binding if present
           if (record->hasGttBinding && record->gttOffset != 0 && controller) {
               IntelGTT* gtt = controller->getGTT();
-              if (gtt) {
+              // A tracked binding that fails to untrack was evicted meanwhile;
+              // one that untracks may have been moved right up to that point
+              if (gtt && (!record->gttTracked || gtt->untrackBinding(&record->gttBinding))) {
+                  syncSurfaceGGTT(record);
                   IOLog("[TGL][SurfaceClient] Unbinding GTT: offset=0x%x size=%zu\n",
                         record->gttOffset, record->gttSize);
                   gtt->unbindSurfacePages(record->gttOffset, record->gttSize);
               }
           }
+          record->gttTracked = false;
          
          // STEP 2: Complete memory descriptor (unpin pages)
          if (record->memDesc && record->isPrepared) {
@@ -4662,11 +4779,15 @@ void IntelSurfaceClient::destroySurfaceRecord(uint32_t surfaceID) {
              record->isPrepared = false;
          }
          
-         // STEP 3: Release memory descriptor
+         // STEP 3: Release memory descriptor and its segment list
          if (record->memDesc) {
              record->memDesc->release();
              record->memDesc = NULL;
          }
+         if (record->sgTable) {
+             IntelGTT::destroySGTable(record->sgTable);
+             record->sgTable = NULL;
+         }
          
          // STEP 4: Cleanup IOSurface
          if (record->iosurfaceID != 0) {
@@ -4815,6 +4936,14 @@ IOReturn IntelSurfaceClient::doGetSurfaceInfo(uint32_t surfaceID, void* info, ui
      return kIOReturnNotFound;
  }
 
+ // The GPU address is about to leave the kernel: from here on it must not
+ // move, so pin the binding for the rest of the surface's life
+ IOLockLock(surfacesLock);
+ if (!record->gttExported) {
+     record->gttExported = pinSurfaceGGTT(record);
+ }
+ IOLockUnlock(surfacesLock);
+
  IntelIOSurfaceManager* surfaceManager = IntelIOSurfaceManager::sharedInstance();
  IntelIOSurfaceProperties props;
  if (!surfaceManager || surfaceManager->getSurfaceProperties(record->iosurfaceID, &props) != kIOReturnSuccess) {
@@ -4851,6 +4980,180 @@ IOReturn IntelSurfaceClient::doGetSurfaceInfo(uint32_t surfaceID, void* info, ui
  return kIOReturnSuccess;
 }
 
+// Scanout, an exported address and the lock/unlock window pin the binding;
+// outside of those the surface is busy until the work queued on every engine
+// before its last hand-off retires. Unpinned ranges were never handed out,
+// so compaction may move them as freely as eviction may drop them.
+const struct gtt_binding_ops IntelSurfaceClient::kSurfaceBindingOps = {
+    IntelSurfaceClient::surfaceGGTTIsBusy,
+    IntelSurfaceClient::surfaceGGTTEvicted,
+    IntelSurfaceClient::surfaceGGTTRelocated,
+};
+
+// Stamp the surface with the newest render and blitter seqno whenever
+// userspace hands it back to the GPU, so eviction leaves it alone until that
+// work has retired. Caller holds surfacesLock.
+void IntelSurfaceClient::markSurfaceGPUUse(SurfaceRecord* record) {
+ if (!record || !controller) {
+     return;
+ }
+ 
+ static const int kEngines[SurfaceRecord::kUseEngines] = { RCS0, BCS0 };
+ 
+ for (uint32_t i = 0; i < SurfaceRecord::kUseEngines; i++) {
+     IntelRingBuffer* ring = controller->getRingBuffer(kEngines[i]);
+     
+     // Engines that share a ring only need one stamp
+     if (ring && i > 0 && ring == controller->getRingBuffer(kEngines[0])) {
+         ring = NULL;
+     }
+     
+     if (ring) {
+         record->lastUseSeqno[i] = ring->getSeqno();
+     }
+     __atomic_store_n(&record->lastUseRing[i], ring, __ATOMIC_RELEASE);
+ }
+}
+
+// Called by IntelGTT with its LRU lock held: only reads the rings'
+// breadcrumbs, never calls back into the GTT.
+bool IntelSurfaceClient::surfaceGGTTIsBusy(void* owner) {
+ SurfaceRecord* record = (SurfaceRecord*)owner;
+ if (!record) {
+     return false;
+ }
+ 
+ for (uint32_t i = 0; i < SurfaceRecord::kUseEngines; i++) {
+     IntelRingBuffer* ring = __atomic_load_n(&record->lastUseRing[i], __ATOMIC_ACQUIRE);
+     if (ring && !ring->isSeqnoCompleted(record->lastUseSeqno[i])) {
+         return true;
+     }
+ }
+ 
+ return false;
+}
+
+// Called by IntelGTT with its LRU lock held: PTEs are cleared and the range
+// is free. This runs on whichever thread needed the space, so it must not
+// take surfacesLock (lock order is surfacesLock -> LRU lock) or touch the
+// rest of the record; the owner folds the eviction in under surfacesLock.
+void IntelSurfaceClient::surfaceGGTTEvicted(void* owner) {
+ SurfaceRecord* record = (SurfaceRecord*)owner;
+ if (record) {
+     __atomic_store_n(&record->gttEvicted, true, __ATOMIC_RELEASE);
+ }
+}
+
+// Called by IntelGTT with its LRU lock held once the PTEs have been copied to
+// newStart. Same rules as surfaceGGTTEvicted: record the move, fold it later.
+void IntelSurfaceClient::surfaceGGTTRelocated(void* owner, u64 newStart) {
+ SurfaceRecord* record = (SurfaceRecord*)owner;
+ if (record) {
+     __atomic_store_n(&record->gttMovedTo, newStart, __ATOMIC_RELEASE);
+ }
+}
+
+// Caller holds surfacesLock. Keeps the surface manager's copy of the address
+// in step when the binding lands somewhere new.
+void IntelSurfaceClient::publishSurfaceGGTTAddress(SurfaceRecord* record, uint32_t oldOffset, u64 newAddr) {
+ IntelIOSurfaceManager* surfaceManager = IntelIOSurfaceManager::sharedInstance();
+ IntelIOSurfaceProperties props;
+ if (surfaceManager && record->iosurfaceID != 0 && oldOffset != 0 &&
+     surfaceManager->getSurfaceProperties(record->iosurfaceID, &props) == kIOReturnSuccess &&
+     props.gpuAddress == oldOffset) {
+     props.gpuAddress = newAddr;
+     surfaceManager->setSurfaceProperties(record->iosurfaceID, &props);
+ }
+}
+
+// Caller holds surfacesLock. Folds a compaction move into the record. Once
+// the binding is pinned or untracked it cannot move again, so a sync after
+// either of those is final.
+void IntelSurfaceClient::syncSurfaceGGTT(SurfaceRecord* record) {
+ u64 newAddr = __atomic_exchange_n(&record->gttMovedTo, 0, __ATOMIC_ACQ_REL);
+ if (newAddr == 0 || !record->hasGttBinding) {
+     return;
+ }
+ 
+ uint32_t oldOffset = record->gttOffset;
+ if (record->gpuAddress == oldOffset) {
+     record->gpuAddress = newAddr;
+ }
+ record->gttOffset = (uint32_t)newAddr;
+ publishSurfaceGGTTAddress(record, oldOffset, newAddr);
+}
+
+// Caller holds surfacesLock. Binds the retained SG table at a new address and
+// tracks it already pinned, so nothing can evict it before the caller is done.
+bool IntelSurfaceClient::rebindSurfaceGGTT(SurfaceRecord* record) {
+ if (!record || !__atomic_load_n(&record->gttEvicted, __ATOMIC_ACQUIRE) || !controller) {
+     return false;
+ }
+ 
+ // Fold the eviction into the record first; it supersedes any earlier move
+ syncSurfaceGGTT(record);
+ uint32_t oldOffset = record->gttOffset;
+ if (record->hasGttBinding) {
+     if (record->gpuAddress == oldOffset) {
+         record->gpuAddress = 0;
+     }
+     record->hasGttBinding = false;
+     record->gttTracked = false;
+     record->gttOffset = 0;
+ }
+ 
+ IntelGTT* gtt = controller->getGTT();
+ if (!gtt || !record->sgTable) {
+     return false;
+ }
+ 
+ // Pages are still wired from the original prepare(); only PTEs are needed
+ u64 gttAddr = gtt->allocateSpace(record->gttSize, 4096);
+ if (gttAddr == 0) {
+     IOLog("[TGL][SurfaceClient] ERR  GGTT rebind: no space for %zu bytes\n", record->gttSize);
+     return false;
+ }
+ 
+ if (!gtt->bindRange(gttAddr, record->sgTable->entries, record->sgTable->count,
+                     (u32)(GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE))) {
+     IOLog("[TGL][SurfaceClient] ERR  GGTT rebind: bindRange failed at 0x%llx\n", gttAddr);
+     gtt->freeSpace(gttAddr, record->gttSize);
+     return false;
+ }
+ 
+ record->gttOffset = (uint32_t)gttAddr;
+ record->gpuAddress = gttAddr;
+ record->hasGttBinding = true;
+ __atomic_store_n(&record->gttEvicted, false, __ATOMIC_RELEASE);
+ record->gttTracked = gtt->trackBinding(&record->gttBinding, gttAddr, record->gttSize,
+                                        record, &kSurfaceBindingOps, true);
+ 
+ // The old address was never exported, but the surface manager may still
+ // hold it
+ publishSurfaceGGTTAddress(record, oldOffset, gttAddr);
+ 
+ IOLog("[TGL][SurfaceClient] OK  Surface %u rebound to GGTT 0x%llx\n", record->handle, gttAddr);
+ return record->gttTracked;
+}
+
+// Caller holds surfacesLock. Takes one pin on the surface's binding, bringing
+// it back first if it was evicted; false if there is nothing to pin.
+bool IntelSurfaceClient::pinSurfaceGGTT(SurfaceRecord* record) {
+ if (!record || !controller || !controller->getGTT()) {
+     return false;
+ }
+ 
+ // A failed pin means the binding went away under us and gttEvicted is set
+ if (record->gttTracked && !__atomic_load_n(&record->gttEvicted, __ATOMIC_ACQUIRE) &&
+     controller->getGTT()->pinBinding(&record->gttBinding)) {
+     // Pinned ranges never move, so this picks up the final address
+     syncSurfaceGGTT(record);
+     return true;
+ }
+ 
+ return rebindSurfaceGGTT(record);
+}
+
 IOReturn IntelSurfaceClient::doLockSurface(uint32_t surfaceID, uint32_t lockType) {
  IOLog("[TGL][SurfaceClient] 🔒 Locking surface: ID=%u lockType=%u\n", surfaceID, lockType);
  
@@ -4897,6 +5200,16 @@ IOReturn IntelSurfaceClient::doLockSurface(uint32_t surfaceID, uint32_t lockType
       return kIOReturnNotFound;
   }
  
+ // Bring an evicted binding back before the caller reads gpuAddress, and keep
+ // it resident until unlock. Rebind and pin happen under one surfacesLock
+ // hold so two lockers cannot both bind a range, and eviction cannot slip in
+ // between.
+ IOLockLock(surfacesLock);
+ if (!record->lockPinned) {
+     record->lockPinned = pinSurfaceGGTT(record);
+ }
+ IOLockUnlock(surfacesLock);
+ 
  IntelIOSurfaceManager* surfaceManager = IntelIOSurfaceManager::sharedInstance();
  if (surfaceManager && record->iosurfaceID != 0) {
      surfaceManager->lockSurface(record->iosurfaceID, lockType, 0);
@@ -4918,6 +5231,17 @@ IOReturn IntelSurfaceClient::doUnlockSurface(uint32_t surfaceID) {
      return kIOReturnNotFound;
  }
  
+ // Stamp before unpinning so the binding is never evictable while the
+ // work that last used it is still in flight
+ IOLockLock(surfacesLock);
+ markSurfaceGPUUse(record);
+ 
+ if (record->lockPinned && controller && controller->getGTT()) {
+     controller->getGTT()->unpinBinding(&record->gttBinding);
+     record->lockPinned = false;
+ }
+ IOLockUnlock(surfacesLock);
+ 
  IntelIOSurfaceManager* surfaceManager = IntelIOSurfaceManager::sharedInstance();
  if (surfaceManager && record->iosurfaceID != 0) {
      surfaceManager->unlockSurface(record->iosurfaceID);
@@ -4988,7 +5312,10 @@ IOReturn IntelSurfaceClient::doSetShapeBacking(const void* shapeData, uint32_t s
  }
  
  // Update IOSurface backing
+ IOLockLock(surfacesLock);
  record->iosurfaceID = iosurfaceID;
+ markSurfaceGPUUse(record);
+ IOLockUnlock(surfacesLock);
  
  IOLog("[TGL][SurfaceClient] OK  Shape backing configured!\n");
  return kIOReturnSuccess;
@@ -40,6 +40,9 @@ class IOMemoryDescriptor;
 class IntelIOFramebuffer;
 class IntelBlitter;
 class IntelRingBuffer;
+struct gtt_sg_table;
+struct gtt_binding;
+struct gtt_binding_ops;
 
 
 // MARK: - Apple Client Type Enum (Exact)
@@ -169,7 +172,7 @@ struct IOAccelDeviceInfoData {
     uint32_t reserved[3];        // Padding
 } __attribute__((packed));
 
-// Type 1/3/7 (Context) - Selector 2: submit_data_buffers input (136+ bytes)
+// Type 1/3/7 (Context) - Selector 2: submit_data_buffers input (136 bytes per buffer, back to back)
 struct IOAccelContextSubmitDataBuffersIn {
     uint64_t bufferAddress;      // GPU command buffer address
     uint32_t bufferSize;         // Command buffer size
@@ -310,6 +313,10 @@ public:
     static IOReturn s_get_next_gid_group(OSObject* target, void* ref, IOExternalMethodArguments* args);
     static IOReturn s_set_api_property(OSObject* target, void* ref, IOExternalMethodArguments* args);
     
+    // Driver debug selectors (top of the vendor range, admin only)
+    static IOReturn s_mmio_trace_control(OSObject* target, void* ref, IOExternalMethodArguments* args);  // Selector 23
+    static IOReturn s_mmio_trace_drain(OSObject* target, void* ref, IOExternalMethodArguments* args);    // Selector 24
+    
 protected:
     // Device client has minimal cleanup (no GPU state)
     virtual void performTerminationCleanup() override { /* No GPU state to clean */ }
@@ -352,6 +359,9 @@ protected:
     
     //  CRITICAL: Apple's context enabled flag (offset 0x698 in binary)
     volatile bool contextEnabled;
+    
+    // Buffers accepted by one submit_data_buffers call (one GuC batch)
+    static const uint32_t kMaxSubmitBurst = 32;
 
 public:
     virtual bool start(IOService* provider) override;
@@ -390,6 +400,8 @@ private:
     IOReturn doSubmitDataBuffers(const IOAccelContextSubmitDataBuffersIn* input,
                                 IOAccelContextSubmitDataBuffersOut* output,
                                 uint32_t inputSize, uint32_t outputSize);
+    IntelRequest* prepareDataBufferRequest(const IOAccelContextSubmitDataBuffersIn* input,
+                                           uint32_t seqno, IOReturn* error);
     
     //  WindowServer 2D Command Submission (Type 3 Client)
     IOReturn doSubmit2DCommands(const IOAccelContextSubmitDataBuffersIn* input,
@@ -515,6 +527,9 @@ public:
     uint32_t lastSubmittedStatus;
     uint64_t completionCallback;
     
+    // Command buffers accepted by one submit_command_buffer call
+    static const uint32_t kMaxSubmitBurst = 32;
+    
     // Lifecycle
     virtual bool start(IOService* provider) override;
     
@@ -549,10 +564,14 @@ public:
     
     // Implementation methods
     IOReturn doSetNotificationPort(mach_port_t port);
-    IOReturn doSubmitCommandBuffer(const IOAccelCommandBufferSubmit* submit,
+    IOReturn doSubmitCommandBuffer(const IOAccelCommandBufferSubmit* submits,
+                                   uint32_t count,
                                    uint32_t* outStatus,
                                    uint32_t* outSeqno,
                                    uint32_t* outFence);
+    IntelRequest* prepareCommandBufferRequest(const IOAccelCommandBufferSubmit* submit,
+                                              IntelContext* context,
+                                              uint32_t seqno, IOReturn* error);
     IOReturn doWaitForCompletion(uint32_t fenceID, uint32_t timeoutMs);
     IOReturn doGetCommandBufferStatus(uint32_t bufferID, uint32_t* status, uint32_t* progress);
     IOReturn doSetPriorityBand(uint32_t bandwidth);
@@ -599,6 +618,7 @@ private:
         OSObject* iosurfaceObj;          //  APPLE: IOSurface object pointer (passed in selector 9)
         mach_port_t iosurfacePort;
         IOMemoryDescriptor* memDesc;    // CRITICAL: Retain for complete() on destroy
+        struct gtt_sg_table* sgTable;   // Coalesced segments of memDesc, built at prepare()
         // Scanout mapping cache (to avoid remap/unmap blinking on triple buffering)
         static const uint32_t kScanoutCacheSlots = 3;
         uint32_t scanoutCacheNext;
@@ -608,6 +628,7 @@ private:
         size_t   scanoutCacheGttSize[kScanoutCacheSlots];
         bool     scanoutCachePrepared[kScanoutCacheSlots];
         bool     scanoutCacheHasBinding[kScanoutCacheSlots];
+        struct gtt_sg_table* scanoutCacheSG[kScanoutCacheSlots];
 
         // Current scanout selection
         uint32_t scanoutGttOffset;      // GGTT offset used for scanout programming
@@ -625,6 +646,21 @@ private:
         bool isMapped;
         bool isPrepared;         // True if memDesc->prepare() was called
         bool hasGttBinding;      // True if bound to GGTT for scanout
+        // GGTT eviction: the creation-time binding may be reclaimed under
+        // aperture pressure until its address is handed out, and is rebound
+        // lazily on the next lock. Everything but gttEvicted is guarded by
+        // surfacesLock.
+        struct gtt_binding* gttBinding;  // LRU entry, cleared by the GTT on eviction
+        bool gttTracked;         // gttBinding was registered
+        volatile bool gttEvicted;  // Set by the GTT under its LRU lock; sgTable kept for rebind
+        volatile uint64_t gttMovedTo;  // Set by compaction under the LRU lock; 0 = not moved
+        bool gttExported;        // Address returned to userspace: pinned until destroy
+        bool lockPinned;         // Pinned for the lock/unlock window
+        // Newest seqno on each engine that can touch the surface when it was
+        // last handed back to the GPU; busy until all of them complete
+        static const uint32_t kUseEngines = 2;  // RCS0, BCS0
+        IntelRingBuffer* lastUseRing[kUseEngines];
+        uint32_t lastUseSeqno[kUseEngines];
     };
     
     // Surface tracking
@@ -702,9 +738,23 @@ private:
     IOReturn doSetShapeBackingWithScalars(uint32_t surfaceID, uint32_t iosurfaceID);
     
     //  CRITICAL: IOMemoryDescriptor -> GGTT binding for direct scanout
+    // ioSGTable caches the descriptor's segment list: built on first bind,
+    // reused as-is on later binds of the same descriptor.
     uint64_t bindMemoryDescriptorToGGTT(IOMemoryDescriptor* memDesc,
                                         uint32_t* outGttOffset,
-                                        size_t* outSize);
+                                        size_t* outSize,
+                                        struct gtt_sg_table** ioSGTable);
+    
+    // GGTT eviction support for surface bindings
+    static bool surfaceGGTTIsBusy(void* owner);
+    static void surfaceGGTTEvicted(void* owner);
+    static void surfaceGGTTRelocated(void* owner, u64 newStart);
+    static const struct gtt_binding_ops kSurfaceBindingOps;
+    void markSurfaceGPUUse(SurfaceRecord* record);
+    bool rebindSurfaceGGTT(SurfaceRecord* record);
+    bool pinSurfaceGGTT(SurfaceRecord* record);
+    void syncSurfaceGGTT(SurfaceRecord* record);
+    void publishSurfaceGGTTAddress(SurfaceRecord* record, uint32_t oldOffset, u64 newAddr);
     
     uint32_t allocateSurfaceHandle(SurfaceRecord* surface, uint32_t preferredHandle);
     SurfaceRecord* getSurfaceRecord(uint32_t surfaceID);
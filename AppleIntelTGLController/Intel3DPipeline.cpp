@@ -1095,13 +1095,10 @@ Pipeline3DError Intel3DPipeline::submitPipelineCommand(uint32_t* commands,
         return PIPELINE_STATE_ERROR;
     }
     
-    IntelRequest* request = new IntelRequest();
-    if (!request || !request->init()) {
-        return PIPELINE_MEMORY_ERROR;
-    }
-    
-    if (!request->initWithContext(pipelineContext)) {
-        request->release();
+    IntelRequestManager* requestManager = controller->getRequestManager();
+    IntelRequest* request = requestManager ?
+        requestManager->allocateRequest(renderRing, pipelineContext) : nullptr;
+    if (!request) {
         return PIPELINE_MEMORY_ERROR;
     }
     
@@ -1112,6 +1109,9 @@ Pipeline3DError Intel3DPipeline::submitPipelineCommand(uint32_t* commands,
         return PIPELINE_STATE_ERROR;
     }
     
+    // Picks up the ring breadcrumb so waitForCompletion() can track it
+    request->submit();
+    
     if (requestOut) {
         *requestOut = request;
         request->retain();
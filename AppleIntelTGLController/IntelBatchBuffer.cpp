@@ -85,11 +85,18 @@ bool IntelBatchBuffer::addCommand(u32 command)
 
 bool IntelBatchBuffer::emitDwords(const u32 *data, size_t count)
 {
-    for (size_t i = 0; i < count; i++) {
-        if (!emit(data[i])) {
-            return false;
-        }
+    if (!data || count == 0) {
+        return count == 0;
     }
+    
+    // Single bounds check, then one bulk copy
+    if (!building || !batchPtr || used + count * 4 > size) {
+        return false;
+    }
+    
+    memcpy((void *)((uintptr_t)batchPtr + used), data, count * 4);
+    used += count * 4;
+    
     return true;
 }
 
@@ -124,16 +131,18 @@ bool IntelBatchBuffer::submit(IntelRingBuffer *ring)
     }
     
     // Submit via ring
-    if (!ring->begin(4)) {
+    u32 *cs = ring->reserve(4);
+    if (!cs) {
         return false;
     }
     
-    // MI_BATCH_BUFFER_START
-    ring->emit(0x31 << 23 | 1);  // MI_BATCH_BUFFER_START, length=1
-    ring->emit((u32)batchAddr);
-    ring->emit((u32)(batchAddr >> 32));
+    // MI_BATCH_BUFFER_START, padded to a qword
+    cs[0] = 0x31 << 23 | 1;  // MI_BATCH_BUFFER_START, length=1
+    cs[1] = (u32)batchAddr;
+    cs[2] = (u32)(batchAddr >> 32);
+    cs[3] = MI::NOOP;
     
-    return ring->advance();
+    return ring->commit();
 }
 
 u64 IntelBatchBuffer::getGPUAddress() const
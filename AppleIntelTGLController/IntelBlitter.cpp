@@ -622,14 +622,20 @@ BlitError IntelBlitter::submitBlitCommand(uint32_t* commands,
         return BLIT_ERROR_ENGINE_BUSY;
     }
     
-    // Add commands to ring buffer
-    for (uint32_t i = 0; i < numDwords; i++) {
-        ring->emit(commands[i]);
+    // Reserve the whole span up front and copy the commands in one go
+    uint32_t* cs = ring->reserve(numDwords + 2);
+    if (!cs) {
+        controller->getRequestManager()->freeRequest(request);
+        return BLIT_ERROR_ENGINE_BUSY;
     }
     
+    memcpy(cs, commands, numDwords * sizeof(uint32_t));
+    
     // Add MI_FLUSH_DW for completion
-    ring->emit(MI_FLUSH_DW);
-    ring->emit(0);
+    cs[numDwords] = MI_FLUSH_DW;
+    cs[numDwords + 1] = 0;
+    
+    ring->commit();
     
     // Submit
     bool submitted = controller->getRequestManager()->submitRequest(request);
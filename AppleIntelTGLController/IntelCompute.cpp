@@ -866,13 +866,10 @@ ComputeError IntelCompute::submitComputeCommand(uint32_t* commands,
         return COMPUTE_DISPATCH_ERROR;
     }
     
-    IntelRequest* request = new IntelRequest();
-    if (!request || !request->init()) {
-        return COMPUTE_MEMORY_ERROR;
-    }
-    
-    if (!request->initWithContext(computeContext)) {
-        request->release();
+    IntelRequestManager* requestManager = controller->getRequestManager();
+    IntelRequest* request = requestManager ?
+        requestManager->allocateRequest(computeRing, computeContext) : nullptr;
+    if (!request) {
         return COMPUTE_MEMORY_ERROR;
     }
     
@@ -883,6 +880,9 @@ ComputeError IntelCompute::submitComputeCommand(uint32_t* commands,
         return COMPUTE_DISPATCH_ERROR;
     }
     
+    // Picks up the ring breadcrumb so waitForCompletion() can track it
+    request->submit();
+    
     if (requestOut) {
         *requestOut = request;
         request->retain();
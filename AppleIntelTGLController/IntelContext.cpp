@@ -25,6 +25,7 @@ IntelContext::IntelContext()
     , contextGpuAddress(0)
     , ppgtt(NULL)
     , boundRing(NULL)
+    , gucState(NULL)
     , statsLock(NULL)
 {
     bzero(&stats, sizeof(stats));
@@ -98,17 +99,12 @@ void IntelContext::cleanup()
             contextVirtual = NULL;
         }
         
-        IntelGTT *gtt = controller->getGTT();
-        if (gtt && contextGpuAddress) {
-            gtt->unbindObject(contextObj);
-            gtt->freeSpace(contextGpuAddress, contextObj->getSize());
-        }
-        
         IntelGEM *gem = controller->getGEM();
         if (gem) {
-            gem->destroyObject(contextObj);
+            gem->destroyBoundObject(contextObj);
         }
         contextObj = NULL;
+        contextGpuAddress = 0;
     }
     
     // Free locks
@@ -141,32 +137,12 @@ bool IntelContext::allocateContextState()
     }
     
     // Create context state object
-    contextObj = gem->createObject(GEN12_CONTEXT_SIZE, 0);
+    contextObj = gem->createBoundObject(GEN12_CONTEXT_SIZE, 0);
     if (!contextObj) {
         IOLog("IntelContext: Failed to create context object\n");
         return false;
     }
-    
-    // Allocate GTT space
-    IntelGTT *gtt = controller->getGTT();
-    if (!gtt) {
-        IOLog("IntelContext: No GTT manager\n");
-        return false;
-    }
-    
-    contextGpuAddress = gtt->allocateSpace(GEN12_CONTEXT_SIZE, 4096);
-    if (contextGpuAddress == 0) {
-        IOLog("IntelContext: Failed to allocate GTT space\n");
-        return false;
-    }
-    
-    contextObj->setGTTAddress(contextGpuAddress);
-    
-    // Bind to GTT
-    if (!gtt->bindObject(contextObj, 0)) {
-        IOLog("IntelContext: Failed to bind context object\n");
-        return false;
-    }
+    contextGpuAddress = contextObj->getGTTAddress();
     
     // Map for CPU access
     if (!contextObj->mapCPU(&contextVirtual)) {
@@ -208,8 +184,8 @@ bool IntelContext::writeContextState()
     
     // PPGTT pointer
     if (ppgtt) {
-        state[5] = (u32)ppgtt->getRootAddress();
-        state[6] = (u32)(ppgtt->getRootAddress() >> 32);
+        state[5] = (u32)ppgtt->getRootPhysicalAddress();
+        state[6] = (u32)(ppgtt->getRootPhysicalAddress() >> 32);
     }
     
     return true;
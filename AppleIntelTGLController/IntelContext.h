@@ -18,6 +18,7 @@ class AppleIntelTGLController;
 class IntelGEMObject;
 class IntelRingBuffer;
 class IntelPPGTT;
+class GuCContextState;
 
 /* Context Flags */
 #define CONTEXT_BANNED      (1 << 0)  // Context has caused GPU hang
@@ -89,6 +90,10 @@ public:
     bool isValid() const;
     IOReturn restoreAfterReset();
     
+    // GuC submission state (owned by IntelGuCSubmission)
+    void setGuCState(GuCContextState* state) { gucState = state; }
+    GuCContextState* getGuCState() const { return gucState; }
+    
 private:
     AppleIntelTGLController *controller;
     
@@ -108,6 +113,9 @@ private:
     // Ring Buffer
     IntelRingBuffer *boundRing;
     
+    // GuC
+    GuCContextState *gucState;
+    
     // Statistics
     struct context_stats stats;
     IOLock *statsLock;
@@ -3,10 +3,14 @@
  */
 
 #include "IntelFence.h"
+#include "IntelRingBuffer.h"
 #include "linux_compat.h"
 #include "linux_time.h"
 #include <IOKit/IOLib.h>
 
+/* Spin budget before blocking in wait() */
+#define FENCE_WAIT_SPIN_NS  (20 * 1000ULL)
+
 #define super OSObject
 OSDefineMetaClassAndStructors(IntelFence, OSObject)
 
@@ -27,6 +31,7 @@ IntelFence* IntelFence::create(uint32_t id)
     fence->seqno = 0;
     fence->engineId = 0;
     fence->signalTime = 0;
+    fence->ring = nullptr;
     
     return fence;
 }
@@ -66,36 +71,46 @@ void IntelFence::free()
 bool IntelFence::wait(uint32_t timeoutMs)
 {
     // Fast path: already signaled
-    IOLockLock(fenceLock);
-    if (signaled) {
-        IOLockUnlock(fenceLock);
+    if (isSignaled()) {
         return true;
     }
-    IOLockUnlock(fenceLock);
     
-    // Calculate deadline in nanoseconds
-    u64 startTime = ktime_get_ns();
-    u64 deadlineNs = startTime + (u64)timeoutMs * 1000000ULL;
+    // Breadcrumb fences wait on the ring, which wakes on its interrupt
+    if (ring) {
+        if (!ring->waitSeqno(seqno, timeoutMs)) {
+            IOLog("IntelFence: Timeout waiting for fence %u (seqno=%u)\n", fenceId, seqno);
+            return false;
+        }
+        signal();
+        return true;
+    }
     
-    while (true) {
-        // Check if signaled
-        IOLockLock(fenceLock);
+    // Short spin first; small batches often signal within microseconds
+    u64 spinEnd = ktime_get_ns() + FENCE_WAIT_SPIN_NS;
+    while (ktime_get_ns() < spinEnd) {
         if (signaled) {
-            IOLockUnlock(fenceLock);
             return true;
         }
-        IOLockUnlock(fenceLock);
-        
-        // Check timeout
-        u64 now = ktime_get_ns();
-        if (now >= deadlineNs) {
-            IOLog("IntelFence: Timeout waiting for fence %u (seqno=%u)\n", fenceId, seqno);
-            return false;
+    }
+    
+    // Then block until signal() wakes us
+    uint64_t deadline;
+    clock_interval_to_deadline(timeoutMs, kMillisecondScale, &deadline);
+    
+    IOLockLock(waitLock);
+    while (!signaled) {
+        if (IOLockSleepDeadline(waitLock, &signaled, deadline, THREAD_UNINT) == THREAD_TIMED_OUT) {
+            break;
         }
-        
-        // Sleep briefly (1ms)
-        msleep(1);
     }
+    bool done = signaled;
+    IOLockUnlock(waitLock);
+    
+    if (!done) {
+        IOLog("IntelFence: Timeout waiting for fence %u (seqno=%u)\n", fenceId, seqno);
+    }
+    
+    return done;
 }
 
 void IntelFence::signal()
@@ -111,11 +126,20 @@ void IntelFence::signal()
     }
     
     IOLockUnlock(fenceLock);
+    
+    // Waiters check signaled under waitLock, so this wakeup cannot be missed
+    IOLockLock(waitLock);
+    IOLockWakeup(waitLock, &signaled, false);
+    IOLockUnlock(waitLock);
 }
 
 bool IntelFence::isSignaled() const
 {
-    return signaled;
+    if (signaled) {
+        return true;
+    }
+    
+    return ring && ring->isSeqnoCompleted(seqno);
 }
 
 void IntelFence::reset()
@@ -123,5 +147,6 @@ void IntelFence::reset()
     IOLockLock(fenceLock);
     signaled = false;
     signalTime = 0;
+    ring = nullptr;
     IOLockUnlock(fenceLock);
 }
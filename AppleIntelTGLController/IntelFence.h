@@ -14,6 +14,8 @@
 #include <IOKit/IOService.h>
 #include <IOKit/IOLocks.h>
 
+class IntelRingBuffer;
+
 class IntelFence : public OSObject {
     OSDeclareDefaultStructors(IntelFence)
     
@@ -42,12 +44,17 @@ public:
     void setEngineId(uint32_t engine) { this->engineId = engine; }
     uint32_t getEngineId() const { return engineId; }
     
+    // Seqno is a breadcrumb on this ring; completion is read from its
+    // status page instead of waiting for signal()
+    void attachRing(IntelRingBuffer* ring) { this->ring = ring; }
+    
 private:
     uint32_t    fenceId;        // Unique fence ID
     bool        signaled;       // True when GPU completed
     uint32_t    seqno;          // Associated sequence number
     uint32_t    engineId;       // Which engine this fence is for
     uint64_t    signalTime;     // When it was signaled (for debugging)
+    IntelRingBuffer* ring;      // Breadcrumb source, if any
     
     IOLock*     fenceLock;      // Protects signaled flag
     IOLock*     waitLock;       // For wait/signal mechanism
@@ -64,7 +64,7 @@ bool IntelFramebuffer::allocate(uint32_t width, uint32_t height, uint32_t bpp, e
         return false;
     }
     
-    IntelGEMObject *obj = gem->createObject(size, 0);
+    IntelGEMObject *obj = gem->createObject(size, I915_BO_ALLOC_SCANOUT);
     if (!obj) {
         IOLog("IntelFramebuffer: Failed to create GEM object\n");
         return false;
@@ -8,6 +8,7 @@
 #include "IntelGEM.h"
 #include "AppleIntelTGLController.h"
 #include "IntelUncore.h"
+#include "IntelGTT.h"
 #include <IOKit/IOLib.h>
 
 
@@ -24,24 +25,34 @@ bool IntelGEM::init(AppleIntelTGLController *ctrl)
     
     controller = ctrl;
     
-    // Initialize object list
-    object_list_head = NULL;
-    object_list_tail = NULL;
-    
-    object_list_lock = IOLockAlloc();
-    if (!object_list_lock) {
-        IOLog("IntelGEM: Failed to allocate object_list_lock\n");
-        return false;
+    // Initialize object buckets
+    memset(object_buckets, 0, sizeof(object_buckets));
+    
+    for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+        object_buckets[i].lock = IOLockAlloc();
+        if (!object_buckets[i].lock) {
+            IOLog("IntelGEM: Failed to allocate bucket lock %d\n", i);
+            while (--i >= 0) {
+                IOLockFree(object_buckets[i].lock);
+                object_buckets[i].lock = NULL;
+            }
+            return false;
+        }
     }
     
     // Initialize statistics
     memset(&stats, 0, sizeof(stats));
     
-    stats_lock = IOLockAlloc();
-    if (!stats_lock) {
-        IOLog("IntelGEM: Failed to allocate stats_lock\n");
-        IOLockFree(object_list_lock);
-        object_list_lock = NULL;
+    // Initialize slab classes
+    memset(slab_classes, 0, sizeof(slab_classes));
+    
+    slab_lock = IOLockAlloc();
+    if (!slab_lock) {
+        IOLog("IntelGEM: Failed to allocate slab_lock\n");
+        for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+            IOLockFree(object_buckets[i].lock);
+            object_buckets[i].lock = NULL;
+        }
         return false;
     }
     
@@ -66,30 +77,56 @@ void IntelGEM::cleanup()
     printStatistics();
     
     // Destroy all remaining objects
-    IOLockLock(object_list_lock);
-    
-    IntelGEMObject *obj = object_list_head;
-    while (obj) {
-        IntelGEMObject *next = obj->next;
-        IOLog("IntelGEM: WARNING - Object %p still exists at cleanup\n", obj);
-        obj->destroy();
-        obj = next;
+    for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+        struct gem_object_bucket *bucket = &object_buckets[i];
+        if (!bucket->lock) {
+            continue;
+        }
+        
+        IOLockLock(bucket->lock);
+        
+        IntelGEMObject *obj = bucket->head;
+        while (obj) {
+            IntelGEMObject *next = obj->next;
+            IOLog("IntelGEM: WARNING - Object %p still exists at cleanup\n", obj);
+            obj->destroy();
+            obj = next;
+        }
+        
+        bucket->head = NULL;
+        bucket->tail = NULL;
+        
+        IOLockUnlock(bucket->lock);
     }
     
-    object_list_head = NULL;
-    object_list_tail = NULL;
-    
-    IOLockUnlock(object_list_lock);
-    
-    // Free locks
-    if (stats_lock) {
-        IOLockFree(stats_lock);
-        stats_lock = NULL;
+    // Release slab chunks (objects above returned their slots)
+    if (slab_lock) {
+        IOLockLock(slab_lock);
+        for (int i = 0; i < GEM_SLAB_CLASS_COUNT; i++) {
+            struct gem_slab *slab = slab_classes[i];
+            while (slab) {
+                struct gem_slab *next = slab->next;
+                if (slab->used) {
+                    IOLog("IntelGEM: WARNING - Slab %p still has %u slots in use\n",
+                          slab, slab->used);
+                }
+                destroySlab(slab);
+                slab = next;
+            }
+            slab_classes[i] = NULL;
+        }
+        IOLockUnlock(slab_lock);
+        
+        IOLockFree(slab_lock);
+        slab_lock = NULL;
     }
     
-    if (object_list_lock) {
-        IOLockFree(object_list_lock);
-        object_list_lock = NULL;
+    // Free locks
+    for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+        if (object_buckets[i].lock) {
+            IOLockFree(object_buckets[i].lock);
+            object_buckets[i].lock = NULL;
+        }
     }
     
     controller = NULL;
@@ -110,19 +147,41 @@ IntelGEMObject* IntelGEM::createObject(u64 size, u32 flags)
     // Check memory limit
     if (!checkMemoryLimit(size)) {
         IOLog("IntelGEM: Memory limit exceeded for allocation of %llu bytes\n", size);
-        IOLockLock(stats_lock);
-        stats.allocation_failures++;
-        IOLockUnlock(stats_lock);
+        statInc(&stats.allocation_failures);
         return NULL;
     }
     
+    // Small objects come out of a shared slab chunk; fall back to a
+    // dedicated descriptor if the slab path cannot satisfy the request.
+    // Slots share the chunk's LLC, 4KB-aligned binding, so anything that
+    // asks for more than that gets its own object.
+    IntelGEMObject *obj = NULL;
+    if (size <= GEM_SLAB_MAX_OBJECT_SIZE && (flags & ~GEM_SLAB_ALLOC_FLAGS) == 0) {
+        u64 offset = 0;
+        struct gem_slab *slab = slabAlloc(size, &offset);
+        if (slab) {
+            obj = IntelGEMObject::createFromSlab(this, size, flags, slab, offset);
+            if (!obj) {
+                slabFree(slab, offset);
+            }
+        }
+    }
+    
+    if (obj) {
+        trackObject(obj);
+        updateMemoryStats(size);
+        return obj;
+    }
+    
     // Create object
-    IntelGEMObject *obj = IntelGEMObject::create(this, size, flags);
+    obj = IntelGEMObject::create(this, size, flags);
+    if (!obj && trimMapCache() > 0) {
+        // Idle cached mappings were holding kernel VM; retry once
+        obj = IntelGEMObject::create(this, size, flags);
+    }
     if (!obj) {
         IOLog("IntelGEM: Failed to create object\n");
-        IOLockLock(stats_lock);
-        stats.allocation_failures++;
-        IOLockUnlock(stats_lock);
+        statInc(&stats.allocation_failures);
         return NULL;
     }
     
@@ -159,18 +218,95 @@ void IntelGEM::destroyObject(IntelGEMObject *obj)
           obj, stats.active_objects, stats.active_memory / (1024 * 1024));
 }
 
+IntelGEMObject* IntelGEM::createBoundObject(u64 size, u32 flags)
+{
+    IntelGEMObject *obj = createObject(size, flags);
+    if (!obj) {
+        return NULL;
+    }
+    
+    // Slab slots already sit inside their chunk's GGTT range
+    if (obj->isSlabObject()) {
+        return obj;
+    }
+    
+    IntelGTT *gtt = controller ? controller->getGTT() : NULL;
+    if (!gtt) {
+        IOLog("IntelGEM: No GTT to bind object %p\n", obj);
+        destroyObject(obj);
+        return NULL;
+    }
+    
+    u64 addr = gtt->allocateSpace(size, 4096);
+    if (addr == 0) {
+        IOLog("IntelGEM: Failed to allocate GTT space for %llu bytes\n", size);
+        destroyObject(obj);
+        return NULL;
+    }
+    
+    obj->setGTTAddress(addr);
+    
+    if (!gtt->bindObject(obj, 0)) {
+        IOLog("IntelGEM: Failed to bind object %p\n", obj);
+        gtt->freeSpace(addr, size);
+        obj->setGTTAddress(0);
+        destroyObject(obj);
+        return NULL;
+    }
+    
+    return obj;
+}
+
+void IntelGEM::destroyBoundObject(IntelGEMObject *obj)
+{
+    if (!obj) {
+        return;
+    }
+    
+    IntelGTT *gtt = controller ? controller->getGTT() : NULL;
+    u64 addr = obj->getGTTAddress();
+    
+    if (gtt && addr && !obj->isSlabObject()) {
+        gtt->unbindObject(obj);
+        gtt->freeSpace(addr, obj->getSize());
+    }
+    
+    destroyObject(obj);
+}
+
 
  * Object Tracking
 
+u32 IntelGEM::bucketForObject(const IntelGEMObject *obj)
+{
+    // Objects are heap-allocated, so drop the low alignment bits and fold
+    // a few higher ones in to spread neighbours across buckets
+    uintptr_t key = (uintptr_t)obj >> 4;
+    key ^= key >> GEM_OBJECT_BUCKET_SHIFT;
+    key ^= key >> (2 * GEM_OBJECT_BUCKET_SHIFT);
+    return (u32)(key & (GEM_OBJECT_BUCKETS - 1));
+}
+
+void IntelGEM::lockCounted(IOLock *lock)
+{
+    // Count only the acquisitions that would have blocked
+    if (!IOLockTryLock(lock)) {
+        statInc(&stats.lock_contentions);
+        IOLockLock(lock);
+    }
+}
+
 void IntelGEM::trackObject(IntelGEMObject *obj)
 {
     if (!obj) {
         return;
     }
     
-    IOLockLock(object_list_lock);
-    addToList(obj);
-    IOLockUnlock(object_list_lock);
+    struct gem_object_bucket *bucket = &object_buckets[bucketForObject(obj)];
+    
+    lockCounted(bucket->lock);
+    addToList(bucket, obj);
+    IOLockUnlock(bucket->lock);
 }
 
 void IntelGEM::untrackObject(IntelGEMObject *obj)
@@ -179,37 +315,39 @@ void IntelGEM::untrackObject(IntelGEMObject *obj)
         return;
     }
     
-    IOLockLock(object_list_lock);
-    removeFromList(obj);
-    IOLockUnlock(object_list_lock);
+    struct gem_object_bucket *bucket = &object_buckets[bucketForObject(obj)];
+    
+    lockCounted(bucket->lock);
+    removeFromList(bucket, obj);
+    IOLockUnlock(bucket->lock);
 }
 
-void IntelGEM::addToList(IntelGEMObject *obj)
+void IntelGEM::addToList(struct gem_object_bucket *bucket, IntelGEMObject *obj)
 {
     obj->next = NULL;
-    obj->prev = object_list_tail;
+    obj->prev = bucket->tail;
     
-    if (object_list_tail) {
-        object_list_tail->next = obj;
+    if (bucket->tail) {
+        bucket->tail->next = obj;
     } else {
-        object_list_head = obj;
+        bucket->head = obj;
     }
     
-    object_list_tail = obj;
+    bucket->tail = obj;
 }
 
-void IntelGEM::removeFromList(IntelGEMObject *obj)
+void IntelGEM::removeFromList(struct gem_object_bucket *bucket, IntelGEMObject *obj)
 {
     if (obj->prev) {
         obj->prev->next = obj->next;
     } else {
-        object_list_head = obj->next;
+        bucket->head = obj->next;
     }
     
     if (obj->next) {
         obj->next->prev = obj->prev;
     } else {
-        object_list_tail = obj->prev;
+        bucket->tail = obj->prev;
     }
     
     obj->next = NULL;
@@ -232,37 +370,270 @@ void IntelGEM::freeMemory(IntelGEMObject *obj)
     // This is just for accounting
 }
 
+
+ * Slab Allocator
+
+int IntelGEM::slabClassForSize(u64 size)
+{
+    for (int cls = 0; cls < GEM_SLAB_CLASS_COUNT; cls++) {
+        if (size <= (1ULL << (GEM_SLAB_MIN_SHIFT + cls))) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+struct gem_slab* IntelGEM::createSlab(u32 slot_size)
+{
+    // One pinned, contiguous chunk per slab so every slot also satisfies
+    // I915_BO_ALLOC_CONTIGUOUS
+    IOBufferMemoryDescriptor *backing = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(
+        kernel_task,
+        kIODirectionInOut | kIOMemoryPhysicallyContiguous | kIOMemoryKernelUserShared,
+        GEM_SLAB_CHUNK_SIZE,
+        0x0000FFFFFFFFF000ULL);
+    if (!backing) {
+        IOLog("IntelGEM: Failed to allocate slab chunk\n");
+        return NULL;
+    }
+    
+    if (backing->prepare() != kIOReturnSuccess) {
+        IOLog("IntelGEM: Failed to wire slab chunk\n");
+        backing->release();
+        return NULL;
+    }
+    
+    struct gem_slab *slab = (struct gem_slab *)IOMalloc(sizeof(struct gem_slab));
+    if (!slab) {
+        backing->complete();
+        backing->release();
+        return NULL;
+    }
+    bzero(slab, sizeof(*slab));
+    
+    slab->backing = backing;
+    slab->cpu_base = (u8 *)backing->getBytesNoCopy();
+    slab->slot_size = slot_size;
+    slab->slot_count = GEM_SLAB_CHUNK_SIZE / slot_size;
+    slab->free_mask = (slab->slot_count >= 64) ? ~0ULL : ((1ULL << slab->slot_count) - 1);
+    bzero(slab->cpu_base, GEM_SLAB_CHUNK_SIZE);
+    
+    // Bind the whole chunk once, with the same PTE bits bindObject uses;
+    // sub-objects address it by offset and never rebind their slot
+    IntelGTT *gtt = controller ? controller->getGTT() : NULL;
+    if (gtt) {
+        u64 addr = gtt->allocateSpace(GEM_SLAB_CHUNK_SIZE, 4096);
+        if (addr) {
+            if (gtt->insertEntries(addr, backing, GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE | GTT_PAGE_CACHE_LLC)) {
+                slab->gpu_base = addr;
+                slab->gtt_bound = true;
+            } else {
+                gtt->freeSpace(addr, GEM_SLAB_CHUNK_SIZE);
+            }
+        }
+        
+        // Slots would otherwise inherit an address nothing maps; let the
+        // caller fall back to a dedicated object instead
+        if (!slab->gtt_bound) {
+            IOLog("IntelGEM: Failed to bind slab chunk\n");
+            IOFree(slab, sizeof(struct gem_slab));
+            backing->complete();
+            backing->release();
+            return NULL;
+        }
+    } else {
+        // Same fallback as IntelGEMObject::allocateGPUAddress
+        slab->gpu_base = backing->getPhysicalSegment(0, NULL);
+    }
+    
+    statInc(&stats.slab_chunks);
+    statAdd(&stats.slab_chunk_memory, GEM_SLAB_CHUNK_SIZE);
+    
+    IOLog("IntelGEM: New slab chunk %p (%u x %u bytes) at GPU 0x%llx%s\n",
+          slab, slab->slot_count, slot_size, slab->gpu_base,
+          slab->gtt_bound ? "" : " (unbound)");
+    
+    return slab;
+}
+
+void IntelGEM::destroySlab(struct gem_slab *slab)
+{
+    if (!slab) {
+        return;
+    }
+    
+    if (slab->gtt_bound) {
+        IntelGTT *gtt = controller ? controller->getGTT() : NULL;
+        if (gtt) {
+            gtt->clearEntries(slab->gpu_base, GEM_SLAB_CHUNK_SIZE);
+            gtt->freeSpace(slab->gpu_base, GEM_SLAB_CHUNK_SIZE);
+        }
+    }
+    
+    if (slab->backing) {
+        slab->backing->complete();
+        slab->backing->release();
+    }
+    
+    IOFree(slab, sizeof(struct gem_slab));
+    
+    statAdd(&stats.slab_chunks, -1);
+    statAdd(&stats.slab_chunk_memory, -(s64)GEM_SLAB_CHUNK_SIZE);
+}
+
+struct gem_slab* IntelGEM::slabAlloc(u64 size, u64 *out_offset)
+{
+    int cls = slabClassForSize(size);
+    if (cls < 0 || !out_offset || !slab_lock) {
+        return NULL;
+    }
+    
+    struct gem_slab *fresh = NULL;
+    struct gem_slab *slab;
+    
+    lockCounted(slab_lock);
+    
+    for (;;) {
+        slab = slab_classes[cls];
+        while (slab && slab->free_mask == 0) {
+            slab = slab->next;
+        }
+        
+        if (slab || fresh) {
+            break;
+        }
+        
+        // Allocating, wiring and binding a chunk is slow; do it unlocked
+        // and rescan afterwards in case another thread published one first
+        IOLockUnlock(slab_lock);
+        fresh = createSlab(1U << (GEM_SLAB_MIN_SHIFT + cls));
+        if (!fresh) {
+            return NULL;
+        }
+        lockCounted(slab_lock);
+    }
+    
+    if (!slab) {
+        fresh->next = slab_classes[cls];
+        slab_classes[cls] = fresh;
+        slab = fresh;
+        fresh = NULL;
+    }
+    
+    u32 slot = __builtin_ctzll(slab->free_mask);
+    slab->free_mask &= ~(1ULL << slot);
+    slab->used++;
+    *out_offset = (u64)slot * slab->slot_size;
+    
+    IOLockUnlock(slab_lock);
+    
+    // Lost the race to publish a chunk; ours was never visible
+    if (fresh) {
+        destroySlab(fresh);
+    }
+    
+    statInc(&stats.slab_objects);
+    
+    return slab;
+}
+
+void IntelGEM::slabFree(struct gem_slab *slab, u64 offset)
+{
+    if (!slab || !slab_lock) {
+        return;
+    }
+    
+    u32 slot = (u32)(offset / slab->slot_size);
+    
+    // Scrub before the slot can be handed to another client
+    bzero(slab->cpu_base + offset, slab->slot_size);
+    
+    bool release_chunk = false;
+    
+    lockCounted(slab_lock);
+    
+    slab->free_mask |= (1ULL << slot);
+    slab->used--;
+    
+    // Keep one chunk per class around to absorb alloc/free churn
+    if (slab->used == 0) {
+        int cls = slabClassForSize(slab->slot_size);
+        struct gem_slab **link = &slab_classes[cls];
+        if (*link != slab || slab->next) {
+            while (*link && *link != slab) {
+                link = &(*link)->next;
+            }
+            if (*link) {
+                *link = slab->next;
+                release_chunk = true;
+            }
+        }
+    }
+    
+    IOLockUnlock(slab_lock);
+    
+    statAdd(&stats.slab_objects, -1);
+    
+    if (release_chunk) {
+        destroySlab(slab);
+    }
+}
+
 bool IntelGEM::checkMemoryLimit(u64 size)
 {
-    IOLockLock(stats_lock);
-    bool ok = (stats.active_memory + size <= max_memory);
-    IOLockUnlock(stats_lock);
-    return ok;
+    // Advisory: a concurrent create may still push slightly past the limit
+    u64 active = *(volatile u64 *)&stats.active_memory;
+    return (active + size <= max_memory);
 }
 
 void IntelGEM::updateMemoryStats(s64 delta)
 {
-    IOLockLock(stats_lock);
-    
     if (delta > 0) {
-        stats.total_objects++;
-        stats.active_objects++;
-        stats.total_memory += delta;
-        stats.active_memory += delta;
+        statInc(&stats.total_objects);
+        statInc(&stats.active_objects);
+        statAdd(&stats.total_memory, delta);
+        u64 active = (u64)OSAddAtomic64(delta, (volatile SInt64 *)&stats.active_memory) + delta;
         
-        if (stats.active_memory > stats.peak_memory) {
-            stats.peak_memory = stats.active_memory;
+        // Raise the high-water mark unless another thread already beat us to it
+        u64 peak = *(volatile u64 *)&stats.peak_memory;
+        while (active > peak) {
+            if (OSCompareAndSwap64(peak, active, (volatile UInt64 *)&stats.peak_memory)) {
+                break;
+            }
+            peak = *(volatile u64 *)&stats.peak_memory;
         }
     } else {
-        stats.active_objects--;
-        stats.active_memory -= (-delta);
+        statAdd(&stats.active_objects, -1);
+        statAdd(&stats.active_memory, delta);
     }
-    
-    IOLockUnlock(stats_lock);
 }
 
 
 
+u32 IntelGEM::trimMapCache()
+{
+    u32 released = 0;
+    
+    for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+        struct gem_object_bucket *bucket = &object_buckets[i];
+        
+        lockCounted(bucket->lock);
+        
+        for (IntelGEMObject *obj = bucket->head; obj; obj = obj->next) {
+            released += obj->releaseCachedMaps();
+        }
+        
+        IOLockUnlock(bucket->lock);
+    }
+    
+    if (released) {
+        statAdd(&stats.map_cache_released, released);
+        IOLog("IntelGEM: Released %u cached CPU mappings\n", released);
+    }
+    
+    return released;
+}
+
 bool IntelGEM::waitForIdle(u64 timeout_ms)
 {
     IOLog("IntelGEM: waitForIdle - timeout=%llu ms\n", timeout_ms);
@@ -270,20 +641,24 @@ bool IntelGEM::waitForIdle(u64 timeout_ms)
     // TODO: Wait for all GPU operations to complete
     // For now, just iterate through objects
     
-    IOLockLock(object_list_lock);
-    
-    IntelGEMObject *obj = object_list_head;
-    while (obj) {
-        if (!obj->waitIdle(timeout_ms * 1000000ULL)) {
-            IOLog("IntelGEM: Object %p failed to become idle\n", obj);
-            IOLockUnlock(object_list_lock);
-            return false;
+    for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+        struct gem_object_bucket *bucket = &object_buckets[i];
+        
+        lockCounted(bucket->lock);
+        
+        IntelGEMObject *obj = bucket->head;
+        while (obj) {
+            if (!obj->waitIdle(timeout_ms * 1000000ULL)) {
+                IOLog("IntelGEM: Object %p failed to become idle\n", obj);
+                IOLockUnlock(bucket->lock);
+                return false;
+            }
+            obj = obj->next;
         }
-        obj = obj->next;
+        
+        IOLockUnlock(bucket->lock);
     }
     
-    IOLockUnlock(object_list_lock);
-    
     IOLog("IntelGEM: All objects idle\n");
     return true;
 }
@@ -292,16 +667,20 @@ bool IntelGEM::flushAll()
 {
     IOLog("IntelGEM: flushAll\n");
     
-    IOLockLock(object_list_lock);
-    
-    IntelGEMObject *obj = object_list_head;
-    while (obj) {
-        obj->flush();
-        obj = obj->next;
+    for (int i = 0; i < GEM_OBJECT_BUCKETS; i++) {
+        struct gem_object_bucket *bucket = &object_buckets[i];
+        
+        lockCounted(bucket->lock);
+        
+        IntelGEMObject *obj = bucket->head;
+        while (obj) {
+            obj->flush();
+            obj = obj->next;
+        }
+        
+        IOLockUnlock(bucket->lock);
     }
     
-    IOLockUnlock(object_list_lock);
-    
     return true;
 }
 
@@ -314,24 +693,31 @@ void IntelGEM::getStatistics(struct gem_stats *out_stats)
         return;
     }
     
-    IOLockLock(stats_lock);
-    memcpy(out_stats, &stats, sizeof(struct gem_stats));
-    IOLockUnlock(stats_lock);
+    // Each counter is read atomically; the snapshot as a whole is not
+    const volatile u64 *src = (const volatile u64 *)&stats;
+    u64 *dst = (u64 *)out_stats;
+    for (size_t i = 0; i < sizeof(struct gem_stats) / sizeof(u64); i++) {
+        dst[i] = src[i];
+    }
 }
 
 void IntelGEM::printStatistics()
 {
-    IOLockLock(stats_lock);
+    struct gem_stats snap;
+    getStatistics(&snap);
     
     IOLog("IntelGEM: Statistics:\n");
-    IOLog("  Total objects created: %llu\n", stats.total_objects);
-    IOLog("  Active objects: %llu\n", stats.active_objects);
-    IOLog("  Total memory allocated: %llu MB\n", stats.total_memory / (1024 * 1024));
-    IOLog("  Active memory: %llu MB\n", stats.active_memory / (1024 * 1024));
-    IOLog("  Peak memory: %llu MB\n", stats.peak_memory / (1024 * 1024));
-    IOLog("  Allocation failures: %llu\n", stats.allocation_failures);
-    
-    IOLockUnlock(stats_lock);
+    IOLog("  Total objects created: %llu\n", snap.total_objects);
+    IOLog("  Active objects: %llu\n", snap.active_objects);
+    IOLog("  Total memory allocated: %llu MB\n", snap.total_memory / (1024 * 1024));
+    IOLog("  Active memory: %llu MB\n", snap.active_memory / (1024 * 1024));
+    IOLog("  Peak memory: %llu MB\n", snap.peak_memory / (1024 * 1024));
+    IOLog("  Allocation failures: %llu\n", snap.allocation_failures);
+    IOLog("  Slab objects: %llu in %llu chunks (%llu KB wired)\n",
+          snap.slab_objects, snap.slab_chunks, snap.slab_chunk_memory / 1024);
+    IOLog("  Lock contentions: %llu\n", snap.lock_contentions);
+    IOLog("  Map cache: %llu hits, %llu misses, %llu released\n",
+          snap.map_cache_hits, snap.map_cache_misses, snap.map_cache_released);
 }
 
 
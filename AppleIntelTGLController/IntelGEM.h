@@ -10,6 +10,7 @@
 
 #include <IOKit/IOService.h>
 #include <IOKit/IOLocks.h>
+#include <libkern/OSAtomic.h>
 #include "IntelGEMObject.h"
 #include "linux_compat.h"
 
@@ -17,7 +18,46 @@
 class AppleIntelTGLController;
 class IntelUncore;
 
-/* GEM statistics */
+/*
+ * Small-object slab allocator
+ *
+ * Objects up to GEM_SLAB_MAX_OBJECT_SIZE are carved out of pinned,
+ * physically contiguous backing chunks instead of getting their own
+ * IOBufferMemoryDescriptor. Each chunk is bound into the GGTT once and
+ * every slot inherits that binding at (gpu_base + offset).
+ */
+#define GEM_SLAB_MIN_SHIFT          12                  /* 4KB smallest class */
+#define GEM_SLAB_CLASS_COUNT        5                   /* 4K, 8K, 16K, 32K, 64K */
+#define GEM_SLAB_MAX_OBJECT_SIZE    (1ULL << (GEM_SLAB_MIN_SHIFT + GEM_SLAB_CLASS_COUNT - 1))
+#define GEM_SLAB_CHUNK_SIZE         (256 * 1024)        /* 64 slots of 4KB, 4 of 64KB */
+#define GEM_SLAB_ALLOC_FLAGS        (I915_BO_ALLOC_CONTIGUOUS | I915_BO_ALLOC_CPU_CLEAR) /* Flags a slot can honour */
+
+struct gem_slab {
+    IOBufferMemoryDescriptor *backing;  /* Pinned chunk */
+    u8 *cpu_base;                       /* Kernel virtual address of chunk */
+    u64 gpu_base;                       /* GGTT address (or physical if unbound) */
+    bool gtt_bound;                     /* gpu_base came from the GGTT */
+    u64 free_mask;                      /* Bit set = slot free */
+    u32 slot_size;
+    u32 slot_count;
+    u32 used;
+    struct gem_slab *next;
+};
+
+/*
+ * Object tracking is sharded by object address so concurrent clients
+ * creating and destroying objects rarely meet on the same lock.
+ */
+#define GEM_OBJECT_BUCKET_SHIFT     4
+#define GEM_OBJECT_BUCKETS          (1 << GEM_OBJECT_BUCKET_SHIFT)
+
+struct gem_object_bucket {
+    IntelGEMObject *head;
+    IntelGEMObject *tail;
+    IOLock *lock;
+};
+
+/* GEM statistics - updated with atomics, no lock */
 struct gem_stats {
     u64 total_objects;          /* Total objects created */
     u64 active_objects;         /* Currently active objects */
@@ -25,6 +65,13 @@ struct gem_stats {
     u64 active_memory;          /* Currently allocated memory */
     u64 peak_memory;            /* Peak memory usage */
     u64 allocation_failures;    /* Failed allocations */
+    u64 slab_objects;           /* Active objects carved from slabs */
+    u64 slab_chunks;            /* Backing chunks currently held */
+    u64 slab_chunk_memory;      /* Bytes wired by slab chunks */
+    u64 lock_contentions;       /* Tracking/slab lock acquisitions that had to block */
+    u64 map_cache_hits;         /* CPU maps served from an object's map cache */
+    u64 map_cache_misses;       /* CPU maps that had to build a kernel mapping */
+    u64 map_cache_released;     /* Cached mappings torn down under pressure */
 };
 
 class IntelGEM {
@@ -37,6 +84,12 @@ public:
     IntelGEMObject* createObject(u64 size, u32 flags = 0);
     void destroyObject(IntelGEMObject *obj);
     
+    /* Objects the kernel keeps GGTT-mapped for their lifetime (rings,
+     * status pages, context images, page table roots). Slab-backed or
+     * not, getGTTAddress() is valid on return. */
+    IntelGEMObject* createBoundObject(u64 size, u32 flags = 0);
+    void destroyBoundObject(IntelGEMObject *obj);
+    
     /* Object tracking */
     void trackObject(IntelGEMObject *obj);
     void untrackObject(IntelGEMObject *obj);
@@ -45,6 +98,14 @@ public:
     bool allocateMemory(IntelGEMObject *obj);
     void freeMemory(IntelGEMObject *obj);
     
+    /* Slab sub-allocation (objects <= GEM_SLAB_MAX_OBJECT_SIZE) */
+    struct gem_slab* slabAlloc(u64 size, u64 *out_offset);
+    void slabFree(struct gem_slab *slab, u64 offset);
+    
+    /* CPU map cache */
+    void noteMapCacheAccess(bool hit) { statInc(hit ? &stats.map_cache_hits : &stats.map_cache_misses); }
+    u32 trimMapCache();
+    
     /* Synchronization */
     bool waitForIdle(u64 timeout_ms);
     bool flushAll();
@@ -59,25 +120,37 @@ public:
     bool isInitialized() const { return initialized; }
     
 private:
-    /* Object list management */
-    void addToList(IntelGEMObject *obj);
-    void removeFromList(IntelGEMObject *obj);
+    /* Object list management (caller holds the bucket lock) */
+    static u32 bucketForObject(const IntelGEMObject *obj);
+    void addToList(struct gem_object_bucket *bucket, IntelGEMObject *obj);
+    void removeFromList(struct gem_object_bucket *bucket, IntelGEMObject *obj);
+    
+    /* Atomic statistics helpers */
+    void statAdd(u64 *counter, s64 delta) { OSAddAtomic64(delta, (volatile SInt64 *)counter); }
+    void statInc(u64 *counter) { OSIncrementAtomic64((volatile SInt64 *)counter); }
+    void lockCounted(IOLock *lock);
     
     /* Memory limit checking */
     bool checkMemoryLimit(u64 size);
     void updateMemoryStats(s64 delta);  // s64 is int64_t
     
+    /* Slab chunk management */
+    static int slabClassForSize(u64 size);
+    struct gem_slab* createSlab(u32 slot_size);
+    void destroySlab(struct gem_slab *slab);
+    
     /* Parent controller */
     AppleIntelTGLController *controller;
     
     /* Object tracking */
-    IntelGEMObject *object_list_head;
-    IntelGEMObject *object_list_tail;
-    IOLock *object_list_lock;
+    struct gem_object_bucket object_buckets[GEM_OBJECT_BUCKETS];
+    
+    /* Slab classes, each a list of chunks */
+    struct gem_slab *slab_classes[GEM_SLAB_CLASS_COUNT];
+    IOLock *slab_lock;
     
     /* Statistics */
     struct gem_stats stats;
-    IOLock *stats_lock;
     
     /* Configuration */
     u64 max_memory;             /* Maximum memory to allocate */
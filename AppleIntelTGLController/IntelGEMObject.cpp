@@ -7,7 +7,10 @@
 
 #include "IntelGEMObject.h"
 #include "IntelGEM.h"
+#include "IntelGTT.h"
+#include "AppleIntelTGLController.h"
 #include <IOKit/IOLib.h>
+#include <IOKit/IOSubMemoryDescriptor.h>
 
 
  * Creation and Destruction
@@ -16,10 +19,16 @@ IntelGEMObject::IntelGEMObject()
 {
     gem = NULL;
     memory_descriptor = NULL;
-    memory_map = NULL;
+    for (int i = 0; i < I915_MAP_COUNT; i++) {
+        map_cache[i] = NULL;
+        map_pins[i] = 0;
+    }
     cpu_address = NULL;
     gpu_address = 0;
+    gtt_binding = NULL;
     size = 0;
+    slab = NULL;
+    slab_offset = 0;
     cache_level = I915_CACHE_NONE;
     read_domains = 0;
     write_domain = 0;
@@ -72,6 +81,27 @@ IntelGEMObject* IntelGEMObject::create(IntelGEM *gem_mgr, u64 obj_size, u32 obj_
     return obj;
 }
 
+IntelGEMObject* IntelGEMObject::createFromSlab(IntelGEM *gem_mgr, u64 obj_size, u32 obj_flags,
+                                               struct gem_slab *parent, u64 offset)
+{
+    if (!gem_mgr || !parent || obj_size == 0 || obj_size > parent->slot_size) {
+        return NULL;
+    }
+    
+    IntelGEMObject *obj = new IntelGEMObject();
+    if (!obj) {
+        return NULL;
+    }
+    
+    // No per-object logging here: this is the hot path for small state buffers
+    if (!obj->initFromSlab(gem_mgr, obj_size, obj_flags, parent, offset)) {
+        delete obj;
+        return NULL;
+    }
+    
+    return obj;
+}
+
 void IntelGEMObject::destroy()
 {
     IOLog("IntelGEMObject: Destroying object %p (ref_count=%llu)\n", this, ref_count);
@@ -131,6 +161,50 @@ bool IntelGEMObject::init(IntelGEM *gem_mgr, u64 obj_size, u32 obj_flags)
     return true;
 }
 
+bool IntelGEMObject::initFromSlab(IntelGEM *gem_mgr, u64 obj_size, u32 obj_flags,
+                                  struct gem_slab *parent, u64 offset)
+{
+    gem = gem_mgr;
+    size = obj_size;
+    flags = obj_flags;
+    
+    ref_lock = IOLockAlloc();
+    if (!ref_lock) {
+        IOLog("IntelGEMObject: Failed to allocate ref_lock\n");
+        return false;
+    }
+    
+    // Window onto the parent chunk so existing getLength()/getPhysicalSegment()
+    // users see only this object's bytes
+    memory_descriptor = IOSubMemoryDescriptor::withSubRange(parent->backing, offset,
+                                                            obj_size, kIODirectionInOut);
+    if (!memory_descriptor) {
+        IOLog("IntelGEMObject: Failed to create slab sub-descriptor\n");
+        cleanup();
+        return false;
+    }
+    
+    // The chunk is already pinned, mapped and bound; just inherit its addresses.
+    // The slot is only owned by this object once init can no longer fail.
+    slab = parent;
+    slab_offset = offset;
+    cpu_address = parent->cpu_base + offset;
+    cpu_mapped = true;
+    gpu_address = parent->gpu_base + offset;
+    
+    clock_sec_t secs;
+    clock_nsec_t nsecs;
+    clock_get_system_nanotime(&secs, &nsecs);
+    created_time = (u64)secs * 1000000000ULL + nsecs;
+    last_access_time = created_time;
+    
+    cache_level = I915_CACHE_LLC;
+    read_domains = I915_GEM_DOMAIN_CPU;
+    write_domain = I915_GEM_DOMAIN_CPU;
+    
+    return true;
+}
+
 void IntelGEMObject::cleanup()
 {
     // Unmap if mapped
@@ -145,6 +219,15 @@ void IntelGEMObject::cleanup()
     // Free GPU address
     freeGPUAddress();
     
+    // Tear down cached mappings before the descriptor goes away
+    for (int i = 0; i < I915_MAP_COUNT; i++) {
+        if (map_cache[i]) {
+            map_cache[i]->release();
+            map_cache[i] = NULL;
+        }
+        map_pins[i] = 0;
+    }
+    
     // Free memory
     freeMemory();
     
@@ -194,6 +277,15 @@ void IntelGEMObject::freeMemory()
         memory_descriptor->release();
         memory_descriptor = NULL;
     }
+    
+    // Hand the slot back to its chunk
+    if (slab) {
+        if (gem) {
+            gem->slabFree(slab, slab_offset);
+        }
+        slab = NULL;
+        slab_offset = 0;
+    }
 }
 
 bool IntelGEMObject::allocateGPUAddress()
@@ -220,6 +312,16 @@ bool IntelGEMObject::allocateGPUAddress()
 void IntelGEMObject::freeGPUAddress()
 {
     // TODO: Release GTT entry
+    // Stop eviction tracking so the GTT never calls back into a dead object
+    if (gtt_binding && gem) {
+        AppleIntelTGLController *ctrl = gem->getController();
+        IntelGTT *gtt = ctrl ? ctrl->getGTT() : NULL;
+        if (gtt) {
+            gtt->untrackBinding(&gtt_binding);
+        }
+        gtt_binding = NULL;
+    }
+    
     gpu_address = 0;
 }
 
@@ -261,17 +363,98 @@ bool IntelGEMObject::mapCPU(void **address)
         return true;
     }
     
-    // Map memory for CPU access
-    memory_map = memory_descriptor->map();
-    if (!memory_map) {
-        IOLog("IntelGEMObject: Failed to map memory\n");
+    // Cached (WB) mapping from the map cache; repeat map/unmap pairs reuse it
+    if (!pinMap(I915_MAP_WB, &cpu_address)) {
         return false;
     }
     
-    memory_map->retain();
-    cpu_address = (void*)memory_map->getVirtualAddress();
     cpu_mapped = true;
-    map_count++;
+    *address = cpu_address;
+    return true;
+}
+
+void IntelGEMObject::unmapCPU()
+{
+    // Slab objects live in the chunk's permanent kernel mapping
+    if (!cpu_mapped || slab) {
+        return;
+    }
+    
+    // Drop the pin only; the mapping stays cached for the next mapCPU()
+    unpinMap(I915_MAP_WB);
+    
+    cpu_address = NULL;
+    cpu_mapped = false;
+}
+
+bool IntelGEMObject::pinMap(enum intel_map_type type, void **address)
+{
+    if (!memory_descriptor || !address || type >= I915_MAP_COUNT) {
+        return false;
+    }
+    
+    // Slab chunks already have a permanent cached kernel mapping. Another
+    // cache mode would alias those pages with conflicting attributes, so
+    // callers that need WC/UC must not allocate from the slab.
+    if (slab) {
+        if (type != I915_MAP_WB) {
+            IOLog("IntelGEMObject: Map type %d not supported on a slab object\n", type);
+            return false;
+        }
+        
+        // The first map stands in for creating one; only reuse is a hit
+        IOLockLock(ref_lock);
+        bool hit = (map_count != 0);
+        if (!hit) {
+            map_count++;
+        }
+        IOLockUnlock(ref_lock);
+        
+        *address = slab->cpu_base + slab_offset;
+        if (gem) {
+            gem->noteMapCacheAccess(hit);
+        }
+        return true;
+    }
+    
+    IOLockLock(ref_lock);
+    
+    // Only one cache mode may alias the pages at a time (as in i915's
+    // pin_map): an idle mapping of another type is dropped, a busy one wins
+    for (int i = 0; i < I915_MAP_COUNT; i++) {
+        if (i == type || !map_cache[i]) {
+            continue;
+        }
+        if (map_pins[i] > 0) {
+            IOLockUnlock(ref_lock);
+            IOLog("IntelGEMObject: Map type %d requested while type %d is pinned\n", type, i);
+            return false;
+        }
+        map_cache[i]->release();
+        map_cache[i] = NULL;
+    }
+    
+    bool hit = (map_cache[type] != NULL);
+    if (!hit) {
+        static const IOOptionBits cacheModes[I915_MAP_COUNT] = {
+            kIOMapDefaultCache,
+            kIOMapWriteCombineCache,
+            kIOMapInhibitCache,
+        };
+        
+        map_cache[type] = memory_descriptor->map(cacheModes[type]);
+        if (!map_cache[type]) {
+            IOLockUnlock(ref_lock);
+            IOLog("IntelGEMObject: Failed to map memory (type %d)\n", type);
+            return false;
+        }
+        map_count++;
+    }
+    
+    map_pins[type]++;
+    *address = (void *)map_cache[type]->getVirtualAddress();
+    
+    IOLockUnlock(ref_lock);
     
     // Update access time
     clock_sec_t secs;
@@ -279,27 +462,41 @@ bool IntelGEMObject::mapCPU(void **address)
     clock_get_system_nanotime(&secs, &nsecs);
     last_access_time = (u64)secs * 1000000000ULL + nsecs;
     
-    *address = cpu_address;
+    if (gem) {
+        gem->noteMapCacheAccess(hit);
+    }
     
-    IOLog("IntelGEMObject: Mapped to CPU address %p\n", cpu_address);
     return true;
 }
 
-void IntelGEMObject::unmapCPU()
+void IntelGEMObject::unpinMap(enum intel_map_type type)
 {
-    if (!cpu_mapped) {
+    if (type >= I915_MAP_COUNT || slab) {
         return;
     }
     
-    if (memory_map) {
-        memory_map->release();
-        memory_map = NULL;
+    IOLockLock(ref_lock);
+    if (map_pins[type] > 0) {
+        map_pins[type]--;
     }
+    IOLockUnlock(ref_lock);
+}
+
+u32 IntelGEMObject::releaseCachedMaps()
+{
+    u32 released = 0;
     
-    cpu_address = NULL;
-    cpu_mapped = false;
+    IOLockLock(ref_lock);
+    for (int i = 0; i < I915_MAP_COUNT; i++) {
+        if (map_cache[i] && map_pins[i] == 0) {
+            map_cache[i]->release();
+            map_cache[i] = NULL;
+            released++;
+        }
+    }
+    IOLockUnlock(ref_lock);
     
-    IOLog("IntelGEMObject: Unmapped from CPU\n");
+    return released;
 }
 
 bool IntelGEMObject::mapGTT(u64 *address)
@@ -364,6 +561,12 @@ bool IntelGEMObject::setCacheLevel(enum intel_cache_level level)
         return true;  // Already set
     }
     
+    // Slab slots share their chunk's LLC binding with their neighbours
+    if (slab) {
+        IOLog("IntelGEMObject: Cannot change cache level of a slab object\n");
+        return false;
+    }
+    
     // TODO: Implement cache level changes
     // This requires flushing caches and updating PTEs
     
@@ -15,6 +15,8 @@
 // Forward declarations
 class IntelGEM;
 class IntelVMA;
+struct gem_slab;
+struct gtt_binding;
 
 /* Cache levels for buffer objects */
 enum intel_cache_level {
@@ -44,12 +46,21 @@ enum intel_memory_domain {
      I915_GEM_DOMAIN_INSTRUCTION | \
      I915_GEM_DOMAIN_VERTEX)
 
+/* CPU mapping types kept in the per-object map cache */
+enum intel_map_type {
+    I915_MAP_WB = 0,            /* Cached (write-back) */
+    I915_MAP_WC,                /* Write-combined, for streaming uploads */
+    I915_MAP_UC,                /* Uncached */
+    I915_MAP_COUNT
+};
+
 /* Buffer object flags */
 enum intel_gem_object_flags {
     I915_BO_ALLOC_CONTIGUOUS    = (1 << 0),  /* Physically contiguous */
     I915_BO_ALLOC_VOLATILE      = (1 << 1),  /* Can be discarded */
     I915_BO_ALLOC_USER          = (1 << 2),  /* User-visible object */
     I915_BO_ALLOC_CPU_CLEAR     = (1 << 3),  /* Clear on CPU map */
+    I915_BO_ALLOC_SCANOUT       = (1 << 4),  /* Display surface, needs its own aligned binding */
 };
 
 /* Buffer object structure - represents a GPU buffer */
@@ -59,6 +70,8 @@ class IntelGEMObject {
 public:
     /* Creation and destruction */
     static IntelGEMObject* create(IntelGEM *gem, u64 size, u32 flags = 0);
+    static IntelGEMObject* createFromSlab(IntelGEM *gem, u64 size, u32 flags,
+                                          struct gem_slab *slab, u64 offset);
     void destroy();
     
     /* Constructor/Destructor - public for create pattern */
@@ -72,6 +85,13 @@ public:
     /* Memory mapping */
     bool mapCPU(void **address);
     void unmapCPU();
+    
+    /* Map cache: mappings persist after unpin and are only torn down by
+     * releaseCachedMaps() (memory pressure), a switch to another map type,
+     * or object destruction */
+    bool pinMap(enum intel_map_type type, void **address);
+    void unpinMap(enum intel_map_type type);
+    u32 releaseCachedMaps();
     bool mapGTT(u64 *gpu_address);
     void unmapGTT();
     
@@ -99,12 +119,21 @@ public:
     bool isValid() const { return (memory_descriptor != NULL); }
     bool isMapped() const { return cpu_mapped || gtt_mapped; }
     
+    /* GGTT eviction tracking slot (owned by IntelGTT) */
+    struct gtt_binding **getGTTBindingSlot() { return &gtt_binding; }
+    
+    /* Slab sub-objects share their chunk's backing and GTT binding */
+    bool isSlabObject() const { return slab != NULL; }
+    u64 getBackingOffset() const { return slab_offset; }  // Offset within backing chunk
+    
     /* Statistics */
     u64 getRefCount() const { return ref_count; }
     u64 getMapCount() const { return map_count; }
     
     /* Initialization - public for external use */
     bool init(IntelGEM *gem, u64 size, u32 flags = 0);
+    bool initFromSlab(IntelGEM *gem, u64 size, u32 flags,
+                      struct gem_slab *slab, u64 offset);
     
 private:
     /* Cleanup */
@@ -121,13 +150,19 @@ private:
     
     /* Memory descriptor */
     IOMemoryDescriptor *memory_descriptor;  /* macOS memory object */
-    IOMemoryMap *memory_map;                /* CPU mapping */
-    void *cpu_address;                      /* CPU virtual address */
+    IOMemoryMap *map_cache[I915_MAP_COUNT]; /* Cached CPU mappings by type */
+    u32 map_pins[I915_MAP_COUNT];           /* Active users per mapping */
+    void *cpu_address;                      /* CPU virtual address (mapCPU) */
     
     /* GPU addressing */
     u64 gpu_address;                        /* GPU virtual address */
+    struct gtt_binding *gtt_binding;        /* GGTT LRU entry, NULL if untracked */
     u64 size;                               /* Object size in bytes */
     
+    /* Slab backing (NULL for standalone objects) */
+    struct gem_slab *slab;                  /* Parent chunk */
+    u64 slab_offset;                        /* Offset within chunk */
+    
     /* Cache and domain state */
     enum intel_cache_level cache_level;
     u32 read_domains;                       /* Current read domains */
@@ -7,6 +7,7 @@
 #include "AppleIntelTGLController.h"
 #include "IntelRingBuffer.h"
 #include "IntelIOAccelerator.h"
+#include "IntelRequest.h"
 #include <IOKit/IOLib.h>
 
 #define super OSObject
@@ -30,7 +31,7 @@ bool IntelGTInterrupts::init() {
     
     // Initialize handler lists
     for (int i = 0; i < GT_ENGINE_COUNT; i++) {
-        renderCompleteHandlers[i] = nullptr;
+        memset(&renderCompleteHeaps[i], 0, sizeof(RenderCompleteHeap));
         userInterruptHandlers[i] = nullptr;
         gpuHangHandlers[i] = nullptr;
         
@@ -44,6 +45,9 @@ bool IntelGTInterrupts::init() {
     }
     
     pageFaultHandlers = nullptr;
+    renderHandlerFree = nullptr;
+    renderHandlerChunks = nullptr;
+    renderInvocations = nullptr;
     
     enabledInterrupts = 0;
     engineEnabled = 0;
@@ -51,6 +55,7 @@ bool IntelGTInterrupts::init() {
     // Clear statistics
     memset(&stats, 0, sizeof(stats));
     handlerStartTime = 0;
+    decodeTime = 0;
     
     watchdogInterval = WATCHDOG_CHECK_INTERVAL_MS;
     watchdogRunning = false;
@@ -77,6 +82,10 @@ void IntelGTInterrupts::free() {
         stop();
     }
     
+    if (renderLock) {
+        freeRenderCompleteHandlers();
+    }
+    
     // Free locks
     if (interruptLock) IOLockFree(interruptLock);
     if (renderLock) IOLockFree(renderLock);
@@ -140,17 +149,7 @@ void IntelGTInterrupts::stop() {
     unregisterInterruptHandler();
     
     // Free all handler lists
-    IOLockLock(renderLock);
-    for (int i = 0; i < GT_ENGINE_COUNT; i++) {
-        RenderCompleteHandler* handler = renderCompleteHandlers[i];
-        while (handler) {
-            RenderCompleteHandler* next = handler->next;
-            IOFree(handler, sizeof(RenderCompleteHandler));
-            handler = next;
-        }
-        renderCompleteHandlers[i] = nullptr;
-    }
-    IOLockUnlock(renderLock);
+    freeRenderCompleteHandlers();
     
     IOLockLock(userLock);
     for (int i = 0; i < GT_ENGINE_COUNT; i++) {
@@ -248,25 +247,13 @@ bool IntelGTInterrupts::enableInterrupts(uint32_t types) {
     masterCtl |= (1 << 31);
     controller->writeRegister32(GEN11_GT_INT_CTL, masterCtl);
     
-    // Enable per-engine interrupts
-    for (int engine = 0; engine < GT_ENGINE_COUNT; engine++) {
+    // Class enables carry every enabled type; the per-engine masks decide
+    // which engines actually deliver them
+    uint32_t bits = engineInterruptBits(enabledInterrupts);
+    writeGTInterruptEnable(bits);
+    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
         if (engineEnabled & (1 << engine)) {
-            uint32_t engineIER = 0;
-            
-            if (types & GT_INT_RENDER_COMPLETE) {
-                engineIER |= GT_RENDER_COMPLETE_INT;
-            }
-            if (types & GT_INT_USER) {
-                engineIER |= GT_USER_INTERRUPT;
-            }
-            if (types & GT_INT_CONTEXT_SWITCH) {
-                engineIER |= GT_CONTEXT_SWITCH_INT;
-            }
-            if (types & GT_INT_ERROR) {
-                engineIER |= GT_ERROR_INT;
-            }
-            
-            controller->writeRegister32(GEN11_GT_ENGINE_IER(engine), engineIER);
+            writeEngineInterruptMask(engine, ~bits);
         }
     }
     
@@ -281,15 +268,12 @@ void IntelGTInterrupts::disableInterrupts(uint32_t types) {
     
     enabledInterrupts &= ~types;
     
-    for (int engine = 0; engine < GT_ENGINE_COUNT; engine++) {
-        uint32_t engineIER = controller->readRegister32(GEN11_GT_ENGINE_IER(engine));
-        
-        if (types & GT_INT_RENDER_COMPLETE) engineIER &= ~GT_RENDER_COMPLETE_INT;
-        if (types & GT_INT_USER) engineIER &= ~GT_USER_INTERRUPT;
-        if (types & GT_INT_CONTEXT_SWITCH) engineIER &= ~GT_CONTEXT_SWITCH_INT;
-        if (types & GT_INT_ERROR) engineIER &= ~GT_ERROR_INT;
-        
-        controller->writeRegister32(GEN11_GT_ENGINE_IER(engine), engineIER);
+    uint32_t bits = engineInterruptBits(enabledInterrupts);
+    writeGTInterruptEnable(bits);
+    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
+        if (engineEnabled & (1 << engine)) {
+            writeEngineInterruptMask(engine, ~bits);
+        }
     }
     
     if (enabledInterrupts == 0) {
@@ -315,6 +299,7 @@ bool IntelGTInterrupts::enableEngineInterrupts(uint32_t engine) {
     
     IOLockLock(interruptLock);
     engineEnabled |= (1 << engine);
+    writeEngineInterruptMask(engine, ~engineInterruptBits(enabledInterrupts));
     IOLockUnlock(interruptLock);
     
     IOLog("GT engine %s interrupts enabled\n", getEngineName(engine));
@@ -327,9 +312,8 @@ void IntelGTInterrupts::disableEngineInterrupts(uint32_t engine) {
     IOLockLock(interruptLock);
     engineEnabled &= ~(1 << engine);
     
-    uint32_t engineIER = controller->readRegister32(GEN11_GT_ENGINE_IER(engine));
-    engineIER = 0;
-    controller->writeRegister32(GEN11_GT_ENGINE_IER(engine), engineIER);
+    // Class enables are shared with other engines; mask just this one
+    writeEngineInterruptMask(engine, 0xFFFF);
     
     IOLockUnlock(interruptLock);
     
@@ -341,18 +325,42 @@ bool IntelGTInterrupts::registerRenderCompleteHandler(uint32_t engine, uint32_t
                                                      RenderCompleteCallback callback, void* context) {
     if (engine >= GT_ENGINE_COUNT || !callback) return false;
     
-    RenderCompleteHandler* handler = (RenderCompleteHandler*)IOMalloc(sizeof(RenderCompleteHandler));
-    if (!handler) return false;
+    RenderCompleteHeap* heap = &renderCompleteHeaps[engine];
+    
+    IOLockLock(renderLock);
+    
+    // Grow the heap and the node pool here, never in the interrupt path
+    if (heap->count == heap->capacity) {
+        uint32_t newCapacity = heap->capacity ? heap->capacity * 2 : RENDER_HEAP_INITIAL;
+        RenderCompleteHandler** nodes =
+            (RenderCompleteHandler**)IOMalloc(newCapacity * sizeof(RenderCompleteHandler*));
+        if (!nodes) {
+            IOLockUnlock(renderLock);
+            return false;
+        }
+        if (heap->nodes) {
+            memcpy(nodes, heap->nodes, heap->count * sizeof(RenderCompleteHandler*));
+            IOFree(heap->nodes, heap->capacity * sizeof(RenderCompleteHandler*));
+        }
+        heap->nodes = nodes;
+        heap->capacity = newCapacity;
+    }
+    
+    RenderCompleteHandler* handler = allocRenderHandler();
+    if (!handler) {
+        IOLockUnlock(renderLock);
+        return false;
+    }
     
     handler->callback = callback;
     handler->context = context;
     handler->engine = engine;
     handler->waitSeqno = seqno;
     handler->enabled = true;
+    handler->next = nullptr;
+    
+    heapPush(heap, handler);
     
-    IOLockLock(renderLock);
-    handler->next = renderCompleteHandlers[engine];
-    renderCompleteHandlers[engine] = handler;
     IOLockUnlock(renderLock);
     
     return true;
@@ -361,19 +369,28 @@ bool IntelGTInterrupts::registerRenderCompleteHandler(uint32_t engine, uint32_t
 void IntelGTInterrupts::unregisterRenderCompleteHandler(uint32_t engine, RenderCompleteCallback callback) {
     if (engine >= GT_ENGINE_COUNT || !callback) return;
     
-    IOLockLock(renderLock);
+    RenderCompleteHeap* heap = &renderCompleteHeaps[engine];
     
-    RenderCompleteHandler** prev = &renderCompleteHandlers[engine];
-    RenderCompleteHandler* handler = renderCompleteHandlers[engine];
+    IOLockLock(renderLock);
     
-    while (handler) {
+    // Rare path: linear search, O(log n) removal
+    for (uint32_t i = 0; i < heap->count; i++) {
+        RenderCompleteHandler* handler = heap->nodes[i];
         if (handler->callback == callback) {
-            *prev = handler->next;
-            IOFree(handler, sizeof(RenderCompleteHandler));
+            heapRemove(heap, i);
+            handler->next = renderHandlerFree;
+            renderHandlerFree = handler;
             break;
         }
-        prev = &handler->next;
-        handler = handler->next;
+    }
+    
+    // The handler may already have been popped into a batch that runs
+    // unlocked; the caller is free to tear down its context once we return,
+    // so wait for other threads' batches that still carry this callback.
+    // Batches on this thread (a callback unregistering itself or another
+    // handler) are below us on the stack and must not be waited on.
+    while (renderCallbackInFlight(callback)) {
+        IOLockSleep(renderLock, &renderInvocations, THREAD_UNINT);
     }
     
     IOLockUnlock(renderLock);
@@ -387,22 +404,23 @@ bool IntelGTInterrupts::waitForRenderComplete(uint32_t engine, uint32_t seqno, u
         return true;
     }
     
-    uint64_t startTime = mach_absolute_time();
-    {
-        // Use nanoseconds directly
-        // tbase assumed 1:1
-        uint64_t timeoutNs = timeout_ms * 1000000ULL;
-        uint64_t timeoutAbs = (timeoutNs * 1) / 1;
+    // Sleep until updateSeqno() wakes us with a newer seqno
+    uint64_t deadline;
+    clock_interval_to_deadline(timeout_ms, kMillisecondScale, &deadline);
     
-        while (!seqnoComplete(engine, seqno)) {
-            uint64_t now = mach_absolute_time();
-            if ((now - startTime) >= timeoutAbs) {
+    IOLockLock(interruptLock);
+    while (((int32_t)(currentSeqno[engine] - seqno)) < 0) {
+        if (IOLockSleepDeadline(interruptLock, &currentSeqno[engine], deadline,
+                                THREAD_UNINT) == THREAD_TIMED_OUT) {
+            bool complete = ((int32_t)(currentSeqno[engine] - seqno)) >= 0;
+            IOLockUnlock(interruptLock);
+            if (!complete) {
                 IOLog("GT: Render wait timeout on %s (seqno %u)\n", getEngineName(engine), seqno);
-                return false;
             }
-            IOSleep(1);
+            return complete;
         }
     }
+    IOLockUnlock(interruptLock);
     
     return true;
 }
@@ -629,39 +647,39 @@ void IntelGTInterrupts::interruptOccurred(OSObject* owner, IOInterruptEventSourc
 void IntelGTInterrupts::handleInterrupt() {
     handlerStartTime = mach_absolute_time();
     
-    uint32_t masterStatus = controller->readRegister32(GEN11_GT_INT_CTL);
-    if (!(masterStatus & (1 << 31))) {
+    // Already on the work loop (dispatched by the display handler), so
+    // decode, acknowledge and handle in one pass. One master read says which
+    // banks fired; each bank's identities say which engine and what.
+    uint32_t mmioReads = 1;
+    uint32_t masterStatus = controller->readRegister32(GEN11_GFX_MSTR_IRQ);
+    uint32_t banks = masterStatus & (GEN11_GT_DW_IRQ(0) | GEN11_GT_DW_IRQ(1));
+    if (!(masterStatus & GEN11_MASTER_IRQ) || !banks) {
         stats.spuriousInterrupts++;
+        stats.decodeMMIOReads += mmioReads;
         return;
     }
     
     stats.totalInterrupts++;
     
-    // Handle per-engine interrupts
-    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
-        if (!(engineEnabled & (1 << engine))) continue;
-        
-        uint32_t engineIIR = controller->readRegister32(GEN11_GT_ENGINE_IIR(engine));
-        if (engineIIR == 0) continue;
-        
-        if (engineIIR & GT_RENDER_COMPLETE_INT) {
-            handleRenderComplete(engine);
-        }
-        
-        if (engineIIR & GT_USER_INTERRUPT) {
-            handleUserInterrupt(engine);
+    uint32_t engineIIR[GT_ENGINE_COUNT] = { 0 };
+    for (uint32_t bank = 0; bank < GEN11_GT_BANKS; bank++) {
+        if (banks & GEN11_GT_DW_IRQ(bank)) {
+            decodeInterruptBank(bank, engineIIR, &mmioReads);
         }
-        
-        if (engineIIR & GT_CONTEXT_SWITCH_INT) {
-            handleContextSwitch(engine);
-        }
-        
-        if (engineIIR & GT_ERROR_INT) {
-            handleGPUError(engine);
+    }
+    
+    stats.decodeMMIOReads += mmioReads;
+    if (mmioReads > stats.decodeMaxReads) {
+        stats.decodeMaxReads = mmioReads;
+    }
+    decodeTime = mach_absolute_time();
+    
+    // Everything is acknowledged before handling, so completions that land
+    // meanwhile raise a fresh interrupt instead of being lost
+    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
+        if (engineIIR[engine]) {
+            handleEngineInterrupt(engine, engineIIR[engine]);
         }
-        
-        // Clear interrupt
-        controller->writeRegister32(GEN11_GT_ENGINE_IIR(engine), engineIIR);
     }
     
     // Update handler time
@@ -675,12 +693,92 @@ void IntelGTInterrupts::handleInterrupt() {
     }
 }
 
+void IntelGTInterrupts::decodeInterruptBank(uint32_t bank, uint32_t* engineIIR, uint32_t* mmioReads) {
+    uint32_t dw = controller->readRegister32(GEN11_GT_INTR_DW(bank));
+    (*mmioReads)++;
+    if (!dw) {
+        return;
+    }
+    
+    uint32_t bits = dw;
+    while (bits) {
+        uint32_t bit = __builtin_ctz(bits);
+        bits &= bits - 1;
+        
+        // Select the source and read back its identity
+        controller->writeRegister32(GEN11_IIR_REG_SELECTOR(bank), 1U << bit);
+        uint32_t ident = 0;
+        for (uint32_t spin = 0; spin < GEN11_IDENTITY_SPIN_MAX; spin++) {
+            ident = controller->readRegister32(GEN11_INTR_IDENTITY_REG(bank));
+            (*mmioReads)++;
+            if (ident & GEN11_INTR_DATA_VALID) {
+                break;
+            }
+        }
+        if (!(ident & GEN11_INTR_DATA_VALID)) {
+            stats.spuriousInterrupts++;
+            continue;
+        }
+        
+        // Acknowledge the identity
+        controller->writeRegister32(GEN11_INTR_IDENTITY_REG(bank), ident);
+        
+        // The identity names the engine; bank bit positions are not stable
+        // across SKUs
+        uint32_t engine = engineFromIdentity(ident);
+        uint32_t iir = GEN11_INTR_ENGINE_INTR(ident);
+        if (engine < GT_ENGINE_COUNT && (engineEnabled & (1 << engine))) {
+            engineIIR[engine] |= iir;
+        }
+    }
+    
+    // Clear the bank
+    controller->writeRegister32(GEN11_GT_INTR_DW(bank), dw);
+}
+
+uint32_t IntelGTInterrupts::engineFromIdentity(uint32_t ident) {
+    uint32_t instance = GEN11_INTR_ENGINE_INSTANCE(ident);
+    
+    switch (GEN11_INTR_ENGINE_CLASS(ident)) {
+        case GEN11_RENDER_CLASS:
+            return instance == 0 ? GT_ENGINE_RCS : GT_ENGINE_COUNT;
+        case GEN11_COPY_ENGINE_CLASS:
+            return instance == 0 ? GT_ENGINE_BCS : GT_ENGINE_COUNT;
+        case GEN11_VIDEO_DECODE_CLASS:
+            if (instance == 0) return GT_ENGINE_VCS0;
+            if (instance == 1) return GT_ENGINE_VCS1;
+            return GT_ENGINE_COUNT;
+        case GEN11_VIDEO_ENHANCEMENT_CLASS:
+            return instance == 0 ? GT_ENGINE_VECS : GT_ENGINE_COUNT;
+        default:
+            return GT_ENGINE_COUNT;  // GuC, GT PM and other non-engine sources
+    }
+}
+
+void IntelGTInterrupts::handleEngineInterrupt(uint32_t engine, uint32_t iir) {
+    // Every source an engine raised this round is handled once, so a burst
+    // collapses into a single seqno read and retire
+    if (iir & GT_RENDER_COMPLETE_INT) {
+        handleRenderComplete(engine);
+    }
+    
+    if (iir & GT_USER_INTERRUPT) {
+        handleUserInterrupt(engine);
+    }
+    
+    if (iir & GT_CONTEXT_SWITCH_INT) {
+        handleContextSwitch(engine);
+    }
+    
+    if (iir & GT_ERROR_INT) {
+        handleGPUError(engine);
+    }
+}
+
 /* Specific handlers */
 void IntelGTInterrupts::handleRenderComplete(uint32_t engine) {
     uint32_t seqno = readEngineSeqno(engine);
     
-    IOLog("IntelGTInterrupts:  handleRenderComplete(engine=%u) seqno=%u\n", engine, seqno);
-    
     updateSeqno(engine, seqno);
     
     uint64_t now = mach_absolute_time();
@@ -699,14 +797,28 @@ void IntelGTInterrupts::handleRenderComplete(uint32_t engine) {
     updateRenderCompleteStats(engine, latency);
     invokeRenderCompleteHandlers(engine, seqno);
     
-    //  CRITICAL: Update render ring's retired seqno
+    //  CRITICAL: Update the engine's ring retired seqno
     // This allows sync() to complete immediately instead of timing out
-    IntelRingBuffer* renderRing = controller->getRenderRing();
-    if (renderRing && engine == 0) {  // Engine 0 = RCS (render ring)
-        renderRing->retireSeqno(seqno);
-        IOLog("IntelGTInterrupts:  Retired seqno %u on render ring\n", seqno);
+    IntelRingBuffer* ring = controller->getRingBuffer(engine);
+    if (ring) {
+        // Engines may share a ring; the register seqno only describes the
+        // ring if it belongs to this engine, the breadcrumb always does
+        bool ownRing = ((uint32_t)ring->getEngineId() == engine);
+        if (ring->hasBreadcrumbs() || ownRing) {
+            uint32_t done = ring->hasBreadcrumbs() ? ring->getCompletedSeqno() : seqno;
+            ring->retireSeqno(done);
+            
+            // Moves every request up to seqno to the complete queue in one pass
+            IntelRequestManager* requestManager = controller->getRequestManager();
+            if (requestManager) {
+                requestManager->completeUpTo(ring, done);
+            }
+        }
     }
     
+    // Seqno waiters, fence handlers and ring waiters have all been woken
+    updateWakeupLatencyStats();
+    
     //  CRITICAL: Notify IOAccelerator that command completed
     // This allows WindowServer to be woken up
     IntelIOAccelerator* accelerator = controller->getAccelerator();
@@ -718,6 +830,12 @@ void IntelGTInterrupts::handleRenderComplete(uint32_t engine) {
 void IntelGTInterrupts::handleUserInterrupt(uint32_t engine) {
     stats.userInterrupt[engine]++;
     invokeUserInterruptHandlers(engine);
+    
+    // MI_USER_INTERRUPT carries no seqno; let ring waiters re-check HEAD
+    IntelRingBuffer* ring = controller->getRingBuffer(engine);
+    if (ring) {
+        ring->notifyProgress();
+    }
 }
 
 void IntelGTInterrupts::handleContextSwitch(uint32_t engine) {
@@ -810,33 +928,48 @@ void IntelGTInterrupts::detectGPUHang(uint32_t engine) {
 
 /* Hardware register access */
 void IntelGTInterrupts::writeGTInterruptMask(uint32_t mask) {
-    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
-        controller->writeRegister32(GEN11_GT_ENGINE_IMR(engine), mask);
-    }
+    controller->writeRegister32(GEN11_RCS0_RSVD_INTR_MASK, GEN11_INTR_ENGINE_PAIR(mask));
+    controller->writeRegister32(GEN11_BCS_RSVD_INTR_MASK, GEN11_INTR_ENGINE_PAIR(mask));
+    controller->writeRegister32(GEN11_VCS0_VCS1_INTR_MASK, GEN11_INTR_ENGINE_PAIR(mask));
+    controller->writeRegister32(GEN11_VECS0_VECS1_INTR_MASK, GEN11_INTR_ENGINE_PAIR(mask));
 }
 
 void IntelGTInterrupts::writeGTInterruptEnable(uint32_t enable) {
-    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
-        controller->writeRegister32(GEN11_GT_ENGINE_IER(engine), enable);
-    }
+    controller->writeRegister32(GEN11_RENDER_COPY_INTR_ENABLE, GEN11_INTR_ENGINE_PAIR(enable));
+    controller->writeRegister32(GEN11_VCS_VECS_INTR_ENABLE, GEN11_INTR_ENGINE_PAIR(enable));
 }
 
 uint32_t IntelGTInterrupts::readGTInterruptStatus() {
+    // One bit per bank with anything pending
     uint32_t status = 0;
-    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
-        status |= controller->readRegister32(GEN11_GT_ENGINE_ISR(engine));
+    for (uint32_t bank = 0; bank < GEN11_GT_BANKS; bank++) {
+        if (controller->readRegister32(GEN11_GT_INTR_DW(bank))) {
+            status |= GEN11_GT_DW_IRQ(bank);
+        }
     }
     return status;
 }
 
 void IntelGTInterrupts::clearGTInterruptStatus(uint32_t status) {
-    for (uint32_t engine = 0; engine < GT_ENGINE_COUNT; engine++) {
-        controller->writeRegister32(GEN11_GT_ENGINE_IIR(engine), 0xFFFFFFFF);
+    // Acknowledging goes through the identities; the decoded bits are dropped
+    uint32_t engineIIR[GT_ENGINE_COUNT] = { 0 };
+    uint32_t mmioReads = 0;
+    for (uint32_t bank = 0; bank < GEN11_GT_BANKS; bank++) {
+        if (status & GEN11_GT_DW_IRQ(bank)) {
+            decodeInterruptBank(bank, engineIIR, &mmioReads);
+        }
     }
 }
 
 uint32_t IntelGTInterrupts::readEngineSeqno(uint32_t engine) {
     if (engine >= GT_ENGINE_COUNT) return 0;
+    
+    // Render ring breadcrumbs land in its status page; skip the MMIO read
+    IntelRingBuffer* renderRing = controller->getRenderRing();
+    if (engine == 0 && renderRing && renderRing->hasBreadcrumbs()) {
+        return renderRing->getCompletedSeqno();
+    }
+    
     return controller->readRegister32(GEN11_GT_ENGINE_SEQNO(engine));
 }
 
@@ -850,14 +983,52 @@ uint32_t IntelGTInterrupts::readEngineStatus(uint32_t engine) {
     return controller->readRegister32(GEN11_GT_ENGINE_RING_CTL(engine));
 }
 
+/* Where each GTEngine's 16 interrupt bits sit in the Gen11 registers */
+struct Gen11EngineIntrLayout {
+    uint32_t enableReg;         // Shared by every engine of the class
+    uint32_t enableShift;
+    uint32_t maskReg;
+    uint32_t maskShift;
+};
+
+static const Gen11EngineIntrLayout kEngineIntrLayout[GT_ENGINE_COUNT] = {
+    { GEN11_RENDER_COPY_INTR_ENABLE, 16, GEN11_RCS0_RSVD_INTR_MASK,   16 },  // RCS
+    { GEN11_RENDER_COPY_INTR_ENABLE,  0, GEN11_BCS_RSVD_INTR_MASK,    16 },  // BCS
+    { GEN11_VCS_VECS_INTR_ENABLE,    16, GEN11_VCS0_VCS1_INTR_MASK,   16 },  // VCS0
+    { GEN11_VCS_VECS_INTR_ENABLE,    16, GEN11_VCS0_VCS1_INTR_MASK,    0 },  // VCS1
+    { GEN11_VCS_VECS_INTR_ENABLE,     0, GEN11_VECS0_VECS1_INTR_MASK, 16 },  // VECS
+};
+
 void IntelGTInterrupts::writeEngineInterruptMask(uint32_t engine, uint32_t mask) {
     if (engine >= GT_ENGINE_COUNT) return;
-    controller->writeRegister32(GEN11_GT_ENGINE_IMR(engine), mask);
+    
+    const Gen11EngineIntrLayout* layout = &kEngineIntrLayout[engine];
+    uint32_t value = controller->readRegister32(layout->maskReg);
+    value &= ~(0xFFFFU << layout->maskShift);
+    value |= (mask & 0xFFFF) << layout->maskShift;
+    controller->writeRegister32(layout->maskReg, value);
 }
 
 void IntelGTInterrupts::writeEngineInterruptEnable(uint32_t engine, uint32_t enable) {
     if (engine >= GT_ENGINE_COUNT) return;
-    controller->writeRegister32(GEN11_GT_ENGINE_IER(engine), enable);
+    
+    // Affects the whole class (VCS0 and VCS1 share one field)
+    const Gen11EngineIntrLayout* layout = &kEngineIntrLayout[engine];
+    uint32_t value = controller->readRegister32(layout->enableReg);
+    value &= ~(0xFFFFU << layout->enableShift);
+    value |= (enable & 0xFFFF) << layout->enableShift;
+    controller->writeRegister32(layout->enableReg, value);
+}
+
+uint32_t IntelGTInterrupts::engineInterruptBits(uint32_t types) {
+    uint32_t bits = 0;
+    
+    if (types & GT_INT_RENDER_COMPLETE) bits |= GT_RENDER_COMPLETE_INT;
+    if (types & GT_INT_USER) bits |= GT_USER_INTERRUPT;
+    if (types & GT_INT_CONTEXT_SWITCH) bits |= GT_CONTEXT_SWITCH_INT;
+    if (types & GT_INT_ERROR) bits |= GT_ERROR_INT;
+    
+    return bits;
 }
 
 uint64_t IntelGTInterrupts::readPageFaultAddress() {
@@ -883,6 +1054,7 @@ void IntelGTInterrupts::updateSeqno(uint32_t engine, uint32_t seqno) {
     IOLockLock(interruptLock);
     currentSeqno[engine] = seqno;
     stats.lastSeqno[engine] = seqno;
+    IOLockWakeup(interruptLock, &currentSeqno[engine], false);
     IOLockUnlock(interruptLock);
 }
 
@@ -897,33 +1069,183 @@ bool IntelGTInterrupts::seqnoComplete(uint32_t engine, uint32_t seqno) {
 }
 
 /* Helpers */
-void IntelGTInterrupts::invokeRenderCompleteHandlers(uint32_t engine, uint32_t seqno) {
+static inline bool renderHandlerBefore(const RenderCompleteHandler* a, const RenderCompleteHandler* b) {
+    return (int32_t)(a->waitSeqno - b->waitSeqno) < 0;
+}
+
+RenderCompleteHandler* IntelGTInterrupts::allocRenderHandler() {
+    // Called with renderLock held
+    if (!renderHandlerFree) {
+        RenderCompleteHandlerChunk* chunk =
+            (RenderCompleteHandlerChunk*)IOMalloc(sizeof(RenderCompleteHandlerChunk));
+        if (!chunk) {
+            return nullptr;
+        }
+        
+        chunk->next = renderHandlerChunks;
+        renderHandlerChunks = chunk;
+        
+        for (int i = RENDER_HANDLER_CHUNK - 1; i >= 0; i--) {
+            chunk->nodes[i].next = renderHandlerFree;
+            renderHandlerFree = &chunk->nodes[i];
+        }
+    }
+    
+    RenderCompleteHandler* handler = renderHandlerFree;
+    renderHandlerFree = handler->next;
+    return handler;
+}
+
+void IntelGTInterrupts::heapSiftUp(RenderCompleteHeap* heap, uint32_t index) {
+    RenderCompleteHandler* node = heap->nodes[index];
+    
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!renderHandlerBefore(node, heap->nodes[parent])) {
+            break;
+        }
+        heap->nodes[index] = heap->nodes[parent];
+        heap->nodes[index]->heapIndex = index;
+        index = parent;
+    }
+    
+    heap->nodes[index] = node;
+    node->heapIndex = index;
+}
+
+void IntelGTInterrupts::heapSiftDown(RenderCompleteHeap* heap, uint32_t index) {
+    RenderCompleteHandler* node = heap->nodes[index];
+    
+    while (true) {
+        uint32_t child = index * 2 + 1;
+        if (child >= heap->count) {
+            break;
+        }
+        if (child + 1 < heap->count && renderHandlerBefore(heap->nodes[child + 1], heap->nodes[child])) {
+            child++;
+        }
+        if (!renderHandlerBefore(heap->nodes[child], node)) {
+            break;
+        }
+        heap->nodes[index] = heap->nodes[child];
+        heap->nodes[index]->heapIndex = index;
+        index = child;
+    }
+    
+    heap->nodes[index] = node;
+    node->heapIndex = index;
+}
+
+void IntelGTInterrupts::heapPush(RenderCompleteHeap* heap, RenderCompleteHandler* handler) {
+    heap->nodes[heap->count] = handler;
+    heapSiftUp(heap, heap->count++);
+}
+
+void IntelGTInterrupts::heapRemove(RenderCompleteHeap* heap, uint32_t index) {
+    heap->count--;
+    if (index == heap->count) {
+        return;
+    }
+    
+    // Move the last node into the hole and restore heap order
+    heap->nodes[index] = heap->nodes[heap->count];
+    heap->nodes[index]->heapIndex = index;
+    if (index > 0 && renderHandlerBefore(heap->nodes[index], heap->nodes[(index - 1) / 2])) {
+        heapSiftUp(heap, index);
+    } else {
+        heapSiftDown(heap, index);
+    }
+}
+
+void IntelGTInterrupts::freeRenderCompleteHandlers() {
     IOLockLock(renderLock);
     
-    RenderCompleteHandler** prev = &renderCompleteHandlers[engine];
-    RenderCompleteHandler* handler = renderCompleteHandlers[engine];
+    for (int i = 0; i < GT_ENGINE_COUNT; i++) {
+        RenderCompleteHeap* heap = &renderCompleteHeaps[i];
+        if (heap->nodes) {
+            IOFree(heap->nodes, heap->capacity * sizeof(RenderCompleteHandler*));
+        }
+        memset(heap, 0, sizeof(RenderCompleteHeap));
+    }
     
-    while (handler) {
-        RenderCompleteHandler* next = handler->next;
+    while (renderHandlerChunks) {
+        RenderCompleteHandlerChunk* next = renderHandlerChunks->next;
+        IOFree(renderHandlerChunks, sizeof(RenderCompleteHandlerChunk));
+        renderHandlerChunks = next;
+    }
+    renderHandlerFree = nullptr;
+    
+    IOLockUnlock(renderLock);
+}
+
+void IntelGTInterrupts::invokeRenderCompleteHandlers(uint32_t engine, uint32_t seqno) {
+    RenderCompleteHeap* heap = &renderCompleteHeaps[engine];
+    RenderCompleteHandler* fired = nullptr;
+    RenderCompleteHandler** firedTail = &fired;
+    
+    IOLockLock(renderLock);
+    
+    // Only handlers whose seqno has passed are touched, in seqno order
+    while (heap->count && ((int32_t)(seqno - heap->nodes[0]->waitSeqno)) >= 0) {
+        RenderCompleteHandler* handler = heap->nodes[0];
+        heapRemove(heap, 0);
         
-        if (handler->enabled && ((int32_t)(seqno - handler->waitSeqno)) >= 0) {
-            if (handler->callback) {
-                handler->callback(handler->context, engine, seqno);
-            }
-            
-            // Remove one-shot handler
-            *prev = next;
-            IOFree(handler, sizeof(RenderCompleteHandler));
-        } else {
-            prev = &handler->next;
+        handler->next = nullptr;
+        *firedTail = handler;
+        firedTail = &handler->next;
+    }
+    
+    if (!fired) {
+        IOLockUnlock(renderLock);
+        return;
+    }
+    
+    // Published so unregisterRenderCompleteHandler() can wait for the batch
+    RenderInvocation invocation;
+    invocation.thread = IOThreadSelf();
+    invocation.fired = fired;
+    invocation.next = renderInvocations;
+    renderInvocations = &invocation;
+    
+    IOLockUnlock(renderLock);
+    
+    // Callbacks run unlocked so they may register new handlers
+    for (RenderCompleteHandler* handler = fired; handler; handler = handler->next) {
+        if (handler->enabled && handler->callback) {
+            handler->callback(handler->context, engine, seqno);
         }
-        
-        handler = next;
     }
     
+    // Retire the batch and recycle the one-shot nodes in one splice
+    IOLockLock(renderLock);
+    RenderInvocation** link = &renderInvocations;
+    while (*link != &invocation) {
+        link = &(*link)->next;
+    }
+    *link = invocation.next;
+    
+    *firedTail = renderHandlerFree;
+    renderHandlerFree = fired;
+    IOLockWakeup(renderLock, &renderInvocations, false);
     IOLockUnlock(renderLock);
 }
 
+bool IntelGTInterrupts::renderCallbackInFlight(RenderCompleteCallback callback) {
+    // renderLock held
+    IOThread self = IOThreadSelf();
+    for (RenderInvocation* invocation = renderInvocations; invocation; invocation = invocation->next) {
+        if (invocation->thread == self) {
+            continue;
+        }
+        for (RenderCompleteHandler* handler = invocation->fired; handler; handler = handler->next) {
+            if (handler->callback == callback) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void IntelGTInterrupts::invokeUserInterruptHandlers(uint32_t engine) {
     IOLockLock(userLock);
     
@@ -976,6 +1298,22 @@ void IntelGTInterrupts::updateRenderCompleteStats(uint32_t engine, uint64_t late
     }
 }
 
+void IntelGTInterrupts::updateWakeupLatencyStats() {
+    if (!decodeTime) {
+        return;
+    }
+    
+    uint64_t latencyNs;
+    absolutetime_to_nanoseconds(mach_absolute_time() - decodeTime, &latencyNs);
+    
+    stats.wakeupLatency = stats.wakeups ?
+        (stats.wakeupLatency * 9 + latencyNs) / 10 : latencyNs;
+    if (latencyNs > stats.wakeupLatencyMax) {
+        stats.wakeupLatencyMax = latencyNs;
+    }
+    stats.wakeups++;
+}
+
 void IntelGTInterrupts::updateContextSwitchStats(uint32_t engine, uint64_t latency) {
     if (stats.contextSwitch[engine] > 1) {
         stats.contextSwitchLatency[engine] = (stats.contextSwitchLatency[engine] * 9 + latency) / 10;
@@ -1014,6 +1352,10 @@ void IntelGTInterrupts::printStats() {
     IOLog("Total interrupts: %llu\n", stats.totalInterrupts);
     IOLog("Spurious: %llu\n", stats.spuriousInterrupts);
     IOLog("Handler time: %llu us\n", stats.handlerTime);
+    IOLog("Decode MMIO reads: %llu total, %u max\n",
+          stats.decodeMMIOReads, stats.decodeMaxReads);
+    IOLog("Decode to wakeup: %llu ns avg, %llu ns max (%llu wakeups)\n",
+          stats.wakeupLatency, stats.wakeupLatencyMax, stats.wakeups);
     
     IOLog("\nRender Complete:\n");
     for (uint32_t i = 0; i < GT_ENGINE_COUNT; i++) {
@@ -65,8 +65,34 @@ struct RenderCompleteHandler {
     void* context;
     uint32_t engine;
     uint32_t waitSeqno;         // Seqno to wait for
+    uint32_t heapIndex;         // Position in the engine's heap
     bool enabled;
-    RenderCompleteHandler* next;
+    RenderCompleteHandler* next;    // Free list / fired batch
+};
+
+/* Render complete handlers are preallocated in chunks and recycled */
+#define RENDER_HANDLER_CHUNK        64
+#define RENDER_HEAP_INITIAL         64
+
+struct RenderCompleteHandlerChunk {
+    RenderCompleteHandlerChunk* next;
+    RenderCompleteHandler nodes[RENDER_HANDLER_CHUNK];
+};
+
+/* A fired batch being run unlocked; lives on the invoking thread's stack.
+ * Batches for different engines, or nested ones started from a callback,
+ * can be in flight at the same time. */
+struct RenderInvocation {
+    IOThread thread;
+    RenderCompleteHandler* fired;
+    RenderInvocation* next;
+};
+
+/* Per-engine min-heap of pending handlers, keyed by waitSeqno */
+struct RenderCompleteHeap {
+    RenderCompleteHandler** nodes;
+    uint32_t count;
+    uint32_t capacity;
 };
 
 /* User interrupt handler */
@@ -126,6 +152,15 @@ struct GTInterruptStats {
     uint32_t lastSeqno[GT_ENGINE_COUNT];
     uint64_t lastActivityTime[GT_ENGINE_COUNT];
     uint32_t hangCount;
+    
+    // Identity decode
+    uint64_t decodeMMIOReads;       // Total MMIO reads decoding interrupts
+    uint32_t decodeMaxReads;        // Most MMIO reads for one interrupt
+    
+    // Decode -> ring waiters and fences woken
+    uint64_t wakeups;
+    uint64_t wakeupLatency;         // Average, ns
+    uint64_t wakeupLatencyMax;      // ns
 };
 
 /* GPU hang state */
@@ -203,6 +238,11 @@ public:
 private:
     static void interruptOccurred(OSObject* owner, IOInterruptEventSource* sender, int count);
     
+    /* Banked identity decode */
+    void decodeInterruptBank(uint32_t bank, uint32_t* engineIIR, uint32_t* mmioReads);
+    uint32_t engineFromIdentity(uint32_t ident);
+    void handleEngineInterrupt(uint32_t engine, uint32_t iir);
+    
     /* Specific interrupt handlers */
     void handleRenderComplete(uint32_t engine);
     void handleUserInterrupt(uint32_t engine);
@@ -228,6 +268,7 @@ private:
     uint32_t readEngineStatus(uint32_t engine);
     void writeEngineInterruptMask(uint32_t engine, uint32_t mask);
     void writeEngineInterruptEnable(uint32_t engine, uint32_t enable);
+    uint32_t engineInterruptBits(uint32_t types);
     
     uint64_t readPageFaultAddress();
     uint32_t readPageFaultType();
@@ -239,11 +280,19 @@ private:
     
     /* Helpers */
     void invokeRenderCompleteHandlers(uint32_t engine, uint32_t seqno);
+    bool renderCallbackInFlight(RenderCompleteCallback callback);
+    RenderCompleteHandler* allocRenderHandler();
+    void heapPush(RenderCompleteHeap* heap, RenderCompleteHandler* handler);
+    void heapRemove(RenderCompleteHeap* heap, uint32_t index);
+    void heapSiftUp(RenderCompleteHeap* heap, uint32_t index);
+    void heapSiftDown(RenderCompleteHeap* heap, uint32_t index);
+    void freeRenderCompleteHandlers();
     void invokeUserInterruptHandlers(uint32_t engine);
     void invokeGPUHangHandlers(uint32_t engine, uint32_t acthd);
     void invokePageFaultHandlers(uint64_t faultAddr, uint32_t faultType);
     
     void updateRenderCompleteStats(uint32_t engine, uint64_t latency);
+    void updateWakeupLatencyStats();
     void updateContextSwitchStats(uint32_t engine, uint64_t latency);
     void updateHangStats(uint32_t engine);
     
@@ -256,7 +305,10 @@ private:
     IOTimerEventSource* watchdogTimer;
     
     /* Handler lists */
-    RenderCompleteHandler* renderCompleteHandlers[GT_ENGINE_COUNT];
+    RenderCompleteHeap renderCompleteHeaps[GT_ENGINE_COUNT];
+    RenderCompleteHandler* renderHandlerFree;       // Recycled nodes
+    RenderCompleteHandlerChunk* renderHandlerChunks;
+    RenderInvocation* renderInvocations;            // Fired batches not yet finished
     UserInterruptHandler* userInterruptHandlers[GT_ENGINE_COUNT];
     GPUHangHandler* gpuHangHandlers[GT_ENGINE_COUNT];
     PageFaultHandler* pageFaultHandlers;
@@ -280,6 +332,7 @@ private:
     /* Statistics */
     GTInterruptStats stats;
     uint64_t handlerStartTime;
+    uint64_t decodeTime;            // Identities latched and acknowledged
     
     /* Synchronization */
     IOLock* interruptLock;
@@ -296,11 +349,36 @@ private:
 /* Helper macros for GT register offsets (Tiger Lake) */
 #define GEN11_GT_INT_CTL                0x190000  // Master GT interrupt control
 
-// Per-engine interrupt registers
-#define GEN11_GT_ENGINE_IMR(e)          (0x190010 + (e) * 0x100)
-#define GEN11_GT_ENGINE_IER(e)          (0x190014 + (e) * 0x100)
-#define GEN11_GT_ENGINE_IIR(e)          (0x190018 + (e) * 0x100)
-#define GEN11_GT_ENGINE_ISR(e)          (0x19001C + (e) * 0x100)
+// Gen11+ banked GT interrupt identity registers
+#define GEN11_GFX_MSTR_IRQ              0x190010
+#define GEN11_MASTER_IRQ                (1U << 31)
+#define GEN11_GT_DW_IRQ(bank)           (1U << (bank))
+#define GEN11_GT_INTR_DW(bank)          (0x190018 + (bank) * 4)
+#define GEN11_INTR_IDENTITY_REG(bank)   (0x190060 + (bank) * 4)
+#define GEN11_IIR_REG_SELECTOR(bank)    (0x190070 + (bank) * 4)
+#define GEN11_INTR_DATA_VALID           (1U << 31)
+#define GEN11_INTR_ENGINE_INTR(ident)   ((ident) & 0xFFFF)
+#define GEN11_GT_BANKS                  2
+#define GEN11_IDENTITY_SPIN_MAX         100
+
+// INTR_IDENTITY names the engine by class and instance
+#define GEN11_INTR_ENGINE_CLASS(ident)      (((ident) >> 16) & 0x7)
+#define GEN11_INTR_ENGINE_INSTANCE(ident)   (((ident) >> 20) & 0x3F)
+#define GEN11_RENDER_CLASS              0
+#define GEN11_VIDEO_DECODE_CLASS        1
+#define GEN11_VIDEO_ENHANCEMENT_CLASS   2
+#define GEN11_COPY_ENGINE_CLASS         3
+
+// Per-class interrupt enables: first engine class in [31:16], second in [15:0]
+#define GEN11_RENDER_COPY_INTR_ENABLE   0x190030  // RCS [31:16], BCS [15:0]
+#define GEN11_VCS_VECS_INTR_ENABLE      0x190034  // VCS [31:16], VECS [15:0]
+
+// Per-engine interrupt masks (1 = masked): first engine in [31:16]
+#define GEN11_RCS0_RSVD_INTR_MASK       0x190090  // RCS0 [31:16]
+#define GEN11_BCS_RSVD_INTR_MASK        0x1900A0  // BCS0 [31:16]
+#define GEN11_VCS0_VCS1_INTR_MASK       0x1900A8  // VCS0 [31:16], VCS1 [15:0]
+#define GEN11_VECS0_VECS1_INTR_MASK     0x1900D0  // VECS0 [31:16], VECS1 [15:0]
+#define GEN11_INTR_ENGINE_PAIR(x)       ((((x) & 0xFFFF) << 16) | ((x) & 0xFFFF))
 
 // Engine status registers
 #define GEN11_GT_ENGINE_RING_HEAD(e)    (0x002040 + (e) * 0x1000)
@@ -26,8 +26,11 @@ IntelGTT::IntelGTT()
     , usableSize(0)
     , pageSize(4096)
     , numEntries(0)
-    , allocationBitmap(NULL)
-    , bitmapSize(0)
+    , lruHead(NULL)
+    , lruTail(NULL)
+    , lruClock(0)
+    , lruLock(NULL)
+    , pendingRequestPages(0)
     , statsLock(NULL)
 {
     bzero(&stats, sizeof(stats));
@@ -55,10 +58,10 @@ bool IntelGTT::init(AppleIntelTGLController *ctrl)
     
     IOLog("IntelGTT: Initializing Graphics Translation Table\n");
     
-    // Create locks
-    // allocationLock = IOLockAlloc();  // REMOVED - no locking needed for single-threaded bitmap ops
+    // Create locks (lruLock also serializes the page bitmap)
     statsLock = IOLockAlloc();
-    if (/*!allocationLock || */!statsLock) {
+    lruLock = IOLockAlloc();
+    if (!statsLock || !lruLock) {
         IOLog("IntelGTT: Failed to allocate locks\n");
         return false;
     }
@@ -105,12 +108,23 @@ void IntelGTT::cleanup()
     // }
     IOLog("IntelGTT:  Preserving GTT entries (framebuffer must stay mapped)\n");
     
-    // Free allocation bitmap
-    if (allocationBitmap) {
-        IOFree(allocationBitmap, bitmapSize);
-        allocationBitmap = NULL;
+    // Drop eviction tracking. Owners may already be gone, so their slots are
+    // left alone; with lruLock NULL every later track call is a no-op.
+    if (lruLock) {
+        IOLockLock(lruLock);
+        while (lruHead) {
+            struct gtt_binding *b = lruHead;
+            lruUnlink(b);
+            IOFree(b, sizeof(struct gtt_binding));
+        }
+        IOLockUnlock(lruLock);
+        IOLockFree(lruLock);
+        lruLock = NULL;
     }
     
+    // Free allocation bitmap and summary
+    pageBitmap.free();
+    
     // Release GTT mapping
     if (gttMap) {
         gttMap->release();
@@ -118,12 +132,6 @@ void IntelGTT::cleanup()
     }
     
     // Free locks
-    // REMOVED - allocationLock not used anymore
-    // if (allocationLock) {
-    //     IOLockFree(allocationLock);
-    //     allocationLock = NULL;
-    // }
-
     if (statsLock) {
         IOLockFree(statsLock);
         statsLock = NULL;
@@ -297,17 +305,13 @@ bool IntelGTT::initializePageTables()
     IOLog("IntelGTT: Initializing page tables\n");
     
     size_t numPages = usableSize / pageSize;
-    bitmapSize = (numPages + 7) / 8;
-    
-    allocationBitmap = (u8 *)IOMalloc(bitmapSize);
-    if (!allocationBitmap) {
-        IOLog("IntelGTT: Failed to allocate bitmap (%zu bytes)\n", bitmapSize);
+    if (!pageBitmap.init(numPages)) {
+        IOLog("IntelGTT: Failed to allocate bitmap for %zu pages\n", numPages);
         return false;
     }
     
-    bzero(allocationBitmap, bitmapSize);
-    
-    IOLog("IntelGTT: Allocated %zu KB for space tracking\n", bitmapSize / 1024);
+    IOLog("IntelGTT: Allocated %zu KB for space tracking (%zu pages)\n",
+          pageBitmap.getTrackingBytes() / 1024, numPages);
     IOLog("IntelGTT:  Preserving existing GTT entries\n");
     
     // Framebuffer is at GGTT offset 0x800 which is BELOW baseAddress (0x800000)
@@ -373,6 +377,76 @@ void IntelGTT::flushPTE(size_t index)
     (void)readPTE(index);
 }
 
+size_t IntelGTT::writePTERange(size_t index, u64 physAddr, size_t numPages, u64 pteBits)
+{
+    if (index >= numEntries || !gttBase) {
+        return 0;
+    }
+    
+    if (numPages > numEntries - index) {
+        numPages = numEntries - index;
+    }
+    
+    // Sequential stores into the WC mapping combine into full lines;
+    // no barrier or read-back until flushBind()
+    volatile u64 *pte = (volatile u64 *)gttBase + index;
+    u64 entry = (physAddr & ~0xFFFULL) | pteBits;
+    
+    for (size_t i = 0; i < numPages; i++) {
+        pte[i] = entry;
+        entry += pageSize;
+    }
+    
+    IOLockLock(statsLock);
+    stats.pte_write_count += numPages;
+    IOLockUnlock(statsLock);
+    
+    return numPages;
+}
+
+void IntelGTT::clearPTERange(size_t index, size_t numPages)
+{
+    if (index >= numEntries || !gttBase) {
+        return;
+    }
+    
+    if (numPages > numEntries - index) {
+        numPages = numEntries - index;
+    }
+    
+    volatile u64 *pte = (volatile u64 *)gttBase + index;
+    for (size_t i = 0; i < numPages; i++) {
+        pte[i] = 0;
+    }
+    
+    IOLockLock(statsLock);
+    stats.pte_write_count += numPages;
+    IOLockUnlock(statsLock);
+}
+
+void IntelGTT::flushBind(size_t lastIndex)
+{
+    // One posting read drains the WC buffers for the whole batch, then a
+    // single GGTT TLB invalidate
+    __sync_synchronize();
+    (void)readPTE(lastIndex);
+    invalidate();
+    
+    IOLockLock(statsLock);
+    stats.batch_count++;
+    stats.pte_flush_count++;
+    IOLockUnlock(statsLock);
+}
+
+void IntelGTT::invalidate()
+{
+    if (!uncore) {
+        return;
+    }
+    
+    uncore->writeRegister32(GEN6_GFX_FLSH_CNTL, GFX_FLSH_CNTL_EN);
+}
+
 
  * GTT Operations
 
@@ -412,36 +486,37 @@ bool IntelGTT::insertEntries(u64 start, IOMemoryDescriptor *mem, u32 flags)
     
     UInt64 offset = 0;
     IODMACommand::Segment64 segments[10];
-    UInt32 numSegments = 10;
     size_t currentIndex = startIndex;
+    size_t endIndex = startIndex + numPages;
+    u64 pteBits = makeGen12PTE(0, flags);
     
-    while (offset < size && currentIndex < startIndex + numPages) {
-        UInt64 transferSize = 0;
+    while (offset < size && currentIndex < endIndex) {
+        UInt32 numSegments = 10;
         
-        if (dmaCmd->gen64IOVMSegments(&offset, segments, &numSegments) != kIOReturnSuccess) {
+        if (dmaCmd->gen64IOVMSegments(&offset, segments, &numSegments) != kIOReturnSuccess ||
+            numSegments == 0) {
             break;
         }
         
-        for (UInt32 i = 0; i < numSegments && currentIndex < startIndex + numPages; i++) {
-            IOPhysicalAddress64 physAddr = segments[i].fIOVMAddr;
-            IOByteCount segLength = segments[i].fLength;
-            size_t segPages = (segLength + pageSize - 1) / pageSize;
+        // Each segment is one contiguous PTE run
+        for (UInt32 i = 0; i < numSegments && currentIndex < endIndex; i++) {
+            size_t segPages = (segments[i].fLength + pageSize - 1) / pageSize;
             
-            for (size_t p = 0; p < segPages && currentIndex < startIndex + numPages; p++) {
-                writePTE(currentIndex, physAddr + (p * pageSize), flags);
-                currentIndex++;
+            if (segPages > endIndex - currentIndex) {
+                segPages = endIndex - currentIndex;
             }
             
-            transferSize += segLength;
+            currentIndex += writePTERange(currentIndex, segments[i].fIOVMAddr,
+                                          segPages, pteBits);
         }
     }
     
     dmaCmd->clearMemoryDescriptor();
     dmaCmd->release();
     
-    // Flush PTEs
-    for (size_t i = startIndex; i < currentIndex; i++) {
-        flushPTE(i);
+    // Flush PTEs once for the whole batch
+    if (currentIndex > startIndex) {
+        flushBind(currentIndex - 1);
     }
     
     // Update statistics
@@ -464,10 +539,8 @@ bool IntelGTT::clearEntries(u64 start, size_t size)
     IOLog("IntelGTT: Clearing %zu pages at index %zu\n", numPages, startIndex);
     
     // Clear PTEs
-    for (size_t i = 0; i < numPages; i++) {
-        writePTE(startIndex + i, 0, 0);
-        flushPTE(startIndex + i);
-    }
+    clearPTERange(startIndex, numPages);
+    flushBind(startIndex + numPages - 1);
     
     // Update statistics
     IOLockLock(statsLock);
@@ -477,7 +550,120 @@ bool IntelGTT::clearEntries(u64 start, size_t size)
     return true;
 }
 
-bool IntelGTT::bindObject(IntelGEMObject *obj, u32 cache_level)
+bool IntelGTT::bindRange(u64 start, const struct gtt_sg_entry *sg, u32 count, u32 flags)
+{
+    if (!sg || count == 0 || !gttBase || start < baseAddress) {
+        return false;
+    }
+    
+    size_t startIndex = (start - baseAddress) / pageSize;
+    size_t rangePages = 0;
+    
+    for (u32 i = 0; i < count; i++) {
+        rangePages += (sg[i].length + pageSize - 1) / pageSize;
+    }
+    
+    if (rangePages == 0 || startIndex + rangePages > numEntries) {
+        IOLog("IntelGTT: bindRange out of range (%zu pages at index %zu)\n",
+              rangePages, startIndex);
+        return false;
+    }
+    
+    u64 pteBits = makeGen12PTE(0, flags);
+    size_t index = startIndex;
+    
+    for (u32 i = 0; i < count; i++) {
+        size_t segPages = (sg[i].length + pageSize - 1) / pageSize;
+        index += writePTERange(index, sg[i].phys, segPages, pteBits);
+    }
+    
+    flushBind(index - 1);
+    
+    IOLockLock(statsLock);
+    stats.insert_count++;
+    IOLockUnlock(statsLock);
+    
+    return true;
+}
+
+struct gtt_sg_table *IntelGTT::createSGTable(IOMemoryDescriptor *mem)
+{
+    if (!mem || mem->getLength() == 0) {
+        return NULL;
+    }
+    
+    struct gtt_sg_table *sgt = (struct gtt_sg_table *)IOMalloc(sizeof(struct gtt_sg_table));
+    if (!sgt) {
+        return NULL;
+    }
+    
+    bzero(sgt, sizeof(*sgt));
+    
+    IOByteCount totalLength = mem->getLength();
+    IOByteCount offset = 0;
+    
+    while (offset < totalLength) {
+        IOByteCount segLen = 0;
+        addr64_t segPhys = mem->getPhysicalSegment(offset, &segLen);
+        
+        if (segPhys == 0 || segLen == 0) {
+            IOLog("IntelGTT: createSGTable: no segment at offset %llu\n", (u64)offset);
+            destroySGTable(sgt);
+            return NULL;
+        }
+        
+        if (segLen > totalLength - offset) {
+            segLen = totalLength - offset;
+        }
+        
+        // Merge with the previous run when physically adjacent
+        if (sgt->count > 0 &&
+            sgt->entries[sgt->count - 1].phys + sgt->entries[sgt->count - 1].length == segPhys) {
+            sgt->entries[sgt->count - 1].length += segLen;
+        } else {
+            if (sgt->count == sgt->capacity) {
+                u32 newCapacity = sgt->capacity ? sgt->capacity * 2 : 16;
+                struct gtt_sg_entry *grown = (struct gtt_sg_entry *)IOMalloc(
+                    newCapacity * sizeof(struct gtt_sg_entry));
+                if (!grown) {
+                    destroySGTable(sgt);
+                    return NULL;
+                }
+                
+                if (sgt->entries) {
+                    memcpy(grown, sgt->entries, sgt->count * sizeof(struct gtt_sg_entry));
+                    IOFree(sgt->entries, sgt->capacity * sizeof(struct gtt_sg_entry));
+                }
+                sgt->entries = grown;
+                sgt->capacity = newCapacity;
+            }
+            
+            sgt->entries[sgt->count].phys = segPhys;
+            sgt->entries[sgt->count].length = segLen;
+            sgt->count++;
+        }
+        
+        offset += segLen;
+    }
+    
+    sgt->length = totalLength;
+    return sgt;
+}
+
+void IntelGTT::destroySGTable(struct gtt_sg_table *sgt)
+{
+    if (!sgt) {
+        return;
+    }
+    
+    if (sgt->entries) {
+        IOFree(sgt->entries, sgt->capacity * sizeof(struct gtt_sg_entry));
+    }
+    
+    IOFree(sgt, sizeof(struct gtt_sg_table));
+}
+
+bool IntelGTT::bindObject(IntelGEMObject *obj, u32 cache_level, bool pinned)
 {
     if (!obj) {
         return false;
@@ -491,6 +677,11 @@ bool IntelGTT::bindObject(IntelGEMObject *obj, u32 cache_level)
         return false;
     }
     
+    // Slab slots are mapped by their chunk's binding and are never evicted
+    if (obj->isSlabObject()) {
+        return true;
+    }
+    
     u32 flags = GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE;
     
     if (!insertEntries(gttAddr, mem, flags)) {
@@ -501,6 +692,14 @@ bool IntelGTT::bindObject(IntelGEMObject *obj, u32 cache_level)
     IOLog("IntelGTT: Bound object at 0x%llx (%zu bytes)\n",
           gttAddr, obj->getSize());
     
+    // Existing callers bind hardware state (contexts, rings, page tables,
+    // framebuffers), so objects are pinned unless the caller opts in
+    struct gtt_binding **slot = obj->getGTTBindingSlot();
+    if (*slot) {
+        untrackBinding(slot);
+    }
+    trackBinding(slot, gttAddr, obj->getSize(), obj, NULL, pinned);
+    
     // Update statistics
     IOLockLock(statsLock);
     stats.bind_count++;
@@ -518,8 +717,13 @@ bool IntelGTT::unbindObject(IntelGEMObject *obj)
     u64 gttAddr = obj->getGTTAddress();
     size_t size = obj->getSize();
     
-    if (gttAddr == 0) {
-        return true;  // Not bound
+    if (gttAddr == 0 || obj->isSlabObject()) {
+        return true;  // Not bound, or mapped by its slab chunk
+    }
+    
+    struct gtt_binding **slot = obj->getGTTBindingSlot();
+    if (*slot && !untrackBinding(slot)) {
+        return true;  // Evicted in the meantime; PTEs already cleared
     }
     
     if (!clearEntries(gttAddr, size)) {
@@ -541,7 +745,7 @@ bool IntelGTT::unbindObject(IntelGEMObject *obj)
  * IOSurface Scanout Support - System Physical -> GTT Offset
 
 
- * bindSurfacePages / unbindSurfacePages - NO LOCKING
+ * bindSurfacePages / unbindSurfacePages - range reserved under lruLock
 
 
 
@@ -549,43 +753,36 @@ uint32_t IntelGTT::findFreeGTTRegion(uint32_t numPages)
 {
     // Bitmap page 0 = baseAddress (8MB)
     // So bitmap page N = baseAddress + N*4096
-    size_t totalPages = usableSize / pageSize;
-    uint32_t currentRun = 0;
-    uint32_t startPage = 0;
+    if (!lruLock) {
+        return 0;
+    }
     
-    for (size_t page = 0; page < totalPages; page++) {
-        size_t byteIndex = page / 8;
-        size_t bitIndex = page % 8;
-        
-        if (byteIndex >= bitmapSize) break;
-        
-        bool isUsed = (allocationBitmap[byteIndex] & (1 << bitIndex)) != 0;
-        
-        if (!isUsed) {
-            if (currentRun == 0) {
-                startPage = (uint32_t)page;
-            }
-            currentRun++;
-            
-            if (currentRun >= numPages) {
-                // CRITICAL: Add baseAddress offset!
-                // bitmap page 0 = baseAddress, not 0
-                uint64_t gttByteOffset = baseAddress + ((uint64_t)startPage * 4096);
-                
-                IOLog("OK  GTT: Found free region at bitmap page %u -> GTT offset 0x%llx\n",
-                      startPage, gttByteOffset);
-                IOLog("   Calculation: baseAddress(0x%llx) + (page %u * 4096) = 0x%llx\n",
-                      baseAddress, startPage, gttByteOffset);
-                
-                return (uint32_t)gttByteOffset;
-            }
-        } else {
-            currentRun = 0;
-        }
+    // Reserve the range before dropping the lock so nobody else can take it
+    IOLockLock(lruLock);
+    size_t startPage = pageBitmap.findFreeSpace(numPages, 1);
+    
+    if (startPage == SIZE_MAX && evictForSpace(numPages, 1)) {
+        startPage = pageBitmap.findFreeSpace(numPages, 1);
+    }
+    
+    if (startPage != SIZE_MAX) {
+        pageBitmap.markUsed(startPage, numPages);
     }
+    IOLockUnlock(lruLock);
     
-    IOLog("ERR  GTT: No free region for %u pages\n", numPages);
-    return 0;
+    if (startPage == SIZE_MAX) {
+        IOLog("ERR  GTT: No free region for %u pages\n", numPages);
+        return 0;
+    }
+    
+    // CRITICAL: Add baseAddress offset!
+    // bitmap page 0 = baseAddress, not 0
+    uint64_t gttByteOffset = baseAddress + ((uint64_t)startPage * 4096);
+    
+    IOLog("OK  GTT: Found free region at bitmap page %zu -> GTT offset 0x%llx\n",
+          startPage, gttByteOffset);
+    
+    return (uint32_t)gttByteOffset;
 }
 
 uint32_t IntelGTT::bindSurfacePages(IOPhysicalAddress sysPhys, size_t size)
@@ -625,63 +822,33 @@ uint32_t IntelGTT::bindSurfacePages(IOPhysicalAddress sysPhys, size_t size)
     IOLog("  Writing PTEs: gttOffset=0x%x, baseAddress=0x%llx, index=%u\n",
           gttOffset, baseAddress, gttStartIndex);
     
-    for (uint32_t i = 0; i < numPages; i++) {
-        uint32_t gttIndex = gttStartIndex + i;
-        
-        // Bounds check
-        if (gttIndex >= numEntries) {
-            IOLog("ERR  GTT: Index %u exceeds numEntries %zu!\n",
-                  gttIndex, numEntries);
-            break;
-        }
-        
-        uint64_t pagePhys = sysPhys + ((uint64_t)i * 4096);
-        uint64_t pte = (pagePhys & 0xFFFFFFFFF000ULL) | 0x3;  // Present + Writable
-        
-        //  CRITICAL: Use volatile write + explicit memory barrier
-        volatile uint64_t *ptePtr = &gttEntries[gttIndex];
-        *ptePtr = pte;
-        __sync_synchronize();  // Full memory barrier after each write
-        
-        //  DEBUG: Log first and last few PTEs
-        if (i < 3 || i >= numPages - 3) {
-            IOLog("  PTE[%u] = 0x%016llx (phys 0x%llx)\n", gttIndex, pte, pagePhys);
-        } else if (i == 3) {
-            IOLog("  ... (%u more PTEs)\n", numPages - 6);
-        }
+    // One streamed run (Present + Writable), one posting read + TLB invalidate
+    size_t written = writePTERange(gttStartIndex, sysPhys, numPages, 0x3);
+    if (written < numPages) {
+        IOLog("ERR  GTT: Index %zu exceeds numEntries %zu!\n",
+              gttStartIndex + written, numEntries);
     }
     
-    //  CRITICAL: Multiple memory barriers to ensure all writes committed
-    __sync_synchronize();  // Compiler barrier
-    OSSynchronizeIO();     // I/O barrier
-    __sync_synchronize();  // Another full barrier
+    flushBind(gttStartIndex + (written ? written - 1 : 0));
     
     //  VERIFY: Read back first PTE to confirm write
     uint64_t firstPTE = gttEntries[gttStartIndex];
     uint64_t expectedPTE = (sysPhys & 0xFFFFFFFFF000ULL) | 0x3;
     
-    IOLog("   Verification: PTE[%u] = 0x%016llx (expected 0x%016llx)\n",
-          gttStartIndex, firstPTE, expectedPTE);
-    IOLog("     GTT base virtual: %p\n", gttBase);
-    IOLog("     PTE address: %p (base + %u * 8)\n",
-          &gttEntries[gttStartIndex], gttStartIndex);
-    
     if (firstPTE == expectedPTE) {
-        IOLog("  OK  PTE verification PASSED! GTT write successful!\n");
+        IOLog("  OK  PTE verification PASSED! PTE[%u] = 0x%016llx\n",
+              gttStartIndex, firstPTE);
     } else if ((firstPTE & 0x1) == 0) {
         IOLog("  ERR  PTE NOT PRESENT - GTT mapping may not be writable!\n");
         IOLog("     Check: Is GTT mapped with kIOMapInhibitCache?\n");
         IOLog("     Check: Is BAR0 physical address correct?\n");
     } else {
-        IOLog("    PTE present but wrong value - possible address mismatch\n");
+        IOLog("    PTE present but wrong value 0x%016llx (expected 0x%016llx)\n",
+              firstPTE, expectedPTE);
     }
     
-    flush();
-    
-    // Mark bitmap - bitmap page 0 = baseAddress
-    // So bitmap page = (gttOffset - baseAddress) / 4096
+    // Bitmap page 0 = baseAddress; findFreeGTTRegion() already marked it
     size_t bitmapStartPage = (gttOffset - baseAddress) / 4096;
-    markSpaceUsed(bitmapStartPage, numPages);
     
     IOLog("OK  GTT: Surface mapped at GTT offset 0x%08x "
           "(bitmap page %zu)\n", gttOffset, bitmapStartPage);
@@ -696,22 +863,20 @@ bool IntelGTT::unbindSurfacePages(uint32_t gttOffset, size_t size)
     }
     
     uint32_t numPages = (uint32_t)((size + 4095) / 4096);
-    volatile uint64_t* gttEntries = (volatile uint64_t*)gttBase;
-    
-    // gttOffset includes baseAddress
-    uint32_t gttStartIndex = gttOffset / 4096;
     
-    for (uint32_t i = 0; i < numPages; i++) {
-        uint32_t gttIndex = gttStartIndex + i;
-        if (gttIndex >= numEntries) break;
-        gttEntries[gttIndex] = 0;
-    }
+    // gttOffset includes baseAddress; PTE index matches bindSurfacePages()
+    uint32_t gttStartIndex = (gttOffset - (uint32_t)baseAddress) / 4096;
     
-    flush();
+    clearPTERange(gttStartIndex, numPages);
+    flushBind(gttStartIndex + numPages - 1);
     
     // Bitmap page = (gttOffset - baseAddress) / 4096
     size_t bitmapStartPage = (gttOffset - baseAddress) / 4096;
-    markSpaceFree(bitmapStartPage, numPages);
+    if (lruLock) {
+        IOLockLock(lruLock);
+        pageBitmap.markFree(bitmapStartPage, numPages);
+        IOLockUnlock(lruLock);
+    }
     
     IOLog("OK  GTT: Unmapped %u pages at GTT offset 0x%08x\n",
           numPages, gttOffset);
@@ -721,185 +886,399 @@ bool IntelGTT::unbindSurfacePages(uint32_t gttOffset, size_t size)
 
 
 
- * Address Space Allocation
+ * allocateSpace / freeSpace - find + mark under lruLock
+u64 IntelGTT::allocateSpace(size_t size, size_t alignment)
+{
+    if (size == 0 || size > usableSize) {
+        return 0;
+    }
+    
+    size_t numPages = (size + pageSize - 1) / pageSize;
+    size_t alignmentPages = (alignment + pageSize - 1) / pageSize;
+    if (alignmentPages == 0) alignmentPages = 1;
+    
+    if (!lruLock) {
+        return 0;
+    }
+    
+    IOLockLock(lruLock);
+    size_t startPage = pageBitmap.findFreeSpace(numPages, alignmentPages);
+    if (startPage == SIZE_MAX && evictForSpace(numPages, alignmentPages)) {
+        startPage = pageBitmap.findFreeSpace(numPages, alignmentPages);
+    }
+    
+    if (startPage != SIZE_MAX) {
+        pageBitmap.markUsed(startPage, numPages);
+    }
+    IOLockUnlock(lruLock);
+    
+    if (startPage == SIZE_MAX) {
+        IOLog("IntelGTT: No free space for %zu pages\n", numPages);
+        return 0;
+    }
+    
+    // startPage is bitmap page, address = baseAddress + startPage*pageSize
+    u64 address = baseAddress + (startPage * pageSize);
+    
+    IOLog("IntelGTT: Allocated 0x%llx - 0x%llx (%zu pages)\n",
+          address, address + size, numPages);
+    
+    return address;
+}
 
-size_t IntelGTT::findFreeSpace(size_t numPages, size_t alignmentPages)
+bool IntelGTT::freeSpace(u64 address, size_t size)
 {
-    size_t totalPages = usableSize / pageSize;
-    size_t currentRun = 0;
-    size_t startPage = 0;
+    if (address < baseAddress || size == 0 || !lruLock) {
+        return false;
+    }
     
-    for (size_t page = 0; page < totalPages; page++) {
-        size_t byteIndex = page / 8;
-        size_t bitIndex = page % 8;
-        
-        bool isUsed = (allocationBitmap[byteIndex] & (1 << bitIndex)) != 0;
-        
-        if (!isUsed) {
-            if (currentRun == 0) {
-                if ((page % alignmentPages) == 0) {
-                    startPage = page;
-                    currentRun = 1;
-                }
-            } else {
-                currentRun++;
-            }
-            
-            if (currentRun >= numPages) {
-                return startPage;
-            }
-        } else {
-            currentRun = 0;
-        }
+    // Bitmap page = (address - baseAddress) / pageSize
+    size_t startPage = (address - baseAddress) / pageSize;
+    size_t numPages = (size + pageSize - 1) / pageSize;
+    
+    IOLockLock(lruLock);
+    pageBitmap.markFree(startPage, numPages);
+    IOLockUnlock(lruLock);
+    
+    IOLog("IntelGTT: Freed 0x%llx - 0x%llx (%zu pages)\n",
+          address, address + size, numPages);
+    
+    return true;
+}
+
+
+
+
+ * LRU Eviction
+
+void IntelGTT::lruUnlink(struct gtt_binding *b)
+{
+    if (b->lruPrev) {
+        b->lruPrev->lruNext = b->lruNext;
+    } else {
+        lruHead = b->lruNext;
+    }
+    
+    if (b->lruNext) {
+        b->lruNext->lruPrev = b->lruPrev;
+    } else {
+        lruTail = b->lruPrev;
     }
     
-    return SIZE_MAX;
+    b->lruPrev = NULL;
+    b->lruNext = NULL;
 }
 
+void IntelGTT::lruAppend(struct gtt_binding *b)
+{
+    b->lastUse = ++lruClock;
+    b->lruNext = NULL;
+    b->lruPrev = lruTail;
+    
+    if (lruTail) {
+        lruTail->lruNext = b;
+    } else {
+        lruHead = b;
+    }
+    
+    lruTail = b;
+}
 
- * Bitmap operations - NO LOCKING
- * bindSurfacePages is single-threaded from WindowServer
+bool IntelGTT::trackBinding(struct gtt_binding **slot, u64 start, size_t size, void *owner,
+                            const struct gtt_binding_ops *ops, bool pinned)
+{
+    if (!slot || !lruLock || size == 0) {
+        return false;
+    }
+    
+    struct gtt_binding *b = (struct gtt_binding *)IOMalloc(sizeof(struct gtt_binding));
+    if (!b) {
+        return false;
+    }
+    bzero(b, sizeof(*b));
+    
+    b->start = start;
+    b->size = size;
+    b->owner = owner;
+    b->ops = ops;
+    b->slot = slot;
+    b->pinCount = pinned ? 1 : 0;
+    
+    IOLockLock(lruLock);
+    lruAppend(b);
+    *slot = b;
+    IOLockUnlock(lruLock);
+    
+    return true;
+}
 
-void IntelGTT::markSpaceUsed(size_t startPage, size_t numPages)
+bool IntelGTT::untrackBinding(struct gtt_binding **slot)
 {
-    if (numPages == 0) return;
+    if (!slot || !lruLock) {
+        return false;
+    }
     
-    size_t endPage = startPage + numPages;
-    size_t lastPage = endPage - 1;
-    size_t maxByteIndex = lastPage / 8;
+    IOLockLock(lruLock);
+    struct gtt_binding *b = *slot;
+    if (b) {
+        lruUnlink(b);
+        *slot = NULL;
+    }
+    IOLockUnlock(lruLock);
+    
+    if (!b) {
+        return false;
+    }
     
-    if (maxByteIndex >= bitmapSize) {
-        IOLog("IntelGTT::markSpaceUsed: ERROR - Out of bounds! "
-              "startPage=%zu numPages=%zu maxByte=%zu bitmapSize=%zu\n",
-              startPage, numPages, maxByteIndex, bitmapSize);
+    IOFree(b, sizeof(struct gtt_binding));
+    return true;
+}
+
+void IntelGTT::touchBinding(struct gtt_binding **slot)
+{
+    if (!slot || !lruLock) {
         return;
     }
     
-    for (size_t page = startPage; page < endPage; ) {
-        size_t byteIndex = page / 8;
-        size_t bitOffset = page % 8;
-        size_t pagesRemaining = endPage - page;
-        
-        if (byteIndex >= bitmapSize) break;
-        
-        if (bitOffset == 0 && pagesRemaining >= 8) {
-            size_t wholeBytesAvailable = pagesRemaining / 8;
-            size_t maxBytes = bitmapSize - byteIndex;
-            size_t bytesToSet = (wholeBytesAvailable < maxBytes)
-                                ? wholeBytesAvailable
-                                : maxBytes;
-            
-            memset(&allocationBitmap[byteIndex], 0xFF, bytesToSet);
-            page += bytesToSet * 8;
-        } else {
-            size_t bitsAvailable = 8 - bitOffset;
-            size_t bitsToSet = (pagesRemaining < bitsAvailable)
-                               ? pagesRemaining
-                               : bitsAvailable;
-            
-            uint8_t mask = ((1 << bitsToSet) - 1) << bitOffset;
-            allocationBitmap[byteIndex] |= mask;
-            
-            page += bitsToSet;
-        }
+    IOLockLock(lruLock);
+    struct gtt_binding *b = *slot;
+    if (b && b != lruTail) {
+        lruUnlink(b);
+        lruAppend(b);
     }
+    IOLockUnlock(lruLock);
 }
 
-void IntelGTT::markSpaceFree(size_t startPage, size_t numPages)
+bool IntelGTT::pinBinding(struct gtt_binding **slot)
 {
-    if (numPages == 0) return;
+    if (!slot || !lruLock) {
+        return false;
+    }
     
-    size_t endPage = startPage + numPages;
-    size_t lastPage = endPage - 1;
-    size_t maxByteIndex = lastPage / 8;
+    IOLockLock(lruLock);
+    bool pinned = (*slot != NULL);
+    if (pinned) {
+        (*slot)->pinCount++;
+    }
+    IOLockUnlock(lruLock);
     
-    if (maxByteIndex >= bitmapSize) {
-        IOLog("IntelGTT::markSpaceFree: ERROR - Out of bounds!\n");
+    return pinned;
+}
+
+void IntelGTT::unpinBinding(struct gtt_binding **slot)
+{
+    if (!slot || !lruLock) {
         return;
     }
     
-    for (size_t page = startPage; page < endPage; ) {
-        size_t byteIndex = page / 8;
-        size_t bitOffset = page % 8;
-        size_t pagesRemaining = endPage - page;
-        
-        if (byteIndex >= bitmapSize) break;
+    IOLockLock(lruLock);
+    struct gtt_binding *b = *slot;
+    if (b && b->pinCount > 0) {
+        // Unpinned ranges become the most recently used, not the first victim
+        b->pinCount--;
+        if (b->pinCount == 0 && b != lruTail) {
+            lruUnlink(b);
+            lruAppend(b);
+        }
+    }
+    IOLockUnlock(lruLock);
+}
+
+// Caller holds lruLock and re-runs findFreeSpace() itself on success
+bool IntelGTT::evictForSpace(size_t numPages, size_t alignmentPages)
+{
+    u32 evicted = 0;
+    u64 evictedBytes = 0;
+    bool satisfied = false;
+    
+    // Oldest first; skip scanout/locked ranges and anything still in flight
+    struct gtt_binding *b = lruHead;
+    while (b) {
+        struct gtt_binding *next = b->lruNext;
         
-        if (bitOffset == 0 && pagesRemaining >= 8) {
-            size_t wholeBytesAvailable = pagesRemaining / 8;
-            size_t maxBytes = bitmapSize - byteIndex;
-            size_t bytesToClear = (wholeBytesAvailable < maxBytes)
-                                  ? wholeBytesAvailable
-                                  : maxBytes;
+        if (b->pinCount == 0 &&
+            !(b->ops && b->ops->isBusy && b->ops->isBusy(b->owner))) {
+            size_t index = (b->start - baseAddress) / pageSize;
+            size_t pages = (b->size + pageSize - 1) / pageSize;
             
-            memset(&allocationBitmap[byteIndex], 0x00, bytesToClear);
-            page += bytesToClear * 8;
-        } else {
-            size_t bitsAvailable = 8 - bitOffset;
-            size_t bitsToClear = (pagesRemaining < bitsAvailable)
-                                 ? pagesRemaining
-                                 : bitsAvailable;
+            lruUnlink(b);
+            *b->slot = NULL;
+            
+            clearPTERange(index, pages);
+            flushBind(index + pages - 1);
+            pageBitmap.markFree(index, pages);
             
-            uint8_t mask = ((1 << bitsToClear) - 1) << bitOffset;
-            allocationBitmap[byteIndex] &= ~mask;
+            if (b->ops && b->ops->evicted) {
+                b->ops->evicted(b->owner);
+            }
             
-            page += bitsToClear;
+            evicted++;
+            evictedBytes += (u64)pages * pageSize;
+            IOFree(b, sizeof(struct gtt_binding));
+            
+            if (pageBitmap.findFreeSpace(numPages, alignmentPages) != SIZE_MAX) {
+                satisfied = true;
+                break;
+            }
         }
+        
+        b = next;
+    }
+    
+    // Remember what we could not place so the compactor knows its target
+    if (!satisfied && numPages > pendingRequestPages) {
+        pendingRequestPages = numPages;
+    }
+    
+    IOLockLock(statsLock);
+    stats.evict_count += evicted;
+    stats.evict_bytes += evictedBytes;
+    if (!satisfied) {
+        stats.evict_failures++;
     }
+    IOLockUnlock(statsLock);
+    
+    IOLog("IntelGTT: Evicted %u bindings (%llu KB) for %zu pages: %s\n",
+          evicted, evictedBytes / 1024, numPages, satisfied ? "ok" : "still full");
+    
+    return satisfied;
 }
 
 
- * allocateSpace / freeSpace - NO LOCKING
-u64 IntelGTT::allocateSpace(size_t size, size_t alignment)
+
+ * Compaction
+
+void IntelGTT::getFragmentation(struct gtt_frag_info *info)
 {
-    if (size == 0 || size > usableSize) {
-        return 0;
+    if (!info) {
+        return;
     }
     
-    size_t numPages = (size + pageSize - 1) / pageSize;
-    size_t alignmentPages = (alignment + pageSize - 1) / pageSize;
-    if (alignmentPages == 0) alignmentPages = 1;
+    bzero(info, sizeof(*info));
+    if (!pageBitmap.getTotalPages() || !lruLock) {
+        return;
+    }
     
-    size_t startPage = findFreeSpace(numPages, alignmentPages);
-    if (startPage == SIZE_MAX) {
-        IOLog("IntelGTT: No free space for %zu pages\n", numPages);
-        return 0;
+    // Walk free extents with the same word-level helpers as the allocator
+    IOLockLock(lruLock);
+    size_t page = pageBitmap.findNextFreePage(0);
+    while (page != SIZE_MAX) {
+        size_t end = pageBitmap.findNextUsedPage(page, pageBitmap.getTotalPages());
+        size_t extent = end - page;
+        
+        info->freePages += extent;
+        info->freeExtents++;
+        if (extent > info->largestFreeExtent) {
+            info->largestFreeExtent = extent;
+        }
+        
+        page = pageBitmap.findNextFreePage(end);
     }
+    IOLockUnlock(lruLock);
     
-    markSpaceUsed(startPage, numPages);
+    if (info->freePages > 0) {
+        info->fragmentationPct = (u32)(100 - (info->largestFreeExtent * 100) / info->freePages);
+    }
+}
+
+void IntelGTT::relocateBinding(struct gtt_binding *b, size_t newIndex)
+{
+    size_t oldIndex = (b->start - baseAddress) / pageSize;
+    size_t pages = (b->size + pageSize - 1) / pageSize;
+    u64 newStart = baseAddress + (u64)newIndex * pageSize;
     
-    // startPage is bitmap page, address = baseAddress + startPage*pageSize
-    u64 address = baseAddress + (startPage * pageSize);
+    // Copy the PTEs so the new range is live before the owner switches
+    pageBitmap.markUsed(newIndex, pages);
     
-    IOLog("IntelGTT: Allocated 0x%llx - 0x%llx (%zu pages)\n",
-          address, address + size, numPages);
+    volatile u64 *pte = (volatile u64 *)gttBase;
+    for (size_t i = 0; i < pages; i++) {
+        pte[newIndex + i] = pte[oldIndex + i];
+    }
+    flushBind(newIndex + pages - 1);
     
-    return address;
+    b->ops->relocated(b->owner, newStart);
+    b->start = newStart;
+    
+    clearPTERange(oldIndex, pages);
+    flushBind(oldIndex + pages - 1);
+    pageBitmap.markFree(oldIndex, pages);
+    
+    IOLockLock(statsLock);
+    stats.relocate_count++;
+    stats.relocate_bytes += (u64)pages * pageSize;
+    stats.pte_write_count += pages;
+    IOLockUnlock(statsLock);
 }
 
-bool IntelGTT::freeSpace(u64 address, size_t size)
+u32 IntelGTT::compactSlice(u64 deadline, u32 maxMoves)
 {
-    if (address < baseAddress || size == 0) {
-        return false;
+    if (!lruLock || !gttBase) {
+        return 0;
     }
     
-    // Bitmap page = (address - baseAddress) / pageSize
-    size_t startPage = (address - baseAddress) / pageSize;
-    size_t numPages = (size + pageSize - 1) / pageSize;
+    u32 moves = 0;
     
-    markSpaceFree(startPage, numPages);
+    IOLockLock(lruLock);
     
-    IOLog("IntelGTT: Freed 0x%llx - 0x%llx (%zu pages)\n",
-          address, address + size, numPages);
+    // Only compact on behalf of an allocation that actually failed
+    while (pendingRequestPages && moves < maxMoves && mach_absolute_time() < deadline) {
+        if (pageBitmap.findFreeSpace(pendingRequestPages, 1) != SIZE_MAX) {
+            pendingRequestPages = 0;
+            break;
+        }
+        
+        // Highest movable binding that has a lower first-fit hole to go to
+        struct gtt_binding *best = NULL;
+        size_t bestTarget = 0;
+        
+        for (struct gtt_binding *b = lruHead; b; b = b->lruNext) {
+            if (b->pinCount || !b->ops || !b->ops->relocated) {
+                continue;
+            }
+            if (b->ops->isBusy && b->ops->isBusy(b->owner)) {
+                continue;
+            }
+            
+            size_t index = (b->start - baseAddress) / pageSize;
+            if (best && index <= (best->start - baseAddress) / pageSize) {
+                continue;
+            }
+            
+            size_t target = pageBitmap.findFreeSpace((b->size + pageSize - 1) / pageSize, 1);
+            if (target != SIZE_MAX && target < index) {
+                best = b;
+                bestTarget = target;
+            }
+        }
+        
+        if (!best) {
+            break;
+        }
+        
+        relocateBinding(best, bestTarget);
+        moves++;
+    }
     
-    return true;
+    IOLockUnlock(lruLock);
+    
+    return moves;
 }
 
 
 
-
  * Statistics
 
+size_t IntelGTT::getUsedSize() const
+{
+    return (pageBitmap.getTotalPages() - pageBitmap.getFreePages()) * pageSize;
+}
+
+bool IntelGTT::isValid(u64 address, size_t size) const
+{
+    return address >= baseAddress &&
+           address + size <= baseAddress + usableSize;
+}
+
 void IntelGTT::getStats(struct gtt_stats *out)
 {
     if (!out) {
@@ -907,6 +1286,10 @@ void IntelGTT::getStats(struct gtt_stats *out)
     }
     
     IOLockLock(statsLock);
+    stats.used_entries = pageBitmap.getTotalPages() - pageBitmap.getFreePages();
+    stats.free_entries = pageBitmap.getFreePages();
+    stats.used_bytes = (u64)stats.used_entries * pageSize;
+    stats.free_bytes = (u64)pageBitmap.getFreePages() * pageSize;
     memcpy(out, &stats, sizeof(struct gtt_stats));
     IOLockUnlock(statsLock);
 }
@@ -920,6 +1303,10 @@ void IntelGTT::printStats()
     if (!statsLock) return;
     
     IOLockLock(statsLock);
+    stats.used_entries = pageBitmap.getTotalPages() - pageBitmap.getFreePages();
+    stats.free_entries = pageBitmap.getFreePages();
+    stats.used_bytes = (u64)stats.used_entries * pageSize;
+    stats.free_bytes = (u64)pageBitmap.getFreePages() * pageSize;
     IOLog("IntelGTT Statistics:\n");
     IOLog("  Total entries: %zu (%.2f MB)\n",
           stats.total_entries, stats.total_bytes / (1024.0 * 1024.0));
@@ -934,6 +1321,15 @@ void IntelGTT::printStats()
     IOLog("  Operations: insert=%u clear=%u bind=%u unbind=%u\n",
           stats.insert_count, stats.clear_count,
           stats.bind_count, stats.unbind_count);
+    IOLog("  PTE batches: %u, PTE writes: %llu, flushes: %u (%.1f PTEs/flush)\n",
+          stats.batch_count, stats.pte_write_count, stats.pte_flush_count,
+          stats.pte_flush_count > 0 ?
+          (double)stats.pte_write_count / stats.pte_flush_count : 0.0);
+    IOLog("  Evictions: %u (%.2f MB), unrelieved pressure: %u\n",
+          stats.evict_count, stats.evict_bytes / (1024.0 * 1024.0),
+          stats.evict_failures);
+    IOLog("  Relocations: %u (%.2f MB)\n",
+          stats.relocate_count, stats.relocate_bytes / (1024.0 * 1024.0));
     IOLockUnlock(statsLock);
 }
 
@@ -13,6 +13,7 @@
 #include <IOKit/IOMemoryDescriptor.h>
 #include <IOKit/IOBufferMemoryDescriptor.h>
 #include "linux_compat.h"
+#include "IntelPageBitmap.h"
 
 class AppleIntelTGLController;
 class IntelGEMObject;
@@ -24,6 +25,10 @@ class IntelUncore;
 #define GTT_PAGE_CACHE_LLC  (3ULL << 8)  // Last Level Cache
 #define GTT_PAGE_CACHE_L3   (1ULL << 10) // L3 cache
 
+/* GGTT TLB invalidation */
+#define GEN6_GFX_FLSH_CNTL  0x101008
+#define GFX_FLSH_CNTL_EN    (1 << 0)
+
 /* Address Space Types */
 enum i915_address_space_type {
     GTT_TYPE_GGTT = 0,  // Global GTT (all contexts)
@@ -35,6 +40,50 @@ struct gen12_pte_t {
     u64 val;
 } __attribute__((packed));
 
+/* Scatter list entry for bindRange() */
+struct gtt_sg_entry {
+    u64 phys;       // Physical start (4KB aligned)
+    u64 length;     // Bytes, rounded up to whole pages
+};
+
+/* Coalesced physical segment list for a prepared IOMemoryDescriptor.
+ * Built once, then reused for every GGTT/PPGTT bind of the same backing. */
+struct gtt_sg_table {
+    struct gtt_sg_entry *entries;
+    u32 count;
+    u32 capacity;
+    u64 length;     // Total bytes covered
+};
+
+/* Eviction hooks supplied by the owner of a tracked GGTT binding */
+struct gtt_binding_ops {
+    bool (*isBusy)(void *owner);    // Fence check; NULL = idle whenever unpinned
+    void (*evicted)(void *owner);   // PTEs already cleared and space freed
+    void (*relocated)(void *owner, u64 newStart);  // Compaction moved it; NULL = immovable
+};
+
+/* Free-space layout of the GGTT, for the compactor */
+struct gtt_frag_info {
+    size_t freePages;
+    size_t largestFreeExtent;   // Pages
+    u32 freeExtents;
+    u32 fragmentationPct;       // 100 - largest extent as % of free space
+};
+
+/* One tracked GGTT range, kept on an LRU list (head = least recently used).
+ * The owner holds the pointer in *slot; the GTT clears it on eviction. */
+struct gtt_binding {
+    u64 start;
+    size_t size;
+    void *owner;
+    const struct gtt_binding_ops *ops;
+    struct gtt_binding **slot;
+    u32 pinCount;           // Scanout / CPU-locked ranges are never evicted
+    u64 lastUse;
+    struct gtt_binding *lruPrev;
+    struct gtt_binding *lruNext;
+};
+
 /* GTT Statistics */
 struct gtt_stats {
     size_t total_entries;
@@ -47,6 +96,14 @@ struct gtt_stats {
     u32 clear_count;
     u32 bind_count;
     u32 unbind_count;
+    u32 batch_count;        // PTE batches (insert/clear/bindRange/surface)
+    u64 pte_write_count;    // PTEs written across all batches
+    u32 pte_flush_count;    // Posting read + TLB invalidate, one per batch
+    u32 evict_count;        // Bindings evicted under aperture pressure
+    u64 evict_bytes;
+    u32 evict_failures;     // Pressure that eviction could not relieve
+    u32 relocate_count;     // Bindings moved by compaction
+    u64 relocate_bytes;
 };
 
 class IntelGTT {
@@ -61,7 +118,12 @@ public:
     // GTT Operations
     bool insertEntries(u64 start, IOMemoryDescriptor *mem, u32 flags);
     bool clearEntries(u64 start, size_t size);
-    bool bindObject(IntelGEMObject *obj, u32 cache_level);
+    bool bindRange(u64 start, const struct gtt_sg_entry *sg, u32 count, u32 flags);
+    
+    // Scatter-gather tables (descriptor must already be prepared)
+    static struct gtt_sg_table *createSGTable(IOMemoryDescriptor *mem);
+    static void destroySGTable(struct gtt_sg_table *sgt);
+    bool bindObject(IntelGEMObject *obj, u32 cache_level, bool pinned = true);
     bool unbindObject(IntelGEMObject *obj);
     uint64_t getGTTBasePhysicalAddress();
 
@@ -73,6 +135,22 @@ public:
     u64 allocateSpace(size_t size, size_t alignment);
     bool freeSpace(u64 address, size_t size);
     
+    // LRU eviction tracking (all calls go through the owner's slot)
+    bool trackBinding(struct gtt_binding **slot, u64 start, size_t size, void *owner,
+                      const struct gtt_binding_ops *ops, bool pinned);
+    bool untrackBinding(struct gtt_binding **slot);  // false if already evicted
+    void touchBinding(struct gtt_binding **slot);
+    bool pinBinding(struct gtt_binding **slot);      // false if already evicted
+    void unpinBinding(struct gtt_binding **slot);
+    
+    // Compaction: slide movable bindings down into lower free extents.
+    // Only unpinned bindings whose ops provide relocated() move; surfaces
+    // pin theirs once the address is handed out. Does nothing unless an allocation
+    // failed (pendingRequestPages); stops at deadline or after maxMoves.
+    void getFragmentation(struct gtt_frag_info *info);
+    size_t getPendingRequestPages() const { return pendingRequestPages; }
+    u32 compactSlice(u64 deadline, u32 maxMoves);
+    
     // Cache Management
     void flush();
     void invalidate();
@@ -103,10 +181,17 @@ private:
     size_t pageSize;         // Page size (4KB)
     size_t numEntries;       // Number of PTE entries
     
-    // Free Space Tracking (simple bitmap for now)
-    u8 *allocationBitmap;
-    size_t bitmapSize;
-    // IOLock *allocationLock;  // REMOVED - lock-free bitmap operations
+    // Free Space Tracking (word/summary bitmap, guarded by lruLock)
+    IntelPageBitmap pageBitmap;
+    
+    // Bound ranges in LRU order for eviction. lruLock also guards
+    // pageBitmap, so allocation, eviction and compaction never
+    // see each other's half-finished updates.
+    struct gtt_binding *lruHead;
+    struct gtt_binding *lruTail;
+    u64 lruClock;
+    IOLock *lruLock;
+    size_t pendingRequestPages;  // Largest request eviction could not satisfy
     
     // Statistics
     struct gtt_stats stats;
@@ -118,16 +203,23 @@ private:
     bool initializePageTables();
     
     uint32_t findFreeGTTRegion(uint32_t numPages);  // Helper for bindSurfacePages
+    
+    // Eviction (lruLock held by caller for the list and bitmap helpers)
+    void lruUnlink(struct gtt_binding *b);
+    void lruAppend(struct gtt_binding *b);
+    bool evictForSpace(size_t numPages, size_t alignmentPages);
+    void relocateBinding(struct gtt_binding *b, size_t newIndex);
+    
+    // Batched PTE writes: stream whole runs, then flushBind() once
+    size_t writePTERange(size_t index, u64 physAddr, size_t numPages, u64 pteBits);
+    void clearPTERange(size_t index, size_t numPages);
+    void flushBind(size_t lastIndex);
 public:
     void writePTE(size_t index, u64 physAddr, u32 flags);
     u64 readPTE(size_t index);
     void flushPTE(size_t index);
     
     u64 makeGen12PTE(u64 physAddr, u32 flags);
-    
-    size_t findFreeSpace(size_t numPages, size_t alignmentPages);
-    void markSpaceUsed(size_t startPage, size_t numPages);
-    void markSpaceFree(size_t startPage, size_t numPages);
 };
 
 #endif // INTEL_GTT_H
@@ -13,6 +13,7 @@
  */
 
 #include "IntelGuC.h"
+#include "IntelGuCSubmission.h"
 #include "AppleIntelTGLController.h"
 #include "IntelContext.h"
 #include "IntelRequest.h"
@@ -33,6 +34,7 @@ OSDefineMetaClassAndStructors(IntelGuC, OSObject)
 
 // Communication timeouts
 #define GUC_SEND_TIMEOUT_MS     10
+#define GUC_CTB_SPACE_POLL_US   10      // Re-check interval while the H2G ring is full
 #define GUC_INIT_TIMEOUT_MS     100
 #define GUC_STATUS_TIMEOUT_US   100000  // 100ms
 
@@ -98,7 +100,16 @@ bool IntelGuC::initWithController(AppleIntelTGLController* ctrl) {
     ctbPhysAddr = 0;
     ctbHead = 0;
     
+    h2gBuffer = NULL;
+    h2gPhysAddr = 0;
+    h2gTail = 0;
+    h2gCredits = 0;
+    h2gEnabled = false;
+    ctbFenceSeq = 0;
+    memset(ctbPending, 0, sizeof(ctbPending));
+    
     memset(&stats, 0, sizeof(stats));
+    installG2HHandlers();
     
     // Create locks
     messageLock = IORecursiveLockAlloc();
@@ -107,12 +118,22 @@ bool IntelGuC::initWithController(AppleIntelTGLController* ctrl) {
         return false;
     }
     
+    ctbLock = IOLockAlloc();
+    if (!ctbLock) {
+        IOLog("IntelGuC: ERROR - Failed to allocate CTB lock\n");
+        IORecursiveLockFree(messageLock);
+        messageLock = NULL;
+        return false;
+    }
+    
     // Allocate shared memory for GuC communication
     sharedMemory = IOBufferMemoryDescriptor::withCapacity(4096, kIODirectionInOut);
     if (!sharedMemory) {
         IOLog("IntelGuC: ERROR - Failed to allocate shared memory\n");
         IORecursiveLockFree(messageLock);
         messageLock = NULL;
+        IOLockFree(ctbLock);
+        ctbLock = NULL;
         return false;
     }
     
@@ -224,6 +245,21 @@ void IntelGuC::shutdown() {
     // Disable logging
     disableLogging();
     
+    // Stop H2G traffic and release anyone waiting on a response
+    if (h2gEnabled) {
+        uint32_t data[1] = { GUC_CTB_TYPE_H2G };
+        sendMMIOMessage(GUC_ACTION_DEREGISTER_CTB, data, 1, NULL);
+        
+        IOLockLock(ctbLock);
+        h2gEnabled = false;
+        for (uint32_t i = 0; i < GUC_CTB_MAX_INFLIGHT; i++) {
+            if (ctbPending[i].fence) {
+                IOLockWakeup(ctbLock, &ctbPending[i], false);
+            }
+        }
+        IOLockUnlock(ctbLock);
+    }
+    
     // Release interrupt source
     if (g2hInterruptSource) {
         g2hInterruptSource->disable();
@@ -243,12 +279,17 @@ void IntelGuC::shutdown() {
         firmwareMemory = NULL;
     }
     
-    // Free lock
+    // Free locks
     if (messageLock) {
         IORecursiveLockFree(messageLock);
         messageLock = NULL;
     }
     
+    if (ctbLock) {
+        IOLockFree(ctbLock);
+        ctbLock = NULL;
+    }
+    
     // Cleanup CTB buffer
     cleanupCTBBuffer();
     
@@ -496,6 +537,46 @@ bool IntelGuC::sendH2GMessage(uint32_t action, uint32_t* data, uint32_t len, uin
         return false;
     }
     
+    if (!h2gEnabled) {
+        return sendMMIOMessage(action, data, len, response);
+    }
+    
+    // Once the CTB is up every message goes through it: an MMIO send would
+    // overtake whatever is still queued in the ring. When the channel is
+    // full, wait for the GuC to consume or give up.
+    // Must not be called from the work loop when a response is wanted:
+    // the response arrives through the G2H handler running there
+    uint64_t deadline;
+    clock_interval_to_deadline(GUC_SEND_TIMEOUT_MS, kMillisecondScale, &deadline);
+    
+    IOReturn ret;
+    for (;;) {
+        ret = response ? sendCTBRequest(action, data, len, response)
+                       : sendCTBMessage(action, data, len);
+        if (ret != kIOReturnNoSpace && ret != kIOReturnBusy) {
+            break;
+        }
+        if (mach_absolute_time() >= deadline) {
+            ret = kIOReturnTimeout;
+            break;
+        }
+        IODelay(GUC_CTB_SPACE_POLL_US);
+    }
+    
+    if (ret != kIOReturnSuccess) {
+        IOLog("IntelGuC: ERROR - CTB send of action 0x%x failed: 0x%x\n", action, ret);
+        stats.errors++;
+        return false;
+    }
+    
+    return true;
+}
+
+bool IntelGuC::sendMMIOMessage(uint32_t action, uint32_t* data, uint32_t len, uint32_t* response) {
+    if (!isReady()) {
+        return false;
+    }
+    
     if (len > GUC_MAX_MMIO_MSG_LEN) {
         IOLog("IntelGuC: ERROR - Message too long (%u > %u)\n", len, GUC_MAX_MMIO_MSG_LEN);
         return false;
@@ -532,6 +613,140 @@ bool IntelGuC::sendH2GMessageFast(uint32_t action, uint32_t data0, uint32_t data
     return sendH2GMessage(action, data, 2, NULL);
 }
 
+uint32_t IntelGuC::h2gSpace() {
+    // GuC advances head as it consumes; one dword stays free so that
+    // head == tail always means empty
+    uint32_t head = __atomic_load_n(&h2gBuffer->desc.head, __ATOMIC_ACQUIRE);
+    return (head + GUC_CTB_SIZE_DWORDS - h2gTail - 1) % GUC_CTB_SIZE_DWORDS;
+}
+
+IOReturn IntelGuC::writeH2G(uint32_t fence, uint32_t flags, uint32_t action,
+                            const uint32_t* data, uint32_t len) {
+    // Called with ctbLock held
+    uint32_t total = GUC_CTB_H2G_HDR_LEN + len;
+    if (total > GUC_CTB_MSG_MAX_LEN || (len && !data)) {
+        return kIOReturnBadArgument;
+    }
+    
+    // Only look at the GuC's head when the cached credits run out
+    if (h2gCredits < total) {
+        h2gCredits = h2gSpace();
+        if (h2gCredits < total) {
+            stats.h2gNoSpace++;
+            return kIOReturnNoSpace;
+        }
+    }
+    
+    uint32_t* ring = h2gBuffer->messages;
+    uint32_t tail = h2gTail;
+    
+    ring[tail] = GUC_CTB_MSG_MAKE_HDR_FLAGS(GUC_CTB_H2G_MSG_REQUEST, flags, total);
+    tail = (tail + 1) % GUC_CTB_SIZE_DWORDS;
+    ring[tail] = fence;
+    tail = (tail + 1) % GUC_CTB_SIZE_DWORDS;
+    ring[tail] = action;
+    tail = (tail + 1) % GUC_CTB_SIZE_DWORDS;
+    for (uint32_t i = 0; i < len; i++) {
+        ring[tail] = data[i];
+        tail = (tail + 1) % GUC_CTB_SIZE_DWORDS;
+    }
+    
+    // Release: message body is visible before the GuC sees the new tail
+    h2gTail = tail;
+    h2gCredits -= total;
+    __atomic_store_n(&h2gBuffer->desc.tail, tail, __ATOMIC_RELEASE);
+    
+    mmioWrite(GUC_SEND_INTERRUPT, 1);
+    stats.h2gCtbMessages++;
+    
+    return kIOReturnSuccess;
+}
+
+IOReturn IntelGuC::sendCTBMessage(uint32_t action, const uint32_t* data, uint32_t len) {
+    if (!h2gEnabled) {
+        return kIOReturnNotReady;
+    }
+    
+    IOLockLock(ctbLock);
+    IOReturn ret = writeH2G(0, 0, action, data, len);
+    IOLockUnlock(ctbLock);
+    
+    return ret;
+}
+
+IOReturn IntelGuC::sendCTBRequest(uint32_t action, const uint32_t* data, uint32_t len, uint32_t* response) {
+    if (!h2gEnabled) {
+        return kIOReturnNotReady;
+    }
+    
+    IOLockLock(ctbLock);
+    
+    // Fence encodes its slot so the response handler finds it directly
+    GuCCTBPending* pending = NULL;
+    uint32_t slot;
+    for (slot = 0; slot < GUC_CTB_MAX_INFLIGHT; slot++) {
+        if (ctbPending[slot].fence == 0) {
+            pending = &ctbPending[slot];
+            break;
+        }
+    }
+    if (!pending) {
+        IOLockUnlock(ctbLock);
+        return kIOReturnBusy;
+    }
+    
+    if (++ctbFenceSeq == 0) {
+        ctbFenceSeq = 1;
+    }
+    pending->fence = ctbFenceSeq * GUC_CTB_MAX_INFLIGHT + slot;
+    if (pending->fence == 0) {
+        pending->fence = GUC_CTB_MAX_INFLIGHT;
+    }
+    pending->status = 0;
+    pending->response = 0;
+    pending->done = false;
+    
+    IOReturn ret = writeH2G(pending->fence, GUC_CTB_FLAG_NEEDS_RESPONSE, action, data, len);
+    if (ret != kIOReturnSuccess) {
+        pending->fence = 0;
+        IOLockUnlock(ctbLock);
+        return ret;
+    }
+    
+    uint64_t deadline;
+    clock_interval_to_deadline(GUC_CTB_RESPONSE_TIMEOUT_MS, kMillisecondScale, &deadline);
+    
+    while (!pending->done && h2gEnabled) {
+        if (IOLockSleepDeadline(ctbLock, pending, deadline, THREAD_UNINT) == THREAD_TIMED_OUT) {
+            break;
+        }
+    }
+    
+    if (!pending->done) {
+        ret = kIOReturnTimeout;
+    } else if (pending->status != 0) {
+        ret = kIOReturnError;
+    } else if (response) {
+        *response = pending->response;
+    }
+    
+    pending->fence = 0;
+    IOLockUnlock(ctbLock);
+    
+    return ret;
+}
+
+bool IntelGuC::registerCTB(uint32_t type, uint64_t physAddr) {
+    uint32_t data[4] = {
+        type,
+        GUC_CTB_SIZE_DWORDS,
+        (uint32_t)physAddr,
+        (uint32_t)(physAddr >> 32)
+    };
+    
+    return sendMMIOMessage(GUC_ACTION_REGISTER_CTB, data, 4, NULL);
+}
+
 
 // MARK: - G2H Communication (GuC to Host)
 
@@ -553,6 +768,19 @@ bool IntelGuC::processG2HMessage() {
     return true;
 }
 
+void IntelGuC::installG2HHandlers() {
+    for (uint32_t i = 0; i < GUC_G2H_MSG_TYPE_COUNT; i++) {
+        g2hHandlers[i] = NULL;
+    }
+    
+    g2hHandlers[GUC_G2H_MSG_CRASH_DUMP_POSTED] = &IntelGuC::handleG2HCrashDump;
+    g2hHandlers[GUC_G2H_MSG_REQUEST_COMPLETE]  = &IntelGuC::handleG2HRequestComplete;
+    g2hHandlers[GUC_G2H_MSG_CONTEXT_COMPLETE]  = &IntelGuC::handleG2HContextComplete;
+    g2hHandlers[GUC_G2H_MSG_ENGINE_RESET]      = &IntelGuC::handleG2HEngineReset;
+    g2hHandlers[GUC_G2H_MSG_EXCEPTION]         = &IntelGuC::handleG2HException;
+    g2hHandlers[GUC_G2H_MSG_RESPONSE]          = &IntelGuC::handleG2HResponse;
+}
+
 bool IntelGuC::processG2HMessages() {
     if (!ctbBuffer) {
         // Fallback to legacy scratch register
@@ -561,64 +789,55 @@ bool IntelGuC::processG2HMessages() {
     
     stats.g2hInterrupts++;
     
-    // Read CTB head and tail
+    uint32_t head = ctbHead;  // Host owns the G2H head
     uint32_t tail = readCTBTail();
-    uint32_t head = ctbHead;  // Use cached head
-    
-    if (head == tail) {
-        return true;  // No messages
-    }
-    
-    IOLog("IntelGuC: 📨 Processing G2H messages (head=%u, tail=%u)\n", head, tail);
-    
     uint32_t processed = 0;
     
-    // Process all pending messages
+    // Drain everything, re-reading tail so messages posted while we were
+    // dispatching are handled in this pass rather than the next interrupt
     while (head != tail) {
-        GuCG2HMessage msg;
-        if (!readCTBMessage(head, &msg)) {
-            IOLog("IntelGuC: ERR  Failed to read CTB message at index %u\n", head);
+        if (tail >= GUC_CTB_SIZE_DWORDS) {
+            IOLog("IntelGuC: ERR  Invalid G2H tail %u\n", tail);
+            ctbBuffer->desc.status = 1;
+            stats.errors++;
             break;
         }
         
-        uint32_t msgType = GUC_CTB_MSG_TYPE(msg.header);
-        uint32_t msgLen = GUC_CTB_MSG_LEN(msg.header);
-        
-        IOLog("IntelGuC: 📬 G2H message type=0x%x len=%u\n", msgType, msgLen);
-        
-        // Dispatch based on message type
-        switch (msgType) {
-            case GUC_G2H_MSG_REQUEST_COMPLETE:
-                handleG2HRequestComplete(&msg);
+        while (head != tail) {
+            GuCG2HMessage msg;
+            if (!readCTBMessage(head, &msg)) {
+                // Corrupt stream: flag it and resync to the producer
+                ctbBuffer->desc.status = 1;
+                stats.errors++;
+                head = tail;
                 break;
-                
-            case GUC_G2H_MSG_CONTEXT_COMPLETE:
-                handleG2HContextComplete(&msg);
-                break;
-                
-            case GUC_G2H_MSG_CRASH_DUMP_POSTED:
-                IOLog("IntelGuC:  GuC crash dump posted!\n");
-                break;
-                
-            case GUC_G2H_MSG_ENGINE_RESET:
-                IOLog("IntelGuC:  Engine reset notification\n");
-                break;
-                
-            default:
+            }
+            
+            uint32_t msgType = GUC_CTB_MSG_TYPE(msg.header);
+            G2HHandler handler = g2hHandlers[msgType];
+            if (handler) {
+                (this->*handler)(&msg);
+            } else {
                 IOLog("IntelGuC:  Unknown G2H message type 0x%x\n", msgType);
-                break;
+            }
+            
+            head = (head + GUC_CTB_MSG_LEN(msg.header)) % GUC_CTB_SIZE_DWORDS;
+            processed++;
         }
         
-        // Advance head (with wraparound)
-        head = (head + msgLen) % GUC_CTB_SIZE_DWORDS;
-        processed++;
+        tail = readCTBTail();
     }
     
-    // Update cached head
-    ctbHead = head;
-    writeCTBHead(head);
-    
-    IOLog("IntelGuC: OK  Processed %u G2H messages\n", processed);
+    // One head update for the whole batch
+    if (processed) {
+        ctbHead = head;
+        writeCTBHead(head);
+        
+        stats.g2hMessages += processed;
+        if (processed > stats.g2hMaxBatch) {
+            stats.g2hMaxBatch = processed;
+        }
+    }
     
     return true;
 }
@@ -634,8 +853,13 @@ bool IntelGuC::handleG2HRequestComplete(GuCG2HMessage* msg) {
     uint32_t fenceId = msg->data[2];
     uint32_t engineId = msg->data[3];
     
-    IOLog("IntelGuC: OK  Request complete - fence=%u seqno=%u engine=%u context=%u\n",
-          fenceId, seqno, engineId, contextId);
+    (void)engineId;
+    
+    // 0. Advance the context's WQ head so its slots (and doorbell) free up
+    IntelGuCSubmission* submission = controller->getGuCSubmission();
+    if (submission) {
+        submission->retireWorkQueue(contextId);
+    }
     
     // 1. Signal fence (wakes WindowServer)
     if (fenceId != 0) {
@@ -657,9 +881,46 @@ bool IntelGuC::handleG2HContextComplete(GuCG2HMessage* msg) {
     }
     
     uint32_t contextId = msg->data[0];
-    IOLog("IntelGuC: OK  Context complete - context=%u\n", contextId);
     
-    // TODO: Handle context completion
+    // The context went idle: everything it had queued has been consumed
+    IntelGuCSubmission* submission = controller->getGuCSubmission();
+    if (submission) {
+        submission->retireWorkQueue(contextId);
+    }
+    
+    return true;
+}
+
+bool IntelGuC::handleG2HCrashDump(GuCG2HMessage* msg) {
+    IOLog("IntelGuC:  GuC crash dump posted!\n");
+    stats.errors++;
+    return true;
+}
+
+bool IntelGuC::handleG2HEngineReset(GuCG2HMessage* msg) {
+    IOLog("IntelGuC:  Engine reset notification (engine=%u)\n", msg->data[0]);
+    return true;
+}
+
+bool IntelGuC::handleG2HException(GuCG2HMessage* msg) {
+    IOLog("IntelGuC:  GuC exception (code=0x%08x)\n", msg->data[0]);
+    stats.errors++;
+    return true;
+}
+
+bool IntelGuC::handleG2HResponse(GuCG2HMessage* msg) {
+    // data[0] = fence, data[1] = status, data[2] = response payload
+    uint32_t fence = msg->data[0];
+    GuCCTBPending* pending = &ctbPending[fence % GUC_CTB_MAX_INFLIGHT];
+    
+    IOLockLock(ctbLock);
+    if (fence != 0 && pending->fence == fence) {
+        pending->status = msg->data[1];
+        pending->response = msg->data[2];
+        pending->done = true;
+        IOLockWakeup(ctbLock, pending, true);
+    }
+    IOLockUnlock(ctbLock);
     
     return true;
 }
@@ -684,6 +945,10 @@ bool IntelGuC::initializeCTB() {
         ctbBuffer->desc.reserved = 0;
         ctbHead = 0;
         
+        memset(&h2gBuffer->desc, 0, sizeof(h2gBuffer->desc));
+        h2gTail = 0;
+        h2gCredits = GUC_CTB_SIZE_DWORDS - 1;
+        
         IOLog("IntelGuC: OK  CTB buffer initialized at phys=0x%llx\n", ctbPhysAddr);
     }
     
@@ -691,8 +956,9 @@ bool IntelGuC::initializeCTB() {
 }
 
 bool IntelGuC::allocateCTBBuffer() {
-    // Allocate memory for CTB buffer (must be physically contiguous)
-    size_t bufferSize = sizeof(GuCCTBBuffer);
+    // Allocate memory for both CTBs (must be physically contiguous):
+    // G2H first, H2G second
+    size_t bufferSize = 2 * sizeof(GuCCTBBuffer);
     
     ctbMemory = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(
         kernel_task,
@@ -756,6 +1022,9 @@ bool IntelGuC::allocateCTBBuffer() {
     // Zero the buffer
     memset(ctbBuffer, 0, bufferSize);
     
+    h2gBuffer = ctbBuffer + 1;
+    h2gPhysAddr = ctbPhysAddr + sizeof(GuCCTBBuffer);
+    
     IOLog("IntelGuC: OK  Allocated CTB buffer (%zu bytes) at virt=%p phys=0x%llx\n",
           bufferSize, ctbBuffer, ctbPhysAddr);
     
@@ -772,6 +1041,12 @@ void IntelGuC::cleanupCTBBuffer() {
     ctbBuffer = NULL;
     ctbPhysAddr = 0;
     ctbHead = 0;
+    
+    h2gBuffer = NULL;
+    h2gPhysAddr = 0;
+    h2gTail = 0;
+    h2gCredits = 0;
+    h2gEnabled = false;
 }
 
 
@@ -805,6 +1080,14 @@ bool IntelGuC::initializeCTBCommunication() {
     
     IOLog("IntelGuC: OK  G2H interrupts enabled (0x%08x)\n", interruptEnable);
     
+    // Register the H2G channel; from here on sendH2GMessage goes via CTB
+    if (registerCTB(GUC_CTB_TYPE_H2G, h2gPhysAddr)) {
+        h2gEnabled = true;
+        IOLog("IntelGuC: OK  H2G CTB registered - phys=0x%llx\n", h2gPhysAddr);
+    } else {
+        IOLog("IntelGuC: WARNING - H2G CTB registration failed, using MMIO messages\n");
+    }
+    
     // Create and connect G2H interrupt source
     if (!g2hInterruptSource) {
         g2hInterruptSource = IOInterruptEventSource::interruptEventSource(
@@ -846,12 +1129,13 @@ uint32_t IntelGuC::readCTBTail() {
     if (!ctbBuffer) {
         return 0;
     }
-    return ctbBuffer->desc.tail;
+    // Acquire pairs with the GuC's tail publication
+    return __atomic_load_n(&ctbBuffer->desc.tail, __ATOMIC_ACQUIRE);
 }
 
 void IntelGuC::writeCTBHead(uint32_t head) {
     if (ctbBuffer) {
-        ctbBuffer->desc.head = head;
+        __atomic_store_n(&ctbBuffer->desc.head, head, __ATOMIC_RELEASE);
     }
 }
 
@@ -956,15 +1240,21 @@ bool IntelGuC::scheduleContext(IntelContext* context) {
 // MARK: - Command Submission (Week 39 preview)
 
 
-bool IntelGuC::submitCommand(IntelRequest* request) {
+bool IntelGuC::submitCommand(uint32_t contextId, uint32_t wqTail) {
     if (!isReady()) {
         return false;
     }
     
-    stats.commandsSubmitted++;
+    // Ask the GuC to schedule the context's work queue up to wqTail; fire
+    // and forget, completion comes back as GUC_G2H_MSG_REQUEST_COMPLETE.
+    // contextId is the GuC stage index, not IntelContext::getId()
+    uint32_t data[2] = { contextId, wqTail };
     
-    // GuC-based submission (simplified)
-    // Real implementation needs work queue setup
+    if (!sendH2GMessage(GUC_ACTION_SCHEDULE_CONTEXT, data, 2, NULL)) {
+        return false;
+    }
+    
+    stats.commandsSubmitted++;
     return true;
 }
 
@@ -59,6 +59,8 @@ class IntelRequest;
 #define GUC_ACTION_REGISTER_WORKQUEUE     0x4501
 #define GUC_ACTION_DEREGISTER_WORKQUEUE   0x4502
 #define GUC_ACTION_SETUP_FENCE_BUFFER     0x6020
+#define GUC_ACTION_REGISTER_CTB           0x4505   // Sent over MMIO
+#define GUC_ACTION_DEREGISTER_CTB         0x4506
 
 // GuC WOPCM (Write-Once Power Context Memory) registers
 #define GUC_WOPCM_SIZE          0xC050
@@ -73,6 +75,8 @@ enum GuCAction {
     GUC_ACTION_REGISTER_CONTEXT             = 0x0004,
     GUC_ACTION_DEREGISTER_CONTEXT           = 0x0005,
     GUC_ACTION_SCHEDULE_CONTEXT             = 0x0006,
+    GUC_ACTION_ALLOCATE_DOORBELL            = 0x0010,
+    GUC_ACTION_DEALLOCATE_DOORBELL          = 0x0020,
     
     // SLPC (Power management)
     GUC_ACTION_SLPC_REQUEST                 = 0x3003,
@@ -108,6 +112,10 @@ struct GuCStats {
     uint64_t doorbellRings;         // Doorbell rings
     uint64_t firmwareReloads;       // Firmware reload count
     uint64_t errors;                // Error count
+    uint64_t h2gCtbMessages;        // H2G messages sent through the CTB
+    uint64_t h2gNoSpace;            // Sends refused for lack of credits
+    uint64_t g2hMessages;           // G2H messages dispatched
+    uint64_t g2hMaxBatch;           // Most G2H messages drained in one pass
 };
 
 // G2H (GuC-to-Host) message types
@@ -117,8 +125,11 @@ enum GuCG2HMessageType {
     GUC_G2H_MSG_CONTEXT_COMPLETE        = 0x0003,
     GUC_G2H_MSG_ENGINE_RESET            = 0x0004,
     GUC_G2H_MSG_EXCEPTION               = 0x0005,
+    GUC_G2H_MSG_RESPONSE                = 0x0006,   // Reply to an H2G request
 };
 
+#define GUC_G2H_MSG_TYPE_COUNT  256     // Dispatch table size (8-bit type)
+
 // CTB (Command Transport Buffer) constants
 #define GUC_CTB_SIZE_DWORDS     4096    // 16KB buffer
 #define GUC_CTB_MSG_MIN_LEN     1
@@ -133,6 +144,21 @@ enum GuCG2HMessageType {
 #define GUC_CTB_MSG_FLAGS(hdr)      (((hdr) >> 8) & 0xFF)
 #define GUC_CTB_MSG_LEN(hdr)        (((hdr) >> 16) & 0xFFFF)
 #define GUC_CTB_MSG_MAKE_HDR(type, len) (((len) << 16) | (type))
+#define GUC_CTB_MSG_MAKE_HDR_FLAGS(type, flags, len) \
+    (((len) << 16) | (((flags) & 0xFF) << 8) | (type))
+
+// H2G message layout: [0] header, [1] fence, [2] action, [3..] data
+#define GUC_CTB_H2G_MSG_REQUEST         0x10
+#define GUC_CTB_H2G_HDR_LEN             3
+#define GUC_CTB_FLAG_NEEDS_RESPONSE     (1 << 0)
+
+// CTB types for GUC_ACTION_REGISTER_CTB
+#define GUC_CTB_TYPE_H2G                0
+#define GUC_CTB_TYPE_G2H                1
+
+// Outstanding H2G requests awaiting a G2H response (power of two)
+#define GUC_CTB_MAX_INFLIGHT            8
+#define GUC_CTB_RESPONSE_TIMEOUT_MS     50
 
 // CTB buffer descriptor (shared with GuC firmware)
 struct GuCCTBDesc {
@@ -162,6 +188,14 @@ struct GuCCTBBuffer {
     uint32_t messages[GUC_CTB_SIZE_DWORDS];
 };
 
+// H2G request waiting for its G2H response
+struct GuCCTBPending {
+    uint32_t fence;         // 0 when the slot is free
+    uint32_t status;
+    uint32_t response;
+    bool done;
+};
+
 /*
  * IntelGuC Class
  * Manages the Graphics Microcontroller (GuC) firmware and communication
@@ -200,15 +234,26 @@ public:
     uint32_t getStatusRegister();
     
     // H2G Communication (Host to GuC)
+    // Goes through the CTB once it is registered, MMIO scratch otherwise
     bool sendH2GMessage(uint32_t action, uint32_t* data, uint32_t len, uint32_t* response);
     bool sendH2GMessageFast(uint32_t action, uint32_t data0, uint32_t data1);
     
+    // Non-blocking CTB send: kIOReturnNoSpace when out of credits
+    IOReturn sendCTBMessage(uint32_t action, const uint32_t* data, uint32_t len);
+    // CTB round trip: sleeps until the G2H response handler wakes it
+    IOReturn sendCTBRequest(uint32_t action, const uint32_t* data, uint32_t len, uint32_t* response);
+    bool isCTBEnabled() const { return h2gEnabled; }
+    
     // G2H Communication (GuC to Host)
     static void handleG2HInterrupt(OSObject* owner, IOInterruptEventSource* source, int count);
     bool processG2HMessage();
     bool processG2HMessages();  // Process all pending messages
     bool handleG2HRequestComplete(GuCG2HMessage* msg);
     bool handleG2HContextComplete(GuCG2HMessage* msg);
+    bool handleG2HCrashDump(GuCG2HMessage* msg);
+    bool handleG2HEngineReset(GuCG2HMessage* msg);
+    bool handleG2HException(GuCG2HMessage* msg);
+    bool handleG2HResponse(GuCG2HMessage* msg);
     
     // CTB Management
     bool initializeCTB();
@@ -227,7 +272,7 @@ public:
     bool scheduleContext(IntelContext* context);
     
     // Command Submission (Week 39)
-    bool submitCommand(IntelRequest* request);
+    bool submitCommand(uint32_t contextId, uint32_t wqTail);
     bool ringDoorbell(IntelContext* context, uint32_t doorbellId);
     
     // SLPC - Single Loop Power Control (Week 40)
@@ -269,14 +314,34 @@ private:
     
     // CTB (Command Transport Buffer)
     IOBufferMemoryDescriptor*   ctbMemory;
-    GuCCTBBuffer*               ctbBuffer;       // Virtual address of CTB
+    GuCCTBBuffer*               ctbBuffer;       // Virtual address of CTB (G2H)
     uint64_t                    ctbPhysAddr;     // Physical address for GuC
     uint32_t                    ctbHead;         // Cached head position
     
+    // H2G send channel (second half of ctbMemory)
+    GuCCTBBuffer*               h2gBuffer;
+    uint64_t                    h2gPhysAddr;
+    uint32_t                    h2gTail;         // Host-owned producer index
+    uint32_t                    h2gCredits;      // Cached free dwords
+    bool                        h2gEnabled;
+    IOLock*                     ctbLock;         // H2G producer + response waits
+    GuCCTBPending               ctbPending[GUC_CTB_MAX_INFLIGHT];
+    uint32_t                    ctbFenceSeq;
+    
+    // G2H dispatch, indexed by message type
+    typedef bool (IntelGuC::*G2HHandler)(GuCG2HMessage* msg);
+    G2HHandler                  g2hHandlers[GUC_G2H_MSG_TYPE_COUNT];
+    
     // Statistics
     GuCStats                stats;
     
     // Helper methods
+    bool sendMMIOMessage(uint32_t action, uint32_t* data, uint32_t len, uint32_t* response);
+    bool registerCTB(uint32_t type, uint64_t physAddr);
+    void installG2HHandlers();
+    uint32_t h2gSpace();
+    IOReturn writeH2G(uint32_t fence, uint32_t flags, uint32_t action,
+                      const uint32_t* data, uint32_t len);
     bool waitForStatus(uint32_t mask, uint32_t value, uint32_t timeout_us);
     bool mmioWrite(uint32_t offset, uint32_t value);
     uint32_t mmioRead(uint32_t offset);
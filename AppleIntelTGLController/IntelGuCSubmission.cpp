@@ -14,6 +14,7 @@
 #include "IntelFence.h"
 #include "IntelRingBuffer.h"
 #include "IntelGEMObject.h"
+#include "IntelGTInterrupts.h"
 #include <IOKit/IOLib.h>
 
 #define super OSObject
@@ -27,9 +28,13 @@ GuCSubmissionQueue::GuCSubmissionQueue() {
     queueMemory = NULL;
     queueBuffer = NULL;
     queueSize = 0;
+    producerLock = NULL;
+    itemCount = 0;
+    itemMask = 0;
     head = 0;
     tail = 0;
-    queueLock = NULL;
+    reservedTail = 0;
+    sharedTail = NULL;
 }
 
 GuCSubmissionQueue::~GuCSubmissionQueue() {
@@ -56,24 +61,38 @@ bool GuCSubmissionQueue::init(uint32_t size) {
     // Zero the queue
     memset(queueBuffer, 0, queueSize);
     
-    // Create lock
-    queueLock = IOLockAlloc();
-    if (!queueLock) {
+    // Round the item count down to a power of two so indices can be masked
+    itemCount = queueSize / GUC_WQ_ITEM_SIZE;
+    while (itemCount & (itemCount - 1)) {
+        itemCount &= itemCount - 1;
+    }
+    if (itemCount == 0) {
+        queueMemory->release();
+        queueMemory = NULL;
+        queueBuffer = NULL;
+        return false;
+    }
+    itemMask = itemCount - 1;
+    
+    producerLock = IOLockAlloc();
+    if (!producerLock) {
         queueMemory->release();
         queueMemory = NULL;
+        queueBuffer = NULL;
         return false;
     }
     
     head = 0;
     tail = 0;
+    reservedTail = 0;
     
     return true;
 }
 
 void GuCSubmissionQueue::cleanup() {
-    if (queueLock) {
-        IOLockFree(queueLock);
-        queueLock = NULL;
+    if (producerLock) {
+        IOLockFree(producerLock);
+        producerLock = NULL;
     }
     
     if (queueMemory) {
@@ -84,64 +103,114 @@ void GuCSubmissionQueue::cleanup() {
     queueBuffer = NULL;
 }
 
-bool GuCSubmissionQueue::enqueueWork(GuCWorkItem* item) {
-    IOLockLock(queueLock);
+bool GuCSubmissionQueue::reserveWork(uint32_t count, uint32_t* start) {
+    if (!queueBuffer || count == 0 || count >= itemCount) {
+        return false;
+    }
+    
+    // Acquire pairs with the consumer's release of head: slots it has
+    // finished reading are safe to overwrite. One slot always stays empty
+    // so the GuC's byte-offset head can tell a full ring from a drained one.
+    uint32_t consumed = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    if ((reservedTail - consumed) + count >= itemCount) {
+        return false;
+    }
+    
+    if (start) {
+        *start = reservedTail;
+    }
+    reservedTail += count;
+    return true;
+}
+
+void GuCSubmissionQueue::publishWork(uint32_t count) {
+    uint32_t newTail = tail + count;
     
-    if (isFull()) {
-        IOLockUnlock(queueLock);
+    // Release: slot contents become visible before the new tail
+    __atomic_store_n(&tail, newTail, __ATOMIC_RELEASE);
+    if (sharedTail) {
+        __atomic_store_n(sharedTail, toByteOffset(newTail), __ATOMIC_RELEASE);
+    }
+}
+
+bool GuCSubmissionQueue::enqueueWork(GuCWorkItem* item) {
+    return enqueueWorkBatch(item, 1);
+}
+
+bool GuCSubmissionQueue::enqueueWorkBatch(const GuCWorkItem* items, uint32_t count) {
+    if (!items || !producerLock) {
         return false;
     }
     
-    // Calculate position
-    uint32_t pos = tail % GUC_MAX_WQ_ITEMS;
-    GuCWorkItem* dest = (GuCWorkItem*)((uint8_t*)queueBuffer + (pos * GUC_WQ_ITEM_SIZE));
+    // Held from reservation to publication so two submitters can never
+    // claim the same slots or publish each other's half-written items
+    IOLockLock(producerLock);
+    
+    uint32_t start;
+    if (!reserveWork(count, &start)) {
+        IOLockUnlock(producerLock);
+        return false;
+    }
     
-    // Copy work item
-    memcpy(dest, item, sizeof(GuCWorkItem));
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(workSlot(start + i), &items[i], sizeof(GuCWorkItem));
+    }
     
-    // Update tail
-    tail++;
+    // Publish all items with a single tail update
+    publishWork(count);
     
-    IOLockUnlock(queueLock);
+    IOLockUnlock(producerLock);
     return true;
 }
 
 bool GuCSubmissionQueue::dequeueWork(GuCWorkItem* item) {
-    IOLockLock(queueLock);
+    uint32_t consumed = head;
     
-    if (isEmpty()) {
-        IOLockUnlock(queueLock);
+    // Acquire pairs with the producer's release of tail
+    if (consumed == __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) {
         return false;
     }
     
-    // Calculate position
-    uint32_t pos = head % GUC_MAX_WQ_ITEMS;
-    GuCWorkItem* src = (GuCWorkItem*)((uint8_t*)queueBuffer + (pos * GUC_WQ_ITEM_SIZE));
-    
-    // Copy work item
     if (item) {
-        memcpy(item, src, sizeof(GuCWorkItem));
+        memcpy(item, workSlot(consumed), sizeof(GuCWorkItem));
     }
     
-    // Update head
-    head++;
-    
-    IOLockUnlock(queueLock);
+    // Release: the slot is read before the producer may reuse it
+    __atomic_store_n(&head, consumed + 1, __ATOMIC_RELEASE);
     return true;
 }
 
 bool GuCSubmissionQueue::isFull() {
-    return (tail - head) >= GUC_MAX_WQ_ITEMS;
+    return (getTail() - getHead()) >= itemCount - 1;
 }
 
 bool GuCSubmissionQueue::isEmpty() {
-    return head == tail;
+    return getHead() == getTail();
 }
 
 void GuCSubmissionQueue::updateHead(uint32_t newHead) {
-    IOLockLock(queueLock);
-    head = newHead;
-    IOLockUnlock(queueLock);
+    __atomic_store_n(&head, newHead, __ATOMIC_RELEASE);
+}
+
+uint32_t GuCSubmissionQueue::advanceHead(uint32_t hwOffset) {
+    if (!itemCount) {
+        return 0;
+    }
+    
+    // The GuC reports a masked byte offset; turn it into a forward step from
+    // the free-running head. Several paths poll this, so only ever move
+    // head forward and never past what was published.
+    uint32_t consumed = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t step = ((hwOffset / GUC_WQ_ITEM_SIZE) - consumed) & itemMask;
+        if (step == 0 || step > getTail() - consumed) {
+            return 0;
+        }
+        if (__atomic_compare_exchange_n(&head, &consumed, consumed + step, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+            return step;
+        }
+    }
 }
 
 uint64_t GuCSubmissionQueue::getPhysicalAddress() {
@@ -162,11 +231,14 @@ GuCContextState::GuCContextState() {
     contextId = 0;
     priority = GUC_CTX_PRIORITY_NORMAL;
     registered = false;
+    readers = 0;
     
     workQueue = NULL;
     memset(&descriptor, 0, sizeof(descriptor));
     memset(&doorbell, 0, sizeof(doorbell));
     doorbellEnabled = false;
+    doorbellPrev = NULL;
+    doorbellNext = NULL;
     
     stageDesc = NULL;
     stageDescMemory = NULL;
@@ -174,6 +246,7 @@ GuCContextState::GuCContextState() {
     submissionsCount = 0;
     completionsCount = 0;
     preemptionsCount = 0;
+    lastSubmitTime = 0;
 }
 
 GuCContextState::~GuCContextState() {
@@ -224,11 +297,13 @@ bool IntelGuCSubmission::init(IntelGuC* gucInstance, AppleIntelTGLController* ct
     controller = ctrl;
     initialized = false;
     
-    // Create context array
-    contexts = OSArray::withCapacity(64);
-    if (!contexts) {
+    // Create context table, indexed by context ID
+    contextTable = (GuCContextState**)IOMalloc(GUC_MAX_STAGE_DESCRIPTORS * sizeof(GuCContextState*));
+    if (!contextTable) {
         return false;
     }
+    bzero(contextTable, GUC_MAX_STAGE_DESCRIPTORS * sizeof(GuCContextState*));
+    contextCount = 0;
     
     // Create locks
     contextsLock = IOLockAlloc();
@@ -237,13 +312,19 @@ bool IntelGuCSubmission::init(IntelGuC* gucInstance, AppleIntelTGLController* ct
     if (!contextsLock || !doorbellLock) {
         if (contextsLock) IOLockFree(contextsLock);
         if (doorbellLock) IOLockFree(doorbellLock);
-        contexts->release();
+        IOFree(contextTable, GUC_MAX_STAGE_DESCRIPTORS * sizeof(GuCContextState*));
+        contextTable = NULL;
         return false;
     }
     
     // Initialize state
     nextContextId = 1;
     memset(doorbellBitmap, 0, sizeof(doorbellBitmap));
+    memset(doorbellOwner, 0, sizeof(doorbellOwner));
+    doorbellHint = 0;
+    doorbellsFree = GUC_NUM_DOORBELLS;
+    doorbellLRUHead = NULL;
+    doorbellLRUTail = NULL;
     
     stageDescriptorPool = NULL;
     stageDescriptorBase = NULL;
@@ -277,9 +358,9 @@ void IntelGuCSubmission::free() {
         doorbellLock = NULL;
     }
     
-    if (contexts) {
-        contexts->release();
-        contexts = NULL;
+    if (contextTable) {
+        IOFree(contextTable, GUC_MAX_STAGE_DESCRIPTORS * sizeof(GuCContextState*));
+        contextTable = NULL;
     }
     
     super::free();
@@ -351,17 +432,32 @@ void IntelGuCSubmission::shutdownSubmission() {
     
     // Unregister all contexts
     IOLockLock(contextsLock);
-    if (contexts) {
-        for (unsigned int i = 0; i < contexts->getCount(); i++) {
-            GuCContextState* state = (GuCContextState*)contexts->getObject(i);
+    if (contextTable) {
+        for (uint32_t i = 0; i < GUC_MAX_STAGE_DESCRIPTORS; i++) {
+            GuCContextState* state = contextTable[i];
             if (state) {
+                contextTable[i] = NULL;
+                if (state->context) {
+                    state->context->setGuCState(NULL);
+                }
+                state->registered = false;
+                drainContextStateLocked(state);
                 delete state;
             }
         }
-        contexts->flushCollection();
+        contextCount = 0;
     }
     IOLockUnlock(contextsLock);
     
+    IOLockLock(doorbellLock);
+    memset(doorbellBitmap, 0, sizeof(doorbellBitmap));
+    memset(doorbellOwner, 0, sizeof(doorbellOwner));
+    doorbellHint = 0;
+    doorbellsFree = GUC_NUM_DOORBELLS;
+    doorbellLRUHead = NULL;
+    doorbellLRUTail = NULL;
+    IOLockUnlock(doorbellLock);
+    
     // Cleanup stage descriptors
     cleanupStageDescriptors();
     
@@ -399,13 +495,19 @@ bool IntelGuCSubmission::registerContext(IntelContext* context, uint32_t priorit
         return false;
     }
     
-    // Assign context ID
-    state->contextId = allocateContextId();
+    // Assign context ID (reserves the table slot)
+    state->contextId = allocateContextId(state);
+    if (state->contextId == 0) {
+        IOLog("IntelGuCSubmission: ERROR - No free context IDs\n");
+        delete state;
+        return false;
+    }
     state->priority = priority;
     
     // Setup context descriptor
     if (!setupContextDescriptor(state)) {
         IOLog("IntelGuCSubmission: ERROR - Failed to setup context descriptor\n");
+        releaseContextId(state->contextId);
         delete state;
         return false;
     }
@@ -413,6 +515,7 @@ bool IntelGuCSubmission::registerContext(IntelContext* context, uint32_t priorit
     // Create work queue
     if (!createWorkQueue(state)) {
         IOLog("IntelGuCSubmission: ERROR - Failed to create work queue\n");
+        releaseContextId(state->contextId);
         delete state;
         return false;
     }
@@ -420,32 +523,38 @@ bool IntelGuCSubmission::registerContext(IntelContext* context, uint32_t priorit
     // Allocate doorbell
     if (!allocateDoorbell(state)) {
         IOLog("IntelGuCSubmission: WARNING - Failed to allocate doorbell\n");
-        // Non-fatal, can use polling
+        // Non-fatal: notifyWork() steals one later or falls back to H2G
     }
     
     // Allocate stage descriptor
     if (!allocateStageDescriptor(state, state->contextId)) {
         IOLog("IntelGuCSubmission: ERROR - Failed to allocate stage descriptor\n");
+        if (state->doorbellEnabled) {
+            releaseDoorbell(state);
+        }
+        releaseContextId(state->contextId);
         delete state;
         return false;
     }
     
-    // Add to context list (store pointer as OSNumber for now)
+    // Publish on the context itself so the submit path needs no table walk
     IOLockLock(contextsLock);
-    OSNumber* ctxNum = OSNumber::withNumber((unsigned long long)state, 64);
-    if (ctxNum) {
-        contexts->setObject(ctxNum);
-        ctxNum->release();
-    }
-    IOLockUnlock(contextsLock);
-    
     state->registered = true;
+    context->setGuCState(state);
+    IOLockUnlock(contextsLock);
     
     // Register with GuC
     if (!guc->registerContext(context)) {
         IOLog("IntelGuCSubmission: WARNING - GuC context registration failed\n");
     }
     
+    // The doorbell was picked before the stage descriptor existed; the GuC
+    // can only be told about it now
+    if (state->doorbellEnabled) {
+        sendContextAction(GUC_ACTION_ALLOCATE_DOORBELL, state->contextId,
+                          state->doorbell.doorbellId);
+    }
+    
     IOLog("IntelGuCSubmission: OK  Context registered (ID=%u, doorbell=%u)\n",
           state->contextId, state->doorbell.doorbellId);
     
@@ -457,45 +566,34 @@ bool IntelGuCSubmission::unregisterContext(IntelContext* context) {
         return false;
     }
     
+    // Unpublish first so new lookups stop resolving this state, then wait
+    // out the ones that already hold it before tearing anything down
     IOLockLock(contextsLock);
-    
-    // Find context state
-    GuCContextState* state = getContextState(context);
+    GuCContextState* state = context->getGuCState();
     if (!state) {
         IOLockUnlock(contextsLock);
         return false;
     }
+    context->setGuCState(NULL);
+    state->registered = false;
+    drainContextStateLocked(state);
+    IOLockUnlock(contextsLock);
     
     IOLog("IntelGuCSubmission: Unregistering context ID=%u...\n", state->contextId);
     
+    // Release doorbell while the GuC still knows the context
+    releaseDoorbell(state);
+    
     // Unregister from GuC
     guc->deregisterContext(context);
     
-    // Release doorbell
-    if (state->doorbellEnabled) {
-        releaseDoorbell(state);
-    }
-    
     // Release stage descriptor
     releaseStageDescriptor(state);
     
     // Destroy work queue
     destroyWorkQueue(state);
     
-    // Remove from list - find by pointer value
-    IOLockLock(contextsLock);
-    for (unsigned int i = 0; i < contexts->getCount(); i++) {
-        OSNumber* num = OSDynamicCast(OSNumber, contexts->getObject(i));
-        if (num && num->unsigned64BitValue() == (unsigned long long)state) {
-            contexts->removeObject(i);
-            break;
-        }
-    }
-    IOLockUnlock(contextsLock);
-    
-    IOLockUnlock(contextsLock);
-    
-    // Release context ID
+    // Release context ID (clears the table slot)
     releaseContextId(state->contextId);
     
     delete state;
@@ -513,7 +611,9 @@ bool IntelGuCSubmission::updateContextPriority(IntelContext* context, uint32_t p
     state->priority = priority;
     state->descriptor.priority = priority;
     
-    return updateContextDescriptor(state);
+    bool result = updateContextDescriptor(state);
+    putContextState(state);
+    return result;
 }
 
 bool IntelGuCSubmission::setupContextDescriptor(GuCContextState* state) {
@@ -579,9 +679,18 @@ bool IntelGuCSubmission::setupContextDescriptor(GuCContextState* state) {
 }
 
 bool IntelGuCSubmission::updateContextDescriptor(GuCContextState* state) {
-    // Would send updated descriptor to GuC
-    // For now, just update local copy
-    return setupContextDescriptor(state);
+    if (!setupContextDescriptor(state)) {
+        return false;
+    }
+    
+    // Scheduling fields go to the stage descriptor the GuC reads; the WQ
+    // head and tail there belong to the queue and are left alone
+    if (state->stageDesc) {
+        state->stageDesc->priority = state->priority;
+        state->stageDesc->attributes = state->descriptor.attributes;
+    }
+    
+    return true;
 }
 
 
@@ -611,6 +720,9 @@ bool IntelGuCSubmission::createWorkQueue(GuCContextState* state) {
         IOLog("IntelGuCSubmission:  Work queue registration with GuC failed - continuing anyway\n");
     }
     
+    // The GuC-visible tail lives in the stage descriptor; allocateStageDescriptor()
+    // hooks it up once that exists
+    
     return true;
 }
 
@@ -627,19 +739,13 @@ bool IntelGuCSubmission::submitWorkItem(GuCContextState* state, GuCWorkItem* ite
         return false;
     }
     
-    // Enqueue work item
+    // Enqueue work item (publishes the descriptor tail)
     if (!state->workQueue->enqueueWork(item)) {
         stats.queueFull++;
         return false;
     }
     
-    // Update descriptor tail
-    state->descriptor.workQueueTail = state->workQueue->getTail();
-    
-    // Ring doorbell if enabled
-    if (state->doorbellEnabled) {
-        ringDoorbell(state);
-    }
+    notifyWork(state);
     
     state->submissionsCount++;
     stats.totalSubmissions++;
@@ -647,45 +753,87 @@ bool IntelGuCSubmission::submitWorkItem(GuCContextState* state, GuCWorkItem* ite
     return true;
 }
 
+bool IntelGuCSubmission::submitWorkItems(GuCContextState* state, const GuCWorkItem* items, uint32_t count) {
+    if (!state || !items || count == 0) {
+        return false;
+    }
+    
+    // One descriptor tail update and one doorbell for the whole run
+    if (!state->workQueue->enqueueWorkBatch(items, count)) {
+        stats.queueFull++;
+        return false;
+    }
+    
+    notifyWork(state);
+    
+    state->submissionsCount += count;
+    stats.totalSubmissions += count;
+    stats.batchSubmissions++;
+    
+    return true;
+}
+
 bool IntelGuCSubmission::processCompletions(GuCContextState* state) {
     if (!state) {
         return false;
     }
     
-    // Read head pointer from hardware (would be updated by GuC)
-    uint32_t hwHead = state->descriptor.workQueueHead;
-    uint32_t swHead = state->workQueue->getHead();
+    // The GuC moves the WQ head in the stage descriptor as it consumes items
+    if (!state->stageDesc) {
+        return false;
+    }
     
-    if (hwHead == swHead) {
+    uint32_t hwHead = __atomic_load_n(&state->stageDesc->workQueueHead, __ATOMIC_ACQUIRE);
+    uint32_t completed = state->workQueue->advanceHead(hwHead);
+    if (completed == 0) {
         return true;  // No completions
     }
     
-    // Update software head
-    state->workQueue->updateHead(hwHead);
-    
-    // Update completion count
-    uint32_t completed = (hwHead - swHead);
     state->completionsCount += completed;
     stats.totalCompletions += completed;
     
     return true;
 }
 
+void IntelGuCSubmission::retireWorkQueue(uint32_t contextId) {
+    GuCContextState* state = getContextStateById(contextId);
+    if (!state) {
+        return;
+    }
+    
+    processCompletions(state);
+    putContextState(state);
+}
+
 
 // MARK: - Doorbell Management
 
 
-bool IntelGuCSubmission::allocateDoorbell(GuCContextState* state) {
+bool IntelGuCSubmission::allocateDoorbell(GuCContextState* state, bool allowSteal) {
     if (!state) {
         return false;
     }
     
+    uint32_t victimId = 0;
     int doorbellId = allocateDoorbellId();
+    if (doorbellId < 0 && allowSteal) {
+        doorbellId = stealDoorbellId(state, &victimId);
+    }
     if (doorbellId < 0) {
-        IOLog("IntelGuCSubmission: ERROR - No available doorbells\n");
         return false;
     }
     
+    // The GuC has to drop the doorbell from the old owner first; the CTB
+    // is ordered, so the allocate below cannot overtake it
+    if (victimId) {
+        sendContextAction(GUC_ACTION_DEALLOCATE_DOORBELL, victimId, doorbellId);
+    }
+    
+    IOLockLock(doorbellLock);
+    doorbellOwner[doorbellId] = (uint16_t)state->contextId;
+    linkDoorbellLRU(state);
+    IOLockUnlock(doorbellLock);
+    
     // Calculate doorbell MMIO offset for Gen12+
     // Doorbell register: 0x140000 + (doorbellId * 4)
     uint32_t doorbellOffset = GUC_DOORBELL_BASE + (doorbellId * 4);
@@ -697,22 +845,43 @@ bool IntelGuCSubmission::allocateDoorbell(GuCContextState* state) {
     state->doorbell.cookie = NULL;
     state->doorbell.physicalAddress = doorbellOffset;  // Store MMIO offset
     
+    OSMemoryBarrier();
     state->doorbellEnabled = true;
     
-    IOLog("IntelGuCSubmission: OK  Doorbell%u allocated for context %u (MMIO offset=0x%x)\n",
-          doorbellId, state->contextId, doorbellOffset);
+    // Contexts still being registered announce theirs from registerContext()
+    if (state->stageDesc) {
+        state->stageDesc->doorbellId = doorbellId;
+        sendContextAction(GUC_ACTION_ALLOCATE_DOORBELL, state->contextId, doorbellId);
+    }
+    
     return true;
 }
 
 void IntelGuCSubmission::releaseDoorbell(GuCContextState* state) {
-    if (!state || !state->doorbellEnabled) {
+    if (!state) {
         return;
     }
     
-    releaseDoorbellId(state->doorbell.doorbellId);
+    // Checked under the lock: the doorbell may have been stolen meanwhile
+    IOLockLock(doorbellLock);
+    bool owned = state->doorbellEnabled &&
+                 state->doorbell.doorbellId < GUC_NUM_DOORBELLS &&
+                 doorbellOwner[state->doorbell.doorbellId] == state->contextId;
+    uint32_t doorbellId = state->doorbell.doorbellId;
+    if (owned) {
+        unlinkDoorbellLRU(state);
+    }
     state->doorbellEnabled = false;
-    
     memset(&state->doorbell, 0, sizeof(state->doorbell));
+    IOLockUnlock(doorbellLock);
+    
+    if (owned) {
+        if (state->stageDesc) {
+            state->stageDesc->doorbellId = GUC_DOORBELL_INVALID;
+            sendContextAction(GUC_ACTION_DEALLOCATE_DOORBELL, state->contextId, doorbellId);
+        }
+        releaseDoorbellId(doorbellId);
+    }
 }
 
 bool IntelGuCSubmission::ringDoorbell(GuCContextState* state) {
@@ -727,18 +896,48 @@ bool IntelGuCSubmission::ringDoorbell(GuCContextState* state) {
     // Pass the context's assigned doorbell ID to GuC
     uint32_t data[2] = {
         doorbellId,
-        state->descriptor.workQueueTail
+        state->workQueue->getTailOffset()
     };
     
     // Notify GuC via doorbell with correct doorbell ID
     guc->ringDoorbell(state->context, doorbellId);
     
-    stats.doorbellRings++;
+    return true;
+}
+
+bool IntelGuCSubmission::notifyWork(GuCContextState* state) {
+    state->lastSubmitTime = mach_absolute_time();
     
-    IOLog("IntelGuCSubmission:  Ringing doorbell%u for context %u (tail=0x%x)\n",
-          doorbellId, state->contextId, state->descriptor.workQueueTail);
+    // Contexts that lost (or never got) a doorbell try to pick one up now,
+    // stealing from an idle context if the pool is exhausted
+    if (!state->doorbellEnabled) {
+        allocateDoorbell(state, true);
+    }
     
-    return true;
+    if (state->doorbellEnabled) {
+        uint32_t doorbellId = state->doorbell.doorbellId;
+        ringDoorbell(state);
+        
+        // A steal racing with this ring means the GuC may have looked at the
+        // new owner's queue instead; only trust (and count) the ring if we
+        // still own it, otherwise the fallback below is what reaches the GuC
+        if (doorbellId < GUC_NUM_DOORBELLS && doorbellOwner[doorbellId] == state->contextId) {
+            stats.doorbellRings++;
+            return true;
+        }
+    }
+    
+    // No doorbell available: ask the GuC to schedule the context directly
+    stats.doorbellFallbacks++;
+    return guc->submitCommand(state->contextId, state->workQueue->getTailOffset());
+}
+
+uint32_t IntelGuCSubmission::getDoorbellHitRate() {
+    uint64_t total = stats.doorbellRings + stats.doorbellFallbacks;
+    if (total == 0) {
+        return 100;
+    }
+    return (uint32_t)((stats.doorbellRings * 100) / total);
 }
 
 bool IntelGuCSubmission::ringDoorbellForContext(IntelContext* context) {
@@ -747,7 +946,12 @@ bool IntelGuCSubmission::ringDoorbellForContext(IntelContext* context) {
         return false;
     }
     
-    return ringDoorbell(state);
+    bool rung = ringDoorbell(state);
+    if (rung) {
+        stats.doorbellRings++;
+    }
+    putContextState(state);
+    return rung;
 }
 
 
@@ -767,17 +971,10 @@ bool IntelGuCSubmission::submitRequest(IntelRequest* request) {
         return false;
     }
     
-    IOLog("IntelGuCSubmission:  submitRequest - context=%p seqno=%u\n", context, request->getSeqno());
-    
     // Get context state
+    // Only registered states are returned
     GuCContextState* state = getContextState(context);
     if (!state) {
-        IOLog("IntelGuCSubmission: ERROR - Context state not found\n");
-        stats.errors++;
-        return false;
-    }
-    
-    if (!state->registered) {
         IOLog("IntelGuCSubmission: ERROR - Context not registered\n");
         stats.errors++;
         return false;
@@ -800,9 +997,6 @@ bool IntelGuCSubmission::submitRequest(IntelRequest* request) {
         
         // Store fence in request
         request->setModernFence(fence);
-        
-        IOLog("IntelGuCSubmission: 🔖 Created fence %u for seqno %u\n",
-              fence->getId(), request->getSeqno());
     }
     
     // Build work item
@@ -812,6 +1006,7 @@ bool IntelGuCSubmission::submitRequest(IntelRequest* request) {
         if (fence) {
             controller->releaseFence(fence->getId());
         }
+        putContextState(state);
         stats.errors++;
         return false;
     }
@@ -821,24 +1016,132 @@ bool IntelGuCSubmission::submitRequest(IntelRequest* request) {
         item.fence = fence->getId();
     }
     
-    IOLog("IntelGuCSubmission: 📨 Queueing work item (fence=%u)...\n", item.fence);
-    
     // Queue work item
     if (!queueWorkItem(state, &item)) {
         IOLog("IntelGuCSubmission: ERROR - Failed to queue work item\n");
         if (fence) {
             controller->releaseFence(fence->getId());
         }
+        putContextState(state);
         stats.errors++;
         return false;
     }
     
-    IOLog("IntelGuCSubmission: OK  Submitted request with fence %u\n",
-          fence ? fence->getId() : 0);
+    putContextState(state);
     
+    if (fence) {
+        armFenceCompletion(fence);
+    }
     return true;
 }
 
+uint32_t IntelGuCSubmission::submitRequests(IntelRequest** requests, uint32_t count) {
+    if (!initialized || !requests || count == 0) {
+        return 0;
+    }
+    
+    uint32_t submitted = 0;
+    
+    while (submitted < count) {
+        uint32_t chunk = count - submitted;
+        if (chunk > GUC_SUBMIT_BATCH_MAX) {
+            chunk = GUC_SUBMIT_BATCH_MAX;
+        }
+        IntelRequest** batch = &requests[submitted];
+        
+        // Validate the chunk up front so fences are not wasted on requests
+        // that cannot be queued
+        GuCContextState* states[GUC_SUBMIT_BATCH_MAX];
+        uint32_t valid = 0;
+        while (valid < chunk) {
+            IntelContext* context = batch[valid]->getContext();
+            GuCContextState* state = context ? getContextState(context) : NULL;
+            if (!state) {
+                IOLog("IntelGuCSubmission: ERROR - Batch request %u has no registered context\n",
+                      submitted + valid);
+                stats.errors++;
+                break;
+            }
+            states[valid] = state;
+            valid++;
+        }
+        
+        if (valid == 0) {
+            return submitted;
+        }
+        
+        // Fences in bulk: one trip through the controller's fence lock
+        IntelFence* fences[GUC_SUBMIT_BATCH_MAX];
+        uint32_t fenceCount = controller->createFences(fences, valid);
+        
+        GuCWorkItem items[GUC_SUBMIT_BATCH_MAX];
+        for (uint32_t i = 0; i < valid; i++) {
+            IntelRequest* request = batch[i];
+            IntelFence* fence = (i < fenceCount) ? fences[i] : NULL;
+            
+            if (fence) {
+                fence->setSeqno(request->getSeqno());
+                IntelRingBuffer* ring = request->getRing();
+                if (ring) {
+                    fence->setEngineId((uint32_t)ring->getEngineId());
+                }
+                request->setModernFence(fence);
+            }
+            
+            // buildWorkItem only fails without a context state, checked above
+            buildWorkItem(request, &items[i]);
+        }
+        
+        // Each run of consecutive requests on the same context is one append
+        uint32_t runStart = 0;
+        while (runStart < valid) {
+            uint32_t runEnd = runStart + 1;
+            while (runEnd < valid && states[runEnd] == states[runStart]) {
+                runEnd++;
+            }
+            
+            if (!submitWorkItems(states[runStart], &items[runStart], runEnd - runStart)) {
+                IOLog("IntelGuCSubmission: ERROR - Work queue full, %u of %u requests submitted\n",
+                      submitted + runStart, count);
+                for (uint32_t i = 0; i < valid; i++) {
+                    IntelFence* fence = batch[i]->getModernFence();
+                    if (!fence) {
+                        continue;
+                    }
+                    if (i < runStart) {
+                        armFenceCompletion(fence);  // Already queued
+                    } else {
+                        batch[i]->setModernFence(NULL);
+                        controller->releaseFence(fence->getId());
+                    }
+                }
+                for (uint32_t i = 0; i < valid; i++) {
+                    putContextState(states[i]);
+                }
+                stats.errors++;
+                return submitted + runStart;
+            }
+            
+            runStart = runEnd;
+        }
+        
+        for (uint32_t i = 0; i < valid; i++) {
+            putContextState(states[i]);
+            
+            IntelFence* fence = batch[i]->getModernFence();
+            if (fence) {
+                armFenceCompletion(fence);
+            }
+        }
+        submitted += valid;
+        if (valid < chunk) {
+            break;
+        }
+    }
+    
+    return submitted;
+}
+
 bool IntelGuCSubmission::submitBatch(IntelContext* context, uint64_t batchAddress, uint32_t batchLength) {
     if (!initialized || !context) {
         return false;
@@ -858,7 +1161,9 @@ bool IntelGuCSubmission::submitBatch(IntelContext* context, uint64_t batchAddres
     item.ringTail = batchLength;  // Simplified
     item.fence = 0;  // Would contain fence ID
     
-    return submitWorkItem(state, &item);
+    bool queued = submitWorkItem(state, &item);
+    putContextState(state);
+    return queued;
 }
 
 bool IntelGuCSubmission::buildWorkItem(IntelRequest* request, GuCWorkItem* item) {
@@ -890,6 +1195,7 @@ bool IntelGuCSubmission::buildWorkItem(IntelRequest* request, GuCWorkItem* item)
     // Fill work item
     item->contextDescriptor = state->contextId;
     item->ringTail = ringTail;
+    putContextState(state);
     
     // Get fence ID from request if available
     IntelFence* fence = request->getModernFence();
@@ -920,7 +1226,9 @@ uint32_t IntelGuCSubmission::getContextPriority(IntelContext* context) {
         return GUC_CTX_PRIORITY_NORMAL;
     }
     
-    return state->priority;
+    uint32_t priority = state->priority;
+    putContextState(state);
+    return priority;
 }
 
 
@@ -967,6 +1275,7 @@ bool IntelGuCSubmission::preemptContext(IntelContext* context) {
     state->preemptionsCount++;
     stats.preemptions++;
     
+    putContextState(state);
     return true;
 }
 
@@ -1101,11 +1410,18 @@ bool IntelGuCSubmission::allocateStageDescriptor(GuCContextState* state, uint32_
     state->stageDesc->doorbellId = state->doorbell.doorbellId;
     state->stageDesc->contextIndex = index;
     
+    // WQ pointers the GuC reads: publishWork() keeps the tail current
+    uint32_t tailOffset = state->workQueue->getTailOffset();
+    state->stageDesc->workQueueHead = tailOffset;
+    state->stageDesc->workQueueTail = tailOffset;
+    state->workQueue->setSharedTail(&state->stageDesc->workQueueTail);
+    
     return true;
 }
 
 void IntelGuCSubmission::releaseStageDescriptor(GuCContextState* state) {
     if (state && state->stageDesc) {
+        state->workQueue->setSharedTail(NULL);
         memset(state->stageDesc, 0, GUC_STAGE_DESC_SIZE);
         state->stageDesc = NULL;
     }
@@ -1116,28 +1432,49 @@ void IntelGuCSubmission::releaseStageDescriptor(GuCContextState* state) {
 
 
 GuCContextState* IntelGuCSubmission::getContextState(IntelContext* context) {
-    if (!context || !contexts) {
+    if (!context || !contextsLock) {
         return NULL;
     }
     
     IOLockLock(contextsLock);
+    GuCContextState* state = context->getGuCState();
+    if (state && state->registered) {
+        state->readers++;
+    } else {
+        state = NULL;
+    }
+    IOLockUnlock(contextsLock);
     
-    for (unsigned int i = 0; i < contexts->getCount(); i++) {
-        //  FIX: We stored contexts as OSNumber pointers, not direct GuCContextState!
-        OSNumber* num = OSDynamicCast(OSNumber, contexts->getObject(i));
-        if (!num) {
-            continue;
-        }
-        
-        GuCContextState* state = (GuCContextState*)num->unsigned64BitValue();
-        if (state && state->context == context) {
-            IOLockUnlock(contextsLock);
-            return state;
-        }
+    return state;
+}
+
+GuCContextState* IntelGuCSubmission::getContextStateById(uint32_t contextId) {
+    if (!contextTable || !contextsLock || contextId == 0 || contextId >= GUC_MAX_STAGE_DESCRIPTORS) {
+        return NULL;
+    }
+    
+    IOLockLock(contextsLock);
+    GuCContextState* state = contextTable[contextId];
+    if (state && state->registered) {
+        state->readers++;
+    } else {
+        state = NULL;
+    }
+    IOLockUnlock(contextsLock);
+    
+    return state;
+}
+
+void IntelGuCSubmission::putContextState(GuCContextState* state) {
+    if (!state) {
+        return;
     }
     
+    IOLockLock(contextsLock);
+    if (--state->readers == 0 && !state->registered) {
+        IOLockWakeup(contextsLock, &state->readers, false);
+    }
     IOLockUnlock(contextsLock);
-    return NULL;
 }
 
 void IntelGuCSubmission::getStatistics(SubmissionStats* outStats) {
@@ -1168,6 +1505,8 @@ void IntelGuCSubmission::dumpContextState(IntelContext* context) {
     IOLog("  Submissions:    %llu\n", state->submissionsCount);
     IOLog("  Completions:    %llu\n", state->completionsCount);
     IOLog("  Preemptions:    %llu\n", state->preemptionsCount);
+    
+    putContextState(state);
 }
 
 void IntelGuCSubmission::dumpWorkQueue(GuCContextState* state) {
@@ -1187,27 +1526,68 @@ void IntelGuCSubmission::dumpWorkQueue(GuCContextState* state) {
 // MARK: - Helper Methods
 
 
-uint32_t IntelGuCSubmission::allocateContextId() {
-    return nextContextId++;
+uint32_t IntelGuCSubmission::allocateContextId(GuCContextState* state) {
+    IOLockLock(contextsLock);
+    
+    // ID 0 is reserved; IDs double as stage descriptor indices
+    for (uint32_t n = 0; n < GUC_MAX_STAGE_DESCRIPTORS - 1; n++) {
+        uint32_t id = nextContextId;
+        nextContextId = (nextContextId + 1 < GUC_MAX_STAGE_DESCRIPTORS) ? nextContextId + 1 : 1;
+        
+        if (!contextTable[id]) {
+            contextTable[id] = state;
+            contextCount++;
+            IOLockUnlock(contextsLock);
+            return id;
+        }
+    }
+    
+    IOLockUnlock(contextsLock);
+    return 0;
+}
+
+// Caller holds contextsLock and has already unpublished the state, so no new
+// reader can find it; sleeps until the existing ones put it back
+void IntelGuCSubmission::drainContextStateLocked(GuCContextState* state) {
+    while (state->readers > 0) {
+        IOLockSleep(contextsLock, &state->readers, THREAD_UNINT);
+    }
 }
 
 void IntelGuCSubmission::releaseContextId(uint32_t contextId) {
-    // Could implement ID recycling here
+    if (contextId == 0 || contextId >= GUC_MAX_STAGE_DESCRIPTORS) {
+        return;
+    }
+    
+    IOLockLock(contextsLock);
+    if (contextTable[contextId]) {
+        contextTable[contextId] = NULL;
+        contextCount--;
+    }
+    IOLockUnlock(contextsLock);
 }
 
 int IntelGuCSubmission::allocateDoorbellId() {
     IOLockLock(doorbellLock);
     
-    // Find free doorbell (1024 doorbells total)
-    for (int i = 0; i < 1024; i++) {
-        int word = i / 32;
-        int bit = i % 32;
+    // Exhausted pool: callers go straight to stealing
+    if (doorbellsFree == 0) {
+        IOLockUnlock(doorbellLock);
+        return -1;
+    }
+    
+    // Word at a time: skip full words, take the lowest clear bit
+    for (uint32_t n = 0; n < GUC_DOORBELL_WORDS; n++) {
+        uint32_t word = (doorbellHint + n) % GUC_DOORBELL_WORDS;
+        uint32_t freeBits = ~doorbellBitmap[word];
         
-        if (!(doorbellBitmap[word] & (1 << bit))) {
-            // Found free doorbell
-            doorbellBitmap[word] |= (1 << bit);
+        if (freeBits) {
+            uint32_t bit = __builtin_ctz(freeBits);
+            doorbellBitmap[word] |= (1U << bit);
+            doorbellsFree--;
+            doorbellHint = word;
             IOLockUnlock(doorbellLock);
-            return i;
+            return (int)(word * 32 + bit);
         }
     }
     
@@ -1215,8 +1595,54 @@ int IntelGuCSubmission::allocateDoorbellId() {
     return -1;  // No free doorbells
 }
 
+int IntelGuCSubmission::stealDoorbellId(GuCContextState* thief, uint32_t* victimId) {
+    IOLockLock(doorbellLock);
+    
+    // Second chance over the LRU: owners with queued work move to the tail,
+    // the first drained one loses its doorbell. The scan is bounded so a
+    // pool full of busy contexts costs every doorbell-less submit O(1).
+    GuCContextState* victim = NULL;
+    for (uint32_t n = 0; n < GUC_DOORBELL_STEAL_SCAN && doorbellLRUHead; n++) {
+        GuCContextState* owner = doorbellLRUHead;
+        
+        // Pick up whatever the GuC consumed since the last G2H; owners stay
+        // alive while linked because releaseDoorbell() unlinks under this lock
+        processCompletions(owner);
+        if (owner != thief && owner->workQueue->isEmpty()) {
+            victim = owner;
+            break;
+        }
+        if (owner == doorbellLRUTail) {
+            break;
+        }
+        unlinkDoorbellLRU(owner);
+        linkDoorbellLRU(owner);
+    }
+    
+    if (!victim) {
+        IOLockUnlock(doorbellLock);
+        return -1;
+    }
+    
+    // The bitmap bit stays set; ownership moves to the caller
+    int doorbellId = (int)victim->doorbell.doorbellId;
+    unlinkDoorbellLRU(victim);
+    victim->doorbellEnabled = false;
+    memset(&victim->doorbell, 0, sizeof(victim->doorbell));
+    victim->doorbell.doorbellId = GUC_DOORBELL_INVALID;
+    if (victim->stageDesc) {
+        victim->stageDesc->doorbellId = GUC_DOORBELL_INVALID;
+    }
+    doorbellOwner[doorbellId] = 0;
+    *victimId = victim->contextId;
+    stats.doorbellSteals++;
+    
+    IOLockUnlock(doorbellLock);
+    return doorbellId;
+}
+
 void IntelGuCSubmission::releaseDoorbellId(int doorbellId) {
-    if (doorbellId < 0 || doorbellId >= 1024) {
+    if (doorbellId < 0 || doorbellId >= GUC_NUM_DOORBELLS) {
         return;
     }
     
@@ -1224,11 +1650,43 @@ void IntelGuCSubmission::releaseDoorbellId(int doorbellId) {
     
     int word = doorbellId / 32;
     int bit = doorbellId % 32;
-    doorbellBitmap[word] &= ~(1 << bit);
+    if (doorbellBitmap[word] & (1U << bit)) {
+        doorbellBitmap[word] &= ~(1U << bit);
+        doorbellsFree++;
+    }
+    doorbellOwner[doorbellId] = 0;
     
     IOLockUnlock(doorbellLock);
 }
 
+void IntelGuCSubmission::linkDoorbellLRU(GuCContextState* state) {
+    // Called with doorbellLock held; appends at the most recent end
+    state->doorbellNext = NULL;
+    state->doorbellPrev = doorbellLRUTail;
+    if (doorbellLRUTail) {
+        doorbellLRUTail->doorbellNext = state;
+    } else {
+        doorbellLRUHead = state;
+    }
+    doorbellLRUTail = state;
+}
+
+void IntelGuCSubmission::unlinkDoorbellLRU(GuCContextState* state) {
+    // Called with doorbellLock held
+    if (state->doorbellPrev) {
+        state->doorbellPrev->doorbellNext = state->doorbellNext;
+    } else {
+        doorbellLRUHead = state->doorbellNext;
+    }
+    if (state->doorbellNext) {
+        state->doorbellNext->doorbellPrev = state->doorbellPrev;
+    } else {
+        doorbellLRUTail = state->doorbellPrev;
+    }
+    state->doorbellPrev = NULL;
+    state->doorbellNext = NULL;
+}
+
 bool IntelGuCSubmission::sendContextAction(uint32_t action, uint32_t contextId, uint32_t data) {
     if (!guc) {
         return false;
@@ -1322,6 +1780,23 @@ void IntelGuCSubmission::signalFence(uint32_t fenceID) {
     // when work completes
 }
 
+void IntelGuCSubmission::armFenceCompletion(IntelFence* fence) {
+    IntelGTInterrupts* gtInterrupts = controller ? controller->getGTInterrupts() : NULL;
+    if (!fence || !gtInterrupts) {
+        return;
+    }
+    
+    // One-shot handler keyed on the fence's seqno; the controller outlives
+    // every handler, so it is the context rather than the fence itself
+    gtInterrupts->registerRenderCompleteHandler(fence->getEngineId(), fence->getSeqno(),
+                                                fenceRenderComplete, controller);
+}
+
+void IntelGuCSubmission::fenceRenderComplete(void* context, uint32_t engine, uint32_t seqno) {
+    AppleIntelTGLController* controller = (AppleIntelTGLController*)context;
+    controller->signalFencesUpTo(engine, seqno);
+}
+
 
 // MARK: - GPU Hang Detection and Recovery
 
@@ -1342,13 +1817,9 @@ bool IntelGuCSubmission::isGPUHung() {
     IOLockLock(contextsLock);
     
     bool hung = false;
-    uint32_t count = contexts->getCount();
     
-    for (uint32_t i = 0; i < count; i++) {
-        OSData* data = OSDynamicCast(OSData, contexts->getObject(i));
-        if (!data) continue;
-        
-        GuCContextState* state = (GuCContextState*)data->getBytesNoCopy();
+    for (uint32_t i = 1; i < GUC_MAX_STAGE_DESCRIPTORS; i++) {
+        GuCContextState* state = contextTable[i];
         if (!state || !state->context) continue;
         
         // Check if context has too many pending submissions
@@ -1408,7 +1879,19 @@ IOReturn IntelGuCSubmission::reinitializeGuC() {
     
     // Clear context state
     IOLockLock(contextsLock);
-    contexts->flushCollection();
+    for (uint32_t i = 0; i < GUC_MAX_STAGE_DESCRIPTORS; i++) {
+        GuCContextState* state = contextTable[i];
+        if (state) {
+            contextTable[i] = NULL;
+            if (state->context) {
+                state->context->setGuCState(NULL);
+            }
+            state->registered = false;
+            drainContextStateLocked(state);
+            delete state;
+        }
+    }
+    contextCount = 0;
     IOLockUnlock(contextsLock);
     
     // TODO: Call into GuC to reload firmware and reset state
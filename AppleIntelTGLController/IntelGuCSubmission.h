@@ -34,6 +34,7 @@ class IntelRequest;
 #define GUC_WQ_SIZE                 (PAGE_SIZE * 2)  // 8KB work queue
 #define GUC_WQ_ITEM_SIZE            64               // 64 bytes per work item
 #define GUC_MAX_WQ_ITEMS            (GUC_WQ_SIZE / GUC_WQ_ITEM_SIZE)
+#define GUC_SUBMIT_BATCH_MAX        16               // Work items built per pass (stack)
 
 // Process descriptor sizes
 #define GUC_PROCESS_DESC_SIZE       (PAGE_SIZE)
@@ -50,6 +51,10 @@ class IntelRequest;
 // Doorbell register layout
 #define GUC_DOORBELL_ENABLED        (1 << 0)
 #define GUC_DOORBELL_HW_ENABLED     (1 << 1)
+#define GUC_NUM_DOORBELLS           1024
+#define GUC_DOORBELL_WORDS          (GUC_NUM_DOORBELLS / 32)
+#define GUC_DOORBELL_STEAL_SCAN     8       // LRU entries a steal looks at before giving up
+#define GUC_DOORBELL_INVALID        0xFFFFFFFF
 
 // Priority levels (0 = lowest, 3 = highest)
 #define GUC_CTX_PRIORITY_LOW        0
@@ -159,28 +164,56 @@ public:
     bool init(uint32_t queueSize);
     void cleanup();
     
+    // Many producers (every client submitting on the context, e.g. the
+    // command queue and the blitter on the default context) serialized by
+    // producerLock; one consumer (GuC) that stays lock-free. Producers own
+    // tail, the consumer owns head, and each publishes with release ordering.
+    
     // Queue operations (renamed to avoid kernel queue.h macro conflicts)
     bool enqueueWork(GuCWorkItem* item);  // renamed from enqueue
+    bool enqueueWorkBatch(const GuCWorkItem* items, uint32_t count);  // all or nothing
     bool dequeueWork(GuCWorkItem* item);  // renamed from dequeue
     bool isFull();
     bool isEmpty();
     
-    // Queue pointers
-    uint32_t getHead() { return head; }
-    uint32_t getTail() { return tail; }
+    // Queue pointers (free-running; masked on access)
+    uint32_t getHead() { return __atomic_load_n(&head, __ATOMIC_ACQUIRE); }
+    uint32_t getTail() { return __atomic_load_n(&tail, __ATOMIC_ACQUIRE); }
+    uint32_t getCapacity() { return itemCount; }
     void updateHead(uint32_t newHead);
+    uint32_t advanceHead(uint32_t hwOffset);  // GuC head byte offset; returns items consumed
+    
+    // Byte offset of an index within the ring, the form the GuC expects
+    uint32_t toByteOffset(uint32_t index) { return (index & itemMask) * GUC_WQ_ITEM_SIZE; }
+    uint32_t getTailOffset() { return toByteOffset(getTail()); }
+    
+    // GuC-visible WQ tail (stage descriptor), set as a byte offset on every
+    // publish. Only changed while no producer can run.
+    void setSharedTail(volatile uint32_t* shared) { sharedTail = shared; }
     
     // Memory access
     void* getQueueBuffer() { return queueBuffer; }
     uint64_t getPhysicalAddress();
     
 private:
+    // Batched reservation: reserve, fill slots in place, then publish.
+    // reserveWork() and publishWork() require producerLock.
+    bool reserveWork(uint32_t count, uint32_t* start);
+    GuCWorkItem* workSlot(uint32_t index) {
+        return (GuCWorkItem*)((uint8_t*)queueBuffer + ((index & itemMask) * GUC_WQ_ITEM_SIZE));
+    }
+    void publishWork(uint32_t count);
+    
     IOBufferMemoryDescriptor* queueMemory;
     void* queueBuffer;
     uint32_t queueSize;
-    uint32_t head;
-    uint32_t tail;
-    IOLock* queueLock;
+    IOLock* producerLock;           // Serializes reserve/fill/publish
+    uint32_t itemCount;             // Power of two
+    uint32_t itemMask;
+    uint32_t head;                  // Consumer index
+    uint32_t tail;                  // Producer index
+    uint32_t reservedTail;          // Producer-private: tail + reserved slots
+    volatile uint32_t* sharedTail;
 };
 
 
@@ -201,6 +234,7 @@ public:
     uint32_t contextId;
     uint32_t priority;
     bool registered;
+    uint32_t readers;               // Lookups holding this state, under contextsLock
     
     // Work queue
     GuCSubmissionQueue* workQueue;
@@ -209,6 +243,8 @@ public:
     // Doorbell
     GuCDoorbellInfo doorbell;
     bool doorbellEnabled;
+    GuCContextState* doorbellPrev;  // Doorbell LRU links, under doorbellLock
+    GuCContextState* doorbellNext;
     
     // Stage descriptor
     GuCStageDescriptor* stageDesc;
@@ -218,6 +254,7 @@ public:
     uint64_t submissionsCount;
     uint64_t completionsCount;
     uint64_t preemptionsCount;
+    uint64_t lastSubmitTime;        // mach_absolute_time
 };
 
 
@@ -258,26 +295,40 @@ public:
     
     // Work queue operations
     bool submitWorkItem(GuCContextState* state, GuCWorkItem* item);
+    bool submitWorkItems(GuCContextState* state, const GuCWorkItem* items, uint32_t count);
     bool processCompletions(GuCContextState* state);
+    void retireWorkQueue(uint32_t contextId);  // G2H: the GuC made progress on this context
     
 
     // Doorbell Management
 
     
-    // Allocate/release doorbells
-    bool allocateDoorbell(GuCContextState* state);
+    // Allocate/release doorbells and tell the GuC. With allowSteal, an
+    // exhausted pool takes the doorbell of an idle context from the LRU.
+    bool allocateDoorbell(GuCContextState* state, bool allowSteal = false);
     void releaseDoorbell(GuCContextState* state);
     
     // Ring doorbell to notify GuC
     bool ringDoorbell(GuCContextState* state);
     bool ringDoorbellForContext(IntelContext* context);
     
+    // Tell the GuC about new work: doorbell if the context holds (or can
+    // get) one, H2G schedule-context action otherwise
+    bool notifyWork(GuCContextState* state);
+    uint32_t getDoorbellHitRate();  // Percent of notifications via doorbell
+    
 
     // Command Submission
 
     
     // Submit GPU commands via GuC
     bool submitRequest(IntelRequest* request);
+    
+    // Burst submission: fences are allocated in one go, and each run of
+    // requests sharing a context becomes one work queue append, one tail
+    // update and one doorbell. Returns how many leading requests were
+    // submitted.
+    uint32_t submitRequests(IntelRequest** requests, uint32_t count);
     bool submitBatch(IntelContext* context, uint64_t batchAddress, uint32_t batchLength);
     
     // Submission helpers
@@ -329,14 +380,20 @@ public:
     // Status and Debug
 
     
-    // Get context state
+    // Get context state; every non-NULL result must be handed back with
+    // putContextState() so unregisterContext() knows when it may free it
     GuCContextState* getContextState(IntelContext* context);
+    GuCContextState* getContextStateById(uint32_t contextId);  // For GuC-originated IDs
+    void putContextState(GuCContextState* state);
     
     // Statistics
     struct SubmissionStats {
         uint64_t totalSubmissions;
         uint64_t totalCompletions;
         uint64_t doorbellRings;
+        uint64_t doorbellFallbacks;     // Notifications sent as H2G schedule actions
+        uint64_t doorbellSteals;        // Doorbells taken from idle contexts
+        uint64_t batchSubmissions;      // submitRequests() runs (one doorbell each)
         uint64_t preemptions;
         uint64_t queueFull;
         uint64_t errors;
@@ -365,6 +422,10 @@ public:
     // Signal a fence (for testing/manual completion)
     void signalFence(uint32_t fenceID);
     
+    // Signal a submitted fence from the render-complete interrupt once the
+    // engine passes its seqno, whether or not a G2H completion follows
+    void armFenceCompletion(IntelFence* fence);
+    
 
     // GPU Hang Detection and Recovery
 
@@ -379,18 +440,26 @@ public:
     IOReturn reinitializeGuC();
     
 private:
+    static void fenceRenderComplete(void* context, uint32_t engine, uint32_t seqno);
+    
     // Core components
     IntelGuC* guc;
     AppleIntelTGLController* controller;
     bool initialized;
     
     // Context tracking
-    OSArray* contexts;              // Array of GuCContextState
-    IOLock* contextsLock;
+    GuCContextState** contextTable; // Indexed by context ID (== stage descriptor index)
+    uint32_t contextCount;
+    IOLock* contextsLock;           // Serializes table updates and lookups
     uint32_t nextContextId;
     
     // Doorbell management
-    uint32_t doorbellBitmap[32];    // 1024 doorbells (32 * 32 bits)
+    uint32_t doorbellBitmap[GUC_DOORBELL_WORDS];    // 1024 doorbells (32 * 32 bits)
+    uint16_t doorbellOwner[GUC_NUM_DOORBELLS];      // Context ID per doorbell, 0 = free
+    uint32_t doorbellHint;          // Bitmap word to start the next search at
+    uint32_t doorbellsFree;         // Clear bits in doorbellBitmap
+    GuCContextState* doorbellLRUHead;   // Doorbell holders, steal candidates first
+    GuCContextState* doorbellLRUTail;
     IOLock* doorbellLock;
     
     // Stage descriptors
@@ -414,11 +483,15 @@ private:
     SubmissionStats stats;
     
     // Helper methods
-    uint32_t allocateContextId();
+    uint32_t allocateContextId(GuCContextState* state);
     void releaseContextId(uint32_t contextId);
+    void drainContextStateLocked(GuCContextState* state);
     
     int allocateDoorbellId();
+    int stealDoorbellId(GuCContextState* thief, uint32_t* victimId);
     void releaseDoorbellId(int doorbellId);
+    void linkDoorbellLRU(GuCContextState* state);
+    void unlinkDoorbellLRU(GuCContextState* state);
     
     bool sendContextAction(uint32_t action, uint32_t contextId, uint32_t data);
 };
@@ -9,6 +9,9 @@
 #include "IntelMemoryOptimizer.h"
 #include "AppleIntelTGLController.h"
 #include "IntelGEMObject.h"
+#include "IntelGTT.h"
+#include "IntelRingBuffer.h"
+#include "IntelBlitter.h"
 #include <IOKit/IOLib.h>
 
 #define super OSObject
@@ -23,6 +26,7 @@ bool IntelMemoryOptimizer::init() {
     controller = nullptr;
     lock = nullptr;
     cleanupTimer = nullptr;
+    defragTimer = nullptr;
     currentStrategy = OPTIMIZE_BALANCED;
     compressionEnabled = true;
     tilingEnabled = true;
@@ -99,6 +103,17 @@ bool IntelMemoryOptimizer::start() {
         cleanupTimer->setTimeoutMS(POOL_CLEANUP_INTERVAL_MS);
     }
     
+    // Defragmentation slices run on the work loop; armed on demand
+    defragTimer = IOTimerEventSource::timerEventSource(
+        this,
+        OSMemberFunctionCast(IOTimerEventSource::Action,
+                           this,
+                           &IntelMemoryOptimizer::defragTimerFired));
+    
+    if (defragTimer) {
+        controller->getWorkLoop()->addEventSource(defragTimer);
+    }
+    
     // Initialize statistics
     statStartTime = mach_absolute_time();
     memset(&stats, 0, sizeof(stats));
@@ -123,6 +138,13 @@ void IntelMemoryOptimizer::stop() {
         cleanupTimer = nullptr;
     }
     
+    if (defragTimer) {
+        defragTimer->cancelTimeout();
+        controller->getWorkLoop()->removeEventSource(defragTimer);
+        defragTimer->release();
+        defragTimer = nullptr;
+    }
+    
     // Flush all pools
     for (uint32_t i = 0; i < numPools; i++) {
         if (pools[i]) {
@@ -660,20 +682,94 @@ MemoryOptError IntelMemoryOptimizer::optimizeBuffer(
     return result;
 }
 
+bool IntelMemoryOptimizer::defragNeeded() {
+    IntelGTT* gtt = controller ? controller->getGTT() : nullptr;
+    if (!gtt) {
+        return false;
+    }
+    
+    struct gtt_frag_info info;
+    gtt->getFragmentation(&info);
+    
+    stats.ggttFragmentation = info.fragmentationPct;
+    stats.ggttLargestFree = (uint64_t)info.largestFreeExtent * 4096;
+    
+    // Only a request that failed even after eviction justifies moving
+    // bindings, and only if compaction could actually make room for it
+    size_t pending = gtt->getPendingRequestPages();
+    return pending && pending > info.largestFreeExtent && pending <= info.freePages;
+}
+
+bool IntelMemoryOptimizer::enginesIdle() {
+    IntelRingBuffer* ring = controller->getRenderRing();
+    if (ring && !ring->isIdle()) {
+        return false;
+    }
+    
+    IntelBlitter* blitter = controller->getBlitter();
+    if (blitter && !blitter->isIdle()) {
+        return false;
+    }
+    
+    return true;
+}
+
 MemoryOptError IntelMemoryOptimizer::defragment() {
     IORecursiveLockLock(lock);
     
-    // Defragmentation would:
-    // 1. Identify fragmented regions
-    // 2. Move buffers to consolidate free space
-    // 3. Update GTT mappings
-    // (Simplified for framework)
+    IntelGTT* gtt = controller ? controller->getGTT() : nullptr;
+    if (!gtt) {
+        IORecursiveLockUnlock(lock);
+        return MEMORY_OPT_ERROR_NOT_SUPPORTED;
+    }
+    
+    if (!defragNeeded()) {
+        IORecursiveLockUnlock(lock);
+        return MEMORY_OPT_SUCCESS;
+    }
+    
+    // Only move bindings while every engine is idle; try again next slice
+    if (!enginesIdle()) {
+        stats.defragSkippedBusy++;
+        if (defragTimer) {
+            defragTimer->setTimeoutMS(DEFRAG_SLICE_INTERVAL_MS);
+        }
+        IORecursiveLockUnlock(lock);
+        return MEMORY_OPT_SUCCESS;
+    }
+    
+    // One time-bounded slice
+    uint64_t budget;
+    nanoseconds_to_absolutetime((uint64_t)DEFRAG_SLICE_US * 1000, &budget);
+    uint32_t moves = gtt->compactSlice(mach_absolute_time() + budget,
+                                       DEFRAG_MAX_MOVES_PER_SLICE);
+    
+    stats.defragSlices++;
+    stats.defragMoves += moves;
+    
+    // Keep slicing while progress is being made and work remains
+    if (moves > 0 && defragNeeded() && defragTimer) {
+        defragTimer->setTimeoutMS(DEFRAG_SLICE_INTERVAL_MS);
+    }
     
     IORecursiveLockUnlock(lock);
     
+    if (moves > 0) {
+        IOLog("IntelMemoryOptimizer: Defrag slice moved %u bindings "
+              "(fragmentation %u%%, largest free %llu KB)\n",
+              moves, stats.ggttFragmentation, stats.ggttLargestFree / 1024);
+    }
+    
     return MEMORY_OPT_SUCCESS;
 }
 
+void IntelMemoryOptimizer::defragTimerFired(
+    OSObject* owner,
+    IOTimerEventSource* timer)
+{
+    defragment();
+}
+
 // Buffer usage hints
 MemoryOptError IntelMemoryOptimizer::setBufferUsage(
     IntelGEMObject* object,
@@ -760,6 +856,12 @@ void IntelMemoryOptimizer::printStatistics() {
     IOLog("  Avg free time:       %u us\n", s.avgFreeTimeUs);
     IOLog("  Total allocations:   %llu\n", s.totalAllocations);
     IOLog("  Total frees:         %llu\n", s.totalFrees);
+    IOLog("GGTT Defrag:\n");
+    IOLog("  Slices:              %llu (deferred busy: %llu)\n",
+          s.defragSlices, s.defragSkippedBusy);
+    IOLog("  Bindings moved:      %llu\n", s.defragMoves);
+    IOLog("  Fragmentation:       %u%% (largest free %llu KB)\n",
+          s.ggttFragmentation, s.ggttLargestFree / 1024);
 }
 
 // Hardware capabilities
@@ -1009,6 +1111,9 @@ void IntelMemoryOptimizer::cleanupPoolsTimerFired(
         }
     }
     
+    // Periodic fragmentation check; defragment() arms its own slices
+    defragment();
+    
     // Reschedule timer
     if (timer) {
         timer->setTimeoutMS(POOL_CLEANUP_INTERVAL_MS);
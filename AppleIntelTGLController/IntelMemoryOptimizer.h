@@ -132,6 +132,13 @@ struct MemoryOptimizationStats {
     uint32_t avgFreeTimeUs;       // Avg free time
     uint64_t totalAllocations;    // Total allocations
     uint64_t totalFrees;          // Total frees
+    
+    // GGTT defragmentation
+    uint64_t defragSlices;        // Compaction slices run
+    uint64_t defragMoves;         // Bindings relocated
+    uint64_t defragSkippedBusy;   // Slices deferred because the GPU was busy
+    uint32_t ggttFragmentation;   // Last measured fragmentation (%)
+    uint64_t ggttLargestFree;     // Last measured largest free extent (bytes)
 };
 
 // Memory optimization error codes
@@ -171,6 +178,11 @@ typedef enum {
 #define COMPRESSION_THRESHOLD     (4 * 1024 * 1024)  // 4MB
 #define POOL_CLEANUP_INTERVAL_MS  5000               // 5 seconds
 
+// GGTT defragmentation (only for allocations that failed after eviction)
+#define DEFRAG_SLICE_US           2000               // Time budget per slice
+#define DEFRAG_MAX_MOVES_PER_SLICE 16
+#define DEFRAG_SLICE_INTERVAL_MS  20                 // Gap between slices
+
 class IntelMemoryOptimizer : public OSObject {
     OSDeclareDefaultStructors(IntelMemoryOptimizer)
     
@@ -258,6 +270,7 @@ private:
     AppleIntelTGLController* controller;
     IORecursiveLock* lock;
     IOTimerEventSource* cleanupTimer;
+    IOTimerEventSource* defragTimer;
     
     // Optimization state
     IntelOptimizationStrategy currentStrategy;
@@ -312,6 +325,11 @@ private:
     // Pool helpers
     MemoryPool* findPoolForSize(uint64_t size);
     void cleanupPoolsTimerFired(OSObject* owner, IOTimerEventSource* timer);
+    
+    // Defragmentation helpers
+    bool defragNeeded();
+    bool enginesIdle();
+    void defragTimerFired(OSObject* owner, IOTimerEventSource* timer);
     bool canReuseBuffer(IntelGEMObject* object,
                        uint64_t requestedSize,
                        IntelBufferUsage usage);
@@ -20,12 +20,14 @@ IntelPPGTT::IntelPPGTT()
     , baseAddress(0)
     , totalSize(PPGTT_ADDRESS_SPACE_SIZE)
     , pageSize(PPGTT_PAGE_SIZE)
-    , allocationBitmap(NULL)
-    , bitmapSize(0)
     , allocationLock(NULL)
     , statsLock(NULL)
+    , tableLock(NULL)
+    , poolChunks(NULL)
+    , poolFreeList(NULL)
 {
     bzero(&stats, sizeof(stats));
+    bzero(&root, sizeof(root));
 }
 
 IntelPPGTT::~IntelPPGTT()
@@ -54,7 +56,8 @@ bool IntelPPGTT::init(AppleIntelTGLController *ctrl)
     // Create locks
     allocationLock = IOLockAlloc();
     statsLock = IOLockAlloc();
-    if (!allocationLock || !statsLock) {
+    tableLock = IOLockAlloc();
+    if (!allocationLock || !statsLock || !tableLock) {
         IOLog("IntelPPGTT: Failed to allocate locks\n");
         return false;
     }
@@ -71,17 +74,17 @@ bool IntelPPGTT::init(AppleIntelTGLController *ctrl)
         return false;
     }
     
-    // Setup allocation bitmap
+    // Setup allocation bitmap and its summary level
     size_t numPages = totalSize / pageSize;
-    bitmapSize = (numPages + 7) / 8;
-    
-    allocationBitmap = (u8 *)IOMalloc(bitmapSize);
-    if (!allocationBitmap) {
+    if (!pageBitmap.init(numPages)) {
         IOLog("IntelPPGTT: Failed to allocate bitmap\n");
         return false;
     }
     
-    bzero(allocationBitmap, bitmapSize);
+    // Keep VA 0 unmapped so a zero address always means "not bound"
+    IOLockLock(allocationLock);
+    pageBitmap.markUsed(0, 1);
+    IOLockUnlock(allocationLock);
     
     // Initialize statistics
     IOLockLock(statsLock);
@@ -102,11 +105,27 @@ void IntelPPGTT::cleanup()
     IOLog("IntelPPGTT: Cleaning up\n");
     
     // Free allocation bitmap
-    if (allocationBitmap) {
-        IOFree(allocationBitmap, bitmapSize);
-        allocationBitmap = NULL;
+    pageBitmap.free();
+    
+    // Free every PDP/PD/PT below the root, then the pool backing them
+    if (root.children) {
+        IOLockLock(tableLock);
+        destroyTables(&root, PPGTT_LEVEL_PML4);
+        IOLockUnlock(tableLock);
+        
+        IOFree(root.children, PPGTT_ENTRIES_PER_TABLE * sizeof(struct ppgtt_table *));
+        bzero(&root, sizeof(root));
     }
     
+    while (poolChunks) {
+        struct ppgtt_pool_chunk *chunk = poolChunks;
+        poolChunks = chunk->next;
+        chunk->mem->complete();
+        chunk->mem->release();
+        IOFree(chunk, sizeof(*chunk));
+    }
+    poolFreeList = NULL;
+    
     // Release page table root
     if (pml4Obj) {
         if (pml4Virtual) {
@@ -114,16 +133,12 @@ void IntelPPGTT::cleanup()
             pml4Virtual = NULL;
         }
         
-        if (globalGtt && pml4Address) {
-            globalGtt->unbindObject(pml4Obj);
-            globalGtt->freeSpace(pml4Address, pml4Obj->getSize());
-        }
-        
         IntelGEM *gem = controller->getGEM();
         if (gem) {
-            gem->destroyObject(pml4Obj);
+            gem->destroyBoundObject(pml4Obj);
         }
         pml4Obj = NULL;
+        pml4Address = 0;
     }
     
     // Free locks
@@ -137,6 +152,11 @@ void IntelPPGTT::cleanup()
         statsLock = NULL;
     }
     
+    if (tableLock) {
+        IOLockFree(tableLock);
+        tableLock = NULL;
+    }
+    
     printStats();
     IOLog("IntelPPGTT: Cleanup complete\n");
 }
@@ -155,26 +175,12 @@ bool IntelPPGTT::allocatePageTables()
     }
     
     // Allocate PML4 (4KB for Gen12)
-    pml4Obj = gem->createObject(4096, 0);
+    pml4Obj = gem->createBoundObject(4096, 0);
     if (!pml4Obj) {
         IOLog("IntelPPGTT: Failed to create PML4 object\n");
         return false;
     }
-    
-    // Allocate GTT space for PML4
-    pml4Address = globalGtt->allocateSpace(4096, 4096);
-    if (pml4Address == 0) {
-        IOLog("IntelPPGTT: Failed to allocate GTT space for PML4\n");
-        return false;
-    }
-    
-    pml4Obj->setGTTAddress(pml4Address);
-    
-    // Bind to global GTT
-    if (!globalGtt->bindObject(pml4Obj, 0)) {
-        IOLog("IntelPPGTT: Failed to bind PML4 object\n");
-        return false;
-    }
+    pml4Address = pml4Obj->getGTTAddress();
     
     // Map for CPU access
     if (!pml4Obj->mapCPU(&pml4Virtual)) {
@@ -199,38 +205,502 @@ bool IntelPPGTT::initializeRoot()
     // Clear PML4
     bzero(pml4Virtual, 4096);
     
-    // For a full implementation, we would:
-    // 1. Allocate PDP (Page Directory Pointer) tables
-    // 2. Setup PML4 entries pointing to PDPs
-    // 3. Allocate PD (Page Directory) tables on demand
-    // 4. Allocate PT (Page Table) tables on demand
-    //
-    // For now, we just have an empty root that we'll populate on demand
+    // PDP/PD/PT levels are allocated on demand by insertRange()
+    root.vaddr = (u64 *)pml4Virtual;
+    root.phys = pml4Obj->getMemoryDescriptor()->getPhysicalSegment(0, NULL);
+    root.used = 0;
+    root.children = (struct ppgtt_table **)IOMalloc(
+        PPGTT_ENTRIES_PER_TABLE * sizeof(struct ppgtt_table *));
+    
+    if (!root.children || root.phys == 0) {
+        IOLog("IntelPPGTT: Failed to set up root table\n");
+        return false;
+    }
+    
+    bzero(root.children, PPGTT_ENTRIES_PER_TABLE * sizeof(struct ppgtt_table *));
+    
+    IOLog("IntelPPGTT: PML4 physical 0x%llx\n", root.phys);
+    
+    return true;
+}
+
+
+ * Page-Table Page Pool
+
+bool IntelPPGTT::allocTablePage(u64 **vaddr, u64 *phys)
+{
+    if (!poolFreeList) {
+        // Grow the pool by one physically contiguous chunk
+        IOBufferMemoryDescriptor *mem = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(
+            kernel_task,
+            kIODirectionInOut | kIOMemoryPhysicallyContiguous,
+            PPGTT_POOL_CHUNK_PAGES * PPGTT_PAGE_SIZE,
+            GEN12_PPGTT_ADDR_MASK);
+        
+        if (!mem) {
+            IOLog("IntelPPGTT: Failed to grow page-table pool\n");
+            return false;
+        }
+        
+        if (mem->prepare() != kIOReturnSuccess) {
+            mem->release();
+            return false;
+        }
+        
+        struct ppgtt_pool_chunk *chunk =
+            (struct ppgtt_pool_chunk *)IOMalloc(sizeof(struct ppgtt_pool_chunk));
+        if (!chunk) {
+            mem->complete();
+            mem->release();
+            return false;
+        }
+        
+        chunk->mem = mem;
+        chunk->next = poolChunks;
+        poolChunks = chunk;
+        
+        u8 *base = (u8 *)mem->getBytesNoCopy();
+        u64 basePhys = mem->getPhysicalSegment(0, NULL);
+        
+        for (int i = PPGTT_POOL_CHUNK_PAGES - 1; i >= 0; i--) {
+            u64 *page = (u64 *)(base + i * PPGTT_PAGE_SIZE);
+            page[0] = (u64)(uintptr_t)poolFreeList;
+            page[1] = basePhys + i * PPGTT_PAGE_SIZE;
+            poolFreeList = page;
+        }
+        
+        IOLockLock(statsLock);
+        stats.pool_pages += PPGTT_POOL_CHUNK_PAGES;
+        IOLockUnlock(statsLock);
+    }
+    
+    u64 *page = poolFreeList;
+    poolFreeList = (u64 *)(uintptr_t)page[0];
+    *phys = page[1];
+    *vaddr = page;
+    bzero(page, PPGTT_PAGE_SIZE);
+    
+    return true;
+}
+
+void IntelPPGTT::freeTablePage(u64 *vaddr, u64 phys)
+{
+    vaddr[0] = (u64)(uintptr_t)poolFreeList;
+    vaddr[1] = phys;
+    poolFreeList = vaddr;
+}
+
+
+ * Page-Table Walker (tableLock held)
+
+u64 IntelPPGTT::makePTE(u64 physAddr, u32 flags)
+{
+    u64 pte = (physAddr & GEN12_PPGTT_ADDR_MASK) | GEN12_PPGTT_PRESENT;
+    
+    if (flags & GTT_PAGE_WRITEABLE)
+        pte |= GEN12_PPGTT_RW;
+    
+    return pte;
+}
+
+struct ppgtt_table *IntelPPGTT::allocTable(int level)
+{
+    struct ppgtt_table *table =
+        (struct ppgtt_table *)IOMalloc(sizeof(struct ppgtt_table));
+    if (!table) {
+        return NULL;
+    }
+    
+    bzero(table, sizeof(*table));
+    
+    if (!allocTablePage(&table->vaddr, &table->phys)) {
+        IOFree(table, sizeof(*table));
+        return NULL;
+    }
+    
+    if (level > PPGTT_LEVEL_PT) {
+        table->children = (struct ppgtt_table **)IOMalloc(
+            PPGTT_ENTRIES_PER_TABLE * sizeof(struct ppgtt_table *));
+        if (!table->children) {
+            freeTablePage(table->vaddr, table->phys);
+            IOFree(table, sizeof(*table));
+            return NULL;
+        }
+        bzero(table->children, PPGTT_ENTRIES_PER_TABLE * sizeof(struct ppgtt_table *));
+    }
+    
+    IOLockLock(statsLock);
+    stats.table_count++;
+    IOLockUnlock(statsLock);
+    
+    return table;
+}
+
+void IntelPPGTT::freeTable(struct ppgtt_table *table, int level)
+{
+    if (table->children) {
+        IOFree(table->children, PPGTT_ENTRIES_PER_TABLE * sizeof(struct ppgtt_table *));
+    }
+    
+    freeTablePage(table->vaddr, table->phys);
+    IOFree(table, sizeof(*table));
+    
+    IOLockLock(statsLock);
+    stats.table_count--;
+    IOLockUnlock(statsLock);
+}
+
+void IntelPPGTT::accountMapped(u32 pageSizeKind, s64 bytes)
+{
+    IOLockLock(statsLock);
+    switch (pageSizeKind) {
+        case PPGTT_MAPPED_2M:  stats.mapped_2m_bytes  += bytes; break;
+        case PPGTT_MAPPED_64K: stats.mapped_64k_bytes += bytes; break;
+        default:               stats.mapped_4k_bytes  += bytes; break;
+    }
+    IOLockUnlock(statsLock);
+}
+
+bool IntelPPGTT::tableIs64KCompatible(struct ppgtt_table *pt)
+{
+    // IPS makes the GPU read only every 16th PTE, so each 64KB group must
+    // be either entirely absent or 16 contiguous pages starting 64KB-aligned.
+    if (pt->used == 0) {
+        return false;
+    }
+    
+    for (u32 g = 0; g < PPGTT_ENTRIES_PER_TABLE; g += PPGTT_64K_PTES) {
+        u64 *pte = &pt->vaddr[g];
+        
+        if (!(pte[0] & GEN12_PPGTT_PRESENT)) {
+            for (u32 k = 1; k < PPGTT_64K_PTES; k++) {
+                if (pte[k] & GEN12_PPGTT_PRESENT) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        
+        if ((pte[0] & GEN12_PPGTT_ADDR_MASK) & (PPGTT_PAGE_SIZE_64K - 1)) {
+            return false;
+        }
+        
+        for (u32 k = 1; k < PPGTT_64K_PTES; k++) {
+            if (pte[k] != pte[0] + (u64)k * PPGTT_PAGE_SIZE) {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+void IntelPPGTT::update64KMode(struct ppgtt_table *pd, u32 idx)
+{
+    struct ppgtt_table *pt = pd->children[idx];
+    bool want = tableIs64KCompatible(pt);
+    bool have = (pt->flags & PPGTT_TABLE_64K) != 0;
+    
+    if (want == have) {
+        return;
+    }
+    
+    // 4KB PTEs stay fully written, so dropping IPS is always safe
+    s64 bytes = (s64)pt->used * PPGTT_PAGE_SIZE;
+    
+    if (want) {
+        pt->flags |= PPGTT_TABLE_64K;
+        pd->vaddr[idx] |= GEN8_PDE_IPS_64K;
+        accountMapped(PPGTT_MAPPED_4K, -bytes);
+        accountMapped(PPGTT_MAPPED_64K, bytes);
+    } else {
+        pt->flags &= ~PPGTT_TABLE_64K;
+        pd->vaddr[idx] &= ~GEN8_PDE_IPS_64K;
+        accountMapped(PPGTT_MAPPED_64K, -bytes);
+        accountMapped(PPGTT_MAPPED_4K, bytes);
+    }
+}
+
+struct ppgtt_table *IntelPPGTT::splitHugeEntry(struct ppgtt_table *pd, u32 idx)
+{
+    // Replace a 2MB leaf with a PT holding the same 512 pages
+    u64 entry = pd->vaddr[idx];
+    struct ppgtt_table *pt = allocTable(PPGTT_LEVEL_PT);
+    if (!pt) {
+        return NULL;
+    }
+    
+    u64 base = entry & GEN12_PPGTT_ADDR_MASK;
+    u64 flags = entry & (GEN12_PPGTT_PRESENT | GEN12_PPGTT_RW);
+    
+    for (u32 i = 0; i < PPGTT_ENTRIES_PER_TABLE; i++) {
+        pt->vaddr[i] = (base + (u64)i * PPGTT_PAGE_SIZE) | flags;
+    }
+    pt->used = PPGTT_ENTRIES_PER_TABLE;
+    
+    pd->children[idx] = pt;
+    pd->vaddr[idx] = (pt->phys & GEN12_PPGTT_ADDR_MASK) |
+                     GEN12_PPGTT_PRESENT | GEN12_PPGTT_RW;
+    
+    accountMapped(PPGTT_MAPPED_2M, -(s64)PPGTT_PAGE_SIZE_2M);
+    accountMapped(PPGTT_MAPPED_4K, PPGTT_PAGE_SIZE_2M);
+    
+    return pt;
+}
+
+bool IntelPPGTT::insertRange(struct ppgtt_table *table, int level,
+                             u64 start, u64 end, u64 phys, u64 pteFlags)
+{
+    if (level == PPGTT_LEVEL_PT) {
+        // [start, end) lies inside this leaf: write the run in one pass
+        u32 first = PPGTT_LEVEL_INDEX(start, PPGTT_LEVEL_PT);
+        u32 count = (u32)((end - start) / PPGTT_PAGE_SIZE);
+        u32 added = 0;
+        u64 *pte = &table->vaddr[first];
+        
+        for (u32 i = 0; i < count; i++) {
+            if (!(pte[i] & GEN12_PPGTT_PRESENT)) {
+                added++;
+            }
+            pte[i] = ((phys + (u64)i * PPGTT_PAGE_SIZE) & GEN12_PPGTT_ADDR_MASK) | pteFlags;
+        }
+        
+        table->used += added;
+        accountMapped((table->flags & PPGTT_TABLE_64K) ? PPGTT_MAPPED_64K : PPGTT_MAPPED_4K,
+                      (s64)added * PPGTT_PAGE_SIZE);
+        return true;
+    }
+    
+    u64 span = 1ULL << PPGTT_LEVEL_SHIFT(level);
+    
+    for (u64 addr = start; addr < end; ) {
+        u64 next = (addr & ~(span - 1)) + span;
+        if (next > end) {
+            next = end;
+        }
+        
+        u64 runPhys = phys + (addr - start);
+        u32 idx = PPGTT_LEVEL_INDEX(addr, level);
+        struct ppgtt_table *child = table->children[idx];
+        u64 entry = table->vaddr[idx];
+        
+        // A whole, physically contiguous 2MB window becomes a PD leaf
+        if (level == PPGTT_LEVEL_PD && next - addr == span &&
+            !(addr & (span - 1)) && !(runPhys & (span - 1)) &&
+            (!child || child->used == 0)) {
+            if (child) {
+                table->children[idx] = NULL;
+                freeTable(child, PPGTT_LEVEL_PT);
+            } else if (entry & GEN8_PDE_PS_2M) {
+                accountMapped(PPGTT_MAPPED_2M, -(s64)span);
+            } else {
+                table->used++;
+            }
+            
+            table->vaddr[idx] = (runPhys & GEN12_PPGTT_ADDR_MASK) | GEN8_PDE_PS_2M | pteFlags;
+            accountMapped(PPGTT_MAPPED_2M, span);
+            
+            addr = next;
+            continue;
+        }
+        
+        if (!child) {
+            if (level == PPGTT_LEVEL_PD && (entry & GEN8_PDE_PS_2M)) {
+                child = splitHugeEntry(table, idx);
+            } else {
+                child = allocTable(level - 1);
+                if (child) {
+                    table->children[idx] = child;
+                    table->vaddr[idx] = (child->phys & GEN12_PPGTT_ADDR_MASK) |
+                                        GEN12_PPGTT_PRESENT | GEN12_PPGTT_RW;
+                    table->used++;
+                }
+            }
+            
+            if (!child) {
+                IOLog("IntelPPGTT: Out of page-table pages at level %d\n", level - 1);
+                return false;
+            }
+        }
+        
+        if (!insertRange(child, level - 1, addr, next, runPhys, pteFlags)) {
+            return false;
+        }
+        
+        if (level == PPGTT_LEVEL_PD) {
+            update64KMode(table, idx);
+        }
+        
+        addr = next;
+    }
+    
+    return true;
+}
+
+bool IntelPPGTT::splitHugeAt(u64 address)
+{
+    // Walk to the PD covering address; only a 2MB leaf needs work
+    struct ppgtt_table *table = &root;
+    
+    for (int level = PPGTT_LEVEL_PML4; level > PPGTT_LEVEL_PD; level--) {
+        if (!table->children) {
+            return true;
+        }
+        table = table->children[PPGTT_LEVEL_INDEX(address, level)];
+        if (!table) {
+            return true;
+        }
+    }
+    
+    u32 idx = PPGTT_LEVEL_INDEX(address, PPGTT_LEVEL_PD);
+    if (table->children[idx] || !(table->vaddr[idx] & GEN8_PDE_PS_2M)) {
+        return true;
+    }
+    
+    return splitHugeEntry(table, idx) != NULL;
+}
+
+bool IntelPPGTT::clearRange(struct ppgtt_table *table, int level, u64 start, u64 end)
+{
+    if (level == PPGTT_LEVEL_PT) {
+        u32 first = PPGTT_LEVEL_INDEX(start, PPGTT_LEVEL_PT);
+        u32 count = (u32)((end - start) / PPGTT_PAGE_SIZE);
+        u32 removed = 0;
+        u64 *pte = &table->vaddr[first];
+        
+        for (u32 i = 0; i < count; i++) {
+            if (pte[i] & GEN12_PPGTT_PRESENT) {
+                removed++;
+            }
+            pte[i] = 0;
+        }
+        
+        table->used -= removed;
+        accountMapped((table->flags & PPGTT_TABLE_64K) ? PPGTT_MAPPED_64K : PPGTT_MAPPED_4K,
+                      -(s64)removed * PPGTT_PAGE_SIZE);
+        return true;
+    }
+    
+    u64 span = 1ULL << PPGTT_LEVEL_SHIFT(level);
+    
+    for (u64 addr = start; addr < end; ) {
+        u64 next = (addr & ~(span - 1)) + span;
+        if (next > end) {
+            next = end;
+        }
+        
+        u32 idx = PPGTT_LEVEL_INDEX(addr, level);
+        struct ppgtt_table *child = table->children[idx];
+        
+        if (!child && level == PPGTT_LEVEL_PD && (table->vaddr[idx] & GEN8_PDE_PS_2M)) {
+            // Partial clears of a 2MB leaf split it first; if that fails the
+            // leaf stays mapped rather than unmapping live neighbours
+            if (next - addr < span) {
+                child = splitHugeEntry(table, idx);
+                if (!child) {
+                    IOLog("IntelPPGTT: Cannot split 2MB leaf at 0x%llx\n", addr);
+                    return false;
+                }
+            } else {
+                table->vaddr[idx] = 0;
+                table->used--;
+                accountMapped(PPGTT_MAPPED_2M, -(s64)span);
+                addr = next;
+                continue;
+            }
+        }
+        
+        if (child) {
+            bool ok = clearRange(child, level - 1, addr, next);
+            
+            // Tear down tables that no longer map anything
+            if (child->used == 0) {
+                table->vaddr[idx] = 0;
+                table->children[idx] = NULL;
+                table->used--;
+                freeTable(child, level - 1);
+            } else if (level == PPGTT_LEVEL_PD) {
+                update64KMode(table, idx);
+            }
+            
+            if (!ok) {
+                return false;
+            }
+        }
+        
+        addr = next;
+    }
     
     return true;
 }
 
+void IntelPPGTT::destroyTables(struct ppgtt_table *table, int level)
+{
+    if (level == PPGTT_LEVEL_PT || !table->children) {
+        return;
+    }
+    
+    for (u32 i = 0; i < PPGTT_ENTRIES_PER_TABLE; i++) {
+        struct ppgtt_table *child = table->children[i];
+        if (!child) {
+            continue;
+        }
+        
+        destroyTables(child, level - 1);
+        freeTable(child, level - 1);
+        table->children[i] = NULL;
+        table->vaddr[i] = 0;
+    }
+    
+    table->used = 0;
+}
+
+u64 *IntelPPGTT::lookupPTE(u64 address)
+{
+    struct ppgtt_table *table = &root;
+    
+    for (int level = PPGTT_LEVEL_PML4; level > PPGTT_LEVEL_PT; level--) {
+        if (!table->children) {
+            return NULL;
+        }
+        
+        u32 idx = PPGTT_LEVEL_INDEX(address, level);
+        if (!table->children[idx]) {
+            // 2MB leaves live directly in the PD
+            if (level == PPGTT_LEVEL_PD && (table->vaddr[idx] & GEN8_PDE_PS_2M)) {
+                return &table->vaddr[idx];
+            }
+            return NULL;
+        }
+        table = table->children[idx];
+    }
+    
+    return &table->vaddr[PPGTT_LEVEL_INDEX(address, PPGTT_LEVEL_PT)];
+}
+
 
  * PTE Management
 
 void IntelPPGTT::writePTE(u64 address, u64 physAddr, u32 flags)
 {
-    // In a full implementation, this would:
-    // 1. Walk the 4-level page table structure
-    // 2. Allocate intermediate tables on demand
-    // 3. Write the PTE at the leaf level
-    //
-    // For now, this is a simplified stub
-    (void)address;
-    (void)physAddr;
-    (void)flags;
+    address &= ~(u64)(PPGTT_PAGE_SIZE - 1);
+    
+    IOLockLock(tableLock);
+    insertRange(&root, PPGTT_LEVEL_PML4, address, address + PPGTT_PAGE_SIZE,
+                physAddr, makePTE(0, flags));
+    IOLockUnlock(tableLock);
+    
+    OSSynchronizeIO();
 }
 
 u64 IntelPPGTT::readPTE(u64 address)
 {
-    // Read PTE from page tables
-    (void)address;
-    return 0;
+    IOLockLock(tableLock);
+    u64 *pte = lookupPTE(address);
+    u64 value = pte ? *pte : 0;
+    IOLockUnlock(tableLock);
+    
+    return value;
 }
 
 
@@ -242,19 +712,66 @@ bool IntelPPGTT::insertEntries(u64 start, IOMemoryDescriptor *mem, u32 flags)
         return false;
     }
     
-    size_t size = mem->getLength();
-    size_t numPages = (size + pageSize - 1) / pageSize;
+    // Coalesce the backing into physical runs first so each run is one
+    // walk and contiguous 2MB/64KB windows are visible to insertRange
+    struct gtt_sg_table *sgt = IntelGTT::createSGTable(mem);
+    if (!sgt) {
+        IOLog("IntelPPGTT: Failed to build segment list at 0x%llx\n", start);
+        return false;
+    }
     
-    IOLog("IntelPPGTT: Inserting %zu pages at 0x%llx\n", numPages, start);
+    IOLog("IntelPPGTT: Inserting %u runs (%llu bytes) at 0x%llx\n",
+          sgt->count, (u64)sgt->length, start);
     
-    // In a full implementation, we would:
-    // 1. Get physical segments from IOMemoryDescriptor
-    // 2. Walk page tables and allocate intermediate levels
-    // 3. Write PTEs for each physical page
-    //
-    // For now, track the allocation
+    bool ok = insertSGTable(start, sgt, flags);
+    IntelGTT::destroySGTable(sgt);
+    
+    return ok;
+}
+
+bool IntelPPGTT::insertSGTable(u64 start, const struct gtt_sg_table *sgt, u32 flags)
+{
+    if (!sgt || sgt->count == 0) {
+        return false;
+    }
+    
+    size_t numPages = (sgt->length + pageSize - 1) / pageSize;
+    
+    if (!root.children || (start & (pageSize - 1)) || !isValid(start, numPages * pageSize)) {
+        IOLog("IntelPPGTT: Insert out of range at 0x%llx\n", start);
+        return false;
+    }
+    
+    u64 pteFlags = makePTE(0, flags);
+    u64 va = start;
+    bool ok = true;
+    
+    IOLockLock(tableLock);
+    
+    for (u32 i = 0; i < sgt->count; i++) {
+        u64 len = (sgt->entries[i].length + pageSize - 1) & ~(u64)(pageSize - 1);
+        
+        if (!insertRange(&root, PPGTT_LEVEL_PML4, va, va + len,
+                         sgt->entries[i].phys & ~(u64)(pageSize - 1), pteFlags)) {
+            ok = false;
+            break;
+        }
+        
+        va += len;
+    }
+    
+    if (!ok) {
+        clearRange(&root, PPGTT_LEVEL_PML4, start, start + numPages * pageSize);
+    }
+    
+    IOLockUnlock(tableLock);
+    
+    OSSynchronizeIO();
+    
+    if (!ok) {
+        return false;
+    }
     
-    // Update statistics
     IOLockLock(statsLock);
     stats.insert_count++;
     IOLockUnlock(statsLock);
@@ -266,10 +783,33 @@ bool IntelPPGTT::clearEntries(u64 start, size_t size)
 {
     size_t numPages = (size + pageSize - 1) / pageSize;
     
+    if (!root.children || (start & (pageSize - 1)) || !isValid(start, numPages * pageSize)) {
+        return false;
+    }
+    
     IOLog("IntelPPGTT: Clearing %zu pages at 0x%llx\n", numPages, start);
     
-    // Clear PTEs in page tables
-    // For now, just update statistics
+    u64 end = start + numPages * pageSize;
+    
+    // Split any 2MB leaf the range only partly covers before touching a
+    // PTE, so a page-table allocation failure leaves the mapping intact
+    IOLockLock(tableLock);
+    bool ok = ((start & (PPGTT_PAGE_SIZE_2M - 1)) == 0 || splitHugeAt(start)) &&
+              ((end & (PPGTT_PAGE_SIZE_2M - 1)) == 0 || splitHugeAt(end - 1));
+    
+    // Clear PTEs; tables left empty are returned to the pool
+    if (ok) {
+        ok = clearRange(&root, PPGTT_LEVEL_PML4, start, end);
+    }
+    IOLockUnlock(tableLock);
+    
+    OSSynchronizeIO();
+    
+    if (!ok) {
+        IOLog("IntelPPGTT: Clear of 0x%llx - 0x%llx failed, 2MB leaf left mapped\n",
+              start, end);
+        return false;
+    }
     
     IOLockLock(statsLock);
     stats.clear_count++;
@@ -293,8 +833,8 @@ bool IntelPPGTT::bindObject(IntelGEMObject *obj, u32 cache_level)
     // Use the object's existing GTT address for simplicity
     u64 address = obj->getGTTAddress();
     if (address == 0) {
-        // Allocate PPGTT address
-        address = allocateSpace(obj->getSize(), pageSize);
+        // insertEntries picks the page size per window
+        address = allocateSpace(obj->getSize(), alignmentFor(obj->getSize()));
         if (address == 0) {
             IOLog("IntelPPGTT: Failed to allocate address\n");
             return false;
@@ -307,7 +847,7 @@ bool IntelPPGTT::bindObject(IntelGEMObject *obj, u32 cache_level)
         return false;
     }
     
-    return insertEntries(address, mem, 0);
+    return insertEntries(address, mem, GTT_PAGE_PRESENT | GTT_PAGE_WRITEABLE);
 }
 
 bool IntelPPGTT::unbindObject(IntelGEMObject *obj)
@@ -331,69 +871,16 @@ bool IntelPPGTT::unbindObject(IntelGEMObject *obj)
 
  * Address Space Allocation
 
-size_t IntelPPGTT::findFreeSpace(size_t numPages, size_t alignmentPages)
-{
-    IOLockLock(allocationLock);
-    
-    size_t totalPages = totalSize / pageSize;
-    size_t currentRun = 0;
-    size_t startPage = 0;
-    
-    for (size_t page = 0; page < totalPages; page++) {
-        size_t byteIndex = page / 8;
-        size_t bitIndex = page % 8;
-        
-        bool isUsed = (allocationBitmap[byteIndex] & (1 << bitIndex)) != 0;
-        
-        if (!isUsed) {
-            if (currentRun == 0) {
-                if ((page % alignmentPages) == 0) {
-                    startPage = page;
-                    currentRun = 1;
-                }
-            } else {
-                currentRun++;
-            }
-            
-            if (currentRun >= numPages) {
-                IOLockUnlock(allocationLock);
-                return startPage;
-            }
-        } else {
-            currentRun = 0;
-        }
-    }
-    
-    IOLockUnlock(allocationLock);
-    return SIZE_MAX;
-}
-
-void IntelPPGTT::markSpaceUsed(size_t startPage, size_t numPages)
+size_t IntelPPGTT::alignmentFor(size_t size)
 {
-    IOLockLock(allocationLock);
-    
-    for (size_t i = 0; i < numPages; i++) {
-        size_t page = startPage + i;
-        size_t byteIndex = page / 8;
-        size_t bitIndex = page % 8;
-        allocationBitmap[byteIndex] |= (1 << bitIndex);
+    // Only an aligned VA lets insertEntries map whole 2MB/64KB windows
+    if (size >= PPGTT_PAGE_SIZE_2M) {
+        return PPGTT_PAGE_SIZE_2M;
     }
-    
-    IOLockUnlock(allocationLock);
-}
-
-void IntelPPGTT::markSpaceFree(size_t startPage, size_t numPages)
-{
-    IOLockLock(allocationLock);
-    
-    for (size_t i = 0; i < numPages; i++) {
-        size_t page = startPage + i;
-        size_t byteIndex = page / 8;
-        size_t bitIndex = page % 8;
-        allocationBitmap[byteIndex] &= ~(1 << bitIndex);
+    if (size >= PPGTT_PAGE_SIZE_64K) {
+        return PPGTT_PAGE_SIZE_64K;
     }
-    
-    IOLockUnlock(allocationLock);
+    return PPGTT_PAGE_SIZE;
 }
 
 u64 IntelPPGTT::allocateSpace(size_t size, size_t alignment)
@@ -409,14 +896,19 @@ u64 IntelPPGTT::allocateSpace(size_t size, size_t alignment)
         alignmentPages = 1;
     }
     
-    size_t startPage = findFreeSpace(numPages, alignmentPages);
+    // Find and claim under one lock so two callers cannot get the same range
+    IOLockLock(allocationLock);
+    size_t startPage = pageBitmap.findFreeSpace(numPages, alignmentPages);
+    if (startPage != SIZE_MAX) {
+        pageBitmap.markUsed(startPage, numPages);
+    }
+    IOLockUnlock(allocationLock);
+    
     if (startPage == SIZE_MAX) {
         IOLog("IntelPPGTT: No free space for %zu pages\n", numPages);
         return 0;
     }
     
-    markSpaceUsed(startPage, numPages);
-    
     u64 address = baseAddress + (startPage * pageSize);
     
     // Update statistics
@@ -440,7 +932,9 @@ bool IntelPPGTT::freeSpace(u64 address, size_t size)
     size_t startPage = (address - baseAddress) / pageSize;
     size_t numPages = (size + pageSize - 1) / pageSize;
     
-    markSpaceFree(startPage, numPages);
+    IOLockLock(allocationLock);
+    pageBitmap.markFree(startPage, numPages);
+    IOLockUnlock(allocationLock);
     
     // Update statistics
     IOLockLock(statsLock);
@@ -496,4 +990,9 @@ void IntelPPGTT::printStats()
           100.0 * stats.used_entries / stats.total_entries);
     IOLog("  Operations: insert=%u clear=%u\n",
           stats.insert_count, stats.clear_count);
+    IOLog("  Page tables: %u live, %u pool pages\n",
+          stats.table_count, stats.pool_pages);
+    IOLog("  Mapped: 4KB=%llu MB 64KB=%llu MB 2MB=%llu MB\n",
+          stats.mapped_4k_bytes >> 20, stats.mapped_64k_bytes >> 20,
+          stats.mapped_2m_bytes >> 20);
 }
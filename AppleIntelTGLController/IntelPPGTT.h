@@ -11,11 +11,14 @@
 
 #include <IOKit/IOService.h>
 #include <IOKit/IOMemoryDescriptor.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
 #include "linux_compat.h"
+#include "IntelPageBitmap.h"
 
 class AppleIntelTGLController;
 class IntelGEMObject;
 class IntelGTT;
+struct gtt_sg_table;
 
 /* PPGTT Configuration (Gen12) */
 #define PPGTT_ADDRESS_SPACE_SIZE  (256ULL * 1024 * 1024 * 1024)  // 256GB per context
@@ -27,6 +30,43 @@ class IntelGTT;
 #define PPGTT_LEVEL_PD    1  // Page Directory
 #define PPGTT_LEVEL_PT    0  // Page Table
 
+/* Gen12 PPGTT entry layout (PTEs and PDEs share it) */
+#define GEN12_PPGTT_PRESENT       (1ULL << 0)
+#define GEN12_PPGTT_RW            (1ULL << 1)
+#define GEN12_PPGTT_ADDR_MASK     0x0000FFFFFFFFF000ULL
+#define GEN8_PDE_PS_2M            (1ULL << 7)   // PD entry is a 2MB leaf
+#define GEN8_PDE_IPS_64K          (1ULL << 11)  // PT below uses 64KB pages
+#define PPGTT_ENTRIES_PER_TABLE   512
+#define PPGTT_LEVEL_SHIFT(level)  (12 + 9 * (level))
+#define PPGTT_LEVEL_INDEX(addr, level) \
+    (((addr) >> PPGTT_LEVEL_SHIFT(level)) & (PPGTT_ENTRIES_PER_TABLE - 1))
+
+/* Huge page sizes */
+#define PPGTT_PAGE_SIZE_64K       (64 * 1024)
+#define PPGTT_PAGE_SIZE_2M        (2 * 1024 * 1024)
+#define PPGTT_64K_PTES            (PPGTT_PAGE_SIZE_64K / PPGTT_PAGE_SIZE)
+
+/* ppgtt_table flags */
+#define PPGTT_TABLE_64K           (1 << 0)  // IPS set in the parent PDE
+
+/* Page-table pages are carved from physically contiguous pool chunks */
+#define PPGTT_POOL_CHUNK_PAGES    16
+
+/* Software shadow of one page-table page */
+struct ppgtt_table {
+    u64 *vaddr;                     // CPU view of the 512 hardware entries
+    u64 phys;                       // Physical address stored in the parent entry
+    u32 used;                       // Present entries in this table
+    u32 flags;                      // PPGTT_TABLE_*
+    struct ppgtt_table **children;  // Next-level tables (NULL at PT level)
+};
+
+/* Backing chunk for the page-table page pool */
+struct ppgtt_pool_chunk {
+    IOBufferMemoryDescriptor *mem;
+    struct ppgtt_pool_chunk *next;
+};
+
 /* PPGTT Statistics */
 struct ppgtt_stats {
     size_t total_entries;
@@ -35,6 +75,18 @@ struct ppgtt_stats {
     u64 used_bytes;
     u32 insert_count;
     u32 clear_count;
+    u32 table_count;     // Live PDP/PD/PT pages (root excluded)
+    u32 pool_pages;      // Pages held by the page-table pool
+    u64 mapped_4k_bytes;
+    u64 mapped_64k_bytes;
+    u64 mapped_2m_bytes;
+};
+
+/* Page size buckets for ppgtt_stats accounting */
+enum ppgtt_mapped_kind {
+    PPGTT_MAPPED_4K = 0,
+    PPGTT_MAPPED_64K,
+    PPGTT_MAPPED_2M,
 };
 
 class IntelPPGTT {
@@ -48,16 +100,19 @@ public:
     
     // PPGTT Operations
     bool insertEntries(u64 start, IOMemoryDescriptor *mem, u32 flags);
+    bool insertSGTable(u64 start, const struct gtt_sg_table *sgt, u32 flags);
     bool clearEntries(u64 start, size_t size);
     bool bindObject(IntelGEMObject *obj, u32 cache_level);
     bool unbindObject(IntelGEMObject *obj);
     
     // Address Allocation
     u64 allocateSpace(size_t size, size_t alignment);
+    static size_t alignmentFor(size_t size);    // Lets large runs use 2MB/64KB pages
     bool freeSpace(u64 address, size_t size);
     
     // Query
     u64 getRootAddress() const { return pml4Address; }
+    u64 getRootPhysicalAddress() const { return root.phys; }
     size_t getTotalSize() const { return totalSize; }
     size_t getUsedSize() const;
     bool isValid(u64 address, size_t size) const;
@@ -66,6 +121,35 @@ public:
     void getStats(struct ppgtt_stats *stats);
     void printStats();
     
+protected:
+    // Page-table page pool. Virtual so a host build can substitute an
+    // in-memory backing store and exercise the walker without hardware.
+    virtual bool allocTablePage(u64 **vaddr, u64 *phys);
+    virtual void freeTablePage(u64 *vaddr, u64 phys);
+    
+    // Page-table walker
+    struct ppgtt_table *allocTable(int level);
+    void freeTable(struct ppgtt_table *table, int level);
+    u64 *lookupPTE(u64 address);
+    bool insertRange(struct ppgtt_table *table, int level,
+                     u64 start, u64 end, u64 phys, u64 pteFlags);
+    bool clearRange(struct ppgtt_table *table, int level, u64 start, u64 end);
+    struct ppgtt_table *splitHugeEntry(struct ppgtt_table *pd, u32 idx);
+    bool splitHugeAt(u64 address);
+    bool tableIs64KCompatible(struct ppgtt_table *pt);
+    void update64KMode(struct ppgtt_table *pd, u32 idx);
+    void accountMapped(u32 pageSizeKind, s64 bytes);
+    void destroyTables(struct ppgtt_table *table, int level);
+    u64 makePTE(u64 physAddr, u32 flags);
+    
+    struct ppgtt_table root;
+    IOLock *tableLock;
+    
+    // Pool free list is intrusive: word 0 of a free page is the next free
+    // page, word 1 is its physical address.
+    struct ppgtt_pool_chunk *poolChunks;
+    u64 *poolFreeList;
+    
 private:
     AppleIntelTGLController *controller;
     IntelGTT *globalGtt;
@@ -81,9 +165,8 @@ private:
     size_t pageSize;
     
     // Free Space Tracking
-    u8 *allocationBitmap;
-    size_t bitmapSize;
-    IOLock *allocationLock;
+    IntelPageBitmap pageBitmap;
+    IOLock *allocationLock;     // Held across pageBitmap find + mark
     
     // Statistics
     struct ppgtt_stats stats;
@@ -95,10 +178,6 @@ private:
     
     void writePTE(u64 address, u64 physAddr, u32 flags);
     u64 readPTE(u64 address);
-    
-    size_t findFreeSpace(size_t numPages, size_t alignmentPages);
-    void markSpaceUsed(size_t startPage, size_t numPages);
-    void markSpaceFree(size_t startPage, size_t numPages);
 };
 
 #endif // INTEL_PPGTT_H
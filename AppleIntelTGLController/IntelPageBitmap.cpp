@@ -0,0 +1,224 @@
+/*
+ * IntelPageBitmap.cpp
+ *
+ * Word/summary bitmap allocator for GPU address spaces
+ */
+
+#include "IntelPageBitmap.h"
+
+IntelPageBitmap::IntelPageBitmap()
+    : bitmap(NULL)
+    , bitmapSize(0)
+    , bitmapWords(0)
+    , summary(NULL)
+    , summarySize(0)
+    , summaryWords(0)
+    , totalPages(0)
+    , freePages(0)
+{
+}
+
+IntelPageBitmap::~IntelPageBitmap()
+{
+    free();
+}
+
+bool IntelPageBitmap::init(size_t numPages)
+{
+    if (bitmap || numPages == 0) {
+        return false;
+    }
+    
+    totalPages = numPages;
+    bitmapWords = DIV_ROUND_UP(totalPages, 64);
+    bitmapSize = bitmapWords * sizeof(u64);
+    summaryWords = DIV_ROUND_UP(bitmapWords, 64);
+    summarySize = summaryWords * sizeof(u64);
+    
+    bitmap = (u64 *)IOMalloc(bitmapSize);
+    summary = (u64 *)IOMalloc(summarySize);
+    if (!bitmap || !summary) {
+        free();
+        return false;
+    }
+    
+    bzero(bitmap, bitmapSize);
+    bzero(summary, summarySize);
+    
+    // Pages past the end in the last word are never free
+    if (totalPages % 64) {
+        bitmap[bitmapWords - 1] = ~0ULL << (totalPages % 64);
+    }
+    
+    for (size_t w = 0; w < bitmapWords; w++) {
+        updateSummary(w);
+    }
+    freePages = totalPages;
+    
+    return true;
+}
+
+void IntelPageBitmap::free()
+{
+    if (bitmap) {
+        IOFree(bitmap, bitmapSize);
+        bitmap = NULL;
+    }
+    
+    if (summary) {
+        IOFree(summary, summarySize);
+        summary = NULL;
+    }
+    
+    bitmapSize = bitmapWords = 0;
+    summarySize = summaryWords = 0;
+    totalPages = freePages = 0;
+}
+
+void IntelPageBitmap::updateSummary(size_t word)
+{
+    u64 bit = 1ULL << (word % 64);
+    
+    if (bitmap[word] != ~0ULL) {
+        summary[word / 64] |= bit;
+    } else {
+        summary[word / 64] &= ~bit;
+    }
+}
+
+size_t IntelPageBitmap::findNextFreePage(size_t page) const
+{
+    if (page >= totalPages) {
+        return SIZE_MAX;
+    }
+    
+    // Remainder of the current word
+    size_t word = page / 64;
+    u64 freeBits = ~bitmap[word] & (~0ULL << (page % 64));
+    if (freeBits) {
+        return word * 64 + __builtin_ctzll(freeBits);
+    }
+    
+    // Next word with a free page, via the summary level
+    word++;
+    size_t sw = word / 64;
+    if (sw >= summaryWords) {
+        return SIZE_MAX;
+    }
+    
+    u64 summaryBits = (word % 64) ? (summary[sw] & (~0ULL << (word % 64)))
+                                  : summary[sw];
+    while (!summaryBits) {
+        if (++sw >= summaryWords) {
+            return SIZE_MAX;
+        }
+        summaryBits = summary[sw];
+    }
+    
+    word = sw * 64 + __builtin_ctzll(summaryBits);
+    size_t found = word * 64 + __builtin_ctzll(~bitmap[word]);
+    
+    return (found < totalPages) ? found : SIZE_MAX;
+}
+
+size_t IntelPageBitmap::findNextUsedPage(size_t page, size_t limit) const
+{
+    // Returns the first used page in [page, limit), or limit if none
+    while (page < limit) {
+        size_t word = page / 64;
+        u64 usedBits = bitmap[word] & (~0ULL << (page % 64));
+    
+        if (usedBits) {
+            size_t found = word * 64 + __builtin_ctzll(usedBits);
+            return (found < limit) ? found : limit;
+        }
+    
+        page = (word + 1) * 64;
+    }
+    
+    return limit;
+}
+
+size_t IntelPageBitmap::findFreeSpace(size_t numPages, size_t alignmentPages) const
+{
+    if (numPages == 0 || numPages > freePages) {
+        return SIZE_MAX;
+    }
+    
+    if (alignmentPages == 0) {
+        alignmentPages = 1;
+    }
+    
+    // First fit: jump to the next free page, align up, then check that the
+    // run is clear a word at a time. A collision restarts past the used page.
+    size_t page = 0;
+    
+    while (page + numPages <= totalPages) {
+        page = findNextFreePage(page);
+        if (page == SIZE_MAX) {
+            break;
+        }
+    
+        page = roundup(page, alignmentPages);
+        if (page + numPages > totalPages) {
+            break;
+        }
+    
+        size_t end = page + numPages;
+        size_t used = findNextUsedPage(page, end);
+        if (used == end) {
+            return page;
+        }
+    
+        page = used + 1;
+    }
+    
+    return SIZE_MAX;
+}
+
+bool IntelPageBitmap::markUsed(size_t startPage, size_t numPages)
+{
+    size_t endPage = startPage + numPages;
+    if (numPages == 0 || endPage > totalPages) {
+        return false;
+    }
+    
+    for (size_t page = startPage; page < endPage; ) {
+        size_t word = page / 64;
+        size_t bitOffset = page % 64;
+        size_t bits = min((size_t)(64 - bitOffset), endPage - page);
+        u64 mask = (bits == 64) ? ~0ULL : (((1ULL << bits) - 1) << bitOffset);
+    
+        freePages -= __builtin_popcountll(mask & ~bitmap[word]);
+        bitmap[word] |= mask;
+        updateSummary(word);
+    
+        page += bits;
+    }
+    
+    return true;
+}
+
+bool IntelPageBitmap::markFree(size_t startPage, size_t numPages)
+{
+    size_t endPage = startPage + numPages;
+    if (numPages == 0 || endPage > totalPages) {
+        return false;
+    }
+    
+    // Clearing bits coalesces with neighbouring free pages implicitly
+    for (size_t page = startPage; page < endPage; ) {
+        size_t word = page / 64;
+        size_t bitOffset = page % 64;
+        size_t bits = min((size_t)(64 - bitOffset), endPage - page);
+        u64 mask = (bits == 64) ? ~0ULL : (((1ULL << bits) - 1) << bitOffset);
+    
+        freePages += __builtin_popcountll(mask & bitmap[word]);
+        bitmap[word] &= ~mask;
+        updateSummary(word);
+    
+        page += bits;
+    }
+    
+    return true;
+}
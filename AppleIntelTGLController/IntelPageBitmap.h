@@ -0,0 +1,50 @@
+/*
+ * IntelPageBitmap.h
+ *
+ * Page-granular address space allocator shared by the GGTT and PPGTT.
+ * A 64-bit word bitmap (bit set = page used) plus a one-bit-per-word
+ * summary level (bit set = word still has at least one free page), so
+ * searches skip full words with ctz instead of testing every page.
+ */
+
+#ifndef INTEL_PAGE_BITMAP_H
+#define INTEL_PAGE_BITMAP_H
+
+#include <IOKit/IOLib.h>
+#include "linux_compat.h"
+
+/* Not thread safe: the owning address space serializes find + mark */
+class IntelPageBitmap {
+public:
+    IntelPageBitmap();
+    ~IntelPageBitmap();
+
+    bool init(size_t numPages);
+    void free();
+
+    // First fit; returns the start page or SIZE_MAX
+    size_t findFreeSpace(size_t numPages, size_t alignmentPages) const;
+    size_t findNextFreePage(size_t page) const;
+    size_t findNextUsedPage(size_t page, size_t limit) const;  // limit if none
+
+    bool markUsed(size_t startPage, size_t numPages);
+    bool markFree(size_t startPage, size_t numPages);
+
+    size_t getTotalPages() const { return totalPages; }
+    size_t getFreePages() const { return freePages; }
+    size_t getTrackingBytes() const { return bitmapSize + summarySize; }
+
+private:
+    void updateSummary(size_t word);
+
+    u64 *bitmap;
+    size_t bitmapSize;      // Bytes
+    size_t bitmapWords;
+    u64 *summary;
+    size_t summarySize;     // Bytes
+    size_t summaryWords;
+    size_t totalPages;
+    size_t freePages;
+};
+
+#endif // INTEL_PAGE_BITMAP_H
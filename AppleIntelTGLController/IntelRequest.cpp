@@ -8,10 +8,13 @@
 #include "IntelRequest.h"
 #include "AppleIntelTGLController.h"
 #include "IntelRingBuffer.h"
+#include "IntelFence.h"
+#include "IntelGuCSubmission.h"
 #include "IntelContext.h"
 #include "IntelGEMObject.h"
 #include "IntelMetalCommandBuffer.h"
 #include <IOKit/IOLib.h>
+#include <libkern/OSAtomic.h>
 
 #define super OSObject
 
@@ -24,6 +27,10 @@
 // Request pool size
 #define REQUEST_POOL_SIZE 256
 
+// Pool growth granularity and ceiling
+#define REQUEST_POOL_CHUNK      64
+#define REQUEST_POOL_MAX_CHUNKS 64
+
 //
 // IntelRequest implementation
 //
@@ -40,6 +47,7 @@ bool IntelRequest::init() {
     context = nullptr;
     state = REQUEST_STATE_IDLE;
     seqno = 0;
+    breadcrumb = false;
     priority = REQUEST_PRIORITY_NORMAL;
     flags = 0;
     
@@ -81,9 +89,92 @@ bool IntelRequest::init() {
     next = nullptr;
     prev = nullptr;
     
+    pool = nullptr;
+    poolRefs = 0;
+    poolIndex = 0;
+    poolNextFree = 0;
+    
+    ownerQueue = nullptr;
+    queuedPriority = REQUEST_PRIORITY_NORMAL;
+    indexSeqno = 0;
+    indexEngine = 0;
+    seqPrev = seqNext = nullptr;
+    hashPrev = hashNext = nullptr;
+    ctxPrev = ctxNext = nullptr;
+    
     return true;
 }
 
+void IntelRequest::taggedRetain(const void* tag) const {
+    if (pool) {
+        OSIncrementAtomic(&poolRefs);
+        return;
+    }
+    super::taggedRetain(tag);
+}
+
+void IntelRequest::taggedRelease(const void* tag, const int when) const {
+    if (pool) {
+        // The pool keeps the real OSObject reference; dropping the last
+        // user reference hands the request back instead of freeing it
+        if (OSDecrementAtomic(&poolRefs) == 1) {
+            pool->recycleRequest(const_cast<IntelRequest*>(this));
+        }
+        return;
+    }
+    super::taggedRelease(tag, when);
+}
+
+void IntelRequest::recycle() {
+    state = REQUEST_STATE_IDLE;
+    ring = nullptr;
+    context = nullptr;
+    seqno = 0;
+    breadcrumb = false;
+    priority = REQUEST_PRIORITY_NORMAL;
+    flags = 0;
+    
+    // Keep the objects array for the next user
+    objectCount = 0;
+    
+    batchBuffer = nullptr;
+    batchOffset = 0;
+    batchLength = 0;
+    batchGPUAddress = 0;
+    
+    completeCallback = nullptr;
+    completeContext = nullptr;
+    timeoutCallback = nullptr;
+    timeoutContext = nullptr;
+    
+    fenceList = nullptr;
+    modernFence = nullptr;
+    
+    completionTag = 0;
+    hangTimeoutMs = REQUEST_TIMEOUT_MS;
+    contextID = 0;
+    queueID = 0;
+    commandCount = 0;
+    if (commandBufferDesc) {
+        commandBufferDesc->release();
+        commandBufferDesc = nullptr;
+    }
+    
+    allocTime = 0;
+    submitTime = 0;
+    startTime = 0;
+    completeTime = 0;
+    retireTime = 0;
+    
+    next = nullptr;
+    prev = nullptr;
+    
+    ownerQueue = nullptr;
+    seqPrev = seqNext = nullptr;
+    hashPrev = hashNext = nullptr;
+    ctxPrev = ctxNext = nullptr;
+}
+
 bool IntelRequest::setBatchAddress(uint64_t userspaceAddress)
 {
     IOLog("TGL: Setting batch address: userspace=0x%llx\n", userspaceAddress);
@@ -291,6 +382,11 @@ bool IntelRequestQueue::init() {
     totalCount = 0;
     maxDepth = 1024;
     
+    bzero(seqHeads, sizeof(seqHeads));
+    bzero(seqTails, sizeof(seqTails));
+    bzero(seqBuckets, sizeof(seqBuckets));
+    bzero(ctxBuckets, sizeof(ctxBuckets));
+    
     bzero(&stats, sizeof(stats));
     
     queueLock = IORecursiveLockAlloc();
@@ -365,44 +461,33 @@ bool IntelRequestQueue::remove(IntelRequest* request) {
     
     IORecursiveLockLock(queueLock);
     
-    IntelRequestPriority priority = request->getPriority();
-    IntelRequest* current = heads[priority];
-    
-    while (current) {
-        if (current == request) {
-            // Remove from list
-            if (current->prev) {
-                current->prev->next = current->next;
-            } else {
-                heads[priority] = current->next;
-            }
-            
-            if (current->next) {
-                current->next->prev = current->prev;
-            } else {
-                tails[priority] = current->prev;
-            }
-            
-            current->next = nullptr;
-            current->prev = nullptr;
-            
-            counts[priority]--;
-            totalCount--;
-            
-            IORecursiveLockUnlock(queueLock);
-            return true;
-        }
-        current = current->next;
+    // Membership is tracked on the request, so no list walk is needed
+    if (request->ownerQueue != this) {
+        IORecursiveLockUnlock(queueLock);
+        return false;
     }
     
+    unlinkInternal(request);
+    
     IORecursiveLockUnlock(queueLock);
-    return false;
+    return true;
 }
 
 void IntelRequestQueue::clear() {
     IORecursiveLockLock(queueLock);
     
     for (int i = 0; i < REQUEST_PRIORITY_COUNT; i++) {
+        IntelRequest* current = heads[i];
+        while (current) {
+            IntelRequest* next = current->next;
+            current->next = current->prev = nullptr;
+            current->ownerQueue = nullptr;
+            current->seqPrev = current->seqNext = nullptr;
+            current->hashPrev = current->hashNext = nullptr;
+            current->ctxPrev = current->ctxNext = nullptr;
+            current = next;
+        }
+        
         heads[i] = nullptr;
         tails[i] = nullptr;
         counts[i] = 0;
@@ -410,6 +495,11 @@ void IntelRequestQueue::clear() {
     
     totalCount = 0;
     
+    bzero(seqHeads, sizeof(seqHeads));
+    bzero(seqTails, sizeof(seqTails));
+    bzero(seqBuckets, sizeof(seqBuckets));
+    bzero(ctxBuckets, sizeof(ctxBuckets));
+    
     IORecursiveLockUnlock(queueLock);
 }
 
@@ -453,15 +543,13 @@ uint32_t IntelRequestQueue::getCountForPriority(IntelRequestPriority priority) c
 IntelRequest* IntelRequestQueue::findBySeqno(uint32_t seqno) {
     IORecursiveLockLock(queueLock);
     
-    for (int i = 0; i < REQUEST_PRIORITY_COUNT; i++) {
-        IntelRequest* current = heads[i];
-        while (current) {
-            if (current->getSeqno() == seqno) {
-                IORecursiveLockUnlock(queueLock);
-                return current;
-            }
-            current = current->next;
+    IntelRequest* current = seqBuckets[seqno & (REQUEST_SEQNO_BUCKETS - 1)];
+    while (current) {
+        if (current->indexSeqno == seqno) {
+            IORecursiveLockUnlock(queueLock);
+            return current;
         }
+        current = current->hashNext;
     }
     
     IORecursiveLockUnlock(queueLock);
@@ -471,21 +559,156 @@ IntelRequest* IntelRequestQueue::findBySeqno(uint32_t seqno) {
 IntelRequest* IntelRequestQueue::findByContext(IntelContext* context) {
     IORecursiveLockLock(queueLock);
     
-    for (int i = 0; i < REQUEST_PRIORITY_COUNT; i++) {
-        IntelRequest* current = heads[i];
-        while (current) {
-            if (current->getContext() == context) {
-                IORecursiveLockUnlock(queueLock);
-                return current;
-            }
-            current = current->next;
+    // Bucket chains hold one context's requests, plus any hash collisions
+    IntelRequest* current = ctxBuckets[contextBucket(context)];
+    while (current) {
+        if (current->getContext() == context) {
+            IORecursiveLockUnlock(queueLock);
+            return current;
         }
+        current = current->ctxNext;
     }
     
     IORecursiveLockUnlock(queueLock);
     return nullptr;
 }
 
+IntelRequest* IntelRequestQueue::dequeueCompleted(IntelRingBuffer* ring, uint32_t seqno) {
+    IORecursiveLockLock(queueLock);
+    
+    // Per-engine list is seqno ordered, so only its head needs checking
+    IntelRequest* request = seqHeads[engineSlot(ring)];
+    if (!request || (int32_t)(seqno - request->indexSeqno) < 0) {
+        IORecursiveLockUnlock(queueLock);
+        return nullptr;
+    }
+    
+    unlinkInternal(request);
+    
+    IORecursiveLockUnlock(queueLock);
+    return request;
+}
+
+uint32_t IntelRequestQueue::engineSlot(IntelRingBuffer* ring) {
+    if (!ring) {
+        return REQUEST_ENGINE_SLOTS - 1;
+    }
+    
+    uint32_t engine = (uint32_t)ring->getEngineId();
+    return engine < REQUEST_ENGINE_SLOTS - 1 ? engine : REQUEST_ENGINE_SLOTS - 1;
+}
+
+uint32_t IntelRequestQueue::contextBucket(IntelContext* context) {
+    uintptr_t key = (uintptr_t)context;
+    return (uint32_t)((key >> 6) ^ (key >> 14)) & (REQUEST_CONTEXT_BUCKETS - 1);
+}
+
+void IntelRequestQueue::indexRequest(IntelRequest* request) {
+    request->ownerQueue = this;
+    request->indexSeqno = request->getSeqno();
+    request->indexEngine = engineSlot(request->getRing());
+    
+    // Seqno order per engine; submissions arrive in order, so this is
+    // normally an append
+    uint32_t slot = request->indexEngine;
+    IntelRequest* after = seqTails[slot];
+    while (after && (int32_t)(after->indexSeqno - request->indexSeqno) > 0) {
+        after = after->seqPrev;
+    }
+    request->seqPrev = after;
+    request->seqNext = after ? after->seqNext : seqHeads[slot];
+    if (request->seqNext) {
+        request->seqNext->seqPrev = request;
+    } else {
+        seqTails[slot] = request;
+    }
+    if (after) {
+        after->seqNext = request;
+    } else {
+        seqHeads[slot] = request;
+    }
+    
+    // Seqno hash
+    IntelRequest** bucket = &seqBuckets[request->indexSeqno & (REQUEST_SEQNO_BUCKETS - 1)];
+    request->hashPrev = nullptr;
+    request->hashNext = *bucket;
+    if (*bucket) {
+        (*bucket)->hashPrev = request;
+    }
+    *bucket = request;
+    
+    // Context bucket
+    bucket = &ctxBuckets[contextBucket(request->getContext())];
+    request->ctxPrev = nullptr;
+    request->ctxNext = *bucket;
+    if (*bucket) {
+        (*bucket)->ctxPrev = request;
+    }
+    *bucket = request;
+}
+
+void IntelRequestQueue::unindexRequest(IntelRequest* request) {
+    uint32_t slot = request->indexEngine;
+    
+    if (request->seqPrev) {
+        request->seqPrev->seqNext = request->seqNext;
+    } else {
+        seqHeads[slot] = request->seqNext;
+    }
+    if (request->seqNext) {
+        request->seqNext->seqPrev = request->seqPrev;
+    } else {
+        seqTails[slot] = request->seqPrev;
+    }
+    
+    if (request->hashPrev) {
+        request->hashPrev->hashNext = request->hashNext;
+    } else {
+        seqBuckets[request->indexSeqno & (REQUEST_SEQNO_BUCKETS - 1)] = request->hashNext;
+    }
+    if (request->hashNext) {
+        request->hashNext->hashPrev = request->hashPrev;
+    }
+    
+    if (request->ctxPrev) {
+        request->ctxPrev->ctxNext = request->ctxNext;
+    } else {
+        ctxBuckets[contextBucket(request->getContext())] = request->ctxNext;
+    }
+    if (request->ctxNext) {
+        request->ctxNext->ctxPrev = request->ctxPrev;
+    }
+    
+    request->ownerQueue = nullptr;
+    request->seqPrev = request->seqNext = nullptr;
+    request->hashPrev = request->hashNext = nullptr;
+    request->ctxPrev = request->ctxNext = nullptr;
+}
+
+void IntelRequestQueue::unlinkInternal(IntelRequest* request) {
+    IntelRequestPriority priority = request->queuedPriority;
+    
+    if (request->prev) {
+        request->prev->next = request->next;
+    } else {
+        heads[priority] = request->next;
+    }
+    
+    if (request->next) {
+        request->next->prev = request->prev;
+    } else {
+        tails[priority] = request->prev;
+    }
+    
+    request->next = nullptr;
+    request->prev = nullptr;
+    
+    counts[priority]--;
+    totalCount--;
+    
+    unindexRequest(request);
+}
+
 void IntelRequestQueue::getStats(IntelRequestStats* outStats) {
     if (!outStats) {
         return;
@@ -504,6 +727,7 @@ void IntelRequestQueue::resetStats() {
 }
 
 bool IntelRequestQueue::enqueueInternalWork(IntelRequest* request, IntelRequestPriority priority) {
+    request->queuedPriority = priority;
     request->next = nullptr;
     request->prev = tails[priority];
     
@@ -517,6 +741,8 @@ bool IntelRequestQueue::enqueueInternalWork(IntelRequest* request, IntelRequestP
     counts[priority]++;
     totalCount++;
     
+    indexRequest(request);
+    
     if (totalCount > stats.maxQueueDepth) {
         stats.maxQueueDepth = totalCount;
     }
@@ -543,6 +769,8 @@ IntelRequest* IntelRequestQueue::dequeueInternalWork(IntelRequestPriority priori
     counts[priority]--;
     totalCount--;
     
+    unindexRequest(request);
+    
     return request;
 }
 
@@ -560,9 +788,11 @@ bool IntelRequestManager::init() {
     controller = nullptr;
     started = false;
     
-    requestPool = nullptr;
+    poolChunks = nullptr;
+    poolChunkCount = 0;
     poolSize = 0;
     poolUsed = 0;
+    poolFreeHead = 0;
     
     poolLock = IORecursiveLockAlloc();
     managerLock = IORecursiveLockAlloc();
@@ -654,26 +884,28 @@ void IntelRequestManager::stop() {
 }
 
 IntelRequest* IntelRequestManager::allocateRequest(IntelRingBuffer* ring, IntelContext* context) {
-    IORecursiveLockLock(poolLock);
+    IntelRequest* request = popFreeRequest();
     
-    // Try to get from pool
-    IntelRequest* request = nullptr;
-    for (uint32_t i = 0; i < poolSize; i++) {
-        if (requestPool[i]->getState() == REQUEST_STATE_IDLE) {
-            request = requestPool[i];
-            request->retain();
-            poolUsed++;
-            break;
+    if (!request) {
+        // Exhausted: grow by a chunk rather than failing. Re-check under the
+        // lock in case another thread already grew the pool.
+        IORecursiveLockLock(poolLock);
+        request = popFreeRequest();
+        if (!request && growRequestPool()) {
+            request = popFreeRequest();
         }
+        IORecursiveLockUnlock(poolLock);
     }
     
-    IORecursiveLockUnlock(poolLock);
-    
     if (!request) {
-        IOLog("IntelRequestManager: Pool exhausted\n");
+        IOLog("IntelRequestManager: Pool exhausted (%u requests)\n", poolSize);
         return nullptr;
     }
     
+    // The caller's reference
+    request->poolRefs = 1;
+    OSIncrementAtomic(&poolUsed);
+    
     if (!request->allocate(ring, context)) {
         request->release();
         return nullptr;
@@ -688,12 +920,58 @@ void IntelRequestManager::freeRequest(IntelRequest* request) {
         return;
     }
     
-    request->setState(REQUEST_STATE_IDLE);
+    // Pooled requests return to the free list once the last reference is
+    // gone (see recycleRequest); others are simply released
     request->release();
+}
+
+void IntelRequestManager::recycleRequest(IntelRequest* request) {
+    // Dropped while still queued: unlink before the links are reset. Every
+    // move between queues (submit, completeUpTo, notifyComplete, retire)
+    // happens under managerLock, so holding it keeps ownerQueue stable
+    // between the read and the remove.
+    IORecursiveLockLock(managerLock);
+    if (request->ownerQueue) {
+        request->ownerQueue->remove(request);
+    }
+    IORecursiveLockUnlock(managerLock);
     
-    IORecursiveLockLock(poolLock);
-    poolUsed--;
-    IORecursiveLockUnlock(poolLock);
+    request->recycle();
+    OSDecrementAtomic(&poolUsed);
+    pushFreeRequest(request);
+}
+
+IntelRequest* IntelRequestManager::poolRequestAt(uint32_t index) const {
+    return poolChunks[index / REQUEST_POOL_CHUNK][index % REQUEST_POOL_CHUNK];
+}
+
+IntelRequest* IntelRequestManager::popFreeRequest() {
+    while (true) {
+        UInt64 old = poolFreeHead;
+        uint32_t slot = (uint32_t)old;
+        if (slot == 0) {
+            return nullptr;
+        }
+        
+        // The tag bump makes a concurrent pop/push of the same slot fail
+        // the swap, so a stale poolNextFree is never installed
+        IntelRequest* request = poolRequestAt(slot - 1);
+        UInt64 head = (((old >> 32) + 1) << 32) | request->poolNextFree;
+        if (OSCompareAndSwap64(old, head, &poolFreeHead)) {
+            return request;
+        }
+    }
+}
+
+void IntelRequestManager::pushFreeRequest(IntelRequest* request) {
+    while (true) {
+        UInt64 old = poolFreeHead;
+        request->poolNextFree = (uint32_t)old;
+        UInt64 head = (((old >> 32) + 1) << 32) | (request->poolIndex + 1);
+        if (OSCompareAndSwap64(old, head, &poolFreeHead)) {
+            return;
+        }
+    }
 }
 
 bool IntelRequestManager::submitRequest(IntelRequest* request) {
@@ -705,8 +983,11 @@ bool IntelRequestManager::submitRequest(IntelRequest* request) {
         return false;
     }
     
+    // Breadcrumb requests are already on the ring, so they are running
+    // and will be completed by completeUpTo()
     IORecursiveLockLock(managerLock);
-    bool result = pendingQueue->enqueueWork(request);
+    IntelRequestQueue* queue = request->hasBreadcrumb() ? runningQueue : pendingQueue;
+    bool result = queue->enqueueWork(request);
     if (result) {
         globalStats.submitted++;
     }
@@ -715,23 +996,50 @@ bool IntelRequestManager::submitRequest(IntelRequest* request) {
     return result;
 }
 
-bool IntelRequestManager::submitBatch(IntelRequest** requests, uint32_t count) {
+uint32_t IntelRequestManager::submitBatch(IntelRequest** requests, uint32_t count) {
     if (!requests || !count || !started) {
-        return false;
+        return 0;
     }
     
     IORecursiveLockLock(managerLock);
     
-    for (uint32_t i = 0; i < count; i++) {
-        if (!requests[i]->submit() || !pendingQueue->enqueueWork(requests[i])) {
-            IORecursiveLockUnlock(managerLock);
-            return false;
+    // Stop at the first request that cannot be submitted; it and everything
+    // after it are left untouched
+    uint32_t ready = 0;
+    while (ready < count && requests[ready]->submit()) {
+        ready++;
+    }
+    
+    // Hand the whole burst to the GuC in one go rather than per request
+    uint32_t queued = ready;
+    IntelGuCSubmission* gucSubmission = controller ? controller->getGuCSubmission() : nullptr;
+    if (gucSubmission && ready > 0) {
+        queued = gucSubmission->submitRequests(requests, ready);
+    }
+    
+    // Whatever the GuC did not take never reached the hardware
+    for (uint32_t i = queued; i < ready; i++) {
+        requests[i]->unsubmit();
+    }
+    
+    for (uint32_t i = 0; i < queued; i++) {
+        IntelRequestQueue* queue = requests[i]->hasBreadcrumb() ? runningQueue : pendingQueue;
+        if (queue->enqueueWork(requests[i])) {
+            globalStats.submitted++;
+            continue;
         }
-        globalStats.submitted++;
+        
+        // Already on the hardware but untrackable: complete it with an error
+        // so waiters and retirement still see it
+        IOLog("IntelRequestManager: Queue full, completing request %u with error\n",
+              requests[i]->getSeqno());
+        requests[i]->setState(REQUEST_STATE_ERROR);
+        completeQueue->enqueueWork(requests[i]);
+        globalStats.errors++;
     }
     
     IORecursiveLockUnlock(managerLock);
-    return true;
+    return queued;
 }
 
 IntelRequest* IntelRequestManager::getRequestBySeqno(uint32_t seqno) {
@@ -763,7 +1071,9 @@ void IntelRequestManager::notifyComplete(IntelRequest* request, bool success) {
     
     request->setState(success ? REQUEST_STATE_COMPLETE : REQUEST_STATE_ERROR);
     
-    runningQueue->remove(request);
+    if (request->ownerQueue) {
+        request->ownerQueue->remove(request);
+    }
     completeQueue->enqueueWork(request);
     
     if (success) {
@@ -775,6 +1085,23 @@ void IntelRequestManager::notifyComplete(IntelRequest* request, bool success) {
     IORecursiveLockUnlock(managerLock);
 }
 
+uint32_t IntelRequestManager::completeUpTo(IntelRingBuffer* ring, uint32_t seqno) {
+    IORecursiveLockLock(managerLock);
+    
+    // One pass over the completed prefix of this ring's seqno list
+    uint32_t completed = 0;
+    IntelRequest* request;
+    while ((request = runningQueue->dequeueCompleted(ring, seqno)) != nullptr) {
+        request->setState(REQUEST_STATE_COMPLETE);
+        completeQueue->enqueueWork(request);
+        completed++;
+    }
+    globalStats.completed += completed;
+    
+    IORecursiveLockUnlock(managerLock);
+    return completed;
+}
+
 void IntelRequestManager::retireCompletedRequests() {
     IORecursiveLockLock(managerLock);
     
@@ -822,6 +1149,26 @@ void IntelRequestManager::stopTimeoutTimer() {
 void IntelRequestManager::checkTimeouts() {
     IORecursiveLockLock(managerLock);
     
+    // Catch completions whose interrupt was missed on any engine;
+    // breadcrumb read only, once per distinct ring
+    IntelRingBuffer* scanned[I915_NUM_ENGINES] = {};
+    for (int engine = 0; controller && engine < I915_NUM_ENGINES; engine++) {
+        IntelRingBuffer* ring = controller->getRingBuffer(engine);
+        if (!ring || !ring->hasBreadcrumbs()) {
+            continue;
+        }
+        
+        bool seen = false;
+        for (int i = 0; i < engine && !seen; i++) {
+            seen = (scanned[i] == ring);
+        }
+        scanned[engine] = ring;
+        
+        if (!seen) {
+            completeUpTo(ring, ring->getCompletedSeqno());
+        }
+    }
+    
     // Check running requests for timeouts
     uint64_t now = mach_absolute_time();
     uint64_t timeout = timeoutInterval * 1000000; // Convert to ns
@@ -850,6 +1197,8 @@ void IntelRequestManager::getStats(IntelRequestStats* outStats) {
     memcpy(outStats, &globalStats, sizeof(IntelRequestStats));
     outStats->pendingRequests = pendingQueue->getCount();
     outStats->runningRequests = runningQueue->getCount();
+    outStats->poolCapacity = poolSize;
+    outStats->poolInUse = (uint32_t)poolUsed;
     IORecursiveLockUnlock(managerLock);
 }
 
@@ -875,6 +1224,8 @@ void IntelRequestManager::printStats() {
     IOLog("Pending:          %u\n", stats.pendingRequests);
     IOLog("Running:          %u\n", stats.runningRequests);
     IOLog("Queue Depth:      %u / %u\n", stats.queueDepth, stats.maxQueueDepth);
+    IOLog("Pool:             %u / %u (%u growths)\n",
+          stats.poolInUse, stats.poolCapacity, stats.poolGrowths);
     
     if (stats.completed > 0) {
         IOLog("Avg Latency:      %llu us\n", stats.totalLatencyUs / stats.completed);
@@ -892,42 +1243,102 @@ void IntelRequestManager::timeoutTimerFired(OSObject* owner, IOTimerEventSource*
 }
 
 bool IntelRequestManager::allocateRequestPool(uint32_t size) {
-    if (requestPool) {
+    if (poolChunks) {
         return true;
     }
     
-    requestPool = (IntelRequest**)IOMalloc(size * sizeof(IntelRequest*));
-    if (!requestPool) {
+    poolChunks = (IntelRequest***)IOMalloc(REQUEST_POOL_MAX_CHUNKS * sizeof(IntelRequest**));
+    if (!poolChunks) {
         return false;
     }
+    bzero(poolChunks, REQUEST_POOL_MAX_CHUNKS * sizeof(IntelRequest**));
     
-    for (uint32_t i = 0; i < size; i++) {
-        requestPool[i] = IntelRequest::withController(controller);
-        if (!requestPool[i]) {
+    IORecursiveLockLock(poolLock);
+    while (poolSize < size) {
+        if (!growRequestPool()) {
+            IORecursiveLockUnlock(poolLock);
             freeRequestPool();
             return false;
         }
     }
+    IORecursiveLockUnlock(poolLock);
     
-    poolSize = size;
-    poolUsed = 0;
+    // Growth from here on is on demand
+    globalStats.poolGrowths = 0;
+    
+    IOLog("IntelRequestManager: Allocated pool of %u requests\n", poolSize);
+    return true;
+}
+
+bool IntelRequestManager::growRequestPool() {
+    // Caller holds poolLock
+    if (!poolChunks || poolChunkCount >= REQUEST_POOL_MAX_CHUNKS) {
+        return false;
+    }
+    
+    IntelRequest** chunk = (IntelRequest**)IOMalloc(REQUEST_POOL_CHUNK * sizeof(IntelRequest*));
+    if (!chunk) {
+        return false;
+    }
+    
+    for (uint32_t i = 0; i < REQUEST_POOL_CHUNK; i++) {
+        chunk[i] = IntelRequest::withController(controller);
+        if (!chunk[i]) {
+            while (i--) {
+                chunk[i]->release();
+            }
+            IOFree(chunk, REQUEST_POOL_CHUNK * sizeof(IntelRequest*));
+            return false;
+        }
+        chunk[i]->pool = this;
+        chunk[i]->poolIndex = poolChunkCount * REQUEST_POOL_CHUNK + i;
+    }
+    
+    // Publish the chunk before any of its slots can appear on the free list
+    poolChunks[poolChunkCount] = chunk;
+    OSMemoryBarrier();
+    poolChunkCount++;
+    poolSize += REQUEST_POOL_CHUNK;
+    globalStats.poolGrowths++;
+    
+    // Push in reverse so the lowest index is handed out first
+    for (uint32_t i = REQUEST_POOL_CHUNK; i-- > 0;) {
+        pushFreeRequest(chunk[i]);
+    }
     
-    IOLog("IntelRequestManager: Allocated pool of %u requests\n", size);
     return true;
 }
 
 void IntelRequestManager::freeRequestPool() {
-    if (requestPool) {
-        for (uint32_t i = 0; i < poolSize; i++) {
-            if (requestPool[i]) {
-                requestPool[i]->release();
+    if (poolChunks) {
+        for (uint32_t c = 0; c < poolChunkCount; c++) {
+            IntelRequest** chunk = poolChunks[c];
+            for (uint32_t i = 0; i < REQUEST_POOL_CHUNK; i++) {
+                IntelRequest* request = chunk[i];
+                SInt32 refs = request->poolRefs;
+                
+                // Detach from the pool. Anything still referenced gets its
+                // user references moved onto the OSObject count so the last
+                // holder frees it normally.
+                request->pool = nullptr;
+                if (refs > 0) {
+                    IOLog("IntelRequestManager: Request %u still referenced at teardown\n",
+                          request->poolIndex);
+                    for (SInt32 r = 0; r < refs; r++) {
+                        request->retain();
+                    }
+                }
+                request->release();
             }
+            IOFree(chunk, REQUEST_POOL_CHUNK * sizeof(IntelRequest*));
         }
-        IOFree(requestPool, poolSize * sizeof(IntelRequest*));
-        requestPool = nullptr;
+        IOFree(poolChunks, REQUEST_POOL_MAX_CHUNKS * sizeof(IntelRequest**));
+        poolChunks = nullptr;
     }
+    poolChunkCount = 0;
     poolSize = 0;
     poolUsed = 0;
+    poolFreeHead = 0;
 }
 
 void IntelRequestManager::updateStats() {
@@ -973,6 +1384,20 @@ bool IntelRequest::wait(uint64_t timeoutMs) {
         return false;
     }
     
+    // Breadcrumb requests: lock-free check, then the ring's wakeup-based wait
+    if (breadcrumb && ring) {
+        if (ring->isSeqnoCompleted(seqno)) {
+            return true;
+        }
+        
+        uint32_t waitMs = (timeoutMs && timeoutMs < UINT32_MAX) ? (uint32_t)timeoutMs : UINT32_MAX;
+        if (!ring->waitSeqno(seqno, waitMs)) {
+            IOLog("TGL: Request wait timeout after %llu ms\n", timeoutMs);
+            return false;
+        }
+        return true;
+    }
+    
     uint64_t start = mach_absolute_time();
     uint64_t timeout = timeoutMs * 1000000;
     
@@ -1006,6 +1431,8 @@ bool IntelRequest::allocate(IntelRingBuffer* ringBuffer, IntelContext* ctx) {
     
     ring = ringBuffer;
     context = ctx;
+    seqno = 0;
+    breadcrumb = false;
     
     // Note: IntelRingBuffer and IntelContext don't inherit from OSObject
     // They are managed separately, no retain/release needed here
@@ -1025,9 +1452,40 @@ bool IntelRequest::submit() {
     state = REQUEST_STATE_SUBMITTED;
     submitTime = mach_absolute_time();
     
+    // Commands were already emitted and advanced on the ring, so its last
+    // seqno is the breadcrumb that marks this request done
+    if (ring && ring->hasBreadcrumbs() && seqno == 0) {
+        seqno = ring->getSeqno();
+        breadcrumb = true;
+        
+        if (modernFence) {
+            modernFence->setSeqno(seqno);
+            modernFence->attachRing(ring);
+        }
+    }
+    
     return true;
 }
 
+void IntelRequest::unsubmit() {
+    if (state != REQUEST_STATE_SUBMITTED) {
+        return;
+    }
+    
+    // Only used before the request reached the hardware, so there is no
+    // ring state to unwind; a breadcrumb seqno would already be on the ring
+    state = REQUEST_STATE_ALLOCATED;
+    submitTime = 0;
+}
+
+bool IntelRequest::isSignaled() const {
+    if (isComplete()) {
+        return true;
+    }
+    
+    return breadcrumb && ring && ring->isSeqnoCompleted(seqno);
+}
+
 void IntelRequest::retire() {
     if (state == REQUEST_STATE_RETIRED) {
         return;
@@ -15,6 +15,7 @@
 #include "linux_compat.h"
 
 class AppleIntelTGLController;
+class IntelRequestManager;
 class IntelRingBuffer;
 class IntelContext;
 class IntelGEMObject;
@@ -41,6 +42,11 @@ enum IntelRequestPriority {
     REQUEST_PRIORITY_COUNT = 4
 };
 
+// Request queue indexes
+#define REQUEST_SEQNO_BUCKETS       256   // Power of two
+#define REQUEST_CONTEXT_BUCKETS     64    // Power of two
+#define REQUEST_ENGINE_SLOTS        8     // Ring engines, last slot for ring-less requests
+
 // Request flags
 #define REQUEST_FLAG_PREEMPTIBLE    (1 << 0)
 #define REQUEST_FLAG_PRIORITY       (1 << 1)
@@ -76,6 +82,9 @@ struct IntelRequestStats {
     uint32_t maxQueueDepth;              // Maximum queue depth
     uint32_t pendingRequests;            // Requests pending
     uint32_t runningRequests;            // Requests running
+    uint32_t poolCapacity;               // Preallocated requests
+    uint32_t poolInUse;                  // Handed out from the pool
+    uint32_t poolGrowths;                // Chunks added after init
 };
 
 //
@@ -90,6 +99,11 @@ public:
     void free() override;
     bool initWithContext(IntelContext* context);
     
+    // Pooled requests count references themselves and go back on the
+    // manager's free list when the last one drops, instead of free()
+    void taggedRetain(const void* tag = nullptr) const override;
+    void taggedRelease(const void* tag, const int when) const override;
+    
     // Factory methods
     static IntelRequest* withController(AppleIntelTGLController* controller);
     static IntelRequest* withRing(IntelRingBuffer* ring);
@@ -97,6 +111,7 @@ public:
     // Lifecycle
     bool allocate(IntelRingBuffer* ring, IntelContext* context);
     bool submit();
+    void unsubmit();        // Undo submit() for a request that never reached the hardware
     bool wait(uint64_t timeoutMs = 0);
     bool waitForCompletion(uint64_t timeoutMs = 0) { return wait(timeoutMs); }
     bool cancel();
@@ -106,6 +121,8 @@ public:
     IntelRequestState getState() const { return state; }
     void setState(IntelRequestState newState);
     bool isComplete() const { return state >= REQUEST_STATE_COMPLETE; }
+    bool isSignaled() const;  // isComplete(), or the ring breadcrumb has passed
+    bool hasBreadcrumb() const { return breadcrumb; }
     bool isRetired() const { return state == REQUEST_STATE_RETIRED; }
     bool hasError() const { return state == REQUEST_STATE_ERROR; }
     
@@ -210,6 +227,29 @@ public:
     IntelRequest* prev;
     
 private:
+    friend class IntelRequestManager;
+    friend class IntelRequestQueue;
+    
+    // Queue indexes (maintained by the IntelRequestQueue holding us)
+    IntelRequestQueue* ownerQueue;
+    IntelRequestPriority queuedPriority;  // List the request sits on
+    uint32_t indexSeqno;         // seqno at enqueue time
+    uint32_t indexEngine;
+    IntelRequest* seqPrev;       // Per-engine seqno order
+    IntelRequest* seqNext;
+    IntelRequest* hashPrev;      // Seqno hash bucket
+    IntelRequest* hashNext;
+    IntelRequest* ctxPrev;       // Per-context bucket
+    IntelRequest* ctxNext;
+    
+    // Request pool (owned by IntelRequestManager)
+    IntelRequestManager* pool;
+    mutable volatile SInt32 poolRefs;
+    uint32_t poolIndex;
+    uint32_t poolNextFree;       // Free-list link: index + 1, 0 terminates
+    
+    void recycle();
+
     AppleIntelTGLController* controller;
     IntelRingBuffer* ring;
     IntelContext* context;
@@ -217,6 +257,7 @@ private:
     // Request state
     IntelRequestState state;
     uint32_t seqno;
+    bool breadcrumb;       // seqno is a ring breadcrumb (not a GuC fence value)
     IntelRequestPriority priority;
     uint32_t flags;
     
@@ -299,10 +340,14 @@ public:
     void setController(AppleIntelTGLController* ctrl) { controller = ctrl; }
     AppleIntelTGLController* getController() const { return controller; }
     
-    // Search
+    // Search (hashed; cost is independent of queue depth)
     IntelRequest* findBySeqno(uint32_t seqno);
     IntelRequest* findByContext(IntelContext* context);
     
+    // Oldest request on ring whose seqno is at or before seqno, removed
+    // from the queue; nullptr once everything up to seqno is out
+    IntelRequest* dequeueCompleted(IntelRingBuffer* ring, uint32_t seqno);
+    
     // Statistics
     void getStats(IntelRequestStats* stats);
     void resetStats();
@@ -319,6 +364,12 @@ private:
     uint32_t totalCount;
     uint32_t maxDepth;
     
+    // Indexes over the same requests
+    IntelRequest* seqHeads[REQUEST_ENGINE_SLOTS];
+    IntelRequest* seqTails[REQUEST_ENGINE_SLOTS];
+    IntelRequest* seqBuckets[REQUEST_SEQNO_BUCKETS];
+    IntelRequest* ctxBuckets[REQUEST_CONTEXT_BUCKETS];
+    
     // Statistics
     IntelRequestStats stats;
     
@@ -328,6 +379,11 @@ private:
     // Internal methods
     bool enqueueInternalWork(IntelRequest* request, IntelRequestPriority priority);
     IntelRequest* dequeueInternalWork(IntelRequestPriority priority);
+    void unlinkInternal(IntelRequest* request);
+    void indexRequest(IntelRequest* request);
+    void unindexRequest(IntelRequest* request);
+    static uint32_t engineSlot(IntelRingBuffer* ring);
+    static uint32_t contextBucket(IntelContext* context);
 };
 
 //
@@ -351,7 +407,9 @@ public:
     
     // Request submission
     bool submitRequest(IntelRequest* request);
-    bool submitBatch(IntelRequest** requests, uint32_t count);
+    // Returns how many leading requests reached the hardware; the manager
+    // owns those. The rest are rolled back and stay with the caller.
+    uint32_t submitBatch(IntelRequest** requests, uint32_t count);
     
     // Request tracking
     IntelRequest* getRequestBySeqno(uint32_t seqno);
@@ -360,6 +418,7 @@ public:
     
     // Request completion
     void notifyComplete(IntelRequest* request, bool success);
+    uint32_t completeUpTo(IntelRingBuffer* ring, uint32_t seqno);
     void retireCompletedRequests();
     void retireAllRequests();
     
@@ -382,11 +441,14 @@ private:
     AppleIntelTGLController* controller;
     bool started;
     
-    // Request pools
-    IntelRequest** requestPool;
+    // Request pool: chunks of preallocated requests plus a lock-free LIFO
+    // free list. The head packs an ABA tag (high 32) with index + 1 (low 32).
+    IntelRequest*** poolChunks;
+    uint32_t poolChunkCount;
     uint32_t poolSize;
-    uint32_t poolUsed;
-    IORecursiveLock* poolLock;
+    volatile SInt32 poolUsed;
+    volatile UInt64 poolFreeHead;
+    IORecursiveLock* poolLock;       // Serialises growth only
     
     // Request queues
     IntelRequestQueue* pendingQueue;     // Waiting to submit
@@ -408,7 +470,12 @@ private:
     
     // Internal methods
     bool allocateRequestPool(uint32_t size);
+    bool growRequestPool();
     void freeRequestPool();
+    IntelRequest* poolRequestAt(uint32_t index) const;
+    IntelRequest* popFreeRequest();
+    void pushFreeRequest(IntelRequest* request);
+    void recycleRequest(IntelRequest* request);
     void updateStats();
 };
 
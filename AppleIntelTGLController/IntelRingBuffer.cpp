@@ -29,6 +29,10 @@
 #define VCS0_RING_START     0x1C038
 #define VCS0_RING_CTL       0x1C03C
 
+#define RCS_HWS_PGA         0x02080
+#define BCS_HWS_PGA         0x22080
+#define VCS0_HWS_PGA        0x1C080
+
 #define RING_CTL_SIZE(x)    ((x) - 0x1000)
 #define RING_VALID          (1 << 0)
 #define RING_WAIT           (1 << 11)
@@ -40,17 +44,27 @@ IntelRingBuffer::IntelRingBuffer()
     , ringVirtual(NULL)
     , ringGpuAddress(0)
     , ringSize(0)
+    , hwspObj(NULL)
+    , hwspVirtual(NULL)
+    , hwspGpuAddress(0)
     , engineId(RCS0)
     , engineClass(RENDER_CLASS)
     , engineName(NULL)
     , head(0)
     , tail(0)
     , space(0)
+    , reservedBytes(0)
+    , pendingBytes(0)
+    , pendingWraps(0)
     , active(false)
     , gucManaged(false)
     , currentSeqno(0)
     , lastRetiredSeqno(0)
     , ringLock(NULL)
+    , waitLock(NULL)
+    , waiters(NULL)
+    , waitSpinUs(RING_WAIT_SPIN_US)
+    , waitSpinMaxUs(RING_WAIT_SPIN_MAX_US)
     , statsLock(NULL)
 {
     bzero(&regs, sizeof(regs));
@@ -82,8 +96,9 @@ bool IntelRingBuffer::init(AppleIntelTGLController *ctrl, enum intel_engine_id i
     
     // Create locks
     ringLock = IOLockAlloc();
+    waitLock = IOLockAlloc();
     statsLock = IOLockAlloc();
-    if (!ringLock || !statsLock) {
+    if (!ringLock || !waitLock || !statsLock) {
         IOLog("IntelRing: Failed to allocate locks\n");
         return false;
     }
@@ -97,6 +112,11 @@ bool IntelRingBuffer::init(AppleIntelTGLController *ctrl, enum intel_engine_id i
         return false;
     }
     
+    // Status page is optional: without it completion falls back to HEAD
+    if (!allocateStatusPage()) {
+        IOLog("IntelRing: No status page, using HEAD polling for completion\n");
+    }
+    
     // Setup hardware registers
     if (!setupRegisters()) {
         IOLog("IntelRing: Failed to setup registers\n");
@@ -134,20 +154,27 @@ void IntelRingBuffer::cleanup()
             ringVirtual = NULL;
         }
         
-        if (gtt && ringGpuAddress) {
-            gtt->unbindObject(ringObj);
+        IntelGEM *gem = controller->getGEM();
+        if (gem) {
+            gem->destroyBoundObject(ringObj);
         }
-        
-        // Ring object will be freed by GEM
         ringObj = NULL;
+        ringGpuAddress = 0;
     }
     
+    freeStatusPage();
+    
     // Free locks
     if (ringLock) {
         IOLockFree(ringLock);
         ringLock = NULL;
     }
     
+    if (waitLock) {
+        IOLockFree(waitLock);
+        waitLock = NULL;
+    }
+    
     if (statsLock) {
         IOLockFree(statsLock);
         statsLock = NULL;
@@ -167,53 +194,80 @@ bool IntelRingBuffer::allocateRing()
         return false;
     }
     
-    ringObj = gem->createObject(ringSize, 0);
+    ringObj = gem->createBoundObject(ringSize, 0);
     if (!ringObj) {
         IOLog("IntelRing: Failed to create ring object\n");
         return false;
     }
+    ringGpuAddress = ringObj->getGTTAddress();
     
-    // Allocate GTT space
-    if (!gtt) {
-        IOLog("IntelRing: No GTT manager\n");
+    // Map for CPU access
+    if (!ringObj->mapCPU(&ringVirtual)) {
+        IOLog("IntelRing: Failed to map ring buffer\n");
         return false;
     }
     
-    ringGpuAddress = gtt->allocateSpace(ringSize, 4096);
-    if (ringGpuAddress == 0) {
-        IOLog("IntelRing: Failed to allocate GTT space\n");
-        return false;
-    }
+    // Clear ring buffer
+    bzero(ringVirtual, ringSize);
     
-    ringObj->setGTTAddress(ringGpuAddress);
+    IOLog("IntelRing: Ring allocated at virtual %p, GPU 0x%llx\n",
+          ringVirtual, ringGpuAddress);
     
-    // Bind to GTT
-    if (!gtt->bindObject(ringObj, 0)) {
-        IOLog("IntelRing: Failed to bind ring object\n");
-        gtt->freeSpace(ringGpuAddress, ringSize);
+    return true;
+}
+
+bool IntelRingBuffer::allocateStatusPage()
+{
+    IntelGEM *gem = controller->getGEM();
+    if (!gem || !gtt) {
         return false;
     }
     
-    // Map for CPU access
-    if (!ringObj->mapCPU(&ringVirtual)) {
-        IOLog("IntelRing: Failed to map ring buffer\n");
+    hwspObj = gem->createBoundObject(RING_HWSP_SIZE, 0);
+    if (!hwspObj) {
+        IOLog("IntelRing: Failed to create status page object\n");
         return false;
     }
+    hwspGpuAddress = hwspObj->getGTTAddress();
     
-    // Clear ring buffer
-    bzero(ringVirtual, ringSize);
+    void *vaddr = NULL;
+    if (!hwspObj->mapCPU(&vaddr)) {
+        IOLog("IntelRing: Failed to map status page\n");
+        freeStatusPage();
+        return false;
+    }
     
-    IOLog("IntelRing: Ring allocated at virtual %p, GPU 0x%llx\n",
-          ringVirtual, ringGpuAddress);
+    bzero(vaddr, RING_HWSP_SIZE);
+    hwspVirtual = (volatile u32 *)vaddr;
     
+    IOLog("IntelRing: Status page at GPU 0x%llx\n", hwspGpuAddress);
     return true;
 }
 
+void IntelRingBuffer::freeStatusPage()
+{
+    if (!hwspObj) {
+        return;
+    }
+    
+    if (hwspVirtual) {
+        hwspObj->unmapCPU();
+        hwspVirtual = NULL;
+    }
+    
+    IntelGEM *gem = controller->getGEM();
+    if (gem) {
+        gem->destroyBoundObject(hwspObj);
+    }
+    hwspObj = NULL;
+    hwspGpuAddress = 0;
+}
+
 bool IntelRingBuffer::setupRegisters()
 {
     // Registers were set by getRegisterOffsets()
-    IOLog("IntelRing: Register offsets: TAIL=0x%x HEAD=0x%x START=0x%x CTL=0x%x\n",
-          regs.tail, regs.head, regs.start, regs.ctl);
+    IOLog("IntelRing: Register offsets: TAIL=0x%x HEAD=0x%x START=0x%x CTL=0x%x HWS=0x%x\n",
+          regs.tail, regs.head, regs.start, regs.ctl, regs.hws);
     return true;
 }
 
@@ -253,6 +307,11 @@ bool IntelRingBuffer::initializeHardware()
     // Set ring start address
     writeRegister(regs.start, (u32)ringGpuAddress);
     
+    // Point the engine at our status page for breadcrumbs
+    if (hwspGpuAddress && regs.hws) {
+        writeRegister(regs.hws, (u32)hwspGpuAddress);
+    }
+    
     // Clear head and tail
     writeRegister(regs.head, 0);
     writeRegister(regs.tail, 0);
@@ -303,25 +362,23 @@ void IntelRingBuffer::writeRegister(u32 reg, u32 value)
 
  * Ring State Management
 
+u32 IntelRingBuffer::readHead()
+{
+    return readRegister(regs.head) & (ringSize - 1);  // Mask to ring size
+}
+
 void IntelRingBuffer::updateHead()
 {
-    u32 hwHead = readRegister(regs.head);
-    head = hwHead & (ringSize - 1);  // Mask to ring size
+    head = readHead();
     updateSpace();
 }
 
 void IntelRingBuffer::updateTail(u32 newTail)
 {
+    // Wraps are counted where they happen (emit/reserve), once per advance()
     tail = newTail & (ringSize - 1);
     writeRegister(regs.tail, tail);
     updateSpace();
-    
-    // Update statistics
-    IOLockLock(statsLock);
-    if (newTail < tail) {
-        stats.wraps++;
-    }
-    IOLockUnlock(statsLock);
 }
 
 void IntelRingBuffer::updateSpace()
@@ -345,7 +402,8 @@ bool IntelRingBuffer::begin(size_t numDwords)
 {
     IOLockLock(ringLock);
     
-    size_t numBytes = numDwords * 4;
+    // Room for the caller's commands plus the breadcrumb advance() appends
+    size_t numBytes = (numDwords + RING_BREADCRUMB_DWORDS) * 4;
     
     // Check if we have enough space
     if (!waitForSpace(numBytes, 1000)) {
@@ -376,49 +434,137 @@ bool IntelRingBuffer::emit(u32 dword)
     tail = (tail + 4) & (ringSize - 1);
     space -= 4;
     
-    // Update statistics
-    IOLockLock(statsLock);
-    stats.bytes_written += 4;
-    IOLockUnlock(statsLock);
+    // Statistics are folded in once by advance(); ringLock is held here
+    pendingBytes += 4;
+    if (tail == 0) {
+        pendingWraps++;
+    }
     
     return true;
 }
 
 bool IntelRingBuffer::emitDwords(const u32 *data, size_t count)
 {
-    if (!data || count == 0) {
+    if (!data || count == 0 || !ringVirtual) {
         return false;
     }
     
-    for (size_t i = 0; i < count; i++) {
-        if (!emit(data[i])) {
-            return false;
-        }
+    size_t bytes = count * 4;
+    if (space < bytes) {
+        IOLog("IntelRing: No space for %zu dwords\n", count);
+        return false;
+    }
+    
+    // At most two bulk copies: up to the ring end, then from the start
+    size_t first = ringSize - tail;
+    if (first > bytes) {
+        first = bytes;
+    }
+    memcpy((void *)((uintptr_t)ringVirtual + tail), data, first);
+    if (first < bytes) {
+        memcpy(ringVirtual, (const u8 *)data + first, bytes - first);
+        pendingWraps++;
     }
     
+    tail = (tail + bytes) & (ringSize - 1);
+    space -= bytes;
+    pendingBytes += bytes;
+    
     return true;
 }
 
+u32 *IntelRingBuffer::reserve(size_t numDwords)
+{
+    if (!ringVirtual || !ringLock || numDwords == 0) {
+        return NULL;
+    }
+    
+    size_t bytes = numDwords * 4;
+    if (bytes + RING_BREADCRUMB_DWORDS * 4 > ringSize - 8) {
+        IOLog("IntelRing: Reservation of %zu dwords exceeds ring\n", numDwords);
+        return NULL;
+    }
+    
+    IOLockLock(ringLock);
+    
+    // A span that would cross the ring end also consumes the tail padding
+    size_t remain = ringSize - tail;
+    size_t need = (bytes > remain) ? bytes + remain : bytes;
+    need += RING_BREADCRUMB_DWORDS * 4;
+    
+    if (!waitForSpace(need, 1000)) {
+        IOLog("IntelRing: Timeout waiting for %zu bytes\n", need);
+        IOLockUnlock(ringLock);
+        return NULL;
+    }
+    
+    if (bytes > remain) {
+        // MI_NOOP is 0, so the padding is a plain fill
+        bzero((void *)((uintptr_t)ringVirtual + tail), remain);
+        tail = 0;
+        space -= remain;
+        pendingBytes += remain;
+        pendingWraps++;
+    }
+    
+    reservedBytes = (u32)bytes;
+    return (u32 *)((uintptr_t)ringVirtual + tail);
+}
+
+bool IntelRingBuffer::commit()
+{
+    if (!reservedBytes) {
+        return false;
+    }
+    
+    tail = (tail + reservedBytes) & (ringSize - 1);
+    space -= reservedBytes;
+    pendingBytes += reservedBytes;
+    reservedBytes = 0;
+    
+    // Publishes the tail, folds in statistics and drops ringLock
+    return advance();
+}
+
+void IntelRingBuffer::cancel()
+{
+    if (!reservedBytes) {
+        return;
+    }
+    
+    // Any wrap padding already written stays; it is harmless MI_NOOPs
+    reservedBytes = 0;
+    IOLockUnlock(ringLock);
+}
+
 bool IntelRingBuffer::advance()
 {
     if (!ringLock) {
         return false;
     }
     
-    // Update tail register to submit commands
-    updateTail(tail);
-    
     // Increment sequence number
     currentSeqno++;
     
+    // Breadcrumb space was reserved by begin()/reserve()
+    emitBreadcrumb(currentSeqno);
+    
+    // Update tail register to submit commands
+    updateTail(tail);
+    
     IOLog("IntelRing:  Submitted seqno %u (tail=0x%x)\n", currentSeqno, tail);
     
-    // Update statistics
+    // Update statistics, once per submission
     IOLockLock(statsLock);
     stats.commands_submitted++;
+    stats.bytes_written += pendingBytes;
+    stats.wraps += pendingWraps;
     stats.last_seqno = currentSeqno;
     IOLockUnlock(statsLock);
     
+    pendingBytes = 0;
+    pendingWraps = 0;
+    
     IOLockUnlock(ringLock);
     
     return true;
@@ -430,19 +576,14 @@ bool IntelRingBuffer::submitCommand(const u32 *commands, size_t numDwords, Intel
         return false;
     }
     
-    // Begin command buffer
-    if (!begin(numDwords)) {
+    u32 *cs = reserve(numDwords);
+    if (!cs) {
         return false;
     }
     
-    // Emit all commands
-    if (!emitDwords(commands, numDwords)) {
-        IOLockUnlock(ringLock); // Unlock on error
-        return false;
-    }
+    memcpy(cs, commands, numDwords * 4);
     
-    // Advance and submit
-    return advance();
+    return commit();
 }
 
 
@@ -460,31 +601,260 @@ bool IntelRingBuffer::isSpaceAvailable(size_t numBytes) const
 
 bool IntelRingBuffer::waitForSpace(size_t numBytes, u32 timeoutMs)
 {
-    AbsoluteTime deadline;
+    if (isSpaceAvailable(numBytes)) {
+        return true;
+    }
+    
+    if (!waitEvent(RING_WAIT_SPACE, (u32)numBytes, timeoutMs)) {
+        // Timeout
+        IOLockLock(statsLock);
+        stats.waits++;
+        IOLockUnlock(statsLock);
+        return false;
+    }
+    
+    return true;
+}
+
+
+ * Wait Queue
+
+bool IntelRingBuffer::seqnoPassed(u32 seqno) const
+{
+    return isSeqnoCompleted(seqno);
+}
+
+bool IntelRingBuffer::waitConditionMet(enum ring_wait_kind kind, u32 arg)
+{
+    // Breadcrumbs answer seqno and idle checks from memory; only space
+    // still needs the real HEAD
+    if (hasBreadcrumbs()) {
+        if (kind == RING_WAIT_SEQNO) {
+            return seqnoPassed(arg);
+        }
+        if (kind == RING_WAIT_IDLE) {
+            return seqnoPassed(currentSeqno);
+        }
+    }
+    
+    u32 hwHead = readHead();
+    
+    // Only begin()/reserve() wait for space and they hold ringLock, so they
+    // are the only waiters allowed to refresh the cached head and space
+    if (kind == RING_WAIT_SPACE) {
+        head = hwHead;
+        updateSpace();
+        return isSpaceAvailable(arg);
+    }
+    
+    // Seqno/idle waiters don't own the ring: compare HEAD against a
+    // tail/seqno pair that is consistent under ringLock. If a submitter
+    // holds it, just look again on the next poll.
+    bool idle = false;
+    if (IOLockTryLock(ringLock)) {
+        idle = (hwHead == tail);
+        u32 seqno = currentSeqno;
+        IOLockUnlock(ringLock);
+        
+        // An idle ring has executed everything submitted so far
+        if (idle && lastRetiredSeqno != seqno) {
+            retireSeqno(seqno);
+        }
+    }
+    
+    return (kind == RING_WAIT_SEQNO) ? seqnoPassed(arg) : idle;
+}
+
+bool IntelRingBuffer::waitEvent(enum ring_wait_kind kind, u32 arg, u32 timeoutMs)
+{
+    if (waitConditionMet(kind, arg)) {
+        return true;
+    }
+    
+    uint64_t start = mach_absolute_time();
+    
+    // Spin phase: most small batches finish in tens of microseconds, well
+    // below what a sleep/wakeup round trip costs
+    u32 spinUs = waitSpinUs;
+    if (spinUs) {
+        uint64_t spinAbs;
+        nanoseconds_to_absolutetime((uint64_t)spinUs * 1000, &spinAbs);
+        
+        while (mach_absolute_time() - start < spinAbs) {
+            if (waitConditionMet(kind, arg)) {
+                // Short waits keep paying off, let the budget grow
+                u32 grown = spinUs + spinUs / 4 + 1;
+                waitSpinUs = grown < waitSpinMaxUs ? grown : waitSpinMaxUs;
+                
+                IOLockLock(statsLock);
+                stats.wait_spin_hits++;
+                IOLockUnlock(statsLock);
+                return true;
+            }
+        }
+    }
+    
+    // Sleep phase: queue up and let retireSeqno()/notifyProgress() wake us.
+    // HEAD is still re-polled every RING_WAIT_FALLBACK_MS in case the
+    // completion never raises an interrupt.
+    uint64_t deadline, slice;
     clock_interval_to_deadline(timeoutMs, kMillisecondScale, &deadline);
+    nanoseconds_to_absolutetime((uint64_t)RING_WAIT_FALLBACK_MS * 1000000ULL, &slice);
+    
+    struct ring_waiter waiter;
+    waiter.kind = kind;
+    waiter.seqno = arg;
+    waiter.woken = false;
+    
+    IOLockLock(waitLock);
+    waiter.next = waiters;
+    waiters = &waiter;
+    IOLockUnlock(waitLock);
+    
+    IOLockLock(statsLock);
+    stats.wait_sleeps++;
+    IOLockUnlock(statsLock);
     
-    while (!isSpaceAvailable(numBytes)) {
-        updateHead();
+    bool done = false;
+    while (true) {
+        if (waitConditionMet(kind, arg)) {
+            done = true;
+            break;
+        }
         
-        if (isSpaceAvailable(numBytes)) {
-            return true;
+        uint64_t now = mach_absolute_time();
+        if (now >= deadline) {
+            break;
         }
         
-        AbsoluteTime now;
-        clock_get_uptime(&now);
+        uint64_t wakeAt = (now + slice < deadline) ? now + slice : deadline;
         
-        if (CMP_ABSOLUTETIME(&now, &deadline) > 0) {
-            // Timeout
-            IOLockLock(statsLock);
-            stats.waits++;
-            IOLockUnlock(statsLock);
-            return false;
+        // A retire between the check above and here sets woken, so the
+        // wakeup is never lost
+        IOLockLock(waitLock);
+        if (!waiter.woken) {
+            IOLockSleepDeadline(waitLock, &waiter, wakeAt, THREAD_UNINT);
+        }
+        waiter.woken = false;
+        IOLockUnlock(waitLock);
+    }
+    
+    IOLockLock(waitLock);
+    struct ring_waiter **link = &waiters;
+    while (*link && *link != &waiter) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = waiter.next;
+    }
+    IOLockUnlock(waitLock);
+    
+    // Long waits mean spinning was wasted CPU; back the budget off
+    uint64_t waitedNs;
+    absolutetime_to_nanoseconds(mach_absolute_time() - start, &waitedNs);
+    if (waitedNs > (uint64_t)waitSpinMaxUs * 4000) {
+        waitSpinUs = spinUs / 2;
+    } else if (spinUs < waitSpinMaxUs) {
+        waitSpinUs = spinUs * 2 + 1 < waitSpinMaxUs ? spinUs * 2 + 1 : waitSpinMaxUs;
+    }
+    
+    return done;
+}
+
+// Cheap pre-check so a wakeup only goes to waiters that will find their
+// condition met; the waiter still re-checks properly before returning
+bool IntelRingBuffer::waiterReady(const struct ring_waiter *w, u32 hwHead) const
+{
+    switch (w->kind) {
+        case RING_WAIT_SEQNO:
+            return seqnoPassed(w->seqno) || (!hasBreadcrumbs() && hwHead == tail);
+        case RING_WAIT_SPACE:
+            return calculateSpace(hwHead, tail) >= w->seqno;
+        case RING_WAIT_IDLE:
+            return hasBreadcrumbs() ? seqnoPassed(currentSeqno) : hwHead == tail;
+    }
+    
+    return false;
+}
+
+void IntelRingBuffer::wakeWaiters(u32 hwHead)
+{
+    // Caller holds waitLock
+    u32 woken = 0;
+    
+    for (struct ring_waiter *w = waiters; w; w = w->next) {
+        if (w->woken || !waiterReady(w, hwHead)) {
+            continue;
         }
         
-        IOSleep(1);  // Sleep 1ms
+        w->woken = true;
+        IOLockWakeup(waitLock, w, true);
+        woken++;
     }
     
-    return true;
+    if (woken) {
+        IOLockLock(statsLock);
+        stats.wait_wakeups += woken;
+        IOLockUnlock(statsLock);
+    }
+}
+
+void IntelRingBuffer::notifyProgress()
+{
+    if (!waitLock) {
+        return;
+    }
+    
+    // No seqno to compare against; read HEAD once and wake only the
+    // waiters whose target it satisfies
+    u32 hwHead = readHead();
+    
+    IOLockLock(waitLock);
+    wakeWaiters(hwHead);
+    IOLockUnlock(waitLock);
+}
+
+u32 IntelRingBuffer::getCompletedSeqno() const
+{
+    if (!hasBreadcrumbs()) {
+        return lastRetiredSeqno;
+    }
+    
+    // Pairs with the GPU's breadcrumb write; anything the request wrote
+    // before its breadcrumb is visible once this value is observed
+    u32 hw = __atomic_load_n(&hwspVirtual[RING_HWSP_SEQNO_INDEX], __ATOMIC_ACQUIRE);
+    
+    // retireSeqno() may be ahead when the interrupt path saw a newer value
+    return (int32_t)(hw - lastRetiredSeqno) > 0 ? hw : lastRetiredSeqno;
+}
+
+bool IntelRingBuffer::isSeqnoCompleted(u32 seqno) const
+{
+    return (int32_t)(getCompletedSeqno() - seqno) >= 0;
+}
+
+void IntelRingBuffer::emitBreadcrumb(u32 seqno)
+{
+    if (!hasBreadcrumbs()) {
+        return;
+    }
+    
+    u64 addr = hwspGpuAddress + RING_HWSP_SEQNO_INDEX * sizeof(u32);
+    
+    emit(MI::STORE_DWORD_GGTT);
+    emit((u32)addr);
+    emit((u32)(addr >> 32));
+    emit(seqno);
+    emit(MI::USER_INTERRUPT);
+    emit(MI::NOOP);
+}
+
+void IntelRingBuffer::setWaitSpinLimit(u32 maxUs)
+{
+    waitSpinMaxUs = maxUs;
+    if (waitSpinUs > maxUs) {
+        waitSpinUs = maxUs;
+    }
 }
 
 
@@ -512,8 +882,15 @@ bool IntelRingBuffer::sync()
 
 void IntelRingBuffer::retireSeqno(u32 seqno)
 {
-    // Called by interrupt handler when GPU completes work
-    IOLockLock(ringLock);
+    // Called by interrupt handler when GPU completes work. Uses waitLock
+    // rather than ringLock: waitForSpace() blocks with ringLock held.
+    if (!waitLock) {
+        return;
+    }
+    
+    u32 hwHead = readHead();
+    
+    IOLockLock(waitLock);
     
     // Update retired seqno if newer
     if ((int32_t)(seqno - lastRetiredSeqno) > 0) {
@@ -521,7 +898,9 @@ void IntelRingBuffer::retireSeqno(u32 seqno)
         IOLog("IntelRing: OK  Retired seqno %u (current=%u)\n", seqno, currentSeqno);
     }
     
-    IOLockUnlock(ringLock);
+    wakeWaiters(hwHead);
+    
+    IOLockUnlock(waitLock);
 }
 
 bool IntelRingBuffer::waitSeqno(u32 seqno, u32 timeoutMs)
@@ -535,41 +914,18 @@ bool IntelRingBuffer::waitSeqno(u32 seqno, u32 timeoutMs)
     
     IOLog("IntelRing:  waitSeqno(%u) - lastRetiredSeqno=%u\n", seqno, lastRetiredSeqno);
     
-    if (seqno <= lastRetiredSeqno) {
+    if (seqnoPassed(seqno)) {
         IOLog("IntelRing: OK  seqno %u already retired!\n", seqno);
         return true;  // Already complete
     }
     
-    IOLog("IntelRing: ⏳ Polling for seqno %u...\n", seqno);
-    
-    AbsoluteTime deadline;
-    clock_interval_to_deadline(timeoutMs, kMillisecondScale, &deadline);
-    
-    while (true) {
-        updateHead();
-        
-        if (isIdle()) {
-            lastRetiredSeqno = currentSeqno;
-            return true;
-        }
-        
-        // Check if interrupt retired it
-        if (seqno <= lastRetiredSeqno) {
-            IOLog("IntelRing: OK  seqno %u retired by interrupt!\n", seqno);
-            return true;
-        }
-        
-        AbsoluteTime now;
-        clock_get_uptime(&now);
-        
-        if (CMP_ABSOLUTETIME(&now, &deadline) > 0) {
-            IOLog("IntelRing: ERR  Timeout waiting for seqno %u (current=%u, lastRetired=%u)\n",
-                  seqno, currentSeqno, lastRetiredSeqno);
-            return false;
-        }
-        
-        IOSleep(1);
+    if (!waitEvent(RING_WAIT_SEQNO, seqno, timeoutMs)) {
+        IOLog("IntelRing: ERR  Timeout waiting for seqno %u (current=%u, lastRetired=%u)\n",
+              seqno, currentSeqno, lastRetiredSeqno);
+        return false;
     }
+    
+    return true;
 }
 
 bool IntelRingBuffer::waitForIdle(uint32_t timeoutMs)
@@ -582,26 +938,12 @@ bool IntelRingBuffer::waitForIdle(uint32_t timeoutMs)
     }
     
     // Wait for the ring to become idle
-    AbsoluteTime deadline;
-    clock_interval_to_deadline(timeoutMs, kMillisecondScale, &deadline);
-    
-    while (true) {
-        updateHead();
-        
-        if (isIdle()) {
-            return true;
-        }
-        
-        AbsoluteTime now;
-        clock_get_uptime(&now);
-        
-        if (CMP_ABSOLUTETIME(&now, &deadline) > 0) {
-            IOLog("IntelRing: Timeout waiting for idle\n");
-            return false;
-        }
-        
-        IOSleep(1);
+    if (!waitEvent(RING_WAIT_IDLE, 0, timeoutMs)) {
+        IOLog("IntelRing: Timeout waiting for idle\n");
+        return false;
     }
+    
+    return true;
 }
 
 void IntelRingBuffer::flush()
@@ -670,6 +1012,10 @@ bool IntelRingBuffer::reset()
     currentSeqno = 0;
     lastRetiredSeqno = 0;
     
+    if (hwspVirtual) {
+        hwspVirtual[RING_HWSP_SEQNO_INDEX] = 0;
+    }
+    
     return start();
 }
 
@@ -693,6 +1039,11 @@ bool IntelRingBuffer::isBusy() const
 
 bool IntelRingBuffer::isIdle() const
 {
+    // The cached HEAD goes stale between polls; the breadcrumb does not
+    if (hasBreadcrumbs()) {
+        return isSeqnoCompleted(currentSeqno);
+    }
+    
     return !isBusy();
 }
 
@@ -703,23 +1054,7 @@ u64 IntelRingBuffer::getRingAddress() const
 
 bool IntelRingBuffer::waitForIdleEngine(u32 timeoutMs)
 {
-    AbsoluteTime deadline;
-    clock_interval_to_deadline(timeoutMs, kMillisecondScale, &deadline);
-    
-    while (!isIdle()) {
-        updateHead();
-        
-        AbsoluteTime now;
-        clock_get_uptime(&now);
-        
-        if (CMP_ABSOLUTETIME(&now, &deadline) > 0) {
-            return false;
-        }
-        
-        IOSleep(1);
-    }
-    
-    return true;
+    return waitEvent(RING_WAIT_IDLE, 0, timeoutMs);
 }
 
 
@@ -744,6 +1079,8 @@ void IntelRingBuffer::printStats()
           stats.bytes_written, stats.bytes_written / (1024.0 * 1024.0));
     IOLog("  Waits: %llu\n", stats.waits);
     IOLog("  Wraps: %llu\n", stats.wraps);
+    IOLog("  Wait spin hits: %llu, sleeps: %llu, wakeups: %llu\n",
+          stats.wait_spin_hits, stats.wait_sleeps, stats.wait_wakeups);
     IOLog("  Last seqno: %u\n", stats.last_seqno);
     IOLog("  Current state: head=%u tail=%u space=%u\n", head, tail, space);
 }
@@ -783,6 +1120,7 @@ void IntelRingBuffer::getRegisterOffsets(enum intel_engine_id id, struct ring_re
             out->head = RCS_RING_HEAD;
             out->start = RCS_RING_START;
             out->ctl = RCS_RING_CTL;
+            out->hws = RCS_HWS_PGA;
             break;
             
         case BCS0:
@@ -790,6 +1128,7 @@ void IntelRingBuffer::getRegisterOffsets(enum intel_engine_id id, struct ring_re
             out->head = BCS_RING_HEAD;
             out->start = BCS_RING_START;
             out->ctl = BCS_RING_CTL;
+            out->hws = BCS_HWS_PGA;
             break;
             
         case VCS0:
@@ -797,6 +1136,7 @@ void IntelRingBuffer::getRegisterOffsets(enum intel_engine_id id, struct ring_re
             out->head = VCS0_RING_HEAD;
             out->start = VCS0_RING_START;
             out->ctl = VCS0_RING_CTL;
+            out->hws = VCS0_HWS_PGA;
             break;
             
         default:
@@ -55,17 +55,45 @@ struct ring_registers {
     u32 head;      // Ring head (read pointer)
     u32 start;     // Ring start address
     u32 ctl;       // Ring control
+    u32 hws;       // Hardware status page address (HWS_PGA)
 };
 
+/* Hardware Status Page */
+#define RING_HWSP_SIZE          4096
+#define RING_HWSP_SEQNO_INDEX   0x40  // Dword slot the breadcrumb lands in
+#define RING_BREADCRUMB_DWORDS  6     // STORE_DATA_IMM (4) + USER_INTERRUPT + NOOP
+
 /* Ring Statistics */
 struct ring_stats {
     u64 commands_submitted;
     u64 bytes_written;
     u64 waits;
     u64 wraps;
+    u64 wait_spin_hits;    // Completed within the spin phase
+    u64 wait_sleeps;       // Had to block on the wait queue
+    u64 wait_wakeups;      // Waiters woken by retire/interrupt
     u32 last_seqno;
 };
 
+/* Wait Queue */
+#define RING_WAIT_SPIN_US       20   // Initial adaptive spin budget
+#define RING_WAIT_SPIN_MAX_US   100  // Spin never exceeds this
+#define RING_WAIT_FALLBACK_MS   1    // Re-poll HEAD if no interrupt arrives
+
+enum ring_wait_kind {
+    RING_WAIT_SEQNO,
+    RING_WAIT_SPACE,
+    RING_WAIT_IDLE,
+};
+
+/* Lives on the waiter's stack while it is blocked */
+struct ring_waiter {
+    enum ring_wait_kind kind;
+    u32 seqno;              // Target seqno, or bytes for RING_WAIT_SPACE
+    bool woken;
+    struct ring_waiter *next;
+};
+
 class IntelRingBuffer {
 public:
     IntelRingBuffer();
@@ -82,6 +110,13 @@ public:
     bool advance();
     bool submitCommand(const u32 *commands, size_t numDwords, IntelRequest* request = nullptr);
     
+    // Reserve/commit emission: reserve() takes ringLock and returns a
+    // contiguous span of numDwords (padding the ring end with MI_NOOP if the
+    // span would wrap); fill it, then commit() to submit or cancel() to drop.
+    u32 *reserve(size_t numDwords);
+    bool commit();
+    void cancel();
+    
     // Space Management
     size_t getAvailableSpace() const;
     bool waitForSpace(size_t numBytes, u32 timeoutMs);
@@ -94,6 +129,15 @@ public:
     bool waitForIdle(uint32_t timeoutMs);
     void flush();
     void retireSeqno(u32 seqno);  // Called by interrupt handler
+    void notifyProgress();        // Engine interrupt without a seqno
+    void setWaitSpinLimit(u32 maxUs);  // 0 disables the spin phase
+    
+    // Breadcrumbs: every advance() stores its seqno into the status page.
+    // These read it with an acquire load - no MMIO, no lock.
+    u32 getCompletedSeqno() const;
+    bool isSeqnoCompleted(u32 seqno) const;
+    bool hasBreadcrumbs() const { return hwspVirtual != NULL && !gucManaged; }
+    u64 getStatusPageAddress() const { return hwspGpuAddress; }
     
     // Control
     bool start();
@@ -126,6 +170,11 @@ private:
     u64 ringGpuAddress;
     size_t ringSize;
     
+    // Hardware Status Page
+    IntelGEMObject *hwspObj;
+    volatile u32 *hwspVirtual;
+    u64 hwspGpuAddress;
+    
     // Engine Info
     enum intel_engine_id engineId;
     enum intel_engine_class engineClass;
@@ -136,6 +185,9 @@ private:
     u32 head;          // CPU-side head cache
     u32 tail;          // CPU-side tail
     u32 space;         // Available space cache
+    u32 reservedBytes; // Outstanding reserve() span
+    u32 pendingBytes;  // Written since last advance(), incl. wrap padding
+    u32 pendingWraps;
     bool active;
     bool gucManaged;   // True if GuC controls this ring
     
@@ -146,15 +198,25 @@ private:
     // Locks
     IOLock *ringLock;
     
+    // Wait Queue (protected by waitLock, as is lastRetiredSeqno)
+    IOLock *waitLock;
+    struct ring_waiter *waiters;
+    u32 waitSpinUs;
+    u32 waitSpinMaxUs;
+    
     // Statistics
     struct ring_stats stats;
     IOLock *statsLock;
     
     // Private Methods
     bool allocateRing();
+    bool allocateStatusPage();
+    void freeStatusPage();
+    void emitBreadcrumb(u32 seqno);
     bool setupRegisters();
     bool initializeHardware();
     
+    u32 readHead();
     void updateHead();
     void updateTail(u32 newTail);
     void updateSpace();
@@ -165,6 +227,12 @@ private:
     size_t calculateSpace(u32 head, u32 tail) const;
     bool waitForIdleEngine(u32 timeoutMs);
     
+    bool seqnoPassed(u32 seqno) const;
+    bool waitConditionMet(enum ring_wait_kind kind, u32 arg);
+    bool waitEvent(enum ring_wait_kind kind, u32 arg, u32 timeoutMs);
+    bool waiterReady(const struct ring_waiter *w, u32 hwHead) const;
+    void wakeWaiters(u32 hwHead);
+    
     const char* getEngineName(enum intel_engine_id id);
     enum intel_engine_class getEngineClass(enum intel_engine_id id);
     void getRegisterOffsets(enum intel_engine_id id, struct ring_registers *regs);
@@ -177,6 +245,7 @@ namespace MI {
     static const u32 FLUSH          = 0x04 << 23;
     static const u32 USER_INTERRUPT = 0x02 << 23;
     static const u32 STORE_DWORD    = 0x20 << 23;
+    static const u32 STORE_DWORD_GGTT = STORE_DWORD | (1 << 22) | 2;  // 64-bit GGTT address
     static const u32 LOAD_REGISTER  = 0x22 << 23;
     
     // Create MI_NOOP with padding
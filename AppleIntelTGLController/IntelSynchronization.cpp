@@ -705,8 +705,11 @@ bool IntelSynchronization::isEngineIdle(IntelRingBuffer* engine) {
 }
 
 bool IntelSynchronization::isGPUIdle() {
-    // Check all engines
-    // In real implementation, would query hardware status
+    // Only the render ring is driven from here today
+    IntelRingBuffer* renderRing = controller ? controller->getRenderRing() : nullptr;
+    if (renderRing) {
+        return isEngineIdle(renderRing);
+    }
     return true;
 }
 
@@ -1028,8 +1031,11 @@ bool IntelSynchronization::isTimelineValueReached(IntelSemaphore* semaphore,
 }
 
 IdleState IntelSynchronization::checkEngineIdleState(IntelRingBuffer* engine) {
-    // Check if engine has pending work
-    // In real implementation, would read hardware registers
+    // Breadcrumb read from the status page, no MMIO
+    if (engine->hasBreadcrumbs() &&
+        !engine->isSeqnoCompleted(engine->getSeqno())) {
+        return IDLE_STATE_ACTIVE;
+    }
     
     return IDLE_STATE_IDLE;
 }
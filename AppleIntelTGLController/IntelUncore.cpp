@@ -8,6 +8,8 @@
 #include "IntelUncore.h"
 #include "AppleIntelTGLController.h"
 #include <IOKit/IOLib.h>
+#include <kern/cpu_number.h>
+#include <mach/mach_time.h>
 
 
  * Initialization
@@ -26,28 +28,48 @@ bool IntelUncore::init(AppleIntelTGLController *ctrl, void *base, size_t size)
     mmioSize = size;
     
     // Initialize locks
-    mmioLock = IOLockAlloc();
-    if (!mmioLock) {
-        IOLog("IntelUncore: Failed to allocate MMIO lock\n");
-        return false;
-    }
-    
     forcewakeLock = IOLockAlloc();
     if (!forcewakeLock) {
         IOLog("IntelUncore: Failed to allocate forcewake lock\n");
-        IOLockFree(mmioLock);
-        mmioLock = NULL;
+        return false;
+    }
+    
+    mmioTraceLock = IOLockAlloc();
+    if (!mmioTraceLock) {
+        IOLog("IntelUncore: Failed to allocate MMIO trace lock\n");
+        IOLockFree(forcewakeLock);
+        forcewakeLock = NULL;
+        return false;
+    }
+    
+    // Deferred forcewake put, armed when the last user of a domain drops it
+    fw_auto_put_call = thread_call_allocate(&IntelUncore::forcewakeAutoPut, this);
+    if (!fw_auto_put_call) {
+        IOLog("IntelUncore: Failed to allocate forcewake auto-put call\n");
+        IOLockFree(mmioTraceLock);
+        mmioTraceLock = NULL;
+        IOLockFree(forcewakeLock);
+        forcewakeLock = NULL;
         return false;
     }
     
     // Initialize state
     fw_domains_active = 0;
+    fw_domains_idle = 0;
+    fw_auto_put_armed = false;
     unclaimed_mmio_check = true;
     read_count = 0;
     write_count = 0;
     forcewake_count = 0;
+    forcewake_wakes = 0;
+    forcewake_auto_puts = 0;
     unclaimed_mmio_count = 0;
     
+    // Tracing stays off until a user client asks for it
+    mmio_trace_enabled = false;
+    mmio_trace_buffer = NULL;
+    bzero(mmio_trace_rings, sizeof(mmio_trace_rings));
+    
     // Clear forcewake domain structures
     for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
         fw_domains[i].mask = 0;
@@ -57,6 +79,8 @@ bool IntelUncore::init(AppleIntelTGLController *ctrl, void *base, size_t size)
         fw_domains[i].val_clear = 0;
         fw_domains[i].val_reset = 0;
         fw_domains[i].active = false;
+        fw_domains[i].wake_count = 0;
+        fw_domains[i].accessed = false;
     }
     
     // Detect and setup forcewake domains
@@ -79,31 +103,59 @@ void IntelUncore::cleanup()
 {
     IOLog("IntelUncore: cleanup() called\n");
     
-    initialized = false;
+    // Stop the deferred put before tearing down what it touches; a run we
+    // waited for may have re-armed itself for recently used domains
+    if (fw_auto_put_call) {
+        thread_call_cancel_wait(fw_auto_put_call);
+        thread_call_cancel(fw_auto_put_call);
+        thread_call_free(fw_auto_put_call);
+        fw_auto_put_call = NULL;
+    }
     
-    // Release all forcewake domains
-    if (fw_domains_active != 0) {
+    // Release all forcewake domains, held or idle
+    if (forcewakeLock && fw_domains_active != 0) {
         IOLog("IntelUncore: Releasing active forcewake domains: 0x%x\n", 
               fw_domains_active);
-        forcewakePut((enum forcewake_domains)fw_domains_active);
+        IOLockLock(forcewakeLock);
+        for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
+            if (fw_domains[i].active) {
+                forcewakeClearDomain((enum forcewake_domain_id)i);
+            }
+            fw_domains[i].wake_count = 0;
+        }
+        fw_domains_active = 0;
+        fw_domains_idle = 0;
+        fw_auto_put_armed = false;
+        IOLockUnlock(forcewakeLock);
+    }
+    
+    initialized = false;
+    
+    // Stop tracing and release the rings
+    mmio_trace_enabled = false;
+    if (mmio_trace_buffer) {
+        IOFree(mmio_trace_buffer, sizeof(struct intel_mmio_trace_record) *
+               MMIO_TRACE_CPUS * MMIO_TRACE_ENTRIES);
+        mmio_trace_buffer = NULL;
     }
     
     // Free locks
+    if (mmioTraceLock) {
+        IOLockFree(mmioTraceLock);
+        mmioTraceLock = NULL;
+    }
+    
     if (forcewakeLock) {
         IOLockFree(forcewakeLock);
         forcewakeLock = NULL;
     }
     
-    if (mmioLock) {
-        IOLockFree(mmioLock);
-        mmioLock = NULL;
-    }
-    
     // Print statistics
     IOLog("IntelUncore: Statistics:\n");
     IOLog("  Reads: %llu\n", read_count);
     IOLog("  Writes: %llu\n", write_count);
-    IOLog("  Forcewake ops: %llu\n", forcewake_count);
+    IOLog("  Forcewake ops: %llu (hardware wakes: %llu, auto-puts: %llu)\n",
+          forcewake_count, forcewake_wakes, forcewake_auto_puts);
     IOLog("  Unclaimed MMIO: %llu\n", unclaimed_mmio_count);
     
     mmioBase = NULL;
@@ -164,73 +216,156 @@ inline void IntelUncore::rawWrite64(u32 offset, u64 value)
 
 
  * Public Register Access
+ *
+ * MMIO is naturally atomic per access, so these take no lock; the
+ * counters are relaxed atomics and only feed the statistics dump.
 
 u8 IntelUncore::readRegister8(u32 offset)
 {
-    IOLockLock(mmioLock);
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
     u8 value = rawRead8(offset);
-    read_count++;
-    IOLockUnlock(mmioLock);
+    __atomic_fetch_add(&read_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, 1 << MMIO_TRACE_WIDTH_SHIFT, start,
+                        __builtin_return_address(0));
+    }
     return value;
 }
 
 u16 IntelUncore::readRegister16(u32 offset)
 {
-    IOLockLock(mmioLock);
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
     u16 value = rawRead16(offset);
-    read_count++;
-    IOLockUnlock(mmioLock);
+    __atomic_fetch_add(&read_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, 2 << MMIO_TRACE_WIDTH_SHIFT, start,
+                        __builtin_return_address(0));
+    }
     return value;
 }
 
 u32 IntelUncore::readRegister32(u32 offset)
 {
-    IOLockLock(mmioLock);
+    return readRegister32From(offset, __builtin_return_address(0));
+}
+
+u32 IntelUncore::readRegister32From(u32 offset, const void *caller)
+{
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
+    // Take exactly the well this register lives in, if any; an awake well
+    // is already held by the auto-put timer and needs no reference
+    enum forcewake_domains domains = getForcewakeDomains(offset, false);
+    if (domains != 0 && forcewakeUseIfAwake(domains)) {
+        domains = (enum forcewake_domains)0;
+    }
+    
+    if (domains != 0) {
+        forcewakeGet(domains);
+    }
+    
     u32 value = rawRead32(offset);
-    read_count++;
-    IOLockUnlock(mmioLock);
+    
+    if (domains != 0) {
+        forcewakePut(domains);
+    }
+    
+    __atomic_fetch_add(&read_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, 4 << MMIO_TRACE_WIDTH_SHIFT, start, caller);
+    }
     return value;
 }
 
 u64 IntelUncore::readRegister64(u32 offset)
 {
-    IOLockLock(mmioLock);
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
     u64 value = rawRead64(offset);
-    read_count++;
-    IOLockUnlock(mmioLock);
+    __atomic_fetch_add(&read_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, 8 << MMIO_TRACE_WIDTH_SHIFT, start,
+                        __builtin_return_address(0));
+    }
     return value;
 }
 
 void IntelUncore::writeRegister8(u32 offset, u8 value)
 {
-    IOLockLock(mmioLock);
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
     rawWrite8(offset, value);
-    write_count++;
-    IOLockUnlock(mmioLock);
+    __atomic_fetch_add(&write_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, MMIO_TRACE_WRITE | (1 << MMIO_TRACE_WIDTH_SHIFT),
+                        start, __builtin_return_address(0));
+    }
 }
 
 void IntelUncore::writeRegister16(u32 offset, u16 value)
 {
-    IOLockLock(mmioLock);
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
     rawWrite16(offset, value);
-    write_count++;
-    IOLockUnlock(mmioLock);
+    __atomic_fetch_add(&write_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, MMIO_TRACE_WRITE | (2 << MMIO_TRACE_WIDTH_SHIFT),
+                        start, __builtin_return_address(0));
+    }
 }
 
 void IntelUncore::writeRegister32(u32 offset, u32 value)
 {
-    IOLockLock(mmioLock);
+    writeRegister32From(offset, value, __builtin_return_address(0));
+}
+
+void IntelUncore::writeRegister32From(u32 offset, u32 value, const void *caller)
+{
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
+    // Shadowed registers (ring tails, ELSP) need no forcewake on write
+    enum forcewake_domains domains = getForcewakeDomains(offset, true);
+    if (domains != 0 && forcewakeUseIfAwake(domains)) {
+        domains = (enum forcewake_domains)0;
+    }
+    
+    if (domains != 0) {
+        forcewakeGet(domains);
+    }
+    
     rawWrite32(offset, value);
-    write_count++;
-    IOLockUnlock(mmioLock);
+    
+    if (domains != 0) {
+        forcewakePut(domains);
+    }
+    
+    __atomic_fetch_add(&write_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, MMIO_TRACE_WRITE | (4 << MMIO_TRACE_WIDTH_SHIFT),
+                        start, caller);
+    }
 }
 
 void IntelUncore::writeRegister64(u32 offset, u64 value)
 {
-    IOLockLock(mmioLock);
+    u64 start = mmio_trace_enabled ? mach_absolute_time() : 0;
+    
     rawWrite64(offset, value);
-    write_count++;
-    IOLockUnlock(mmioLock);
+    __atomic_fetch_add(&write_count, 1, __ATOMIC_RELAXED);
+    
+    if (start) {
+        mmioTraceRecord(offset, value, MMIO_TRACE_WRITE | (8 << MMIO_TRACE_WIDTH_SHIFT),
+                        start, __builtin_return_address(0));
+    }
 }
 
 void IntelUncore::postingRead32(u32 offset)
@@ -244,36 +379,13 @@ void IntelUncore::postingRead32(u32 offset)
 
 u32 IntelUncore::readRegister32_fw(u32 offset)
 {
-    // Get required forcewake domains for this register
-    enum forcewake_domains domains = getForcewakeDomains(offset, false);
-    
-    if (domains != 0) {
-        forcewakeGet(domains);
-    }
-    
-    u32 value = readRegister32(offset);
-    
-    if (domains != 0) {
-        forcewakePut(domains);
-    }
-    
-    return value;
+    // readRegister32 already takes the domain from the range table
+    return readRegister32(offset);
 }
 
 void IntelUncore::writeRegister32_fw(u32 offset, u32 value)
 {
-    // Get required forcewake domains for this register
-    enum forcewake_domains domains = getForcewakeDomains(offset, true);
-    
-    if (domains != 0) {
-        forcewakeGet(domains);
-    }
-    
     writeRegister32(offset, value);
-    
-    if (domains != 0) {
-        forcewakePut(domains);
-    }
 }
 
 
@@ -285,22 +397,42 @@ void IntelUncore::forcewakeGet(enum forcewake_domains domains)
         return;
     }
     
-    IOLockLock(forcewakeLock);
+    __atomic_fetch_add(&forcewake_count, 1, __ATOMIC_RELAXED);
     
-    forcewake_count++;
+    // Nested gets only bump the refcount; no lock, no MMIO
+    u32 slow = 0;
+    for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
+        u32 domain_mask = (1 << i);
+        if ((domains & domain_mask) && fw_domains[i].reg_set != 0 &&
+            !forcewakeTryGetFast((enum forcewake_domain_id)i)) {
+            slow |= domain_mask;
+        }
+    }
+    
+    if (slow == 0) {
+        return;
+    }
     
-    // Set each requested domain
+    IOLockLock(forcewakeLock);
+    
+    // A zero count means asleep: an awake domain always carries at least
+    // the auto-put timer's reference. Anything that gained a user while we
+    // waited for the lock is simply referenced below.
+    u32 waking = 0;
     for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
         u32 domain_mask = (1 << i);
-        if ((domains & domain_mask) && fw_domains[i].reg_set != 0) {
+        if ((slow & domain_mask) && fw_domains[i].wake_count == 0 &&
+            !fw_domains[i].active) {
             forcewakeSetDomain((enum forcewake_domain_id)i);
+            waking |= domain_mask;
         }
     }
     
-    // Wait for acknowledgment
+    // Wait for acknowledgment on the domains we actually woke
     for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
         u32 domain_mask = (1 << i);
-        if ((domains & domain_mask) && fw_domains[i].reg_set != 0) {
+        if (waking & domain_mask) {
+            __atomic_fetch_add(&forcewake_wakes, 1, __ATOMIC_RELAXED);
             if (!forcewakeWaitAck((enum forcewake_domain_id)i, 
                                  TGL_REGS::FORCEWAKE_ACK_TIMEOUT_MS)) {
                 IOLog("IntelUncore: Forcewake domain %d acknowledge timeout!\n", i);
@@ -308,7 +440,15 @@ void IntelUncore::forcewakeGet(enum forcewake_domains domains)
         }
     }
     
-    fw_domains_active |= domains;
+    // Publish the references only once the domains are acked, so the
+    // lockless fast path never sees a count on a domain still waking
+    for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
+        if (slow & (1 << i)) {
+            OSIncrementAtomic(&fw_domains[i].wake_count);
+        }
+    }
+    
+    __atomic_fetch_or(&fw_domains_active, slow, __ATOMIC_RELEASE);
     
     IOLockUnlock(forcewakeLock);
 }
@@ -319,21 +459,71 @@ void IntelUncore::forcewakePut(enum forcewake_domains domains)
         return;
     }
     
+    u32 slow = 0;
+    for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
+        u32 domain_mask = (1 << i);
+        if ((domains & domain_mask) && fw_domains[i].reg_set != 0 &&
+            !forcewakeTryPutFast((enum forcewake_domain_id)i)) {
+            slow |= domain_mask;
+        }
+    }
+    
+    if (slow == 0) {
+        return;
+    }
+    
     IOLockLock(forcewakeLock);
     
-    // Clear each requested domain
+    // Last user: hand the reference to the auto-put timer instead of
+    // dropping it, so the count stays non-zero for as long as the domain
+    // is awake and later gets keep hitting the lockless path
+    bool arm = false;
     for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
         u32 domain_mask = (1 << i);
-        if ((domains & domain_mask) && fw_domains[i].reg_set != 0) {
-            forcewakeClearDomain((enum forcewake_domain_id)i);
+        if (!(slow & domain_mask)) {
+            continue;
         }
+        
+        // A fast get may have raced in since forcewakeTryPutFast() failed
+        volatile SInt32 *count = &fw_domains[i].wake_count;
+        SInt32 old = *count;
+        while (old > 1 && !OSCompareAndSwap(old, old - 1, count)) {
+            old = *count;
+        }
+        if (old > 1) {
+            continue;
+        }
+        
+        // A count of 1 owned by the timer means this put had no matching get
+        if (old <= 0 || (fw_domains_idle & domain_mask)) {
+            IOLog("IntelUncore: Unbalanced forcewake put on domain %d\n", i);
+            continue;
+        }
+        
+        fw_domains_idle |= domain_mask;
+        arm = true;
     }
     
-    fw_domains_active &= ~domains;
+    if (arm && !fw_auto_put_armed) {
+        uint64_t deadline;
+        clock_interval_to_deadline(FORCEWAKE_AUTO_PUT_MS, kMillisecondScale, &deadline);
+        fw_auto_put_armed = true;
+        thread_call_enter_delayed(fw_auto_put_call, deadline);
+    }
     
     IOLockUnlock(forcewakeLock);
 }
 
+void IntelUncore::forcewakeFlush()
+{
+    if (!initialized) {
+        return;
+    }
+    
+    thread_call_cancel(fw_auto_put_call);
+    forcewakeReleaseIdle();
+}
+
 bool IntelUncore::forcewakeWaitAck(enum forcewake_domain_id domain_id, u32 timeout_ms)
 {
     if (domain_id >= FW_DOMAIN_ID_COUNT || fw_domains[domain_id].reg_ack == 0) {
@@ -399,6 +589,110 @@ void IntelUncore::forcewakeClearDomain(enum forcewake_domain_id domain_id)
     d->active = false;
 }
 
+bool IntelUncore::forcewakeTryGetFast(enum forcewake_domain_id domain_id)
+{
+    // Succeeds whenever the domain is awake, since a user or the armed
+    // auto-put always holds a reference then; 0 -> 1 takes the lock
+    volatile SInt32 *count = &fw_domains[domain_id].wake_count;
+    SInt32 old = *count;
+    while (old > 0) {
+        if (OSCompareAndSwap(old, old + 1, count)) {
+            return true;
+        }
+        old = *count;
+    }
+    return false;
+}
+
+bool IntelUncore::forcewakeTryPutFast(enum forcewake_domain_id domain_id)
+{
+    // Only succeeds if another reference remains; the last one goes to the timer
+    volatile SInt32 *count = &fw_domains[domain_id].wake_count;
+    SInt32 old = *count;
+    while (old > 1) {
+        if (OSCompareAndSwap(old, old - 1, count)) {
+            return true;
+        }
+        old = *count;
+    }
+    return false;
+}
+
+bool IntelUncore::forcewakeUseIfAwake(enum forcewake_domains domains)
+{
+    // Mark first, then check: pairs with forcewakeReleaseIdle(), which hides
+    // the domain before re-reading the mark, so either we see it going away
+    // and take a reference, or the timer sees us and keeps it for a period
+    u32 needed = 0;
+    for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
+        if ((domains & (1 << i)) && fw_domains[i].reg_set != 0) {
+            if (!fw_domains[i].accessed) {
+                __atomic_store_n(&fw_domains[i].accessed, true, __ATOMIC_SEQ_CST);
+            }
+            needed |= (1 << i);
+        }
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    
+    return (__atomic_load_n(&fw_domains_active, __ATOMIC_ACQUIRE) & needed) == needed;
+}
+
+void IntelUncore::forcewakeReleaseIdle()
+{
+    IOLockLock(forcewakeLock);
+    
+    // Drop the timer's reference, except on domains the accessors used
+    // without one during the last period; those get another period.
+    // Domains re-taken since their last put still have users and stay up.
+    // A racing fast get either lands before the decrement (and keeps the
+    // domain) or sees zero and waits for us.
+    u32 keep = 0;
+    for (int i = 0; i < FW_DOMAIN_ID_COUNT; i++) {
+        u32 domain_mask = (1 << i);
+        if (!(fw_domains_idle & domain_mask)) {
+            continue;
+        }
+        
+        if (__atomic_exchange_n(&fw_domains[i].accessed, false, __ATOMIC_SEQ_CST)) {
+            keep |= domain_mask;
+            continue;
+        }
+        
+        // Hide the domain from forcewakeUseIfAwake(), then look for a user
+        // that marked it before noticing
+        __atomic_fetch_and(&fw_domains_active, ~domain_mask, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&fw_domains[i].accessed, __ATOMIC_SEQ_CST)) {
+            __atomic_fetch_or(&fw_domains_active, domain_mask, __ATOMIC_RELEASE);
+            keep |= domain_mask;
+            continue;
+        }
+        
+        if (OSDecrementAtomic(&fw_domains[i].wake_count) == 1) {
+            forcewakeClearDomain((enum forcewake_domain_id)i);
+            forcewake_auto_puts++;
+        } else {
+            __atomic_fetch_or(&fw_domains_active, domain_mask, __ATOMIC_RELEASE);
+        }
+    }
+    
+    // Kept domains stay referenced by the re-armed timer
+    fw_domains_idle = keep;
+    fw_auto_put_armed = (keep != 0);
+    if (keep) {
+        uint64_t deadline;
+        clock_interval_to_deadline(FORCEWAKE_AUTO_PUT_MS, kMillisecondScale, &deadline);
+        thread_call_enter_delayed(fw_auto_put_call, deadline);
+    }
+    
+    IOLockUnlock(forcewakeLock);
+}
+
+void IntelUncore::forcewakeAutoPut(thread_call_param_t param0, thread_call_param_t param1)
+{
+    IntelUncore *uncore = (IntelUncore *)param0;
+    uncore->forcewakeReleaseIdle();
+}
+
 bool IntelUncore::checkForcewakeAck(enum forcewake_domain_id domain_id)
 {
     if (domain_id >= FW_DOMAIN_ID_COUNT) {
@@ -415,6 +709,154 @@ bool IntelUncore::checkForcewakeAck(enum forcewake_domain_id domain_id)
 }
 
 
+ * MMIO Tracing
+
+// Exported caller tags are relative to this function, so captures are
+// stable across loads and never reveal where the kext was slid to
+static void mmioTraceAnchor()
+{
+}
+
+bool IntelUncore::mmioTraceEnable(bool enable)
+{
+    if (!initialized) {
+        return false;
+    }
+    
+    IOLockLock(mmioTraceLock);
+    
+    if (!enable) {
+        mmio_trace_enabled = false;
+        IOLockUnlock(mmioTraceLock);
+        IOLog("IntelUncore: MMIO trace disabled\n");
+        return true;
+    }
+    
+    if (!mmio_trace_buffer) {
+        size_t size = sizeof(struct intel_mmio_trace_record) *
+                      MMIO_TRACE_CPUS * MMIO_TRACE_ENTRIES;
+        mmio_trace_buffer = (struct intel_mmio_trace_record *)IOMalloc(size);
+        if (!mmio_trace_buffer) {
+            IOLockUnlock(mmioTraceLock);
+            IOLog("IntelUncore: Failed to allocate MMIO trace buffer\n");
+            return false;
+        }
+        bzero(mmio_trace_buffer, size);
+        
+        for (int c = 0; c < MMIO_TRACE_CPUS; c++) {
+            mmio_trace_rings[c].records = &mmio_trace_buffer[c * MMIO_TRACE_ENTRIES];
+        }
+    }
+    
+    // Rings must be visible before the accessors start producing
+    __atomic_store_n(&mmio_trace_enabled, true, __ATOMIC_RELEASE);
+    
+    IOLockUnlock(mmioTraceLock);
+    
+    IOLog("IntelUncore: MMIO trace enabled (%d rings x %d records)\n",
+          MMIO_TRACE_CPUS, MMIO_TRACE_ENTRIES);
+    return true;
+}
+
+void IntelUncore::mmioTraceRecord(u32 offset, u64 value, u16 flags, u64 start, const void *caller)
+{
+    u64 now = mach_absolute_time();
+    
+    if (!__atomic_load_n(&mmio_trace_enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    
+    // Reserve a slot; the ring is per-CPU so this line is rarely shared,
+    // but the atomic keeps it correct across preemption and migration
+    int cpu = cpu_number();
+    struct intel_mmio_trace_ring *ring = &mmio_trace_rings[cpu & (MMIO_TRACE_CPUS - 1)];
+    u32 slot = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    struct intel_mmio_trace_record *rec = &ring->records[slot & (MMIO_TRACE_ENTRIES - 1)];
+    
+    // seq = 0 tells the drain the slot is mid-write
+    __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    
+    rec->timestamp = start;
+    rec->value = value;
+    rec->offset = offset;
+    rec->caller = (u32)((uintptr_t)caller - (uintptr_t)&mmioTraceAnchor);
+    rec->latency = (u32)(now - start);
+    rec->flags = flags;
+    rec->cpu = (u16)cpu;
+    rec->reserved = 0;
+    
+    __atomic_store_n(&rec->seq, slot + 1, __ATOMIC_RELEASE);
+}
+
+u32 IntelUncore::mmioTraceDrain(struct intel_mmio_trace_record *out, u32 max, u64 *dropped)
+{
+    u32 count = 0;
+    u64 lost = 0;
+    
+    if (!initialized || !out || !mmio_trace_buffer) {
+        if (dropped) {
+            *dropped = 0;
+        }
+        return 0;
+    }
+    
+    IOLockLock(mmioTraceLock);
+    
+    for (int c = 0; c < MMIO_TRACE_CPUS && count < max; c++) {
+        struct intel_mmio_trace_ring *ring = &mmio_trace_rings[c];
+        u32 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        
+        // Producers lapped us; everything older than one ring is gone
+        if (head - ring->tail > MMIO_TRACE_ENTRIES) {
+            ring->dropped += head - ring->tail - MMIO_TRACE_ENTRIES;
+            ring->tail = head - MMIO_TRACE_ENTRIES;
+        }
+        
+        while (ring->tail != head && count < max) {
+            struct intel_mmio_trace_record *rec =
+                &ring->records[ring->tail & (MMIO_TRACE_ENTRIES - 1)];
+            u32 want = ring->tail + 1;
+            u32 seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+            
+            if (seq != want) {
+                // Still being written: pick it up on the next drain
+                if (seq == 0 || (SInt32)(seq - want) < 0) {
+                    break;
+                }
+                // Overwritten by a later lap
+                ring->dropped++;
+                ring->tail++;
+                continue;
+            }
+            
+            out[count] = *rec;
+            
+            // A producer may have lapped us mid-copy
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != want) {
+                ring->dropped++;
+                ring->tail++;
+                continue;
+            }
+            
+            count++;
+            ring->tail++;
+        }
+        
+        lost += ring->dropped;
+        ring->dropped = 0;
+    }
+    
+    IOLockUnlock(mmioTraceLock);
+    
+    if (dropped) {
+        *dropped = lost;
+    }
+    return count;
+}
+
+
  * Forcewake Configuration
 
 void IntelUncore::detectForcewakeConfig()
@@ -480,18 +922,11 @@ bool IntelUncore::setupForcewakeDomains()
 
 enum forcewake_domains IntelUncore::getForcewakeDomains(u32 offset, bool is_write)
 {
-    // For now, return FORCEWAKE_ALL for safety
-    // TODO: Implement proper register range detection
-    // based on i915_reg.h register definitions
-    
-    // Ranges that don't need forcewake (always accessible)
-    if (offset < 0x4000) {
-        return (enum forcewake_domains)0;  // Legacy VGA range
+    if (is_write && TGL_FW::isShadowed(offset)) {
+        return (enum forcewake_domains)0;
     }
     
-    // Most GT registers need GT or RENDER forcewake
-    // For now, be conservative and use both
-    return (enum forcewake_domains)(FORCEWAKE_GT | FORCEWAKE_RENDER);
+    return (enum forcewake_domains)TGL_FW::lookup(offset);
 }
 
 
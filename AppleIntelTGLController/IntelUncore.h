@@ -11,6 +11,7 @@
 #include <IOKit/IOService.h>
 #include <IOKit/IOMemoryDescriptor.h>
 #include <IOKit/IOLocks.h>
+#include <kern/thread_call.h>
 #include "linux_compat.h"
 
 // Forward declarations
@@ -57,8 +58,50 @@ struct forcewake_domain {
     u32 val_clear;              /* Value to write for clear */
     u32 val_reset;              /* Value indicating reset */
     bool active;                /* Domain is currently active */
+    volatile SInt32 wake_count; /* Outstanding gets, plus one while the auto-put timer holds it */
+    volatile bool accessed;     /* Used without a reference since the last auto-put tick */
 };
 
+/* MMIO range -> forcewake domains, inclusive on both ends */
+struct intel_forcewake_range {
+    u32 start;
+    u32 end;
+    u32 domains;
+};
+
+/*
+ * MMIO trace record, exported as-is through the device user client so
+ * host tools can read captures without a translation step (40 bytes).
+ */
+struct intel_mmio_trace_record {
+    u64 timestamp;              /* mach_absolute_time() before the access */
+    u64 value;
+    u32 offset;
+    u32 caller;                 /* Return address relative to the trace anchor */
+    u32 latency;                /* Absolute-time units, forcewake included */
+    u16 flags;                  /* MMIO_TRACE_WRITE | width << MMIO_TRACE_WIDTH_SHIFT */
+    u16 cpu;
+    u32 seq;                    /* Ring slot + 1 once published, 0 while written */
+    u32 reserved;
+};
+
+#define MMIO_TRACE_WRITE        (1 << 0)
+#define MMIO_TRACE_WIDTH_SHIFT  1           /* Access width in bytes */
+#define MMIO_TRACE_CPUS         16          /* Higher CPU numbers share a ring */
+#define MMIO_TRACE_ENTRIES      2048        /* Per ring, power of two */
+
+/* One ring per CPU; padded to a cache line so producers never share one */
+struct intel_mmio_trace_ring {
+    volatile u32 head;          /* Next slot a producer reserves */
+    u32 tail;                   /* Next slot the drain reads (mmioTraceLock) */
+    u64 dropped;                /* Overwritten before they were drained */
+    struct intel_mmio_trace_record *records;
+    u8 pad[40];
+};
+
+/* Idle domains stay awake this long before the deferred put drops them */
+#define FORCEWAKE_AUTO_PUT_MS   1
+
 class IntelUncore {
 public:
     /* Initialization */
@@ -81,11 +124,22 @@ public:
     void forcewakeGet(enum forcewake_domains domains);
     void forcewakePut(enum forcewake_domains domains);
     bool forcewakeWaitAck(enum forcewake_domain_id domain_id, u32 timeout_ms);
+    void forcewakeFlush();      /* Drop idle domains now instead of waiting for the timer */
     
     /* Posting read (ensure write completes) */
     void postingRead32(u32 offset);
     
-    /* Register access with automatic forcewake */
+    /* As above, but traced against an explicit caller (for forwarding wrappers) */
+    u32  readRegister32From(u32 offset, const void *caller);
+    void writeRegister32From(u32 offset, u32 value, const void *caller);
+    
+    /* MMIO tracing: opt-in, per-CPU lock-free rings drained by the user client */
+    bool mmioTraceEnable(bool enable);
+    bool isMMIOTraceEnabled() const { return mmio_trace_enabled; }
+    u32  mmioTraceDrain(struct intel_mmio_trace_record *out, u32 max, u64 *dropped);
+    
+    /* Register access with automatic forcewake (readRegister32/writeRegister32
+     * already look up the domain; these remain for existing callers) */
     u32  readRegister32_fw(u32 offset);
     void writeRegister32_fw(u32 offset, u32 value);
     
@@ -113,6 +167,14 @@ private:
     void forcewakeSetDomain(enum forcewake_domain_id domain_id);
     void forcewakeClearDomain(enum forcewake_domain_id domain_id);
     bool checkForcewakeAck(enum forcewake_domain_id domain_id);
+    bool forcewakeTryGetFast(enum forcewake_domain_id domain_id);
+    bool forcewakeTryPutFast(enum forcewake_domain_id domain_id);
+    bool forcewakeUseIfAwake(enum forcewake_domains domains);
+    void forcewakeReleaseIdle();
+    static void forcewakeAutoPut(thread_call_param_t param0, thread_call_param_t param1);
+    
+    /* MMIO tracing */
+    void mmioTraceRecord(u32 offset, u64 value, u16 flags, u64 start, const void *caller);
     
     /* Debug and error checking */
     bool checkForUnclaimedMMIO(u32 offset);
@@ -129,20 +191,30 @@ private:
     
     /* Forcewake domains */
     struct forcewake_domain fw_domains[FW_DOMAIN_ID_COUNT];
-    u32                     fw_domains_active;  // Bitmask of active domains
+    volatile u32            fw_domains_active;  // Awake domains; read lock-free by the accessors
+    u32                     fw_domains_idle;    // Domains the armed auto-put holds a reference on
+    thread_call_t           fw_auto_put_call;
+    bool                    fw_auto_put_armed;
     
     /* Locks */
-    IOLock                  *mmioLock;          // Serialize MMIO access
-    IOLock                  *forcewakeLock;     // Serialize forcewake operations
+    IOLock                  *forcewakeLock;     // Serialize forcewake 0 <-> 1 transitions
+    IOLock                  *mmioTraceLock;     // Serialize trace enable and drain
+    
+    /* MMIO trace rings; the record buffer lives until cleanup once allocated */
+    volatile bool           mmio_trace_enabled;
+    struct intel_mmio_trace_record *mmio_trace_buffer;
+    struct intel_mmio_trace_ring mmio_trace_rings[MMIO_TRACE_CPUS];
     
     /* Flags */
     bool                    initialized;
     bool                    unclaimed_mmio_check;   // Check for unclaimed MMIO
     
-    /* Statistics */
+    /* Statistics (relaxed atomics; no lock on the access path) */
     UInt64                  read_count;
     UInt64                  write_count;
     UInt64                  forcewake_count;
+    UInt64                  forcewake_wakes;        // Gets that had to wake the hardware
+    UInt64                  forcewake_auto_puts;    // Domains dropped by the deferred put
     UInt64                  unclaimed_mmio_count;
 };
 
@@ -162,6 +234,19 @@ namespace TGL_REGS {
     constexpr u32 FORCEWAKE_KERNEL_FALLBACK     = 0x2;
     constexpr u32 FORCEWAKE_MT_ACK              = 0x10000;
     
+    /* Engine MMIO bases (Gen11+ media layout) */
+    constexpr u32 RENDER_RING_BASE              = 0x02000;
+    constexpr u32 BLT_RING_BASE                 = 0x22000;
+    constexpr u32 GEN11_BSD_RING_BASE           = 0x1c0000;
+    constexpr u32 GEN11_BSD3_RING_BASE          = 0x1d0000;
+    constexpr u32 GEN11_VEBOX_RING_BASE         = 0x1c8000;
+    constexpr u32 GEN11_VEBOX2_RING_BASE        = 0x1d8000;
+    
+    /* Per-engine offsets the hardware shadows (writable without forcewake) */
+    constexpr u32 RING_TAIL                     = 0x030;
+    constexpr u32 RING_EXECLIST_SQ_CONTENTS     = 0x510;
+    constexpr u32 RING_EXECLIST_CONTROL         = 0x550;
+    
     /* Other important registers */
     constexpr u32 GEN6_GT_THREAD_STATUS         = 0x13805c;
     constexpr u32 ECOBUS                        = 0xa180;
@@ -172,4 +257,142 @@ namespace TGL_REGS {
     constexpr u32 GT_FIFO_TIMEOUT_MS            = 10;
 };
 
+/*
+ * Gen12 forcewake range table
+ *
+ * Mirrors i915's __gen12_fw_ranges. Only the render, GT and media wells
+ * are programmed on this driver, so the per-VDBOX/VEBOX ranges map to
+ * FORCEWAKE_MEDIA. Offsets past the end of the table need no forcewake.
+ */
+namespace TGL_FW {
+    constexpr intel_forcewake_range RANGES[] = {
+        { 0x000000, 0x001fff, 0 },                  /* always on */
+        { 0x002000, 0x0026ff, FORCEWAKE_RENDER },
+        { 0x002700, 0x0027ff, FORCEWAKE_GT },
+        { 0x002800, 0x002aff, FORCEWAKE_RENDER },
+        { 0x002b00, 0x002fff, FORCEWAKE_GT },
+        { 0x003000, 0x003fff, FORCEWAKE_RENDER },
+        { 0x004000, 0x0051ff, FORCEWAKE_GT },
+        { 0x005200, 0x007fff, FORCEWAKE_RENDER },
+        { 0x008000, 0x00813f, FORCEWAKE_GT },
+        { 0x008140, 0x00815f, FORCEWAKE_RENDER },
+        { 0x008160, 0x0081ff, 0 },
+        { 0x008200, 0x0082ff, FORCEWAKE_GT },
+        { 0x008300, 0x0084ff, FORCEWAKE_RENDER },
+        { 0x008500, 0x0094cf, FORCEWAKE_GT },
+        { 0x0094d0, 0x00955f, FORCEWAKE_RENDER },
+        { 0x009560, 0x0097ff, 0 },                  /* reserved */
+        { 0x009800, 0x00afff, FORCEWAKE_GT },
+        { 0x00b000, 0x00b47f, FORCEWAKE_RENDER },
+        { 0x00b480, 0x00deff, FORCEWAKE_GT },
+        { 0x00df00, 0x00e8ff, FORCEWAKE_RENDER },
+        { 0x00e900, 0x0147ff, FORCEWAKE_GT },
+        { 0x014800, 0x0148ff, FORCEWAKE_RENDER },
+        { 0x014900, 0x019fff, FORCEWAKE_GT },
+        { 0x01a000, 0x01a7ff, FORCEWAKE_RENDER },
+        { 0x01a800, 0x01afff, FORCEWAKE_GT },
+        { 0x01b000, 0x01bfff, FORCEWAKE_RENDER },
+        { 0x01c000, 0x0243ff, FORCEWAKE_GT },
+        { 0x024400, 0x0247ff, FORCEWAKE_RENDER },
+        { 0x024800, 0x03ffff, FORCEWAKE_GT },
+        { 0x040000, 0x1bffff, 0 },                  /* display, GT interrupts */
+        { 0x1c0000, 0x1c3fff, FORCEWAKE_MEDIA },    /* VDBOX0 */
+        { 0x1c4000, 0x1c7fff, 0 },
+        { 0x1c8000, 0x1cbfff, FORCEWAKE_MEDIA },    /* VEBOX0 */
+        { 0x1cc000, 0x1cffff, FORCEWAKE_MEDIA },    /* VDBOX0 */
+        { 0x1d0000, 0x1d3fff, FORCEWAKE_MEDIA },    /* VDBOX2 */
+        { 0x1d4000, 0x1d7fff, 0 },
+        { 0x1d8000, 0x1dbfff, FORCEWAKE_MEDIA },    /* VEBOX1 */
+        { 0x1dc000, 0x1dffff, FORCEWAKE_MEDIA },    /* VDBOX2 */
+    };
+    
+    constexpr u32 RANGE_COUNT = sizeof(RANGES) / sizeof(RANGES[0]);
+    
+    /* Writes to these land in always-on shadow copies; sorted */
+    constexpr u32 SHADOWED[] = {
+        TGL_REGS::RENDER_RING_BASE + TGL_REGS::RING_TAIL,
+        TGL_REGS::RENDER_RING_BASE + TGL_REGS::RING_EXECLIST_SQ_CONTENTS,
+        TGL_REGS::RENDER_RING_BASE + TGL_REGS::RING_EXECLIST_CONTROL,
+        TGL_REGS::FORCEWAKE_GT_GEN9,
+        TGL_REGS::FORCEWAKE_MEDIA_GEN9,
+        TGL_REGS::FORCEWAKE_RENDER_GEN9,
+        TGL_REGS::BLT_RING_BASE + TGL_REGS::RING_TAIL,
+        TGL_REGS::BLT_RING_BASE + TGL_REGS::RING_EXECLIST_SQ_CONTENTS,
+        TGL_REGS::BLT_RING_BASE + TGL_REGS::RING_EXECLIST_CONTROL,
+        TGL_REGS::GEN11_BSD_RING_BASE + TGL_REGS::RING_TAIL,
+        TGL_REGS::GEN11_VEBOX_RING_BASE + TGL_REGS::RING_TAIL,
+        TGL_REGS::GEN11_BSD3_RING_BASE + TGL_REGS::RING_TAIL,
+        TGL_REGS::GEN11_VEBOX2_RING_BASE + TGL_REGS::RING_TAIL,
+    };
+    
+    constexpr u32 SHADOWED_COUNT = sizeof(SHADOWED) / sizeof(SHADOWED[0]);
+    
+    /* Branchless lower bound: the trip count depends only on the table size */
+    constexpr u32 lookup(u32 offset)
+    {
+        u32 base = 0;
+        u32 n = RANGE_COUNT;
+        while (n > 1) {
+            u32 half = n / 2;
+            base = (RANGES[base + half - 1].end < offset) ? base + half : base;
+            n -= half;
+        }
+        const intel_forcewake_range &r = RANGES[base];
+        return (r.start <= offset && offset <= r.end) ? r.domains : 0;
+    }
+    
+    constexpr bool isShadowed(u32 offset)
+    {
+        u32 base = 0;
+        u32 n = SHADOWED_COUNT;
+        while (n > 1) {
+            u32 half = n / 2;
+            base = (SHADOWED[base + half - 1] < offset) ? base + half : base;
+            n -= half;
+        }
+        return SHADOWED[base] == offset;
+    }
+    
+    constexpr bool rangesSorted()
+    {
+        for (u32 i = 0; i < RANGE_COUNT; i++) {
+            if (RANGES[i].start > RANGES[i].end) {
+                return false;
+            }
+            if (i > 0 && RANGES[i - 1].end >= RANGES[i].start) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    constexpr bool shadowedSorted()
+    {
+        for (u32 i = 1; i < SHADOWED_COUNT; i++) {
+            if (SHADOWED[i - 1] >= SHADOWED[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    /* The searches above are only valid on sorted, non-overlapping tables */
+    static_assert(rangesSorted(), "forcewake ranges must be sorted and disjoint");
+    static_assert(shadowedSorted(), "shadowed registers must be sorted");
+    
+    /* Spot checks against the register definitions */
+    static_assert(lookup(TGL_REGS::FORCEWAKE_ACK_RENDER_GEN9) == 0, "ack registers are always on");
+    static_assert(lookup(TGL_REGS::FORCEWAKE_ACK_GT_GEN9) == 0, "ack registers are always on");
+    static_assert(lookup(TGL_REGS::ECOBUS) == FORCEWAKE_GT, "ECOBUS is in the GT well");
+    static_assert(lookup(TGL_REGS::GEN11_EU_DISABLE) == FORCEWAKE_GT, "EU fuses are in the GT well");
+    static_assert(lookup(TGL_REGS::GEN6_GT_THREAD_STATUS) == 0, "thread status needs no forcewake");
+    static_assert(lookup(TGL_REGS::RENDER_RING_BASE) == FORCEWAKE_RENDER, "RCS is in the render well");
+    static_assert(lookup(TGL_REGS::BLT_RING_BASE) == FORCEWAKE_GT, "BCS is in the GT well");
+    static_assert(lookup(TGL_REGS::GEN11_BSD_RING_BASE) == FORCEWAKE_MEDIA, "VCS0 is in the media well");
+    static_assert(lookup(TGL_REGS::GEN11_VEBOX_RING_BASE) == FORCEWAKE_MEDIA, "VECS0 is in the media well");
+    static_assert(lookup(0x1dffff) == FORCEWAKE_MEDIA && lookup(0x1e0000) == 0, "table end");
+    static_assert(isShadowed(TGL_REGS::RENDER_RING_BASE + TGL_REGS::RING_TAIL), "RCS tail is shadowed");
+    static_assert(!isShadowed(TGL_REGS::RENDER_RING_BASE), "RCS base is not shadowed");
+};
+
 #endif /* IntelUncore_h */